@@ -6,11 +6,19 @@
 #include <atomic>
 #include <iostream>
 #include <unordered_map>
+#include <functional>
+#include <exception>
+#include <thread>
+#include <mutex>
 #include <memx/memx.h>
 #include <memx/accl/dfp.h>
 #include <memx/accl/MxModel.h>
 #include <memx/accl/utils/path.h>
 #include <memx/accl/utils/mxTypes.h>
+#include <memx/accl/utils/device_state.h>
+#include <memx/accl/utils/context_health.hpp>
+#include <memx/accl/utils/context_allocator.hpp>
+#include <memx/accl/utils/power_governor.hpp>
 
 
 namespace MX
@@ -25,6 +33,12 @@ namespace MX
       int num_models;//Number of models DFP is compiled
       Dfp::DfpMeta dfp_meta;
       std::vector<int> context_ids_vector;
+      int context_owner;//dfp the contexts were opened for, the resident dfp for a dfp that swaps with it
+      std::vector<int> device_ids;//MXA devices the DFP runs on, only shared with the DFPs it swaps with
+      std::vector<uint8_t> preloaded_bytes;//DFP file kept in memory so swapping it in does not read the file again
+      uint64_t content_hash;//hash of the DFP content, 0 until needed or if it can't be computed
+      MX::Types::ConnectStats connect_stats;
+      MX::Utils::context_health* health;//health of the contexts, shared with the DFPs it swaps with. NULL till the contexts are opened
       bool valid;
       bool is_bytes;
       bool use_multigroup_lb;
@@ -36,6 +50,8 @@ namespace MX
       int number_of_contexts_attached; // should be less than 32 per device
       std::vector<int> contexts_ids_attached;
       int current_config;
+      MX::Utils::device_state state;//what is known to be configured and downloaded on the device
+      int configs_skipped;//setup steps found done on the device when it was connected
       // int last_context_attached;
     };
 
@@ -48,12 +64,51 @@ namespace MX
         bool setup_mxa(int dfp_tag, std::vector<int>& pgroup_ids);
         void attach_dfp_to_device(int dfp_tag);
         void download_dfp_to_device(int dfp_tag);
+        //Undo a connect that failed after setup_mxa: close the contexts of the dfp and give back the devices it claimed,
+        //devices shared with another dfp stay with it
+        void release_dfp_devices(int dfp_tag);
+        //Forget a dfp whose connect failed before its models were made
+        void remove_dfp(int dfp_tag);
+        //Fail the next count context downloads, to test how a failed connect is handled
+        void inject_download_fault(int count);
+        //Claim the free devices that can run a connected dfp and download it to them, the models of the dfp have to
+        //be given the new contexts and health. Returns the devices added
+        std::vector<int> add_free_devices(int dfp_tag);
+        void share_mxa(int dfp_tag, int resident_dfp_tag);
+        void preload_dfp(int dfp_tag);
+        void swap_dfp(int dfp_tag);
         void init_mx_models(int dfp_tag, std::vector<ModelBase *>* mxmodel_vector );
 
         //Getter functions
         int get_dfp_num_chips(int dfp_tag);
         int get_dfp_num_models(int dfp_tag);
         bool get_dfp_validity(int dfp_tag);
+        MX::Types::ConnectStats get_connect_stats(int dfp_tag);
+        MX::Utils::context_health* get_context_health(int dfp_tag);
+        std::vector<MX::Types::ContextHealth> get_context_health_stats(int dfp_tag);
+        std::vector<int> get_dfp_device_ids(int dfp_tag);
+        std::vector<MX::Types::DeviceCapacity> get_dfp_device_capacity(int dfp_tag);
+        //Device of each context of the dfp, in the order of the contexts of its models
+        std::vector<int> get_dfp_context_devices(int dfp_tag);
+        int get_device_frequency(int device_id);
+
+        //Change the frequency of all chips of a connected device in MHz, throws if a chip refuses it
+        void set_device_frequency(int device_id, int frequency);
+
+        //Move the frequency of the devices of a dfp with the load of its models, POWER_STATIC stops the changes
+        void set_power_policy(int dfp_tag, const MX::Types::PowerPolicy& policy, const std::vector<ModelBase*>& dfp_models);
+        //Frequency and load of each device of a dfp, empty if no power policy was set for the dfp
+        std::vector<MX::Types::DevicePowerStats> get_power_stats(int dfp_tag);
+        //Stop or start the governors of all dfps (dfp_tag -1) or of one dfp, only governors of a dynamic policy are started
+        void stop_power_governors(int dfp_tag = -1);
+        void start_power_governors(int dfp_tag = -1);
+        //Make the governor of a dfp again for the contexts the dfp has now, keeping its policy
+        void refresh_power_governor(int dfp_tag);
+        //Delete the governors, to be called before the models they sample are deleted
+        void delete_power_governors();
+
+        //Skip the configuration and downloads already in place on the devices, for the dfps set up afterwards
+        void set_device_cache(bool enable);
 
         void close_all_devices();
         void cleanup__all_dfps();
@@ -77,10 +132,39 @@ namespace MX
         void throw_chip_exception(int pdfp_chips, int pdevice_chips, int device_id);
         void throw_mxa_gen_exception(int pdfp_num_chips);
         bool configure_device(int device_id, int device_chip_count, int pdfp_num_chips, float pmx_gen);
+        memx_status config_mpu_group(int device_id, int config);
+        uint64_t dfp_content_hash(int dfp_tag);
+        memx_status download_context(dfp_rt_info& ddi, int ctx);
+        //Bring a failed context back: stop its streams, download the dfp again and restart them
+        void reset_context(dfp_rt_info& ddi, int context_idx);
         void throw_device_not_available_exception(int pdevice_id);
         bool connect_device(int dfp_tag, int device_id);
+        void connect_listed_devices(int dfp_tag, const std::vector<int>& pgroup_ids);
+        //true if the chip count of the device suits the dfp
+        bool device_fits_dfp(int device_id, int dfp_tag);
+        //Connect every free device that can run the dfp, the ones that fail are left out
+        std::vector<int> claim_free_devices(int dfp_tag);
+        //Close the contexts of a device and unlock it
+        void release_device(int device_id);
+        void create_context_health(dfp_rt_info& ddi);
+        std::vector<std::exception_ptr> download_to_devices(int dfp_tag, const std::vector<int>& device_ids);
 
         void set_power_mode(int device_id, int num_chips);
+        void set_chip_frequency(int device_id, int num_chips, int frequency);
+        void open_device_contexts(int device_id, int dfp_tag, bool use_multigroup_lb);
+        //Contexts of a device opened for a dfp, in the order they were opened
+        std::vector<int> device_contexts_of(int device_id, int owner_tag);
+        void close_device_contexts(int device_id, int owner_tag);
+        //true if a device in use by other dfps has an MPU group left for the dfp
+        bool device_has_spare_group(int device_id, int dfp_tag);
+
+        MX::Utils::power_governor* create_power_governor(int dfp_tag, const std::vector<ModelBase*>& dfp_models);
+
+        //Run fun(i) for device i of a list, all devices at once, and return the error of each device
+        std::vector<std::exception_ptr> run_per_device(int num_devices, const std::function<void(int)>& fun);
+        void throw_device_errors(const std::vector<int>& device_ids, const std::vector<std::exception_ptr>& errors);
+        //The devices without an error, the others are reported and released if release is set
+        std::vector<int> keep_working_devices(const std::vector<int>& device_ids, const std::vector<std::exception_ptr>& errors, bool release);
 
 
         using mxmaptype = std::unordered_map<int, MX::Runtime::dfp_rt_info>;
@@ -94,8 +178,19 @@ namespace MX
         int required_devices;
         int number_of_context_per_dfp;
         int group_id_passed;
+        bool device_cache_enabled;
+        std::atomic_int download_faults;
         std::vector<int> available_devices_id;
         std::vector<int> open_devices;
+        //guards the device states changed while streaming, by context recoveries and frequency changes
+        std::mutex device_state_mutex;
+
+        //frequency governor of each dfp with a power policy and the models it samples, by dfp tag
+        struct power_control{
+            MX::Utils::power_governor* governor;
+            std::vector<ModelBase*> models;
+        };
+        std::unordered_map<int, power_control> power_governors_;
 
     };// DeviceManager
 
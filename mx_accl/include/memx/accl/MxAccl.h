@@ -5,6 +5,8 @@
 #include <stdint.h>
 #include <atomic>
 #include <thread>
+#include <exception>
+#include <unordered_map>
 
 #include <memx/accl/MxModel.h>
 #include <memx/accl/dfp.h>
@@ -32,49 +34,85 @@ namespace MX
       MxAccl();
 
       /**
-       * @brief Connect a dfp to MxAccl object. Currently only one connect_dfp per MxAccl object is allowed.
+       * @brief Connect a dfp to MxAccl object. Several dfps can be connected, each to its own devices.
        *
        * @param file_path Absolute path of DFP file. char* and String types can also be passed.
-       * @param device_ids_to_use IDs of MXA devices this process intends to use. takes in a vector of IDs and will return an error if an empty vector is passed
+       * @param device_ids_to_use IDs of MXA devices this process intends to use. takes in a vector of IDs and will return an error if an empty vector is passed.
+       * {MX::Types::ALL_DEVICES} claims every free device that can run the dfp, the vector is then replaced by the IDs claimed
        *
        * @return dfp_id which is later to be passed in connect_stream function to specify that specific stream to a dfp
        */
       int connect_dfp(const std::filesystem::path dfp_path,std::vector<int>& device_ids_to_use);
 
       /**
-       * @brief Connect a dfp to MxAccl object. Currently only one connect_dfp per MxAccl object is allowed.
+       * @brief Connect a dfp to MxAccl object. Several dfps can be connected, each to its own devices.
        *
        * @param file_path Absolute path of DFP file. char* and String types can also be passed.
        * @param group_id GroupId of MPU this application is intended to use.
        * group_id is defaulted to 0, but needs to be provided if using
-       * any other group
+       * any other group. MX::Types::ALL_DEVICES claims every free device that can run the dfp
        *
        * @return dfp_id which is later to be passed in connect_stream function to specify that specific stream to a dfp
        */
       int connect_dfp(const std::filesystem::path dfp_path,int group_id = 0);
 
       /**
-       * @brief Connect a dfp as bytes to MxAccl object. Currently only one connect_dfp per MxAccl object is allowed.
+       * @brief Connect a dfp as bytes to MxAccl object. Several dfps can be connected, each to its own devices.
        *
        * @param dfp_bytes Raw uint8_t* pointer to DFP data
-       * @param device_ids_to_use IDs of MXA devices this process intends to use. takes in a vector of IDs and will return an error if an empty vector is passed
+       * @param device_ids_to_use IDs of MXA devices this process intends to use. takes in a vector of IDs and will return an error if an empty vector is passed.
+       * {MX::Types::ALL_DEVICES} claims every free device that can run the dfp, the vector is then replaced by the IDs claimed
        *
        * @return dfp_id which is later to be passed in connect_stream function to specify that specific stream to a dfp
        */
       int connect_dfp(const uint8_t *dfp_bytes, std::vector<int>& device_ids_to_use);
 
       /**
-       * @brief Connect a dfp as bytes to MxAccl object. Currently only one connect_dfp per MxAccl object is allowed.
+       * @brief Connect a dfp as bytes to MxAccl object. Several dfps can be connected, each to its own devices.
        *
        * @param dfp_bytes Raw uint8_t* pointer to DFP data
        * @param group_id GroupId of MPU this application is intended to use.
        * group_id is defaulted to 0, but needs to be provided if using
-       * any other group
+       * any other group. MX::Types::ALL_DEVICES claims every free device that can run the dfp
        *
        * @return dfp_id which is later to be passed in connect_stream function to specify that specific stream to a dfp
        */
       int connect_dfp(const uint8_t *dfp_bytes, int group_id = 0);
 
+      /**
+       * @brief Connect a dfp like connect_dfp() but return before the dfp is downloaded to the devices. The dfp is parsed,
+       * the devices are set up and the models are created before returning, the download runs in the background. Meanwhile
+       * the pre and post models can be connected, the streams connected and the models configured; start() allocates the
+       * featureMaps before it waits for the download. Errors of the download are thrown by wait_connect() and start().
+       * Calls that use the devices of the dfp, such as set_power_policy() or get_context_health(), wait for the download first.
+       *
+       * @param file_path Absolute path of DFP file. char* and String types can also be passed.
+       * @param device_ids_to_use IDs of MXA devices this process intends to use. takes in a vector of IDs and will return an error if an empty vector is passed.
+       * {MX::Types::ALL_DEVICES} claims every free device that can run the dfp, the vector is then replaced by the IDs claimed
+       *
+       * @return dfp_id which is later to be passed in connect_stream function to specify that specific stream to a dfp
+       */
+      int connect_dfp_async(const std::filesystem::path dfp_path,std::vector<int>& device_ids_to_use);
+
+      /**
+       * @brief Connect a dfp as bytes like connect_dfp_async() above. The bytes have to stay valid till the download is done.
+       *
+       * @param dfp_bytes Raw uint8_t* pointer to DFP data
+       * @param device_ids_to_use IDs of MXA devices this process intends to use. takes in a vector of IDs and will return an error if an empty vector is passed.
+       * {MX::Types::ALL_DEVICES} claims every free device that can run the dfp, the vector is then replaced by the IDs claimed
+       *
+       * @return dfp_id which is later to be passed in connect_stream function to specify that specific stream to a dfp
+       */
+      int connect_dfp_async(const uint8_t *dfp_bytes, std::vector<int>& device_ids_to_use);
+
+      /**
+       * @brief Wait for the download of dfps connected with connect_dfp_async(). Returns right away for dfps connected
+       * with connect_dfp(). Throws the error of a failed download, the dfp can't be run then.
+       *
+       * @param dfp_id id of dfp returned by connect_dfp_async() function, -1 waits for all dfps
+       */
+      void wait_connect(int dfp_id = -1);
+
       //Destructor
       ~MxAccl();
 
@@ -100,12 +138,38 @@ namespace MX
       void wait();
 
       /**
-       * @brief Get number of models in the compiled DFP
+       * @brief Get number of models of all connected dfps. Methods that take a model index but no dfp_id count
+       * the models of all dfps in connect order, the models of the second dfp follow those of the first one.
        *
        * @return Number of models
        */
       int get_num_models();
 
+      /**
+       * @brief Get number of models in the compiled DFP
+       *
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return Number of models, 0 if no dfp with this id is connected
+       */
+      int get_num_models(int dfp_id);
+
+      /**
+       * @brief Get number of dfps connected to the object
+       *
+       * @return Number of dfps
+       */
+      int get_num_dfps();
+
+      /**
+       * @brief Get the index of a model of a dfp among the models of all dfps, as taken by the methods that have
+       * a model index but no dfp_id. Throws runtime error if the dfp or the model doesn't exist.
+       *
+       * @param model_id Index of the model in its dfp
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return Index of the model
+       */
+      int get_model_index(int model_id, int dfp_id) const;
+
       /**
        * @brief Get number the number of streams connected to the object
        *
@@ -116,9 +180,48 @@ namespace MX
       /**
        * @brief Get number of chips the dfp is compiled for
        *
+       * @param dfp_id id of dfp returned by connect_dfp() function
        * @return Number of chips
        */
-      int get_dfp_num_chips();
+      int get_dfp_num_chips(int dfp_id = 0);
+
+      /**
+       * @brief Let connect_dfp skip the MPU group configuration, power settings and dfp downloads that the last
+       * process using the devices left in place. The runtime records what it configured and downloaded on each
+       * device in a file that doesn't outlive a reboot; the dfp is identified by a hash of its content, dfps passed
+       * as bytes are always downloaded. Only enable it if the devices are not reset or reprogrammed by other tools
+       * between runs, e.g. by reloading the driver. Applies to the dfps connected after the call, default is disabled.
+       *
+       * @param enable true to skip the setup steps already done on the devices
+       */
+      void set_device_cache(bool enable);
+
+      /**
+       * @brief Get the time spent in each phase of connecting a dfp and the device setup steps that were skipped.
+       * Waits for the download of a dfp connected with connect_dfp_async().
+       *
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return ConnectStats of the dfp
+       */
+      MX::Types::ConnectStats get_connect_stats(int dfp_id = 0);
+
+      /**
+       * @brief Get the devices a dfp runs on, their chips and contexts and the share of the frames each one takes.
+       *
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return DeviceCapacity of each device of the dfp
+       */
+      std::vector<MX::Types::DeviceCapacity> get_device_capacity(int dfp_id = 0);
+
+      /**
+       * @brief Claim the free devices that can run a dfp and were not there when it was connected, e.g. devices
+       * plugged in or released by other processes since, and send frames of the dfp to them too. Devices that
+       * fail to come up are left out with a warning. Cannot be called while MxAccl is running.
+       *
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return IDs of the devices added, empty if no new device was found
+       */
+      std::vector<int> add_free_devices(int dfp_id = 0);
 
       /**
        * @brief Connect a stream to a model
@@ -134,6 +237,72 @@ namespace MX
        * @param dfp_id -> id of dfp returned by connect_dfp() function
       */
       void connect_stream(float_callback_t in_cb, float_callback_t out_cb, int stream_id, int model_id=0, int dfp_id = 0);
+
+      /**
+       * @brief Connect a stream to a model with scheduling options
+       * - Same as connect_stream above, the options decide how this stream shares the send stage of the model
+       * with the other streams of that model under the policy set with set_schedule_policy().
+       * @param in_cb -> input callback function used by this stream
+       * @param out_cb -> output callback function used by this stream
+       * @param stream_id -> Unique id given to this stream which can later
+       *              be used in the corresponding callback functions
+       * @param options -> weight, priority class and per-frame deadline budget of this stream
+       * @param model_id -> Index of model this stream is intended to be connected
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+      */
+      void connect_stream(float_callback_t in_cb, float_callback_t out_cb, int stream_id, const MX::Types::StreamOptions& options, int model_id=0, int dfp_id = 0);
+      /**
+       * @brief Route the outputs of model_a to the inputs of model_b, for models compiled into one DFP such as a backbone
+       * and a head. Every stream later connected to model_a runs through both models: its input callback feeds model_a and
+       * its output callback gets the outputs of model_b. The outputs of model_a are handed to model_b by the runtime, their
+       * formatted data is copied as is when the ports agree on format and shape, so no decode and encode is done on the host.
+       * Both models keep running pipelined. Pipelines can be chained (a to b, b to c).
+       * - The outputs of model_a must match the inputs of model_b in number and size. A pre-processing model of model_b
+       * is not applied to pipelined frames.
+       * - connect_pipeline should be called before connecting the streams of model_a and before calling start().
+       * @param model_a -> Index of the upstream model
+       * @param model_b -> Index of the model consuming the outputs of model_a
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+      */
+      void connect_pipeline(int model_a, int model_b, int dfp_id = 0);
+
+      /**
+       * @brief Connect a stream to a model while MxAccl is running, e.g. when a camera comes online. The featureMaps of the
+       * stream are allocated when it is attached and its input callback starts right away, the other streams of the model
+       * keep running undisturbed. Before start() this is the same as connect_stream(). A model can hold up to the number of
+       * streams set with set_max_streams() while running, a detached stream frees its place for the next attached one.
+       * - A freshest_only stream can only be attached while running if the pipeline depth of the model is >= 2.
+       * @param in_cb -> input callback function used by this stream
+       * @param out_cb -> output callback function used by this stream
+       * @param stream_id -> Unique id given to this stream which can later
+       *              be used in the corresponding callback functions
+       * @param model_id -> Index of model this stream is intended to be connected
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+      */
+      void attach_stream(float_callback_t in_cb, float_callback_t out_cb, int stream_id, int model_id=0, int dfp_id = 0);
+
+      /**
+       * @brief Same as attach_stream above with scheduling options, see connect_stream().
+       * @param in_cb -> input callback function used by this stream
+       * @param out_cb -> output callback function used by this stream
+       * @param stream_id -> Unique id given to this stream which can later
+       *              be used in the corresponding callback functions
+       * @param options -> weight, priority class and per-frame deadline budget of this stream
+       * @param model_id -> Index of model this stream is intended to be connected
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+      */
+      void attach_stream(float_callback_t in_cb, float_callback_t out_cb, int stream_id, const MX::Types::StreamOptions& options, int model_id=0, int dfp_id = 0);
+
+      /**
+       * @brief Disconnect a stream, e.g. when a camera goes offline. While MxAccl is running, the input callback of the
+       * stream is no longer called and this function blocks till the frames it already produced have gone through the
+       * output callback, then the featureMaps of the stream are released. Only this stream is drained, the other streams
+       * keep their frames in flight. Before start() or after stop() the stream is simply removed.
+       * - Should not be called from a callback of the stream or concurrently with stop().
+       * @param stream_id -> id of the stream given in connect_stream or attach_stream
+      */
+      void detach_stream(int stream_id);
+
       // /**
       //  * @brief Connect a stream to a model
       //  * - float_callback_t is a function pointer of type, bool foo(vector<const MX::Types::FeatureMap<float>*>, int).
@@ -183,6 +352,169 @@ namespace MX
       */
       void set_num_workers(int input_num_workers, int output_num_workers,int model_idx=0);
 
+      /**
+       * @brief Set the number of frames each stream of a model can have in flight. With a depth of N, the input
+       * callback of a stream can fill up to N frames ahead and the MXA can work on them while earlier outputs are
+       * still being processed by the output callback. Output callbacks of a stream are still called one at a time
+       * and in the order the inputs were produced. The default depth is 1. This method should be called before calling start().
+       * While a stream of the model is freshest_only, the model runs with a depth of at least 2 so the newest frame
+       * has a slot of its own. The depth set here is kept and used again once no stream is freshest_only.
+       *
+       * @param depth Number of featureMap sets allocated per stream. Must be >= 1
+       * @param model_idx Index of model to which the depth is applied. The default is set to 0
+      */
+      void set_pipeline_depth(int depth, int model_idx=0);
+
+      /**
+       * @brief Set the number of streams a model can hold while running, including the streams attached with
+       * attach_stream(). The per-stream bookkeeping is reserved for this many streams at start() so attaching
+       * doesn't disturb the running streams. The default is 64, raised to the number of connected streams if lower.
+       * This method should be called before calling start().
+       *
+       * @param max_streams Number of streams. Must be >= 1
+       * @param model_idx Index of model to which the limit is applied. The default is set to 0
+      */
+      void set_max_streams(int max_streams, int model_idx=0);
+
+      /**
+       * @brief Set the order in which the send stage of a model serves the filled inputs of its streams.
+       * The default is SCHEDULE_FIFO. Weights, priority classes and deadlines of the streams are given
+       * in connect_stream. This method should be called before calling start().
+       *
+       * @param policy One of MX::Types::StreamSchedulePolicy
+       * @param model_idx Index of model to which the policy is applied. The default is set to 0
+      */
+      void set_schedule_policy(MX::Types::StreamSchedulePolicy policy, int model_idx=0);
+
+      /**
+       * @brief Enable a runtime controller that resizes the input/output worker pools and the FeatureMap conversion
+       * threads of a model while it runs. It watches how busy the callbacks keep the workers and how long the MXA waits
+       * for inputs or for output callbacks, and moves one step at a time within the bounds of config. Each decision is
+       * logged to stdout. The counts set with set_num_workers() and set_parallel_fmap_convert() are used as starting
+       * points. This method should be called before calling start().
+       *
+       * @param enable true to enable the controller, false to keep the worker counts fixed
+       * @param config bounds and decision interval of the controller
+       * @param model_idx Index of model to be tuned. The default is set to 0
+      */
+      void set_auto_tune(bool enable, const MX::Types::AutoTuneConfig& config = MX::Types::AutoTuneConfig(), int model_idx=0);
+
+      /**
+       * @brief Set where and how the threads of a model run: CPU affinity, SCHED_FIFO priority or nice level of the
+       * input workers, output workers, send thread and recv threads, and whether the featureMap buffers are mlocked
+       * and prefaulted. Threads are always named (mx_in_*, mx_out_*, mx_send_*, mx_recv_*) so they can be told apart
+       * in top and perf. Settings the process is not allowed to apply are reported on stderr and skipped.
+       * This method should be called before calling start().
+       *
+       * @param policy placement of every stage of the model
+       * @param model_idx Index of model to which the policy is applied. The default is set to 0
+      */
+      void set_thread_policy(const MX::Types::ThreadPolicy& policy, int model_idx=0);
+
+      /**
+       * @brief Set how stop() winds a model down. stop() waits for the outputs the MXA already produced to reach the
+       * output callbacks, for up to drain_timeout_ms, and drops the rest. With keep_buffers the featureMaps of the model
+       * stay allocated after stop() and are reused by the next start(), which makes stop/start cycles with the same
+       * streams cheap. This method should be called before calling start().
+       *
+       * @param policy drain deadline and buffer keeping of the model
+       * @param model_idx Index of model to which the policy is applied. The default is set to 0
+      */
+      void set_stop_policy(const MX::Types::StopPolicy& policy, int model_idx=0);
+
+      /**
+       * @brief Get the time the frames of a stream waited in the send stage since the last start().
+       *
+       * @param stream_id id of the stream given in connect_stream
+       * @return StreamStats of the stream, throws runtime error if no stream with this id is connected
+      */
+      MX::Types::StreamStats get_stream_stats(int stream_id);
+
+      /**
+       * @brief Set how the send stage of a model spreads frames over the contexts (device groups) of the DFP.
+       * The default is round robin. DISPATCH_LEAST_OUTSTANDING sends each frame to the context with the least
+       * queued work, which keeps slower devices from holding back the others. This method should be called before calling start().
+       *
+       * @param options dispatch policy and stream affinity
+       * @param model_idx Index of model to which the options are applied. The default is set to 0
+      */
+      void set_dispatch_options(const MX::Types::DispatchOptions& options, int model_idx=0);
+
+      /**
+       * @brief Get the frames sent to and in flight on each context of a model since the last start().
+       *
+       * @param model_idx Index of model. The default is set to 0
+       * @return DispatchStats of the model
+      */
+      MX::Types::DispatchStats get_dispatch_stats(int model_idx=0);
+
+      /**
+       * @brief Set how the models of a dfp handle a context (device group) that fails. The failed context stops
+       * getting frames, the next frames go to the other contexts of the dfp and the context is reset and downloaded
+       * again in the background. Frames that were on the context are dropped, or sent again to another context with
+       * replay_in_flight. Frames of a stream keep their order either way, a dropped frame skips its output callback
+       * and is counted in the stream stats. This method should be called before calling start().
+       *
+       * @param policy replay, ofmap timeout and recovery attempts
+       * @param dfp_id id of dfp returned by connect_dfp() function
+      */
+      void set_failover_policy(const MX::Types::FailoverPolicy& policy, int dfp_id=0);
+
+      /**
+       * @brief Get the health of each context of a dfp: whether it takes frames, its failures and recoveries.
+       *
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return ContextHealth of each context of the dfp, in the order of the contexts used by the dispatch stats
+      */
+      std::vector<MX::Types::ContextHealth> get_context_health(int dfp_id=0);
+
+      /**
+       * @brief Wait till the contexts of a dfp that failed are recovered or given up on.
+       *
+       * @param timeout_ms maximum wait in milliseconds, 0 waits forever
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return false on timeout
+      */
+      bool wait_context_recovery(int32_t timeout_ms=0, int dfp_id=0);
+
+      /**
+       * @brief Fail the next frames read from a context of a dfp as if the device had returned an error, to test
+       * how an application copes with failover. The outputs of these frames are dropped and the context is reset.
+       *
+       * @param context_idx Index of the context in the dispatch stats of the models of the dfp
+       * @param count Number of frames to fail
+       * @param dfp_id id of dfp returned by connect_dfp() function
+      */
+      void inject_context_fault(int context_idx, int count=1, int dfp_id=0);
+
+      /**
+       * @brief Fail the next dfp downloads to contexts as if the device had refused them, to test how an application
+       * copes with a failed connect_dfp. The connect throws and gives back the devices it claimed.
+       *
+       * @param count Number of context downloads to fail
+      */
+      void inject_download_fault(int count=1);
+
+      /**
+       * @brief Set how the frequency of the devices of a dfp follows their load. The load of each device, the share of
+       * time it has frames in flight and the frames waiting to be sent to it, is sampled in the background and the
+       * frequency is stepped between min_frequency and max_frequency. Every change is logged. Can be called at any
+       * time, e.g. to trade throughput for power by time of day. POWER_STATIC stops the changes and keeps the current
+       * frequency. Throws logic error if the devices of the dfp already follow the policy of another dfp.
+       *
+       * @param policy profile, frequency range and hysteresis
+       * @param dfp_id id of dfp returned by connect_dfp() function
+      */
+      void set_power_policy(const MX::Types::PowerPolicy& policy, int dfp_id=0);
+
+      /**
+       * @brief Get the frequency and load of each device of a dfp, empty if no power policy was set for the dfp.
+       *
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return DevicePowerStats of each device of the dfp
+      */
+      std::vector<MX::Types::DevicePowerStats> get_power_stats(int dfp_id=0);
+
       /**
        * @brief Connect the information of the post-processing model that has been cropped by the neural compiler
        *
@@ -220,11 +552,33 @@ namespace MX
 
       int group; //Group of the chip connected
 
-      int dfp_tag;
+      std::vector<int> dfp_model_offset_;//index in models of the first model of each dfp, by dfp id
+
+
+      //download and host side timings of each dfp, by dfp id
+      struct connect_state{
+        std::thread* download = NULL;//download of connect_dfp_async, NULL once joined
+        std::exception_ptr error;
+        double plugins_ms = 0;
+        double buffers_ms = 0;
+        double wait_ms = 0;
+        double total_ms = 0;
+      };
+      std::vector<connect_state> connects_;
+
+      int connect_dfp_devices(const std::filesystem::path& pdfp_path, const uint8_t *dfp_bytes, std::vector<int>& device_ids_to_use, bool async);
+      //join the downloads of dfps first to last, without throwing their errors
+      void join_connects(int first, int last);
+      //dfp id of a model index
+      int model_dfp(int model_idx) const;
 
       std::atomic_bool run;//Flag to know status of the Accl
 
-      std::vector<ModelBase *> models;//Vector of all model objects
+      std::vector<ModelBase *> models;//Vector of all model objects, the models of all dfps in connect order
+
+      std::unordered_map<int, int> pipelines_;//downstream model of each model feeding a pipeline
+      //model indices ordered so that a model comes before the models it feeds
+      std::vector<int> pipeline_order();
 
       MX::Runtime::DeviceManager *device_manager;
 
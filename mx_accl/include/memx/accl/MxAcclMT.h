@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <atomic>
 #include <thread>
+#include <future>
 
 #include <memx/accl/MxModel.h>
 #include <memx/accl/dfp.h>
@@ -12,6 +13,7 @@
 #include <memx/accl/utils/featureMap.h>
 #include <memx/accl/utils/path.h>
 #include <memx/accl/DeviceManager.h>
+#include <memx/accl/utils/awaitable.hpp>
 
 using namespace std;
 
@@ -29,66 +31,155 @@ namespace MX
       MxAcclMT();
 
       /**
-       * @brief Connect a dfp to MxAccl object. Currently only one connect_dfp per MxAccl object is allowed.
+       * @brief Connect a dfp to MxAccl object. Several dfps can be connected, each to its own devices.
        *
        * @param file_path Absolute path of DFP file. char* and String types can also be passed.
-       * @param device_ids_to_use IDs of MXA devices this process intends to use. takes in a vector of IDs and will return an error if an empty vector is passed
+       * @param device_ids_to_use IDs of MXA devices this process intends to use. takes in a vector of IDs and will return an error if an empty vector is passed.
+       * {MX::Types::ALL_DEVICES} claims every free device that can run the dfp, the vector is then replaced by the IDs claimed
        *
        * @return dfp_id which is later to be passed in connect_stream function to specify that specific stream to a dfp
        */
       int connect_dfp(const std::filesystem::path dfp_path,std::vector<int>& device_ids_to_use);
 
       /**
-       * @brief Construct a new MxAccl object. Currently only one connect_dfp per MxAccl object is allowed.
+       * @brief Connect a dfp to MxAccl object. Several dfps can be connected, each to its own devices.
        *
        * @param file_path Absolute path of DFP file. char* and String types can also be passed.
        * @param group_id GroupId of MPU this application is intended to use.
        * group_id is defaulted to 0, but needs to be provided if using
-       * any other group
+       * any other group. MX::Types::ALL_DEVICES claims every free device that can run the dfp
        *
        * @return dfp_id which is later to be passed in connect_stream function to specify that specific stream to a dfp
        */
       int connect_dfp(const std::filesystem::path dfp_path,int group_id = 0);
 
       /**
-       * @brief Connect a dfp as bytes to MxAccl object. Currently only one connect_dfp per MxAccl object is allowed.
+       * @brief Connect a dfp as bytes to MxAccl object. Several dfps can be connected, each to its own devices.
        *
        * @param dfp_bytes Raw uint8_t* pointer to DFP data
-       * @param device_ids_to_use IDs of MXA devices this process intends to use. takes in a vector of IDs and will return an error if an empty vector is passed
+       * @param device_ids_to_use IDs of MXA devices this process intends to use. takes in a vector of IDs and will return an error if an empty vector is passed.
+       * {MX::Types::ALL_DEVICES} claims every free device that can run the dfp, the vector is then replaced by the IDs claimed
        *
        * @return dfp_id which is later to be passed in connect_stream function to specify that specific stream to a dfp
        */
       int connect_dfp(const uint8_t *dfp_bytes, std::vector<int>& device_ids_to_use);
 
       /**
-       * @brief Connect a dfp as bytes to MxAccl object. Currently only one connect_dfp per MxAccl object is allowed.
+       * @brief Connect a dfp as bytes to MxAccl object. Several dfps can be connected, each to its own devices.
        *
        * @param dfp_bytes Raw uint8_t* pointer to DFP data
        * @param group_id GroupId of MPU this application is intended to use.
        * group_id is defaulted to 0, but needs to be provided if using
-       * any other group
+       * any other group. MX::Types::ALL_DEVICES claims every free device that can run the dfp
        *
        * @return dfp_id which is later to be passed in connect_stream function to specify that specific stream to a dfp
        */
       int connect_dfp(const uint8_t *dfp_bytes, int group_id = 0);
 
+      /**
+       * @brief Connect a dfp that takes turns with another dfp on its devices, for when there are more models than
+       * devices. The dfp file is kept in memory and downloaded in place of the dfp on the devices when it has frames
+       * to send and the other dfp has no queued frames, or has sent a whole batch (see set_swap_batch_size). Before a
+       * swap the outputs of the dfp on the devices have to be read, so a thread that waits in send_input for a swap
+       * should not be the one receiving the outputs of the other dfp; run(), submit() and infer() do not have this
+       * issue. Several dfps can take turns on the same devices. The dfps have to be compiled for the same number of
+       * chips. Not to be called while frames are sent to the dfp sharing its devices.
+       *
+       * @param file_path Absolute path of DFP file. char* and String types can also be passed.
+       * @param shared_dfp_id id of a dfp returned by connect_dfp() or connect_swap_dfp(), whose devices are shared
+       *
+       * @return dfp_id to be passed to send_input and the other userThreading functions
+       */
+      int connect_swap_dfp(const std::filesystem::path dfp_path, int shared_dfp_id);
+
+      /**
+       * @brief Set the number of frames a dfp sends while other dfps sharing its devices wait, before they get their
+       * turn. Larger batches spread the swap cost over more frames at the cost of latency. The default is 32.
+       *
+       * @param frames Number of frames, >= 1.
+       * @param dfp_id id of any dfp sharing the devices
+       */
+      void set_swap_batch_size(int frames, int dfp_id);
+
+      /**
+       * @brief Get swap counts and latencies of the dfps taking turns on the devices of a dfp.
+       *
+       * @param dfp_id id of any dfp sharing the devices
+       * @return SwapStats of the dfps sharing the devices
+       */
+      MX::Types::SwapStats get_swap_stats(int dfp_id);
+
 
       //Destructor
       ~MxAcclMT();
 
       /**
-       * @brief Get number of models in the compiled DFP
+       * @brief Get number of models of all connected dfps. Methods that take a model index but no dfp_id count
+       * the models of all dfps in connect order, the models of the second dfp follow those of the first one.
        *
        * @return Number of models
        */
       int get_num_models();
 
+      /**
+       * @brief Get number of models in the compiled DFP
+       *
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return Number of models, 0 if no dfp with this id is connected
+       */
+      int get_num_models(int dfp_id);
+
+      /**
+       * @brief Get number of dfps connected to the object
+       *
+       * @return Number of dfps
+       */
+      int get_num_dfps();
+
+      /**
+       * @brief Get the index of a model of a dfp among the models of all dfps, as taken by the methods that have
+       * a model index but no dfp_id. Throws runtime error if the dfp or the model doesn't exist.
+       *
+       * @param model_id Index of the model in its dfp
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return Index of the model
+       */
+      int get_model_index(int model_id, int dfp_id) const;
+
       /**
        * @brief Get number of chips the dfp is compiled for
        *
+       * @param dfp_id id of dfp returned by connect_dfp() function
        * @return Number of chips
        */
-      int get_dfp_num_chips();
+      int get_dfp_num_chips(int dfp_id = 0);
+
+      /**
+       * @brief Let connect_dfp skip the MPU group configuration, power settings and dfp downloads that the last
+       * process using the devices left in place. The runtime records what it configured and downloaded on each
+       * device in a file that doesn't outlive a reboot; the dfp is identified by a hash of its content, dfps passed
+       * as bytes are always downloaded. Only enable it if the devices are not reset or reprogrammed by other tools
+       * between runs, e.g. by reloading the driver. Applies to the dfps connected after the call, default is disabled.
+       *
+       * @param enable true to skip the setup steps already done on the devices
+       */
+      void set_device_cache(bool enable);
+
+      /**
+       * @brief Get the time connect_dfp spent setting up the devices of a dfp and the steps it skipped.
+       *
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return ConnectStats of the dfp
+       */
+      MX::Types::ConnectStats get_connect_stats(int dfp_id = 0);
+
+      /**
+       * @brief Get the devices a dfp runs on, their chips and contexts and the share of the frames each one takes.
+       *
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return DeviceCapacity of each device of the dfp
+       */
+      std::vector<MX::Types::DeviceCapacity> get_device_capacity(int dfp_id = 0);
 
 
       /**
@@ -169,6 +260,64 @@ namespace MX
       */
       bool receive_output(std::vector<float*> &out_data, int model_id, int stream_id, int dfp_id=0, bool channel_first = false, int32_t timeout=0);
 
+      /**
+       * @brief Receive the output of a stream in userThreading mode if one is ready, without waiting.
+       *
+       * @param out_data -> vector of output buffers, same as receive_output
+       * @param model_id -> Index of the model the data is intended to come from.
+       * @param stream_id -> Index of stream the output data belongs to.
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+       * @param channel_first -> boolean variable that indicates the copied data is in channel first or channle last format. default is false expecting data in channel last format
+       * @return Returns true if an output was copied to out_data and false if none is ready.
+      */
+      bool try_receive_output(std::vector<float*> &out_data, int model_id, int stream_id, int dfp_id=0, bool channel_first = false);
+
+      /**
+       * @brief Get an eventfd that becomes readable when outputs are ready to be received (Linux only). It can be added
+       * to epoll, libuv or asio loops next to sockets and camera fds. Its counter is incremented once per ready output,
+       * so read it first and then call try_receive_output until it returns false. The fd is owned and closed by MxAcclMT.
+       *
+       * @param model_id -> Index of the model.
+       * @param stream_id -> Index of the stream, or -1 for an fd signaled for the outputs of every stream of the model.
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+       * @return file descriptor of the eventfd, the same one is returned on every call
+      */
+      int get_event_fd(int model_id, int stream_id = -1, int dfp_id=0);
+
+      /**
+       * @brief Send several frames of a stream to the accelerator in userThreading mode. The frames are encoded
+       * in parallel and submitted back to back, which costs less per frame than calling send_input for each of them.
+       * Their outputs are received in the same order with receive_output or receive_batch. Each frame of the batch has
+       * an output buffer of its own, so the whole batch can be sent before its outputs are received on the same thread.
+       * Models with a pre or post-processing model are the exception: their frames are sent one by one and the outputs
+       * have to be received by another thread while the batch is sent.
+       *
+       * @param batch -> one vector of input data per frame, each laid out as in send_input
+       * @param model_id -> Index of the model the data is targetted to.
+       * @param stream_id -> Index of stream the input data belongs to.
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+       * @param channel_first -> boolean variable that indicates the copied data is in channel first or channle last format. default is false expecting data in channel last format
+       * @param timeout -> Wait time in milliseconds for each frame to be sent. Default is 0 which indicates that the function never timesout.
+       * @return Returns true if all frames are sent and false if a timeout happens.
+      */
+      bool send_batch(const std::vector<std::vector<float*>>& batch, int model_id, int stream_id, int dfp_id=0, bool channel_first = false, int32_t timeout = 0);
+
+      /**
+       * @brief Receive the outputs of num_frames frames of a stream in userThreading mode into contiguous arrays.
+       * Output i of the f-th frame is copied to out_data[i] + f * size of output i, so out_data[i] needs room for
+       * num_frames outputs.
+       *
+       * @param out_data -> vector with one contiguous buffer per model output
+       * @param num_frames -> Number of frames to receive.
+       * @param model_id -> Index of the model the data is intended to come from.
+       * @param stream_id -> Index of stream the output data belongs to.
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+       * @param channel_first -> boolean variable that indicates the copied data is in channel first or channle last format. default is false expecting data in channel last format
+       * @param timeout -> Wait time in milliseconds for each frame to be received. Default is 0 which indicates that the function never timesout.
+       * @return Returns true if all frames are received and false if a timeout happens.
+      */
+      bool receive_batch(std::vector<float*> &out_data, int num_frames, int model_id, int stream_id, int dfp_id=0, bool channel_first = false, int32_t timeout=0);
+
       // /**
       //  * @brief Run inference on the accelerator in userThreading mode.
       //  *
@@ -199,6 +348,70 @@ namespace MX
       */
       bool run(std::vector<float *> in_data, std::vector<float*> &out_data, int pmodel_id, int pstream_id, int dfp_id=0, bool in_channel_first=false, bool out_channel_first=false, int32_t timeout=0);
 
+      /**
+       * @brief Send a frame in userThreading mode without waiting for its outputs. The input data is copied before
+       * the function returns, the outputs are copied into out_data by the library once they arrive and the returned
+       * future becomes ready. A single application thread can keep many frames in flight across streams and models.
+       * Frames of a stream complete in the order they are submitted. Do not mix submit with receive_output on the same stream.
+       *
+       * @param in_data -> vector of input data, same as send_input
+       * @param out_data -> vector of output buffers, they have to stay valid until the future is ready
+       * @param model_id -> Index of the model the data is targetted to.
+       * @param stream_id -> Index of stream the input data belongs to.
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+       * @param in_channel_first -> boolean variable that indicates the copied input data is in channel first or channle last format. default is false expecting data in channel last format
+       * @param out_channel_first -> boolean variable that indicates the copied output data is in channel first or channle last format. default is false expecting data in channel last format
+       * @param timeout -> Wait time in milliseconds for the frame to be sent. Default is 0 which indicates that the function never timesout.
+       * @return future set to true when the outputs are in out_data, false if the accelerator was stopped before they arrived
+      */
+      std::future<bool> submit(std::vector<float *> in_data, std::vector<float*> out_data, int model_id, int stream_id, int dfp_id=0, bool in_channel_first=false, bool out_channel_first=false, int32_t timeout=0);
+
+      /**
+       * @brief Same as the future version of submit, but on_done is called once the outputs are in out_data. The callback runs
+       * on the receive thread of the model, so it should return quickly and must not call receive_output of the same model.
+       *
+       * @param in_data -> vector of input data, same as send_input
+       * @param out_data -> vector of output buffers, they have to stay valid until on_done is called
+       * @param model_id -> Index of the model the data is targetted to.
+       * @param stream_id -> Index of stream the input data belongs to.
+       * @param on_done -> called with true and the stream id when the outputs are ready, with false if the accelerator was stopped before
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+       * @param in_channel_first -> boolean variable that indicates the copied input data is in channel first or channle last format. default is false expecting data in channel last format
+       * @param out_channel_first -> boolean variable that indicates the copied output data is in channel first or channle last format. default is false expecting data in channel last format
+       * @param timeout -> Wait time in milliseconds for the frame to be sent. Default is 0 which indicates that the function never timesout.
+       * @return Returns true if the frame is sent and false if a timeout happens.
+      */
+      bool submit(std::vector<float *> in_data, std::vector<float*> out_data, int model_id, int stream_id, ModelBase::completion_callback_t on_done, int dfp_id=0, bool in_channel_first=false, bool out_channel_first=false, int32_t timeout=0);
+
+#ifdef MX_ACCL_HAS_COROUTINES
+      /**
+       * @brief Awaitable inference for C++20 coroutines, `bool ok = co_await accl.infer(...)`. The frame is sent
+       * with submit when awaited and the coroutine is resumed once the outputs are in out_data. Only available
+       * when the application is compiled as C++20.
+       *
+       * @param in_data -> vector of input data, same as send_input
+       * @param out_data -> vector of output buffers, they have to stay valid until the coroutine resumes
+       * @param model_id -> Index of the model the data is targetted to.
+       * @param stream_id -> Index of stream the input data belongs to.
+       * @param resume_on -> executor resuming the coroutine, e.g. posting it to an event loop. Default resumes it on
+       * the receive thread of the model, so it should reach its next co_await quickly.
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+       * @param in_channel_first -> boolean variable that indicates the copied input data is in channel first or channle last format. default is false expecting data in channel last format
+       * @param out_channel_first -> boolean variable that indicates the copied output data is in channel first or channle last format. default is false expecting data in channel last format
+       * @param timeout -> Wait time in milliseconds for the frame to be sent. Default is 0 which indicates that the function never timesout.
+       * @return awaitable whose result is true when the outputs are in out_data and false if the accelerator was stopped
+       * before or the frame could not be sent within the timeout
+      */
+      MX::Utils::completion_awaitable infer(std::vector<float *> in_data, std::vector<float*> out_data, int model_id, int stream_id,
+                                            MX::Utils::completion_awaitable::executor_t resume_on = nullptr, int dfp_id=0,
+                                            bool in_channel_first=false, bool out_channel_first=false, int32_t timeout=0){
+        return MX::Utils::completion_awaitable(
+          [this, in_data, out_data, model_id, stream_id, dfp_id, in_channel_first, out_channel_first, timeout](MX::Utils::completion_awaitable::completion_t on_done){
+            return submit(in_data, out_data, model_id, stream_id, on_done, dfp_id, in_channel_first, out_channel_first, timeout);
+          }, std::move(resume_on));
+      }
+#endif
+
       /**
        * @brief Configure multi-threaded FeatureMap data conversion using the given number of threads.
        * Conversion multithreading is mainly intended for high FPS single-stream scenarios, or userThreading mode.
@@ -210,9 +423,140 @@ namespace MX
       */
       void set_parallel_fmap_convert(int num_threads, int model_idx=0);
 
+      /**
+       * @brief Set how send_input spreads frames over the contexts (device groups) of the DFP. The default is
+       * round robin, where a sender takes the next context that no other sender is using. DISPATCH_LEAST_OUTSTANDING
+       * sends each frame to the context with the least queued work. The options can be changed at any time.
+       *
+       * @param options dispatch policy and stream affinity
+       * @param model_idx Index of model to which the options are applied. The default is set to 0
+      */
+      void set_dispatch_options(const MX::Types::DispatchOptions& options, int model_idx=0);
+
+      /**
+       * @brief Get the frames sent to and in flight on each context of a model since connect_dfp.
+       *
+       * @param model_idx Index of model. The default is set to 0
+       * @return DispatchStats of the model
+      */
+      MX::Types::DispatchStats get_dispatch_stats(int model_idx=0);
+
+      /**
+       * @brief Set how the models of a dfp handle a context (device group) that fails. The failed context stops
+       * getting frames, the next frames go to the other contexts of the dfp and the context is reset and downloaded
+       * again in the background. receive_output throws for a frame that was on the failed context, submitted frames
+       * report it to their callback. replay_in_flight has no effect in userThreading. Can be called at any time.
+       *
+       * @param policy ofmap timeout and recovery attempts
+       * @param dfp_id id of dfp returned by connect_dfp() function
+      */
+      void set_failover_policy(const MX::Types::FailoverPolicy& policy, int dfp_id=0);
+
+      /**
+       * @brief Get the health of each context of a dfp: whether it takes frames, its failures and recoveries.
+       *
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return ContextHealth of each context of the dfp, in the order of the contexts used by the dispatch stats
+      */
+      std::vector<MX::Types::ContextHealth> get_context_health(int dfp_id=0);
+
+      /**
+       * @brief Wait till the contexts of a dfp that failed are recovered or given up on.
+       *
+       * @param timeout_ms maximum wait in milliseconds, 0 waits forever
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return false on timeout
+      */
+      bool wait_context_recovery(int32_t timeout_ms=0, int dfp_id=0);
+
+      /**
+       * @brief Fail the next frames read from a context of a dfp as if the device had returned an error, to test
+       * how an application copes with failover. The outputs of these frames are dropped and the context is reset.
+       *
+       * @param context_idx Index of the context in the dispatch stats of the models of the dfp
+       * @param count Number of frames to fail
+       * @param dfp_id id of dfp returned by connect_dfp() function
+      */
+      void inject_context_fault(int context_idx, int count=1, int dfp_id=0);
+
+      /**
+       * @brief Fail the next dfp downloads to contexts as if the device had refused them, to test how an application
+       * copes with a failed connect_dfp. The connect throws and gives back the devices it claimed.
+       *
+       * @param count Number of context downloads to fail
+      */
+      void inject_download_fault(int count=1);
+
+      /**
+       * @brief Set how the frequency of the devices of a dfp follows their load. The load of each device, the share of
+       * time it has frames in flight and the frames waiting to be sent to it, is sampled in the background and the
+       * frequency is stepped between min_frequency and max_frequency. Every change is logged. Can be called at any
+       * time, e.g. to trade throughput for power by time of day. POWER_STATIC stops the changes and keeps the current
+       * frequency. Throws logic error if the devices of the dfp already follow the policy of another dfp.
+       *
+       * @param policy profile, frequency range and hysteresis
+       * @param dfp_id id of dfp returned by connect_dfp() function
+      */
+      void set_power_policy(const MX::Types::PowerPolicy& policy, int dfp_id=0);
+
+      /**
+       * @brief Get the frequency and load of each device of a dfp, empty if no power policy was set for the dfp.
+       *
+       * @param dfp_id id of dfp returned by connect_dfp() function
+       * @return DevicePowerStats of each device of the dfp
+      */
+      std::vector<MX::Types::DevicePowerStats> get_power_stats(int dfp_id=0);
+
+      /**
+       * @brief Enable or disable latest-frame-wins mode for a stream in userThreading mode. In this mode send_input
+       * copies the frame and returns right away, the frame is sent to the accelerator in the background. If the
+       * previous frame of the stream hasn't been sent yet, it is replaced by the new one and counted as dropped,
+       * so receive_output returns only the outputs of frames that were actually sent. A frame that cannot be sent in
+       * the background, for example because its context failed, is dropped as well.
+       *
+       * @param stream_id -> Index of stream the mode is applied to.
+       * @param enable -> true to only keep the freshest frame of the stream, false to go back to blocking sends.
+       * @param model_id -> Index of the model the stream sends to. The default is set to 0
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+      */
+      void set_freshest_only(int stream_id, bool enable, int model_id=0, int dfp_id=0);
+
+      /**
+       * @brief Get the number of frames of a stream that were replaced by a newer frame or could not be sent.
+       *
+       * @param stream_id -> Index of stream.
+       * @param model_id -> Index of the model the stream sends to. The default is set to 0
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+       * @return Number of dropped frames, 0 if the stream never used latest-frame-wins mode
+      */
+      uint64_t get_dropped_frames(int stream_id, int model_id=0, int dfp_id=0);
+
+      /**
+       * @brief Create the buffers of streams before their first frame. Streams that are not registered get their
+       * buffers on their first send_input, which takes a lock once per stream. Registering them up front keeps
+       * that work out of the first frames and fails early when the streams exceed the stream limit of the model.
+       * Stream ids that are already registered are skipped.
+       *
+       * @param stream_ids -> Ids of the streams that will send to the model.
+       * @param model_id -> Index of the model the streams send to. The default is set to 0
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+      */
+      void register_streams(const std::vector<int>& stream_ids, int model_id=0, int dfp_id=0);
+
+      /**
+       * @brief Set the number of streams a model can hold. The default is 500 in userThreading mode. It can only
+       * be changed after connect_dfp and before any stream of the model is registered or sends a frame.
+       *
+       * @param max_streams -> Number of streams, >= 1.
+       * @param model_id -> Index of the model. The default is set to 0
+       * @param dfp_id -> id of dfp returned by connect_dfp() function
+      */
+      void set_max_streams(int max_streams, int model_id=0, int dfp_id=0);
+
       private:
           std::filesystem::path dfp_path;
-          int dfp_tag;
+          std::vector<int> dfp_model_offset_;//index in models of the first model of each dfp, by dfp id
+
           bool dfp_valid;
           bool setup_status;
 
@@ -220,7 +564,15 @@ namespace MX
 
           std::atomic_bool manual_run; // Flag to mark manual threading option;
 
-          std::vector<ModelBase *> models;//Vector of all model objects
+          std::vector<ModelBase *> models;//Vector of all model objects, the models of all dfps in connect order
+
+          //dfps taking turns on the same devices, the member index of a dfp in the scheduler is its index in dfp_ids
+          struct swap_group{
+            MX::Utils::model_swap_scheduler* scheduler;
+            std::vector<int> dfp_ids;
+          };
+          std::vector<swap_group*> swap_groups_;
+          swap_group* find_swap_group(int dfp_id);
 
           MX::Runtime::DeviceManager *device_manager;
 
@@ -9,6 +9,8 @@
 #include <functional>
 #include <atomic>
 #include <cstring>
+#include <set>
+#include <deque>
 #include <unordered_set>
 #include <filesystem>
 
@@ -20,6 +22,12 @@
 #include <memx/accl/utils/featureMap.h>
 #include <memx/accl/utils/errors.h>
 #include <memx/accl/utils/mxTypes.h>
+#include <memx/accl/utils/stream_scheduler.hpp>
+#include <memx/accl/utils/context_dispatcher.hpp>
+#include <memx/accl/utils/stream_slot_table.hpp>
+#include <memx/accl/utils/model_swap_scheduler.hpp>
+#include <memx/accl/utils/context_health.hpp>
+#include <memx/accl/utils/thread_policy.h>
 
 using namespace std;
 
@@ -37,13 +45,39 @@ namespace MX
             //function refernce for callback functions
             typedef std::function<bool(vector<const MX::Types::FeatureMap<uint8_t> *>, int)> int_callback_t;
             typedef std::function<bool(vector<const MX::Types::FeatureMap<float> *>, int)> float_callback_t;
+            //completion of an asynchronously submitted frame: success flag and stream id
+            typedef std::function<void(bool, int)> completion_callback_t;
 
             //connect_stream to this Model
-            virtual void connect_stream(float_callback_t, float_callback_t, int)
+            virtual void connect_stream(float_callback_t, float_callback_t, int, const MX::Types::StreamOptions&)
                                             {
                                                 throw runtime_error("base connect_stream float is called");
                                             }
 
+            //connect a stream whose inputs are the outputs of an upstream model, handed over with pipeline_feed
+            virtual void connect_pipeline_stream(float_callback_t, int)
+                                            {
+                                                throw runtime_error("base connect_pipeline_stream float is called");
+                                            }
+
+            //hand the outputs of an upstream model to a pipeline stream, false if the model is not running
+            virtual bool pipeline_feed(int, const vector<const MX::Types::FeatureMap<float> *>&)
+                                            {
+                                                throw runtime_error("base pipeline_feed float is called");
+                                            }
+
+            //connect a stream to this Model while it is running, a NULL input callback attaches a pipeline stream
+            virtual void attach_stream(float_callback_t, float_callback_t, int, const MX::Types::StreamOptions&)
+                                            {
+                                                throw runtime_error("base attach_stream float is called");
+                                            }
+
+            //disconnect a stream once its frames in flight are done, false if the stream is not connected to this model
+            virtual bool detach_stream(int)
+                                            {
+                                                throw runtime_error("base detach_stream is called");
+                                            }
+
             //connect_stream to this Model
             virtual void connect_stream(int_callback_t, float_callback_t, int)
                                             {
@@ -52,8 +86,29 @@ namespace MX
 
             //Set number of workers
             virtual void set_num_workers(int, int)=0;
+            //Set number of in-flight frames per stream
+            virtual void set_pipeline_depth(int)=0;
+            //Set number of streams the model can hold while running
+            virtual void set_max_streams(int)=0;
+            //Set how the model drains and what it keeps on stop
+            virtual void set_stop_policy(const MX::Types::StopPolicy&)=0;
+            //Enable runtime tuning of workers and conversion threads
+            virtual void set_auto_tune(bool, const MX::Types::AutoTuneConfig&)=0;
+            //Set CPU placement and scheduling of the model threads
+            virtual void set_thread_policy(const MX::Types::ThreadPolicy&)=0;
+            //Set the order in which the send stage serves the streams
+            virtual void set_schedule_policy(MX::Types::StreamSchedulePolicy)=0;
+            //Get send stage statistics of a stream, false if the stream is not connected to this model
+            virtual bool get_stream_stats(int, MX::Types::StreamStats&)=0;
+            //Set how the send stage picks the context of each frame
+            virtual void set_dispatch_options(const MX::Types::DispatchOptions&)=0;
+            //Get the frames sent to and in flight on each context
+            virtual MX::Types::DispatchStats get_dispatch_stats()=0;
             // Set multi-thread FMap conversion threads
             virtual void set_parallel_fmap_convert(int)=0;
+            //Allocate the featureMaps of the connected streams, done by model_start() if not called before
+            virtual void model_prepare()=0;
+
             //Start the model
             virtual void model_start()=0;
 
@@ -78,9 +133,51 @@ namespace MX
 
             // manual threadin send for float
             virtual bool model_manual_receive(std::vector<float*> &, int, bool, int32_t)=0;
+
+            // manual threading send of several frames of a stream
+            virtual bool model_manual_send_batch(const std::vector<std::vector<float*>>&, int, bool, int32_t){
+                throw runtime_error("base model manual send batch for float is called");
+            };
+
+            // manual threading receive of several frames of a stream into contiguous outputs
+            virtual bool model_manual_receive_batch(std::vector<float*> &, int, int, bool, int32_t)=0;
+
+            // manual threading send of a frame whose outputs are copied and reported by the recv thread
+            virtual bool model_manual_submit(std::vector<float*>, std::vector<float*>, int, bool, bool, int32_t, completion_callback_t){
+                throw runtime_error("base model manual submit for float is called");
+            };
+
+            // manual threading receive that returns false right away if no output of the stream is ready
+            virtual bool model_manual_try_receive(std::vector<float*> &, int, bool)=0;
+
+            // manual threading registration of streams before their first frame
+            virtual void model_manual_register_streams(const std::vector<int>&)=0;
+
+            // manual threading eventfd readable when outputs of a stream (or of any stream for -1) are ready
+            virtual int model_manual_event_fd(int)=0;
+
+            // manual threading latest-frame-wins mode of a stream
+            virtual void model_manual_set_freshest(int, bool)=0;
+
+            // manual threading number of frames of a stream replaced before being sent
+            virtual uint64_t model_manual_dropped_frames(int)=0;
+
+            // manual threading frames wait for this dfp to be swapped in, as given member of the gate
+            virtual void model_manual_set_swap_gate(MX::Utils::model_swap_scheduler*, int)=0;
+
+            // handling of frames lost on a failed context, not while auto threading is running
+            virtual void set_failover_policy(const MX::Types::FailoverPolicy&)=0;
+
+            // frames waiting in the send stage of auto threading
+            virtual int get_queued_frames()=0;
+            // contexts were added to the dfp, with the health that covers them. Not while the model is running
+            virtual void add_contexts(MX::Utils::context_health*)=0;
             //Get num streams in this model
             virtual int get_num_streams()=0;
 
+            //Check if the model is started in auto threading
+            virtual bool model_running()=0;
+
             //Wait for model to finish
             virtual void model_wait()=0;
 
@@ -103,6 +200,54 @@ namespace MX
             virtual ~ModelBase(){};
         };
 
+        //Frame submitted asynchronously in manual threading, completed by the manual recv thread
+        struct manual_completion{
+            std::vector<float*> out_data;   // user buffers the outputs are copied to
+            bool channel_first;
+            int stream_id;
+            ModelBase::completion_callback_t callback;
+        };
+
+        //Frame handed from the input stage to the send stage and from the send stage to the recv stage
+        struct frame_ticket{
+            int stream;     // index of the stream in the model
+            int in_slot;    // featureMap set holding the input of this frame
+            int out_slot;   // featureMap set receiving the output of this frame
+            uint64_t seq;   // per-stream send order of this frame
+            int context;    // context the frame was sent to
+            int context_idx;// index of that context in the open contexts of the model
+            int in_flight;  // frames in flight on the context once this one was sent, this one included
+            std::chrono::steady_clock::time_point sent_at; // time the frame was sent
+            manual_completion* completion; // manual threading frames sent with submit, NULL otherwise
+            MX::Utils::model_swap_scheduler* swap_gate; // gate that admitted the frame, NULL if the dfp swaps with no other dfp
+            uint32_t generation; // generation of the context when the frame was sent, the frame is lost if the context failed since
+            bool batch;     // manual threading frame sent with send_batch, its outputs go to the batch ring of the stream
+        };
+
+        //Per-stream bookkeeping of the ring of in-flight featureMap sets
+        struct stream_ring{
+            int in_pos = 0;             // next ring position to be filled by the input callback
+            uint64_t sent = 0;          // frames sent to the MXA so far
+            uint64_t dispatched = 0;    // frames handed to the output pool so far
+            uint64_t released = 0;      // frames whose output callback has returned
+            bool out_busy = false;      // output callback of this stream is running
+            std::vector<bool> out_read; // per ring position, ofmaps read and waiting for the output callback
+            std::atomic<uint64_t> enqueued{0}; // frames handed to the send stage so far, replaced frames excluded
+            bool input_done = false;    // no more frames come from the input callback of this stream
+            std::atomic_bool detaching{false}; // detach_stream was called, the input task ends at its next run
+            std::atomic_int feeding{0};  // pipeline_feed calls between their stream lookup and enqueue_input
+            std::set<uint64_t> failed;  // frames lost on a failed context, skipped in send order instead of dispatched
+        };
+
+        //Receive side of one context: frames sent to it in send order and the thread reading their ofmaps
+        struct context_recv{
+            MX::Utils::fifo_queue<frame_ticket> queue;
+            bool flag = false;
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::thread *thread = NULL;
+        };
+
         template <typename T>
         class MxModel : public ModelBase
         {
@@ -111,7 +256,9 @@ namespace MX
             int group_id_; // unique id of MXA
             int num_streams_;// num streams connected to this model
             Dfp::DfpObject *dfp_; // Dfp object
-            MX::Utils::fifo_queue<int> stream_queue; //queue to store stream ids for ifmaps
+            MX::Utils::stream_scheduler<frame_ticket> stream_queue; //per-stream queues of filled input slots for ifmaps
+            int pipeline_depth_; // number of featureMap sets per stream that can be in flight
+            int requested_pipeline_depth_; // depth set by the user, pipeline_depth_ is raised to 2 for freshest_only streams
 
             vector<uint8_t> in_ports_; // input port information
             vector<uint8_t> out_ports_; // output port information
@@ -120,9 +267,9 @@ namespace MX
             thread_pool* input_pool;
             thread_pool* output_pool;
             void model_send_fun(); //send thread function to perform ifmap
-            void model_recv_fun(); //recv thread function to perform ofmap
+            void model_recv_fun(int context_idx); //recv thread function to perform ofmap on one context
             thread *model_send_thread; //send thread for model
-            thread *model_recv_thread; //recv thread for model
+            vector<context_recv*> context_recvs_; //recv queue and thread of each context of the model
             thread *model_manual_recv_thread; //recv thread for model
             void model_manual_recv_fun(); //recv thread function to perform ofmap
             atomic_bool model_run; //flag to specify if model is running
@@ -131,9 +278,19 @@ namespace MX
             typedef std::function<bool(vector<const MX::Types::FeatureMap<T> *>, int stream_id)> combined_input_callback_t;
             typedef std::function<bool(vector<const MX::Types::FeatureMap<float> *>, int stream_id)> combined_output_callback_t;
             //Task done by each worker of input threadpool
-            bool inputTask(combined_input_callback_t in_cb, vector<const MX::Types::FeatureMap<T>* >inputs,int stream, int stream_idx);
+            bool inputTask(combined_input_callback_t in_cb, int stream, int stream_idx);
             //Task done by each worker of output threadpool
-            bool outputTask(combined_output_callback_t out_cb, vector<const MX::Types::FeatureMap<float>* >outputs,int stream, int stream_idx);
+            bool outputTask(combined_output_callback_t out_cb, int out_slot, int stream, int stream_idx);
+            //Hand the next in-order output of a stream to the output pool if it is ready
+            void dispatch_output(int stream);
+            //Queue a filled input slot of a stream to the send stage
+            void enqueue_input(int stream, int slot);
+            //Mark that the input task of a stream has ended
+            void finish_input(int stream);
+            //Copy the upstream outputs of a pipeline stream into its next input slot and queue it
+            bool feed_slot(int stream, const vector<const MX::Types::FeatureMap<float> *>& src);
+            //Mark that a pipeline_feed of a stream has returned, detach_stream waits for it
+            void finish_feed(int stream);
             //vector of input callback functions
             vector<combined_input_callback_t> comb_in_call;
             //vector of output callback functions
@@ -142,7 +299,34 @@ namespace MX
             unordered_set<int> stream_set_;
             //list of streamids connected to the model
             vector<int> stream_id_list;
-
+            //scheduling options of the streams connected to the model
+            vector<MX::Types::StreamOptions> stream_options_;
+            //streams fed by an upstream model, stream id to stream index. They have no input callback
+            std::unordered_map<int, int> pipeline_streams_;
+            //per pipeline stream and input, 1 if the formatted data of the upstream output can be copied as is, 0 if not, -1 not checked yet
+            vector<vector<int>> pipeline_passthrough_;
+            //per pipeline stream, float data of inputs that are converted
+            vector<vector<float>> pipeline_scratch_;
+            //number of streams set by set_max_streams, 0 for the default of the threading mode
+            int max_streams_;
+            //number of streams the running model can hold, the per-stream vectors are reserved to it at start
+            int stream_capacity_;
+            //per stream index, false once the stream has been detached
+            vector<bool> stream_live_;
+            //indices of detached streams, reused by the next stream attached to the running model
+            vector<int> free_streams_;
+            //serializes attach_stream and detach_stream with each other and with the walks over all featureMaps
+            std::mutex streams_mutex;
+            //delete the featureMaps and pre/post models of a slot, leaving it empty
+            void release_slot(int slot);
+            //remove a stream from the connected streams, only while the model is stopped
+            void remove_stream_config(int stream);
+            //drain deadline and buffer keeping of model_stop
+            MX::Types::StopPolicy stop_policy_;
+            //ofmaps discarded by the flush of model_stop, grown to the largest output port
+            vector<uint8_t> flush_scratch_;
+            //move the featureMap sets kept by the last stop to the first slots, releasing the ones beyond needed
+            void reuse_kept_slots(int needed);
             //Vector of featureMaps of size num_streams that holds inputs for pre-processing models
             vector<vector<MX::Types::FeatureMap<T> *>> pre_in_featuremaps_;
             //Vector of featureMaps of size num_streams that holds inputs for models
@@ -176,21 +360,42 @@ namespace MX
             std::mutex input_thread_mutex;
             std::condition_variable input_thread_cv;
 
-            //model_recv
-            bool model_recv_flag;
-            std::mutex model_recv_mutex;
-            std::condition_variable model_recv_cv;
-
             vector<std::mutex*> out_task_mutex;
             vector<std::condition_variable*> out_task_cv;
+            vector<stream_ring*> stream_rings_;
 
             const std::vector<int>* open_contexts;
 
-            int context_send_current_index=0;
             int number_of_contexts;
-
-            //Queue to pass stream id and context id from send to recv functions
-            MX::Utils::fifo_queue<std::pair<int, int>> pair_stream_context_queue;
+            //context of each frame sent, in both threading modes
+            MX::Utils::context_dispatcher dispatcher_;
+
+            //Queue to pass sent frames from manual send to manual recv functions
+            MX::Utils::fifo_queue<frame_ticket> pair_stream_context_queue;
+
+            //Turns on devices shared with other dfps, NULL if the devices are not shared
+            std::atomic<MX::Utils::model_swap_scheduler*> swap_gate_{NULL};
+            int swap_member_ = -1;
+
+            //Health of the contexts, shared with the other models of the dfp. NULL stops the model on a context error
+            MX::Utils::context_health* health_;
+            MX::Types::FailoverPolicy failover_policy_;
+            std::atomic<int32_t> recv_timeout_ms_;
+            //frames lost on a failed context that are sent again, ahead of the stream queue
+            MX::Utils::fifo_queue<frame_ticket> replay_queue_;
+            //set by the send thread under input_task_mutex once it has ended, lost frames are failed from then on
+            bool send_done_;
+            //send a frame, moving to the next healthy context when one fails. replay keeps the send order of the frame
+            void send_ticket(frame_ticket& ticket, bool replay);
+            //ctx if it is healthy, otherwise the next healthy context with the frame moved over to it in the dispatcher
+            //-1 if there is none and the frame was cancelled
+            int healthy_context(int ctx);
+            //a frame read from a failed context or sent before it failed, it is replayed or dropped
+            void reroute_frame(frame_ticket& ticket, const std::string& error);
+            //drop a frame whose outputs will never arrive, its output callback is skipped
+            void fail_frame(const frame_ticket& ticket, const std::string& error);
+            //free the input slot of a sent frame for the input callback
+            void release_input(int in_slot);
 
 
             //Pre-processing model items
@@ -205,12 +410,19 @@ namespace MX
             std::vector<std::vector<MX::Types::FeatureMap<T>*>> transposed_in_featuremaps_;
             std::vector<size_t> pre_out_size;
 
-            void create_and_append_in_fm();
-            void create_and_append_out_fm();
+            //slot -1 appends a new featureMap set, otherwise the set is created in the given empty slot
+            void create_and_append_in_fm(int slot = -1);
+            void create_and_append_out_fm(int slot = -1);
 
-            std::unordered_map<int,int> stream_id_map_;
+            //manual threading stream id to stream index, read without locks. Inserts are serialized by fm_create_mutex
+            MX::Utils::stream_slot_table stream_slots_;
             std::mutex fm_create_mutex;
-            std::mutex manual_mutex_in;
+            //Manual threading sends lock only the context they stream to, frames for different contexts go out in parallel
+            std::vector<std::mutex*> manual_context_mutex;
+            std::atomic<uint32_t> manual_next_context_;
+            //lock a context for the next frame of a stream. Under plain round robin the first free one from the round robin
+            //position, or that position if all are busy. Otherwise the context the dispatcher picks
+            int lock_send_context(std::unique_lock<std::mutex>& lock, int stream_idx);
             std::mutex manual_mutex_out;
             std::vector<std::mutex*> manual_recv_mutex;
             std::vector<std::condition_variable*> manual_recv_cv;
@@ -218,21 +430,111 @@ namespace MX
             std::vector<std::mutex*> manual_recv_task_mutex;
             std::vector<std::condition_variable*> manual_recv_task_cv;
             std::vector<bool> manual_recv_task_flag;
+            //the last frame of a stream was lost on a failed context, its receive throws
+            std::vector<std::atomic_bool*> manual_recv_failed_;
             std::mutex manual_init_mutex;
             std::condition_variable manual_init_cv;
             void create_append_manual_mem();
 
+            //Latest-frame-wins streams of manual threading: send_input only copies the frame
+            //into the mailbox of the stream and the fresh send thread sends the newest one
+            struct fresh_mailbox{
+                std::mutex mutex;
+                bool enabled = false;
+                bool full = false;
+                bool channel_first = false;
+                uint64_t dropped = 0;
+                vector<vector<T>> pending; // newest frame not sent yet
+                vector<vector<T>> sending; // frame being sent by the fresh send thread
+            };
+            std::unordered_map<int, fresh_mailbox*> fresh_mailboxes_;
+            std::mutex fresh_mutex;
+            std::condition_variable fresh_cv;
+            atomic_int fresh_streams_;
+            atomic_int fresh_pending_;
+            bool fresh_run_;
+            thread *model_fresh_send_thread;
+            void model_fresh_send_fun();
+            bool model_manual_send_frame(std::vector<T*> in_data, int stream_id, bool channel_first, int32_t timeout, manual_completion* completion = NULL);
+            //copy the received outputs of a manual threading stream to user buffers
+            void copy_manual_output(int stream_idx, std::vector<float*> &out_data, bool channel_first);
+            //report a submitted frame whose outputs will never arrive
+            void fail_manual_completion(manual_completion* completion);
+            //index of a manual threading stream, creating its featureMaps on first use
+            int manual_stream_index(int stream_id);
+            //create the featureMaps of a new manual threading stream, fm_create_mutex has to be held
+            int register_manual_stream(int stream_id);
+            //reserve the per-stream vectors of manual threading for stream_capacity_ streams
+            void reserve_manual_streams();
+
+            //Eventfds of manual threading signaled by the recv thread when an output is ready, per stream id
+            //and for the whole model. Only created on request, event_fds_active_ keeps the recv thread lock free otherwise
+            std::unordered_map<int, int> event_fds_;
+            int model_event_fd_;
+            std::atomic_bool event_fds_active_;
+            std::mutex event_fd_mutex;
+            void signal_event_fds(int stream_id);
+
+            //Featuremaps the frames of a batch are encoded into in parallel, grown to the largest batch seen
+            vector<vector<MX::Types::FeatureMap<T> *>> batch_in_featuremaps_;
+            std::mutex batch_mutex;
+
+            //Outputs of the batched frames of a manual threading stream. The recv thread reads a batched frame into a
+            //set of its own, so it goes on with the next frames while the whole batch waits to be received. The outputs
+            //of the stream are numbered in read order, the receive takes the oldest of the ring and the featureMaps of
+            //the stream. Guarded by the manual_recv_task_mutex of the stream
+            struct batch_output{
+                vector<MX::Types::FeatureMap<float> *> fmaps;
+                bool lost;      // the frame was lost on a failed context, its receive throws
+                uint64_t seq;   // read order of the output in the stream
+            };
+            struct batch_ring{
+                std::deque<batch_output> ready;                     // outputs read and not received yet, in send order
+                vector<vector<MX::Types::FeatureMap<float> *>> free; // sets free for the next batched frames
+                int pending = 0;                                    // batched frames sent whose outputs are not read yet
+                uint64_t next_seq = 0;                              // read order of the next output of the stream
+                uint64_t slot_seq = 0;                              // read order of the output in the featureMaps of the stream
+            };
+            //true if the next output of a stream to receive is a batched one, manual_recv_task_mutex has to be held
+            bool batch_output_first(int stream_idx);
+            std::vector<batch_ring*> manual_batch_rings_;
+            //reserve a free output set for each of num_frames batched frames of a stream, or give back unsent ones
+            void reserve_batch_outputs(int stream_idx, int num_frames);
+            void unreserve_batch_outputs(int stream_idx, int num_frames);
+            //hand the oldest batched output of a stream to the user, throws if the frame was lost
+            void take_batch_output(int stream_idx, int pstream_id, std::vector<float*> &out_data, bool channel_first);
+
             int parallel_fmap_convert_threads;
 
+            //CPU placement and scheduling of the threads of each stage
+            MX::Types::ThreadPolicy thread_policy_;
+
+            //Runtime controller resizing the worker pools and conversion threads
+            bool auto_tune_;
+            MX::Types::AutoTuneConfig tune_config_;
+            thread *model_tune_thread;
+            bool tune_run_;
+            std::mutex tune_mutex;
+            std::condition_variable tune_cv;
+            void model_tune_fun();
+            void apply_convert_threads(int num_threads);
+            //Time spent in input callbacks, output callbacks, by the send thread waiting for
+            //inputs and by the recv threads waiting for output callbacks, in nanoseconds
+            std::atomic<uint64_t> input_busy_ns_;
+            std::atomic<uint64_t> output_busy_ns_;
+            std::atomic<uint64_t> send_idle_ns_;
+            std::atomic<uint64_t> recv_blocked_ns_;
+
             Dfp::DfpMeta meta_;
 
-            void _post_inference(int stream);
-            void _pre_inference(int stream);
-            void _pre_copy(int stream);
+            void _post_inference(int slot);
+            void _pre_inference(int slot);
+            void _pre_copy(int slot);
 
         public:
-            MxModel(int model_id, Dfp::DfpObject *dfp_object,  const std::vector<int>* popen_contexts = NULL); // Construct model for Inference
+            MxModel(int model_id, Dfp::DfpObject *dfp_object,  const std::vector<int>* popen_contexts = NULL, MX::Utils::context_health* health = NULL); // Construct model for Inference
 
+            void model_prepare() override;
             void model_start() override;
             void model_stop() override;
             void model_wait() override;
@@ -240,8 +542,13 @@ namespace MX
             void model_manual_start() override;
             void model_manual_stop() override;
             ~MxModel();
-            void connect_stream(combined_input_callback_t in_cb, combined_output_callback_t out_cb, int stream_id) override;
+            void connect_stream(combined_input_callback_t in_cb, combined_output_callback_t out_cb, int stream_id, const MX::Types::StreamOptions& options) override;
+            void connect_pipeline_stream(combined_output_callback_t out_cb, int stream_id) override;
+            bool pipeline_feed(int stream_id, const vector<const MX::Types::FeatureMap<float> *>& src) override;
+            void attach_stream(combined_input_callback_t in_cb, combined_output_callback_t out_cb, int stream_id, const MX::Types::StreamOptions& options) override;
+            bool detach_stream(int stream_id) override;
             int get_num_streams() override;
+            bool model_running() override;
             // void log_model_info() override;
             MX::Types::MxModelInfo return_model_info() override;
             MX::Types::MxModelInfo return_pre_model_info() override;
@@ -251,12 +558,44 @@ namespace MX
 
             bool model_manual_receive(std::vector<float*> &out_data, int stream_id, bool channel_first=false, int32_t timeout = 0) override;
 
+            bool model_manual_send_batch(const std::vector<std::vector<T*>>& batch, int stream_id, bool channel_first=false, int32_t timeout = 0) override;
+
+            bool model_manual_receive_batch(std::vector<float*> &out_data, int num_frames, int stream_id, bool channel_first=false, int32_t timeout = 0) override;
+
+            bool model_manual_submit(std::vector<T*> in_data, std::vector<float*> out_data, int stream_id, bool in_channel_first, bool out_channel_first, int32_t timeout, completion_callback_t on_done) override;
+
+            bool model_manual_try_receive(std::vector<float*> &out_data, int stream_id, bool channel_first=false) override;
+
+            void model_manual_register_streams(const std::vector<int>& stream_ids) override;
+
+            int model_manual_event_fd(int stream_id) override;
+
+            void model_manual_set_freshest(int stream_id, bool enable) override;
+
+            uint64_t model_manual_dropped_frames(int stream_id) override;
+
+            void model_manual_set_swap_gate(MX::Utils::model_swap_scheduler* gate, int member) override;
+
+            void set_failover_policy(const MX::Types::FailoverPolicy& policy) override;
+
+            int get_queued_frames() override;
+            void add_contexts(MX::Utils::context_health* health) override;
+
             bool manual_run(std::vector<T *> in_data, std::vector<float*> &out_data, int pstream_id, bool in_channel_first=false, bool out_channel_first=false, int32_t timeout=0) override;
 
             void model_set_post(std::filesystem::path post_model_path, const std::vector<size_t>& post_out_size_list) override;
 
             void model_set_pre(std::filesystem::path pre_model_path) override;
             void set_num_workers(int input_workers, int output_workers) override;
+            void set_pipeline_depth(int depth) override;
+            void set_max_streams(int max_streams) override;
+            void set_stop_policy(const MX::Types::StopPolicy& policy) override;
+            void set_auto_tune(bool enable, const MX::Types::AutoTuneConfig& config) override;
+            void set_thread_policy(const MX::Types::ThreadPolicy& policy) override;
+            void set_schedule_policy(MX::Types::StreamSchedulePolicy policy) override;
+            bool get_stream_stats(int stream_id, MX::Types::StreamStats& stats) override;
+            void set_dispatch_options(const MX::Types::DispatchOptions& options) override;
+            MX::Types::DispatchStats get_dispatch_stats() override;
             void set_parallel_fmap_convert(int num_threads) override;
         };
     } // namespace Runtime
@@ -0,0 +1,66 @@
+#ifndef AWAITABLE_HPP
+#define AWAITABLE_HPP
+
+// C++20 coroutine support of the asynchronous manual threading API. Only available when the
+// including code is compiled as C++20 (MX_ACCL_COROUTINES=ON in CMake), the library itself
+// keeps building as C++17 since the awaitable is built on top of MxAcclMT::submit.
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define MX_ACCL_HAS_COROUTINES 1
+
+#include <coroutine>
+#include <functional>
+#include <utility>
+
+namespace MX
+{
+    namespace Utils
+    {
+        /**
+         * @brief Awaitable of an operation reporting its completion through a callback, such as MxAcclMT::submit.
+         * co_await starts the operation and suspends the coroutine, which is resumed when the callback is called
+         * and gets the success flag of the operation. By default the coroutine resumes on the thread calling the
+         * callback, a resume executor can post it to an event loop instead.
+         */
+        class completion_awaitable{
+            public:
+                typedef std::function<void(bool, int)> completion_t;
+                //starts the operation with the completion to call, returns false if it could not be started
+                typedef std::function<bool(completion_t)> start_t;
+                //resumes the coroutine, e.g. by posting the handle to an event loop
+                typedef std::function<void(std::coroutine_handle<>)> executor_t;
+
+                completion_awaitable(start_t start, executor_t resume_on = nullptr)
+                    : m_start(std::move(start)), m_resume_on(std::move(resume_on)) {}
+
+                bool await_ready() const noexcept { return false; }
+
+                bool await_suspend(std::coroutine_handle<> handle){
+                    bool started = m_start([this, handle](bool ok, int){
+                        m_result = ok;
+                        if(m_resume_on){
+                            m_resume_on(handle);
+                        }
+                        else{
+                            handle.resume();
+                        }
+                    });
+                    //Once started the completion may already have resumed and destroyed this awaitable
+                    if(started){
+                        return true;
+                    }
+                    m_result = false;
+                    return false;
+                }
+
+                bool await_resume() const noexcept { return m_result; }
+
+            private:
+                start_t m_start;
+                executor_t m_resume_on;
+                bool m_result = false;
+        };
+    } // namespace Utils
+} // namespace MX
+
+#endif
+#endif
@@ -0,0 +1,101 @@
+#ifndef CONTEXT_ALLOCATOR_HPP
+#define CONTEXT_ALLOCATOR_HPP
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace MX
+{
+    namespace Utils
+    {
+        /**
+         * @brief Hands out the driver context IDs of a process. The driver has a fixed number of context IDs shared by
+         * all devices, so IDs are given out as contexts are opened, lowest free ID first, whatever the device. Each ID
+         * is owned by a dfp of an owner (a DeviceManager), so the contexts of one dfp can be found and returned without
+         * touching those of other dfps on the same device. All functions are thread safe.
+         */
+        class context_allocator{
+            public:
+                //Context IDs of the driver, 0 to max_contexts-1
+                static constexpr int max_contexts = 32;
+
+                explicit context_allocator(int num_contexts = max_contexts) : m_owners(num_contexts) {}
+
+                //Allocator shared by all devices of the process
+                static context_allocator& process(){
+                    static context_allocator allocator;
+                    return allocator;
+                }
+
+                //Take the lowest free ID for a dfp of an owner, throws if all IDs are in use
+                int allocate(const void* owner, int dfp_tag){
+                    std::lock_guard lock(m_mutex);
+                    for(int ctx = 0; ctx < static_cast<int>(m_owners.size()); ++ctx){
+                        if(m_owners[ctx].owner == NULL){
+                            m_owners[ctx].owner = owner;
+                            m_owners[ctx].dfp_tag = dfp_tag;
+                            return ctx;
+                        }
+                    }
+                    throw std::runtime_error("cannot open more than " + std::to_string(m_owners.size()) + " contexts in a process, all are in use");
+                }
+
+                //Give an ID back, IDs that are not allocated are ignored
+                void release(int ctx){
+                    std::lock_guard lock(m_mutex);
+                    if(ctx >= 0 && ctx < static_cast<int>(m_owners.size())){
+                        m_owners[ctx] = slot();
+                    }
+                }
+
+                //Give back all IDs of an owner
+                void release_owner(const void* owner){
+                    std::lock_guard lock(m_mutex);
+                    for(slot& s : m_owners){
+                        if(s.owner == owner){
+                            s = slot();
+                        }
+                    }
+                }
+
+                bool owned_by(int ctx, const void* owner, int dfp_tag){
+                    std::lock_guard lock(m_mutex);
+                    return ctx >= 0 && ctx < static_cast<int>(m_owners.size()) && m_owners[ctx].owner == owner && m_owners[ctx].dfp_tag == dfp_tag;
+                }
+
+                //IDs of a dfp of an owner, in increasing order
+                std::vector<int> owned(const void* owner, int dfp_tag){
+                    std::lock_guard lock(m_mutex);
+                    std::vector<int> contexts;
+                    for(int ctx = 0; ctx < static_cast<int>(m_owners.size()); ++ctx){
+                        if(m_owners[ctx].owner == owner && m_owners[ctx].dfp_tag == dfp_tag){
+                            contexts.push_back(ctx);
+                        }
+                    }
+                    return contexts;
+                }
+
+                int num_free(){
+                    std::lock_guard lock(m_mutex);
+                    int count = 0;
+                    for(const slot& s : m_owners){
+                        count += (s.owner == NULL) ? 1 : 0;
+                    }
+                    return count;
+                }
+
+            private:
+                struct slot{
+                    const void* owner = NULL;
+                    int dfp_tag = -1;
+                };
+
+                std::vector<slot> m_owners;
+                std::mutex m_mutex;
+        };
+    } // namespace Utils
+} // namespace MX
+
+#endif
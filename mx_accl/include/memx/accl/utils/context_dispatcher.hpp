@@ -0,0 +1,196 @@
+#ifndef CONTEXT_DISPATCHER_HPP
+#define CONTEXT_DISPATCHER_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <memx/accl/utils/mxTypes.h>
+
+namespace MX
+{
+    namespace Utils
+    {
+        /**
+         * @brief Picks the context of each frame a model sends and tracks the frames in flight on every context.
+         * Contexts and streams are identified by their index in the model. acquire(), complete() and the stats are
+         * thread safe and take no locks, but the frames of one context have to be completed by one thread at a time.
+         * set_options() can be called at any time, reset() is not thread safe.
+         */
+        class context_dispatcher{
+            public:
+                context_dispatcher() = default;
+
+                //Size the dispatcher for num_contexts contexts and num_streams streams, clearing all statistics
+                void reset(int num_contexts, int num_streams){
+                    m_num_contexts = std::max(num_contexts, 1);
+                    m_contexts.reset(new context_state[m_num_contexts]);
+                    m_num_streams = std::max(num_streams, 0);
+                    m_stream_context.reset(new std::atomic<int>[std::max(m_num_streams, 1)]);
+                    for(int s = 0; s < m_num_streams; ++s){
+                        m_stream_context[s].store(-1, std::memory_order_relaxed);
+                    }
+                    m_rr_next.store(0);
+                }
+
+                void set_options(const MX::Types::DispatchOptions& options){
+                    m_policy.store(options.policy);
+                    m_affinity.store(options.stream_affinity);
+                }
+
+                MX::Types::DispatchOptions get_options() const{
+                    MX::Types::DispatchOptions options;
+                    options.policy = m_policy.load();
+                    options.stream_affinity = m_affinity.load();
+                    return options;
+                }
+
+                //true if every frame goes to the next context in turn, without any choice to make
+                bool round_robin() const{
+                    return m_policy.load(std::memory_order_relaxed) == MX::Types::DISPATCH_ROUND_ROBIN && !m_affinity.load(std::memory_order_relaxed);
+                }
+
+                //Pick the context of the next frame of a stream and count the frame as in flight on it
+                int acquire(int stream){
+                    bool affinity = m_affinity.load(std::memory_order_relaxed) && stream >= 0 && stream < m_num_streams;
+                    if(affinity){
+                        int ctx = m_stream_context[stream].load(std::memory_order_relaxed);
+                        if(ctx >= 0){
+                            take(ctx);
+                            return ctx;
+                        }
+                    }
+                    int ctx = pick();
+                    if(affinity){
+                        m_stream_context[stream].store(ctx, std::memory_order_relaxed);
+                    }
+                    take(ctx);
+                    return ctx;
+                }
+
+                //Count a frame sent to a given context, e.g. when a send is retried on the next context
+                void take(int ctx){
+                    context_state& state = m_contexts[ctx];
+                    int in_flight = state.in_flight.fetch_add(1, std::memory_order_relaxed) + 1;
+                    state.frames_sent.fetch_add(1, std::memory_order_relaxed);
+                    int max_in_flight = state.max_in_flight.load(std::memory_order_relaxed);
+                    while(in_flight > max_in_flight && !state.max_in_flight.compare_exchange_weak(max_in_flight, in_flight, std::memory_order_relaxed)){
+                    }
+                }
+
+                //Undo acquire() or take() for a frame that could not be sent
+                void cancel(int ctx){
+                    m_contexts[ctx].in_flight.fetch_sub(1, std::memory_order_relaxed);
+                    m_contexts[ctx].frames_sent.fetch_sub(1, std::memory_order_relaxed);
+                }
+
+                //The outputs of a frame sent to a context will never be read, e.g. the context failed with the frame on it.
+                //The frame stays counted in frames_sent
+                void fail(int ctx){
+                    m_contexts[ctx].in_flight.fetch_sub(1, std::memory_order_relaxed);
+                }
+
+                //The outputs of a frame were read from a context, latency_ns after it was sent.
+                //in_flight_at_send is the number of frames on the context right after the frame was sent
+                void complete(int ctx, uint64_t latency_ns, int in_flight_at_send){
+                    context_state& state = m_contexts[ctx];
+                    state.in_flight.fetch_sub(1, std::memory_order_relaxed);
+                    state.total_latency_ns.fetch_add(latency_ns, std::memory_order_relaxed);
+                    state.completed.fetch_add(1, std::memory_order_relaxed);
+                    //the frames ahead of it were served in its latency, which estimates the time per frame of the context
+                    uint64_t per_frame = latency_ns / static_cast<uint64_t>(std::max(in_flight_at_send, 1));
+                    uint64_t estimate = state.frame_ns.load(std::memory_order_relaxed);
+                    state.frame_ns.store(estimate == 0 ? per_frame : estimate - estimate/8 + per_frame/8, std::memory_order_relaxed);
+                }
+
+                //Forget the context of a stream whose index is given to a new stream
+                void release_stream(int stream){
+                    if(stream >= 0 && stream < m_num_streams){
+                        m_stream_context[stream].store(-1, std::memory_order_relaxed);
+                    }
+                }
+
+                int in_flight(int ctx) const{
+                    return m_contexts[ctx].in_flight.load(std::memory_order_relaxed);
+                }
+
+                int num_contexts() const { return m_num_contexts; }
+
+                MX::Types::DispatchStats stats() const{
+                    MX::Types::DispatchStats stats;
+                    uint64_t total = 0;
+                    uint64_t busiest = 0;
+                    for(int ctx = 0; ctx < m_num_contexts; ++ctx){
+                        const context_state& state = m_contexts[ctx];
+                        MX::Types::ContextStats context;
+                        context.frames_sent = state.frames_sent.load(std::memory_order_relaxed);
+                        context.in_flight = state.in_flight.load(std::memory_order_relaxed);
+                        context.max_in_flight = state.max_in_flight.load(std::memory_order_relaxed);
+                        uint64_t completed = state.completed.load(std::memory_order_relaxed);
+                        if(completed > 0){
+                            context.avg_latency_us = state.total_latency_ns.load(std::memory_order_relaxed) / (1000.0 * completed);
+                        }
+                        total += context.frames_sent;
+                        busiest = std::max(busiest, context.frames_sent);
+                        stats.contexts.push_back(context);
+                    }
+                    if(total > 0){
+                        stats.imbalance = static_cast<double>(busiest) * m_num_contexts / total - 1.0;
+                    }
+                    return stats;
+                }
+
+            private:
+                struct context_state{
+                    std::atomic<int> in_flight{0};
+                    std::atomic<int> max_in_flight{0};
+                    std::atomic<uint64_t> frames_sent{0};
+                    std::atomic<uint64_t> completed{0};
+                    std::atomic<uint64_t> total_latency_ns{0};
+                    std::atomic<uint64_t> frame_ns{0}; // moving average of the time per frame, 0 until a frame completed
+                };
+
+                int pick(){
+                    int start = static_cast<int>(m_rr_next.fetch_add(1, std::memory_order_relaxed) % m_num_contexts);
+                    if(m_policy.load(std::memory_order_relaxed) == MX::Types::DISPATCH_ROUND_ROBIN){
+                        return start;
+                    }
+                    //contexts without a measurement yet cost as much as the fastest measured one,
+                    //ties go to the round robin order
+                    uint64_t fastest = 0;
+                    for(int ctx = 0; ctx < m_num_contexts; ++ctx){
+                        uint64_t frame_ns = m_contexts[ctx].frame_ns.load(std::memory_order_relaxed);
+                        if(frame_ns > 0 && (fastest == 0 || frame_ns < fastest)){
+                            fastest = frame_ns;
+                        }
+                    }
+                    int best = start;
+                    uint64_t best_cost = UINT64_MAX;
+                    for(int i = 0; i < m_num_contexts; ++i){
+                        int ctx = (start + i) % m_num_contexts;
+                        uint64_t frame_ns = m_contexts[ctx].frame_ns.load(std::memory_order_relaxed);
+                        if(frame_ns == 0){
+                            frame_ns = std::max<uint64_t>(fastest, 1);
+                        }
+                        uint64_t cost = (m_contexts[ctx].in_flight.load(std::memory_order_relaxed) + 1) * frame_ns;
+                        if(cost < best_cost){
+                            best_cost = cost;
+                            best = ctx;
+                        }
+                    }
+                    return best;
+                }
+
+                int m_num_contexts = 1;
+                int m_num_streams = 0;
+                std::unique_ptr<context_state[]> m_contexts{new context_state[1]};
+                std::unique_ptr<std::atomic<int>[]> m_stream_context;
+                std::atomic<MX::Types::ContextDispatchPolicy> m_policy{MX::Types::DISPATCH_ROUND_ROBIN};
+                std::atomic<bool> m_affinity{false};
+                std::atomic<uint32_t> m_rr_next{0};
+        };
+    } // namespace Utils
+} // namespace MX
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef CONTEXT_HEALTH_HPP
+#define CONTEXT_HEALTH_HPP
+
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+#include <memx/accl/utils/mxTypes.h>
+
+namespace MX
+{
+    namespace Utils
+    {
+        /**
+         * @brief Health of the contexts of a dfp, shared by its models. The first failure reported on a context marks it
+         * unhealthy, the models stop sending to it and a background thread brings it back with the reset function,
+         * retrying with a doubling backoff. Every failure starts a new generation of the context, so frames sent before
+         * a failure are told apart from frames sent to the recovered context. Faults can be injected in place of driver
+         * errors to test the failure paths. All functions are thread safe, healthy(), generation() and take_fault()
+         * take no locks.
+         */
+        class context_health{
+            public:
+                //reset(context_idx) brings a failed context back, it throws if the context can't be recovered
+                using reset_fn = std::function<void(int context_idx)>;
+
+                context_health(int num_contexts, reset_fn reset) : m_num_contexts(std::max(num_contexts, 0)),
+                                                                   m_states(new context_state[std::max(num_contexts, 1)]),
+                                                                   m_reset(std::move(reset)) {}
+
+                ~context_health(){
+                    stop();
+                }
+
+                void set_policy(const MX::Types::FailoverPolicy& policy){
+                    std::lock_guard lock(m_mutex);
+                    m_policy = policy;
+                }
+
+                MX::Types::FailoverPolicy policy(){
+                    std::lock_guard lock(m_mutex);
+                    return m_policy;
+                }
+
+                //Without recovery a failed context stays unhealthy, e.g. when the dfp on it is chosen by a swap scheduler
+                void set_recovery(bool enable){
+                    std::lock_guard lock(m_mutex);
+                    m_recovery = enable;
+                }
+
+                int num_contexts() const { return m_num_contexts; }
+
+                bool healthy(int ctx) const{
+                    return m_states[ctx].healthy.load(std::memory_order_acquire);
+                }
+
+                //Generation of a context, to be read before a frame is sent to it
+                uint32_t generation(int ctx) const{
+                    return m_states[ctx].generation.load(std::memory_order_acquire);
+                }
+
+                bool any_healthy() const{
+                    for(int ctx = 0; ctx < m_num_contexts; ++ctx){
+                        if(healthy(ctx)){
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+
+                /**
+                 * @brief Report that a frame sent to a context in generation gen failed.
+                 * @return true if this report marked the context unhealthy, false if the generation had already failed
+                 */
+                bool report_failure(int ctx, uint32_t gen, const std::string& error){
+                    {
+                        std::lock_guard lock(m_mutex);
+                        context_state& state = m_states[ctx];
+                        if(gen != state.generation.load(std::memory_order_relaxed) || !state.healthy.load(std::memory_order_relaxed)){
+                            return false;
+                        }
+                        state.healthy.store(false, std::memory_order_release);
+                        state.generation.fetch_add(1, std::memory_order_release);
+                        state.failures++;
+                        state.last_error = error;
+                        if(m_recovery && m_reset && m_policy.max_recovery_attempts > 0 && !m_stop){
+                            state.recovering = true;
+                            m_pending.push_back(ctx);
+                            if(!m_thread){
+                                m_thread.reset(new std::thread(&context_health::recovery_fun, this));
+                            }
+                        }
+                    }
+                    m_cv.notify_all();
+                    std::cerr<<"Warning!! Context "<<ctx<<" failed: "<<error<<". Its frames go to the other contexts"<<std::endl;
+                    return true;
+                }
+
+                //Make the next count checks of a context with take_fault() fail
+                void inject_fault(int ctx, int count){
+                    m_states[ctx].faults.fetch_add(count, std::memory_order_relaxed);
+                }
+
+                //true if an injected fault of the context is due, consuming it
+                bool take_fault(int ctx){
+                    int faults = m_states[ctx].faults.load(std::memory_order_relaxed);
+                    while(faults > 0){
+                        if(m_states[ctx].faults.compare_exchange_weak(faults, faults - 1, std::memory_order_relaxed)){
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+
+                /**
+                 * @brief Wait till no context is waiting for recovery.
+                 * @param timeout_ms maximum wait in milliseconds, 0 waits forever
+                 * @return false on timeout
+                 */
+                bool wait_recovery(int32_t timeout_ms){
+                    std::unique_lock lock(m_mutex);
+                    auto done = [this]{ return m_pending.empty(); };
+                    if(timeout_ms > 0){
+                        return m_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), done);
+                    }
+                    m_cv.wait(lock, done);
+                    return true;
+                }
+
+                std::vector<MX::Types::ContextHealth> stats(){
+                    std::lock_guard lock(m_mutex);
+                    std::vector<MX::Types::ContextHealth> stats;
+                    for(int ctx = 0; ctx < m_num_contexts; ++ctx){
+                        const context_state& state = m_states[ctx];
+                        MX::Types::ContextHealth health;
+                        health.healthy = state.healthy.load(std::memory_order_relaxed);
+                        health.recovering = state.recovering;
+                        health.failures = state.failures;
+                        health.recoveries = state.recoveries;
+                        health.last_error = state.last_error;
+                        stats.push_back(health);
+                    }
+                    return stats;
+                }
+
+                //Stop the recovery thread, a recovery in progress is finished first
+                void stop(){
+                    {
+                        std::lock_guard lock(m_mutex);
+                        m_stop = true;
+                    }
+                    m_cv.notify_all();
+                    if(m_thread){
+                        m_thread->join();
+                        m_thread.reset();
+                    }
+                }
+
+            private:
+                struct context_state{
+                    std::atomic<bool> healthy{true};
+                    std::atomic<uint32_t> generation{0};
+                    std::atomic<int> faults{0};
+                    bool recovering = false;
+                    uint64_t failures = 0;
+                    uint64_t recoveries = 0;
+                    std::string last_error;
+                };
+
+                void recovery_fun(){
+                    std::unique_lock lock(m_mutex);
+                    while(true){
+                        m_cv.wait(lock, [this]{ return m_stop || !m_pending.empty(); });
+                        if(m_stop){
+                            break;
+                        }
+                        int ctx = m_pending.front();
+                        MX::Types::FailoverPolicy policy = m_policy;
+                        bool recovered = false;
+                        std::string error;
+                        for(int attempt = 0; attempt < policy.max_recovery_attempts; ++attempt){
+                            //the backoff also gives the frames still in flight on the context time to be moved off it
+                            auto backoff = std::chrono::milliseconds(static_cast<int64_t>(policy.recovery_backoff_ms) << std::min(attempt, 16));
+                            if(m_cv.wait_for(lock, backoff, [this]{ return m_stop; })){
+                                break;
+                            }
+                            lock.unlock();
+                            try{
+                                m_reset(ctx);
+                                recovered = true;
+                            }
+                            catch(const std::exception& err){
+                                error = err.what();
+                            }
+                            catch(...){
+                                error = "unknown error";
+                            }
+                            lock.lock();
+                            if(recovered){
+                                break;
+                            }
+                        }
+                        context_state& state = m_states[ctx];
+                        m_pending.pop_front();
+                        state.recovering = false;
+                        if(recovered){
+                            state.recoveries++;
+                            state.healthy.store(true, std::memory_order_release);
+                        }
+                        else if(!m_stop){
+                            if(!error.empty()){
+                                state.last_error = error;
+                            }
+                            std::cerr<<"Warning!! Context "<<ctx<<" could not be recovered: "<<state.last_error<<std::endl;
+                        }
+                        m_cv.notify_all();
+                    }
+                    //contexts left waiting stay unhealthy
+                    for(int ctx : m_pending){
+                        m_states[ctx].recovering = false;
+                    }
+                    m_pending.clear();
+                    m_cv.notify_all();
+                }
+
+                int m_num_contexts;
+                std::unique_ptr<context_state[]> m_states;
+                reset_fn m_reset;
+                MX::Types::FailoverPolicy m_policy;
+                bool m_recovery = true;
+                bool m_stop = false;
+                std::deque<int> m_pending;
+                std::mutex m_mutex;
+                std::condition_variable m_cv;
+                std::unique_ptr<std::thread> m_thread;
+        };
+    } // namespace Utils
+} // namespace MX
+
+#endif
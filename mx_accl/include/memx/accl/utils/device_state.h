@@ -0,0 +1,42 @@
+#ifndef DEVICE_STATE_H
+#define DEVICE_STATE_H
+
+#include <map>
+#include <stdint.h>
+#include <filesystem>
+
+namespace MX
+{
+    namespace Utils
+    {
+        /**
+         * @brief What the runtime last configured and downloaded on an MXA device. It is kept in a file per device,
+         * so the next process that locks the device can skip the steps whose result is still on the device.
+         * The files are tied to the boot they were written in, a device is reset with the system.
+         */
+        struct device_state{
+            int mpu_config = -1;                 // MPU group configuration, -1 if unknown
+            int power_chips = 0;                 // chip count the frequency and voltage were set for, 0 if unknown
+            uint16_t frequency = 0;
+            uint16_t voltage = 0;
+            std::map<int, uint64_t> context_dfp; // content hash of the dfp downloaded to each group, by the order its context was opened in
+        };
+
+        //Directory of the state files, cleared on reboot where the system has such a directory
+        std::filesystem::path device_state_dir();
+
+        //State of a device as saved by the last process that used it, everything unknown if there is none
+        device_state load_device_state(int device_id);
+
+        //Replace the saved state of a device. Errors are ignored, the next process then redoes the setup
+        void save_device_state(int device_id, const device_state& state);
+
+        //64-bit FNV-1a hash of a buffer, continuing from hash
+        uint64_t hash_bytes(const uint8_t* data, size_t size, uint64_t hash = 14695981039346656037ull);
+
+        //Content hash of a dfp file, 0 if it can't be read
+        uint64_t hash_file(const std::filesystem::path& path);
+    } // namespace Utils
+} // namespace MX
+
+#endif
@@ -87,6 +87,7 @@ namespace MX
 
             //Returns the pointer of formatted data of featureMap
             uint8_t *get_formatted_data();
+            const uint8_t *get_formatted_data() const;
 
             virtual ~FeatureMap();
             //sets the the in_ready flag to user input
@@ -105,11 +106,21 @@ namespace MX
             //copy assignment operator
             FeatureMap& operator=(const FeatureMap& rhs);
 
-            size_t get_formatted_size();
+            size_t get_formatted_size() const;
+            //number of elements of the data in user-facing format
+            size_t get_data_size() const;
+            //format of the formatted data exchanged with the MXA
+            MX_data_format get_format() const;
             std::vector<int64_t> shape(bool channel_first=false) const;
             T* get_data_ptr();
             FeatureMap_Type fm_type = FM_DFP;
             int get_num_fmap_threads() const;
+            //changes the number of conversion threads, can be called while the featureMap is in use
+            void set_num_fmap_threads(int num_threads);
+            //mlocks and prefaults the data and formatted buffers, returns false if they could not be locked
+            bool lock_buffers();
+            //unlocks buffers locked by lock_buffers
+            void unlock_buffers();
         private:
             T *fmap_data; // data in user-facing format (float or uint8_t)
             size_t featureMap_size; // size, in terms of user-facing format
@@ -131,7 +142,8 @@ namespace MX
             uint16_t dim_z;      // shape dimension z
             uint16_t num_ch;      // number of channels -- used for GBF calculations, shape and transforms
 
-            int fmap_convert_threads_;
+            std::atomic_int fmap_convert_threads_;
+            bool buffers_locked_ = false;
 
         };
     } // namespace Types
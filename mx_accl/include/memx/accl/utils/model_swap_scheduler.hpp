@@ -0,0 +1,245 @@
+#ifndef MODEL_SWAP_SCHEDULER_HPP
+#define MODEL_SWAP_SCHEDULER_HPP
+
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+#include <memx/accl/utils/mxTypes.h>
+
+namespace MX
+{
+    namespace Utils
+    {
+        /**
+         * @brief Lets several members (dfps) take turns on the same devices. Only the resident member may send frames,
+         * a member with queued frames is swapped in once the resident one is idle (no frame queued, being sent or on
+         * the device) or has sent a whole batch while others were waiting, and all of its frames were read back.
+         * Members are served in turn, so a member with queued work waits at most one batch of every other member.
+         * All functions are thread safe. The swap function is called without the lock held, by one of the threads
+         * waiting to send to the member being swapped in.
+         */
+        class model_swap_scheduler{
+            public:
+                //swap(from, to) replaces member from on the devices by member to. from is -1 when no member is resident
+                using swap_fn = std::function<void(int from, int to)>;
+
+                model_swap_scheduler(swap_fn swap, int resident = -1) : m_swap(std::move(swap)), m_resident(resident) {}
+
+                //Add a member and return its index
+                int add_member(){
+                    std::lock_guard lock(m_mutex);
+                    m_members.emplace_back();
+                    return static_cast<int>(m_members.size()) - 1;
+                }
+
+                //Number of frames the resident member sends before it gives the devices up to a waiting member
+                void set_batch_size(int frames){
+                    {
+                        std::lock_guard lock(m_mutex);
+                        m_batch_size = std::max(frames, 1);
+                    }
+                    m_cv.notify_all();
+                }
+
+                /**
+                 * @brief Wait until member is resident and may send num_frames frames, swapping it in if it is its turn.
+                 * Every successful enter() has to be followed by leave().
+                 * @param timeout_ms maximum wait in milliseconds, 0 waits forever
+                 * @return false on timeout or after stop()
+                 */
+                bool enter(int member, int num_frames, int32_t timeout_ms){
+                    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+                    std::unique_lock lock(m_mutex);
+                    m_members[member].queued += num_frames;
+                    while(true){
+                        if(m_stop){
+                            m_members[member].queued -= num_frames;
+                            m_cv.notify_all();
+                            return false;
+                        }
+                        if(!m_swapping && m_resident == member && (m_batch_sent < m_batch_size || !others_waiting(member))){
+                            m_members[member].queued -= num_frames;
+                            m_members[member].sending++;
+                            m_batch_sent += num_frames;
+                            return true;
+                        }
+                        if(!m_swapping && next_member() == member){
+                            bool swapped;
+                            try{
+                                swapped = swap_in(lock, member, timeout_ms, deadline);
+                            }
+                            catch(...){
+                                m_members[member].queued -= num_frames;
+                                throw;
+                            }
+                            if(!swapped){
+                                m_members[member].queued -= num_frames;
+                                m_cv.notify_all();
+                                return false;
+                            }
+                            continue;
+                        }
+                        if(!wait(lock, timeout_ms, deadline)){
+                            m_members[member].queued -= num_frames;
+                            m_cv.notify_all();
+                            return false;
+                        }
+                    }
+                }
+
+                //The sender admitted by enter() is done, sent frames are now on the device until complete() is called
+                void leave(int member, int sent_frames){
+                    {
+                        std::lock_guard lock(m_mutex);
+                        m_members[member].sending--;
+                        m_members[member].on_device += sent_frames;
+                        m_members[member].frames += sent_frames;
+                    }
+                    m_cv.notify_all();
+                }
+
+                //The outputs of a frame of member were read from the device
+                void complete(int member){
+                    std::lock_guard lock(m_mutex);
+                    //an idle resident member gives the devices up, a swap waits for the device to drain
+                    if(--m_members[member].on_device == 0){
+                        m_cv.notify_all();
+                    }
+                }
+
+                //Wake all waiting senders and refuse new ones
+                void stop(){
+                    {
+                        std::lock_guard lock(m_mutex);
+                        m_stop = true;
+                    }
+                    m_cv.notify_all();
+                }
+
+                int resident(){
+                    std::lock_guard lock(m_mutex);
+                    return m_resident;
+                }
+
+                MX::Types::SwapStats stats(){
+                    std::lock_guard lock(m_mutex);
+                    MX::Types::SwapStats stats;
+                    stats.resident = m_resident;
+                    stats.swaps = m_swaps;
+                    if(m_swaps > 0){
+                        stats.avg_swap_ms = m_total_swap_ns / (1e6 * m_swaps);
+                    }
+                    stats.max_swap_ms = m_max_swap_ns / 1e6;
+                    uint64_t frames = 0;
+                    for(const member_state& state : m_members){
+                        frames += state.frames;
+                        stats.frames_sent.push_back(state.frames);
+                    }
+                    //each residency started with a swap, except the first one
+                    stats.avg_frames_per_swap = static_cast<double>(frames) / std::max<uint64_t>(m_swaps, 1);
+                    return stats;
+                }
+
+            private:
+                struct member_state{
+                    int queued = 0;     // frames waiting in enter()
+                    int sending = 0;    // senders admitted and not yet left
+                    int on_device = 0;  // frames sent and not yet completed
+                    uint64_t frames = 0;
+                };
+
+                bool others_waiting(int member) const{
+                    for(int m = 0; m < static_cast<int>(m_members.size()); ++m){
+                        if(m != member && m_members[m].queued > 0){
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+
+                //member to swap in next, -1 if the resident member keeps the devices
+                int next_member() const{
+                    int num_members = static_cast<int>(m_members.size());
+                    if(m_resident >= 0 && m_batch_sent < m_batch_size){
+                        const member_state& state = m_members[m_resident];
+                        if(state.queued > 0 || state.sending > 0 || state.on_device > 0){
+                            return -1;
+                        }
+                    }
+                    for(int i = 1; i <= num_members; ++i){
+                        int m = (std::max(m_resident, 0) + i) % num_members;
+                        if(m != m_resident && m_members[m].queued > 0){
+                            return m;
+                        }
+                    }
+                    return -1;
+                }
+
+                bool wait(std::unique_lock<std::mutex>& lock, int32_t timeout_ms, std::chrono::steady_clock::time_point deadline){
+                    if(timeout_ms > 0){
+                        return m_cv.wait_until(lock, deadline) == std::cv_status::no_timeout;
+                    }
+                    m_cv.wait(lock);
+                    return true;
+                }
+
+                //Drain the resident member and swap member in, called with the lock held
+                bool swap_in(std::unique_lock<std::mutex>& lock, int member, int32_t timeout_ms, std::chrono::steady_clock::time_point deadline){
+                    m_swapping = true;
+                    int from = m_resident;
+                    while(from >= 0 && !m_stop && (m_members[from].sending > 0 || m_members[from].on_device > 0)){
+                        if(!wait(lock, timeout_ms, deadline)){
+                            m_swapping = false;
+                            return false;
+                        }
+                    }
+                    if(m_stop){
+                        m_swapping = false;
+                        return false;
+                    }
+                    auto start = std::chrono::steady_clock::now();
+                    lock.unlock();
+                    try{
+                        m_swap(from, member);
+                    }
+                    catch(...){
+                        lock.lock();
+                        //the devices are in an unknown state, the next sender downloads its member again
+                        m_resident = -1;
+                        m_swapping = false;
+                        m_cv.notify_all();
+                        throw;
+                    }
+                    uint64_t swap_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                    lock.lock();
+                    m_resident = member;
+                    m_batch_sent = 0;
+                    m_swapping = false;
+                    m_swaps++;
+                    m_total_swap_ns += swap_ns;
+                    m_max_swap_ns = std::max(m_max_swap_ns, swap_ns);
+                    m_cv.notify_all();
+                    return true;
+                }
+
+                swap_fn m_swap;
+                std::mutex m_mutex;
+                std::condition_variable m_cv;
+                std::vector<member_state> m_members;
+                int m_resident = -1;
+                int m_batch_size = 32;
+                int m_batch_sent = 0;
+                bool m_swapping = false;
+                bool m_stop = false;
+                uint64_t m_swaps = 0;
+                uint64_t m_total_swap_ns = 0;
+                uint64_t m_max_swap_ns = 0;
+        };
+    } // namespace Utils
+} // namespace MX
+
+#endif
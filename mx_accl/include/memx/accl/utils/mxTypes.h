@@ -1,6 +1,7 @@
 #ifndef MXTYPES_H
 #define MXTYPES_H
 #include <vector>
+#include <string>
 #include <stdint.h>
 #include <stdexcept>
 #include <iostream>
@@ -97,6 +98,404 @@ namespace MX
             std::vector<size_t> out_featuremap_sizes;
         };
 
+        /**
+         * @brief Order in which the send stage of a model picks the filled inputs of its streams
+         * - SCHEDULE_FIFO : frames are sent in the order their input callbacks returned (default)
+         * - SCHEDULE_ROUND_ROBIN : streams with a pending frame take turns, one frame each
+         * - SCHEDULE_WEIGHTED_FAIR : streams share the send stage in proportion to StreamOptions::weight
+         * - SCHEDULE_PRIORITY : the stream with the highest StreamOptions::priority is always served first
+         * - SCHEDULE_DEADLINE : the frame with the earliest deadline (filled time + StreamOptions::deadline_us) is served first
+         */
+        enum StreamSchedulePolicy{
+            SCHEDULE_FIFO = 0,
+            SCHEDULE_ROUND_ROBIN,
+            SCHEDULE_WEIGHTED_FAIR,
+            SCHEDULE_PRIORITY,
+            SCHEDULE_DEADLINE
+        };
+
+        /** @struct StreamOptions
+            @brief per-stream scheduling options passed to connect_stream
+            @var StreamOptions::weight
+            Share of the send stage under SCHEDULE_WEIGHTED_FAIR, must be >= 1
+            @var StreamOptions::priority
+            Priority class under SCHEDULE_PRIORITY, higher values are served first
+            @var StreamOptions::deadline_us
+            Latency budget of each frame in microseconds under SCHEDULE_DEADLINE, 0 means no deadline
+            @var StreamOptions::freshest_only
+            Latest-frame-wins mode for live input, a new frame replaces the previous frame of the stream
+            if that one hasn't been sent to the MXA yet. Replaced frames are counted in StreamStats::frames_dropped
+        */
+        struct StreamOptions{
+            int weight = 1;
+            int priority = 0;
+            int64_t deadline_us = 0;
+            bool freshest_only = false;
+        };
+
+        /** @struct StreamStats
+            @brief time the frames of a stream waited in the send stage of its model
+            @var StreamStats::frames_sent
+            Number of frames handed to the MXA
+            @var StreamStats::avg_wait_us
+            Average time in microseconds between the input callback returning and the frame being picked for sending
+            @var StreamStats::max_wait_us
+            Maximum of that time in microseconds
+            @var StreamStats::deadline_misses
+            Number of frames picked after their deadline under SCHEDULE_DEADLINE
+            @var StreamStats::frames_dropped
+            Number of frames replaced by a newer frame before being sent in freshest_only mode
+            @var StreamStats::frames_failed
+            Number of frames lost to a failed context, their output callback is not called
+            @var StreamStats::frames_rerouted
+            Number of frames sent again on another context after their context failed
+            @var StreamStats::last_error
+            Error of the last failed or rerouted frame, empty if there was none
+        */
+        struct StreamStats{
+            uint64_t frames_sent = 0;
+            double avg_wait_us = 0;
+            double max_wait_us = 0;
+            uint64_t deadline_misses = 0;
+            uint64_t frames_dropped = 0;
+            uint64_t frames_failed = 0;
+            uint64_t frames_rerouted = 0;
+            std::string last_error;
+        };
+
+        /** @struct AutoTuneConfig
+            @brief bounds and period of the runtime controller that resizes the worker pools and conversion threads of a model
+            @var AutoTuneConfig::min_input_workers
+            Lower bound of input workers
+            @var AutoTuneConfig::max_input_workers
+            Upper bound of input workers, 0 means number of streams of the model
+            @var AutoTuneConfig::min_output_workers
+            Lower bound of output workers
+            @var AutoTuneConfig::max_output_workers
+            Upper bound of output workers, 0 means number of streams of the model
+            @var AutoTuneConfig::min_convert_threads
+            Lower bound of FeatureMap conversion threads
+            @var AutoTuneConfig::max_convert_threads
+            Upper bound of FeatureMap conversion threads, 0 means number of cores / (2 * number of models)
+            @var AutoTuneConfig::interval_ms
+            Time between two decisions of the controller in milliseconds
+        */
+        struct AutoTuneConfig{
+            int min_input_workers = 1;
+            int max_input_workers = 0;
+            int min_output_workers = 1;
+            int max_output_workers = 0;
+            int min_convert_threads = 1;
+            int max_convert_threads = 0;
+            int interval_ms = 1000;
+        };
+
+        /** @struct ThreadPlacement
+            @brief where and how the threads of one stage of a model run (Linux only, ignored on other platforms)
+            @var ThreadPlacement::cpus
+            CPUs the threads are pinned to, empty keeps the default affinity
+            @var ThreadPlacement::rt_priority
+            SCHED_FIFO priority (1-99) of the threads, 0 keeps the default scheduler
+            @var ThreadPlacement::nice
+            nice level of the threads when rt_priority is 0
+        */
+        struct ThreadPlacement{
+            std::vector<int> cpus;
+            int rt_priority = 0;
+            int nice = 0;
+        };
+
+        /** @struct ThreadPolicy
+            @brief placement of every stage of a model and memory locking of its featureMaps
+            @var ThreadPolicy::input_workers
+            Placement of the input worker pool
+            @var ThreadPolicy::output_workers
+            Placement of the output worker pool
+            @var ThreadPolicy::send
+            Placement of the send thread
+            @var ThreadPolicy::recv
+            Placement of the recv threads, one per context
+            @var ThreadPolicy::lock_memory
+            mlock and prefault the featureMap buffers so the data path never takes a page fault
+        */
+        struct ThreadPolicy{
+            ThreadPlacement input_workers;
+            ThreadPlacement output_workers;
+            ThreadPlacement send;
+            ThreadPlacement recv;
+            bool lock_memory = false;
+        };
+
+        /** @struct StopPolicy
+            @brief how a model drains its streams and what it keeps when stopped
+            @var StopPolicy::drain_timeout_ms
+            Time stop() waits for outputs already read from the MXA to go through the output callbacks, in milliseconds.
+            Outputs still pending after it are dropped
+            @var StopPolicy::keep_buffers
+            Keep the featureMaps of the model allocated after stop(), the next start() reuses them instead of allocating
+            the featureMaps of all streams again. They are released by the next stop() without this option or by the destructor
+        */
+        struct StopPolicy{
+            int drain_timeout_ms = 5000;
+            bool keep_buffers = false;
+        };
+
+        /**
+         * @brief How the send stage of a model picks the context (device group) of each frame
+         * - DISPATCH_ROUND_ROBIN : contexts take turns, one frame each (default)
+         * - DISPATCH_LEAST_OUTSTANDING : the context with the least queued work, its in-flight frames times
+         *   its measured time per frame, so a slower or throttled device gets fewer frames
+         */
+        enum ContextDispatchPolicy{
+            DISPATCH_ROUND_ROBIN = 0,
+            DISPATCH_LEAST_OUTSTANDING
+        };
+
+        /** @struct DispatchOptions
+            @brief context selection of the send stage of a model
+            @var DispatchOptions::policy
+            One of ContextDispatchPolicy
+            @var DispatchOptions::stream_affinity
+            Keep all frames of a stream on the context its first frame was sent to, which keeps the outputs
+            of a stream in order without waiting on other contexts. The first frame picks the context by the policy
+        */
+        struct DispatchOptions{
+            ContextDispatchPolicy policy = DISPATCH_ROUND_ROBIN;
+            bool stream_affinity = false;
+        };
+
+        /** @struct ContextStats
+            @brief frames sent to one context of a model since the last start
+            @var ContextStats::frames_sent
+            Number of frames sent to the context
+            @var ContextStats::in_flight
+            Frames sent to the context whose outputs have not been read yet
+            @var ContextStats::max_in_flight
+            Maximum of in_flight
+            @var ContextStats::avg_latency_us
+            Average time in microseconds between sending a frame to the context and reading its outputs
+        */
+        struct ContextStats{
+            uint64_t frames_sent = 0;
+            int in_flight = 0;
+            int max_in_flight = 0;
+            double avg_latency_us = 0;
+        };
+
+        /** @struct DispatchStats
+            @brief load of the contexts of a model
+            @var DispatchStats::contexts
+            ContextStats of each open context of the model, in context order
+            @var DispatchStats::imbalance
+            Frames sent to the busiest context over the average per context, minus one. 0 when all contexts got the same number of frames
+        */
+        struct DispatchStats{
+            std::vector<ContextStats> contexts;
+            double imbalance = 0;
+        };
+
+        /** @struct ConnectStats
+            @brief time spent in each phase of connecting a dfp, and the device setup steps skipped because their result was on the devices already
+            @var ConnectStats::parse_ms
+            Time to read and parse the dfp in milliseconds
+            @var ConnectStats::setup_ms
+            Time to lock and configure the devices in milliseconds, MPU group configuration and power settings included
+            @var ConnectStats::download_ms
+            Time to open the contexts and download the dfp to them in milliseconds
+            @var ConnectStats::models_ms
+            Time to create the model objects of the dfp in milliseconds
+            @var ConnectStats::plugins_ms
+            Time spent in connect_pre_model and connect_post_model for the models of the dfp in milliseconds
+            @var ConnectStats::buffers_ms
+            Time start() spent allocating the featureMaps of the models of the dfp in milliseconds
+            @var ConnectStats::wait_ms
+            Time the caller was blocked waiting for the download of an asynchronous connect in milliseconds
+            @var ConnectStats::total_ms
+            Time from the connect call till the dfp was on the devices in milliseconds. Without overlap it is the sum of
+            parse_ms, setup_ms, download_ms and models_ms
+            @var ConnectStats::configs_skipped
+            MPU group configurations and power settings that were already in place
+            @var ConnectStats::downloads
+            Downloads of the dfp to a context, swaps included
+            @var ConnectStats::downloads_skipped
+            Contexts that still held the dfp
+        */
+        struct ConnectStats{
+            double parse_ms = 0;
+            double setup_ms = 0;
+            double download_ms = 0;
+            double models_ms = 0;
+            double plugins_ms = 0;
+            double buffers_ms = 0;
+            double wait_ms = 0;
+            double total_ms = 0;
+            int configs_skipped = 0;
+            int downloads = 0;
+            int downloads_skipped = 0;
+        };
+
+        /** @struct SwapStats
+            @brief dfps taking turns on the same devices
+            @var SwapStats::dfp_ids
+            dfps sharing the devices, in the order they were connected
+            @var SwapStats::resident
+            index in dfp_ids of the dfp currently downloaded to the devices, -1 if none
+            @var SwapStats::swaps
+            Number of times a dfp was downloaded in place of another
+            @var SwapStats::avg_swap_ms
+            Average time of a swap in milliseconds, not counting the wait for the outputs of the previous dfp
+            @var SwapStats::max_swap_ms
+            Longest swap in milliseconds
+            @var SwapStats::avg_frames_per_swap
+            Frames sent per swap, the higher the better the swap cost is amortized
+            @var SwapStats::frames_sent
+            Frames sent to each dfp, in dfp_ids order
+        */
+        struct SwapStats{
+            std::vector<int> dfp_ids;
+            int resident = -1;
+            uint64_t swaps = 0;
+            double avg_swap_ms = 0;
+            double max_swap_ms = 0;
+            double avg_frames_per_swap = 0;
+            std::vector<uint64_t> frames_sent;
+        };
+
+        /** @struct FailoverPolicy
+            @brief what the models of a dfp do when one of its contexts fails. A failed context gets no more frames till it
+            is recovered in the background by disabling its streams and downloading the dfp again
+            @var FailoverPolicy::replay_in_flight
+            Send the frames in flight on a failed context again on the other contexts. The input featureMaps of each frame
+            are then held till its outputs are read, raise the pipeline depth to keep the MXA fed. Otherwise these frames
+            are dropped and counted in StreamStats::frames_failed
+            @var FailoverPolicy::recv_timeout_ms
+            Time to wait for the outputs of a frame before its context is taken as failed, 0 waits forever
+            @var FailoverPolicy::max_recovery_attempts
+            Number of times a failed context is reset before it is given up, 0 leaves failed contexts unused
+            @var FailoverPolicy::recovery_backoff_ms
+            Wait before the first recovery attempt in milliseconds, doubled after every failed attempt
+        */
+        struct FailoverPolicy{
+            bool replay_in_flight = false;
+            int recv_timeout_ms = 0;
+            int max_recovery_attempts = 3;
+            int recovery_backoff_ms = 100;
+        };
+
+        /** @struct ContextHealth
+            @brief state of a context of a dfp
+            @var ContextHealth::context_id
+            Id of the context
+            @var ContextHealth::healthy
+            true if frames are sent to the context
+            @var ContextHealth::recovering
+            true while the context waits for or goes through a recovery
+            @var ContextHealth::failures
+            Number of times the context failed
+            @var ContextHealth::recoveries
+            Number of times the context was recovered
+            @var ContextHealth::last_error
+            Error of the last failure or failed recovery, empty if there was none
+        */
+        struct ContextHealth{
+            int context_id = -1;
+            bool healthy = true;
+            bool recovering = false;
+            uint64_t failures = 0;
+            uint64_t recoveries = 0;
+            std::string last_error;
+        };
+
+        /**
+         * @brief How the frequency of the devices of a dfp follows their load
+         * - POWER_STATIC : the frequency set from /etc/memryx/power.conf at connect is kept (default)
+         * - POWER_PERFORMANCE : the devices run at the maximum frequency
+         * - POWER_BALANCED : the frequency is raised when the devices are busy most of the time or frames queue up,
+         *   and lowered when they are mostly idle
+         * - POWER_EFFICIENCY : the devices run at the lowest frequency that keeps frames from queuing up
+         */
+        enum PowerProfile{
+            POWER_STATIC = 0,
+            POWER_PERFORMANCE,
+            POWER_BALANCED,
+            POWER_EFFICIENCY
+        };
+
+        /** @struct PowerPolicy
+            @brief frequency policy of the devices of a dfp. The load is sampled continuously and evaluated once per interval,
+            the frequency moves one step per change
+            @var PowerPolicy::profile
+            One of PowerProfile
+            @var PowerPolicy::min_frequency
+            Lowest frequency in MHz
+            @var PowerPolicy::max_frequency
+            Highest frequency in MHz
+            @var PowerPolicy::step_mhz
+            Change of the frequency per step in MHz
+            @var PowerPolicy::interval_ms
+            Time between evaluations of the load in milliseconds
+            @var PowerPolicy::hold_intervals
+            Number of evaluations in a row that must call for a lower frequency before it is lowered. A higher
+            frequency is applied at the first evaluation that calls for it, so a rising load is served quickly
+        */
+        struct PowerPolicy{
+            PowerProfile profile = POWER_STATIC;
+            int min_frequency = 300;
+            int max_frequency = 600;
+            int step_mhz = 100;
+            int interval_ms = 1000;
+            int hold_intervals = 3;
+        };
+
+        /** @struct DevicePowerStats
+            @brief frequency and load of a device under a PowerPolicy
+            @var DevicePowerStats::device_id
+            Id of the device
+            @var DevicePowerStats::frequency
+            Current frequency in MHz
+            @var DevicePowerStats::utilization
+            Fraction of the last interval the device had frames in flight, 0 to 1
+            @var DevicePowerStats::avg_queued
+            Average number of frames waiting to be sent to the device in the last interval
+            @var DevicePowerStats::changes
+            Number of frequency changes
+            @var DevicePowerStats::errors
+            Number of frequency changes the device refused
+        */
+        struct DevicePowerStats{
+            int device_id = -1;
+            int frequency = 0;
+            double utilization = 0;
+            double avg_queued = 0;
+            uint64_t changes = 0;
+            uint64_t errors = 0;
+        };
+
+        /**
+         * @brief Device id to pass as the only entry of device_ids_to_use to connect a dfp to every free device that can
+         * run it. The list is replaced by the ids of the devices claimed
+         */
+        static constexpr int ALL_DEVICES = -1;
+
+        /** @struct DeviceCapacity
+            @brief a device a dfp runs on and its share of the frames
+            @var DeviceCapacity::device_id
+            Id of the device
+            @var DeviceCapacity::chip_count
+            Number of chips of the device
+            @var DeviceCapacity::num_contexts
+            Number of contexts of the dfp on the device, a device runs as many copies of the dfp as its chips hold
+            @var DeviceCapacity::traffic_share
+            Fraction of the frames of the dfp sent to the device under round robin dispatch, the contexts of all
+            devices take turns
+        */
+        struct DeviceCapacity{
+            int device_id = -1;
+            int chip_count = 0;
+            int num_contexts = 0;
+            double traffic_share = 0;
+        };
+
     } // Namespace Types
 } // Namespace MX
 
@@ -0,0 +1,256 @@
+#ifndef POWER_GOVERNOR_HPP
+#define POWER_GOVERNOR_HPP
+
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+#include <memx/accl/utils/mxTypes.h>
+
+namespace MX
+{
+    namespace Utils
+    {
+        /**
+         * @brief Moves the frequency of a set of devices with their load. The load of every device is sampled many times
+         * per interval of the policy, at the end of an interval the share of samples with frames in flight (utilization)
+         * and the frames waiting to be sent decide the frequency for the next one. The frequency is raised one step as
+         * soon as the load calls for it and lowered one step only after hold_intervals intervals in a row called for it,
+         * so it doesn't follow short dips of the load. sample_load() and evaluate() are run by the governor thread,
+         * or directly when no thread is started. The other functions are thread safe.
+         */
+        class power_governor{
+            public:
+                //Load of a device at one instant
+                struct load_sample{
+                    int in_flight = 0;  // frames sent to the device whose outputs have not been read yet
+                    int queued = 0;     // frames waiting to be sent to the device
+                };
+                using sample_fn = std::function<load_sample(int device_idx)>;
+                //apply(device_idx, frequency) sets the frequency of a device in MHz, it throws if the device refuses it
+                using apply_fn = std::function<void(int device_idx, int frequency)>;
+
+                //A device is busy above this utilization and idle below the lower one. Balanced raises the frequency
+                //of busy devices, efficiency only when frames queue up
+                static constexpr double busy_utilization = 0.9;
+                static constexpr double idle_utilization = 0.5;
+
+                power_governor(const std::vector<int>& device_ids, const std::vector<int>& frequencies, sample_fn sample, apply_fn apply)
+                    : m_sample(std::move(sample)), m_apply(std::move(apply)){
+                    for(size_t i = 0; i < device_ids.size(); ++i){
+                        device_load device;
+                        device.device_id = device_ids[i];
+                        device.frequency = frequencies[i];
+                        m_devices.push_back(device);
+                    }
+                }
+
+                ~power_governor(){
+                    stop();
+                }
+
+                void set_policy(const MX::Types::PowerPolicy& policy){
+                    {
+                        std::lock_guard lock(m_mutex);
+                        m_policy = policy;
+                        for(device_load& device : m_devices){
+                            device.lower_votes = 0;
+                        }
+                        m_policy_changed = true;
+                    }
+                    m_cv.notify_all();
+                }
+
+                MX::Types::PowerPolicy policy(){
+                    std::lock_guard lock(m_mutex);
+                    return m_policy;
+                }
+
+                //Take one sample of the load of every device
+                void sample_load(){
+                    for(size_t i = 0; i < m_devices.size(); ++i){
+                        load_sample sample = m_sample(static_cast<int>(i));
+                        std::lock_guard lock(m_mutex);
+                        device_load& device = m_devices[i];
+                        device.samples++;
+                        device.busy_samples += (sample.in_flight > 0) ? 1 : 0;
+                        device.queued_sum += sample.queued;
+                    }
+                }
+
+                //End the interval: set the frequency of every device from the samples taken since the last evaluation
+                void evaluate(){
+                    for(size_t i = 0; i < m_devices.size(); ++i){
+                        int from;
+                        int to;
+                        {
+                            std::lock_guard lock(m_mutex);
+                            device_load& device = m_devices[i];
+                            if(device.samples > 0){
+                                device.utilization = static_cast<double>(device.busy_samples) / device.samples;
+                                device.avg_queued = static_cast<double>(device.queued_sum) / device.samples;
+                            }
+                            device.samples = 0;
+                            device.busy_samples = 0;
+                            device.queued_sum = 0;
+                            from = device.frequency;
+                            to = target_frequency(device);
+                        }
+                        if(to == from){
+                            continue;
+                        }
+                        std::string error;
+                        try{
+                            m_apply(static_cast<int>(i), to);
+                        }
+                        catch(const std::exception& err){
+                            error = err.what();
+                        }
+                        std::lock_guard lock(m_mutex);
+                        device_load& device = m_devices[i];
+                        if(!error.empty()){
+                            device.errors++;
+                            std::cerr<<"Warning!! Device "<<device.device_id<<" refused frequency "<<to<<" MHz: "<<error<<std::endl;
+                            continue;
+                        }
+                        device.frequency = to;
+                        device.changes++;
+                        std::cout<<"Device "<<device.device_id<<" frequency "<<from<<" -> "<<to<<" MHz (utilization "
+                                 <<static_cast<int>(device.utilization*100)<<"%, "<<device.avg_queued<<" frames queued)"<<std::endl;
+                    }
+                }
+
+                std::vector<MX::Types::DevicePowerStats> stats(){
+                    std::lock_guard lock(m_mutex);
+                    std::vector<MX::Types::DevicePowerStats> stats;
+                    for(const device_load& device : m_devices){
+                        MX::Types::DevicePowerStats device_stats;
+                        device_stats.device_id = device.device_id;
+                        device_stats.frequency = device.frequency;
+                        device_stats.utilization = device.utilization;
+                        device_stats.avg_queued = device.avg_queued;
+                        device_stats.changes = device.changes;
+                        device_stats.errors = device.errors;
+                        stats.push_back(device_stats);
+                    }
+                    return stats;
+                }
+
+                //Start the governor thread, it samples the load twenty times per interval
+                void start(){
+                    std::lock_guard lock(m_mutex);
+                    if(!m_thread){
+                        m_stop = false;
+                        m_thread.reset(new std::thread(&power_governor::governor_fun, this));
+                    }
+                }
+
+                void stop(){
+                    {
+                        std::lock_guard lock(m_mutex);
+                        m_stop = true;
+                    }
+                    m_cv.notify_all();
+                    if(m_thread){
+                        m_thread->join();
+                        m_thread.reset();
+                    }
+                }
+
+            private:
+                struct device_load{
+                    int device_id = -1;
+                    int frequency = 0;
+                    int samples = 0;
+                    int busy_samples = 0;
+                    int64_t queued_sum = 0;
+                    int lower_votes = 0;    // evaluations in a row that called for a lower frequency
+                    double utilization = 0;
+                    double avg_queued = 0;
+                    uint64_t changes = 0;
+                    uint64_t errors = 0;
+                };
+
+                //Frequency of the next interval, called with the lock held
+                int target_frequency(device_load& device){
+                    const MX::Types::PowerPolicy& policy = m_policy;
+                    if(policy.profile == MX::Types::POWER_STATIC){
+                        return device.frequency;
+                    }
+                    if(policy.profile == MX::Types::POWER_PERFORMANCE){
+                        return policy.max_frequency;
+                    }
+                    //a new policy may have moved the bounds
+                    if(device.frequency > policy.max_frequency || device.frequency < policy.min_frequency){
+                        return std::clamp(device.frequency, policy.min_frequency, policy.max_frequency);
+                    }
+                    bool queuing = device.avg_queued >= 1.0;
+                    bool raise;
+                    bool lower;
+                    if(policy.profile == MX::Types::POWER_BALANCED){
+                        raise = queuing || device.utilization >= busy_utilization;
+                        lower = !queuing && device.utilization < idle_utilization;
+                    }
+                    else{
+                        raise = queuing;
+                        lower = device.avg_queued < 0.25;
+                    }
+                    if(raise){
+                        device.lower_votes = 0;
+                        return std::min(device.frequency + policy.step_mhz, policy.max_frequency);
+                    }
+                    if(!lower){
+                        device.lower_votes = 0;
+                        return device.frequency;
+                    }
+                    if(++device.lower_votes < policy.hold_intervals){
+                        return device.frequency;
+                    }
+                    device.lower_votes = 0;
+                    return std::max(device.frequency - policy.step_mhz, policy.min_frequency);
+                }
+
+                void governor_fun(){
+                    auto interval_start = std::chrono::steady_clock::now();
+                    std::unique_lock lock(m_mutex);
+                    while(!m_stop){
+                        auto interval = std::chrono::milliseconds(m_policy.interval_ms);
+                        auto sample_period = std::max(interval / 20, std::chrono::milliseconds(1));
+                        if(m_cv.wait_for(lock, sample_period, [this]{ return m_stop || m_policy_changed; })){
+                            if(m_stop){
+                                break;
+                            }
+                            //a new policy is applied right away, from the load of the last interval
+                            m_policy_changed = false;
+                            interval_start = std::chrono::steady_clock::time_point();
+                        }
+                        lock.unlock();
+                        sample_load();
+                        if(std::chrono::steady_clock::now() - interval_start >= interval){
+                            evaluate();
+                            interval_start = std::chrono::steady_clock::now();
+                        }
+                        lock.lock();
+                    }
+                }
+
+                sample_fn m_sample;
+                apply_fn m_apply;
+                std::vector<device_load> m_devices;
+                MX::Types::PowerPolicy m_policy;
+                bool m_policy_changed = false;
+                bool m_stop = false;
+                std::mutex m_mutex;
+                std::condition_variable m_cv;
+                std::unique_ptr<std::thread> m_thread;
+        };
+    } // namespace Utils
+} // namespace MX
+
+#endif
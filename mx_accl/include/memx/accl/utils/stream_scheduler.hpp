@@ -0,0 +1,268 @@
+#ifndef STREAM_SCHEDULER_HPP
+#define STREAM_SCHEDULER_HPP
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <optional>
+#include <memx/accl/utils/mxTypes.h>
+
+namespace MX
+{
+    namespace Utils
+    {
+        /**
+         * @brief Per-stream queues of the send stage of a model and the policy choosing which stream is served next.
+         * Streams are identified by their index in the model (0 to num_streams-1). push() and pop() are thread safe.
+         */
+        template <typename T>
+        class stream_scheduler{
+            public:
+                typedef std::chrono::steady_clock clock;
+
+                stream_scheduler() : m_policy(MX::Types::SCHEDULE_FIFO) {}
+
+                //Set the policy, should be called while the queues are empty
+                void set_policy(MX::Types::StreamSchedulePolicy policy);
+                MX::Types::StreamSchedulePolicy get_policy();
+
+                //Register a stream with its options, streams have to be added in index order
+                void add_stream(const MX::Types::StreamOptions& options);
+                //Give the index of a removed stream to a new stream, its queue has to be empty
+                void reset_stream(int stream, const MX::Types::StreamOptions& options);
+                //Remove all streams and their statistics
+                void clear();
+
+                //Queue an item of a stream. For a freshest_only stream the item replaces the queued
+                //item of that stream if there is one, and the replaced item is returned
+                std::optional<T> push(int stream, const T& item);
+                //Take the next item as chosen by the policy, returns false if all the queues are empty
+                bool pop(T& item);
+
+                size_t size();
+                size_t num_streams();
+                MX::Types::StreamStats stats(int stream);
+                //Count a frame of a stream lost to a failed context, or sent again on another context if rerouted
+                void record_failure(int stream, bool rerouted, const std::string& error);
+
+            private:
+                struct entry{
+                    T item;
+                    clock::time_point enqueued;
+                    clock::time_point deadline;
+                    uint64_t order;      // global push order, tie breaker of all policies
+                    double finish_tag;   // virtual finish time under weighted fair
+                };
+                struct stream_state{
+                    std::deque<entry> queue;
+                    MX::Types::StreamOptions options;
+                    double last_finish = 0;
+                    double total_wait_us = 0;
+                    MX::Types::StreamStats stats;
+                };
+
+                int pick();
+                bool before(const entry& a, const entry& b, int stream_a, int stream_b);
+
+                MX::Types::StreamSchedulePolicy m_policy;
+                std::vector<stream_state> m_streams;
+                std::mutex m_mutex;
+                size_t m_size = 0;
+                uint64_t m_order = 0;
+                double m_virtual_time = 0;
+                int m_rr_next = 0;
+        };
+
+        template <typename T>
+        void stream_scheduler<T>::set_policy(MX::Types::StreamSchedulePolicy policy){
+            std::lock_guard lock(m_mutex);
+            m_policy = policy;
+        }
+
+        template <typename T>
+        MX::Types::StreamSchedulePolicy stream_scheduler<T>::get_policy(){
+            std::lock_guard lock(m_mutex);
+            return m_policy;
+        }
+
+        template <typename T>
+        void stream_scheduler<T>::add_stream(const MX::Types::StreamOptions& options){
+            if(options.weight < 1){
+                throw std::invalid_argument("stream weight must be a number >= 1");
+            }
+            if(options.deadline_us < 0){
+                throw std::invalid_argument("stream deadline must be a number >= 0");
+            }
+            std::lock_guard lock(m_mutex);
+            stream_state state;
+            state.options = options;
+            m_streams.push_back(std::move(state));
+        }
+
+        template <typename T>
+        void stream_scheduler<T>::reset_stream(int stream, const MX::Types::StreamOptions& options){
+            if(options.weight < 1){
+                throw std::invalid_argument("stream weight must be a number >= 1");
+            }
+            if(options.deadline_us < 0){
+                throw std::invalid_argument("stream deadline must be a number >= 0");
+            }
+            std::lock_guard lock(m_mutex);
+            stream_state& state = m_streams[stream];
+            if(!state.queue.empty()){
+                throw std::logic_error("stream reset while frames of it are queued");
+            }
+            state = stream_state();
+            state.options = options;
+        }
+
+        template <typename T>
+        void stream_scheduler<T>::clear(){
+            std::lock_guard lock(m_mutex);
+            m_streams.clear();
+            m_size = 0;
+            m_order = 0;
+            m_virtual_time = 0;
+            m_rr_next = 0;
+        }
+
+        template <typename T>
+        std::optional<T> stream_scheduler<T>::push(int stream, const T& item){
+            std::lock_guard lock(m_mutex);
+            stream_state& state = m_streams[stream];
+            entry e{item, clock::now(), clock::time_point::max(), m_order++, 0};
+            if(state.options.deadline_us > 0){
+                e.deadline = e.enqueued + std::chrono::microseconds(state.options.deadline_us);
+            }
+            if(state.options.freshest_only && !state.queue.empty()){
+                //The new frame takes the place of the stale one, including its turn
+                entry& stale = state.queue.back();
+                std::optional<T> replaced{std::move(stale.item)};
+                stale.item = e.item;
+                stale.enqueued = e.enqueued;
+                stale.deadline = e.deadline;
+                state.stats.frames_dropped++;
+                return replaced;
+            }
+            //Self-clocked fair queueing: a frame finishes 1/weight after the later of the
+            //current virtual time and the finish of the previous frame of its stream
+            double start = (state.last_finish > m_virtual_time) ? state.last_finish : m_virtual_time;
+            e.finish_tag = start + 1.0 / state.options.weight;
+            state.last_finish = e.finish_tag;
+            state.queue.push_back(std::move(e));
+            m_size++;
+            return std::nullopt;
+        }
+
+        template <typename T>
+        bool stream_scheduler<T>::before(const entry& a, const entry& b, int stream_a, int stream_b){
+            switch(m_policy){
+                case MX::Types::SCHEDULE_WEIGHTED_FAIR:
+                    if(a.finish_tag != b.finish_tag) return a.finish_tag < b.finish_tag;
+                    break;
+                case MX::Types::SCHEDULE_PRIORITY:
+                    if(m_streams[stream_a].options.priority != m_streams[stream_b].options.priority)
+                        return m_streams[stream_a].options.priority > m_streams[stream_b].options.priority;
+                    break;
+                case MX::Types::SCHEDULE_DEADLINE:
+                    if(a.deadline != b.deadline) return a.deadline < b.deadline;
+                    break;
+                default:
+                    break;
+            }
+            return a.order < b.order;
+        }
+
+        template <typename T>
+        int stream_scheduler<T>::pick(){
+            int num_streams = static_cast<int>(m_streams.size());
+            if(m_policy == MX::Types::SCHEDULE_ROUND_ROBIN){
+                for(int i = 0; i < num_streams; ++i){
+                    int stream = (m_rr_next + i) % num_streams;
+                    if(!m_streams[stream].queue.empty()){
+                        m_rr_next = (stream + 1) % num_streams;
+                        return stream;
+                    }
+                }
+                return -1;
+            }
+            int best = -1;
+            for(int stream = 0; stream < num_streams; ++stream){
+                if(m_streams[stream].queue.empty()){
+                    continue;
+                }
+                if(best < 0 || before(m_streams[stream].queue.front(), m_streams[best].queue.front(), stream, best)){
+                    best = stream;
+                }
+            }
+            return best;
+        }
+
+        template <typename T>
+        bool stream_scheduler<T>::pop(T& item){
+            std::lock_guard lock(m_mutex);
+            if(m_size == 0){
+                return false;
+            }
+            int stream = pick();
+            stream_state& state = m_streams[stream];
+            entry& e = state.queue.front();
+
+            auto now = clock::now();
+            double wait_us = std::chrono::duration<double, std::micro>(now - e.enqueued).count();
+            state.stats.frames_sent++;
+            state.total_wait_us += wait_us;
+            state.stats.avg_wait_us = state.total_wait_us / state.stats.frames_sent;
+            if(wait_us > state.stats.max_wait_us){
+                state.stats.max_wait_us = wait_us;
+            }
+            if(now > e.deadline){
+                state.stats.deadline_misses++;
+            }
+            if(e.finish_tag > m_virtual_time){
+                m_virtual_time = e.finish_tag;
+            }
+
+            item = std::move(e.item);
+            state.queue.pop_front();
+            m_size--;
+            return true;
+        }
+
+        template <typename T>
+        size_t stream_scheduler<T>::size(){
+            std::lock_guard lock(m_mutex);
+            return m_size;
+        }
+
+        template <typename T>
+        size_t stream_scheduler<T>::num_streams(){
+            std::lock_guard lock(m_mutex);
+            return m_streams.size();
+        }
+
+        template <typename T>
+        MX::Types::StreamStats stream_scheduler<T>::stats(int stream){
+            std::lock_guard lock(m_mutex);
+            return m_streams[stream].stats;
+        }
+
+        template <typename T>
+        void stream_scheduler<T>::record_failure(int stream, bool rerouted, const std::string& error){
+            std::lock_guard lock(m_mutex);
+            MX::Types::StreamStats& stats = m_streams[stream].stats;
+            if(rerouted){
+                stats.frames_rerouted++;
+            }
+            else{
+                stats.frames_failed++;
+            }
+            stats.last_error = error;
+        }
+    } // namespace Utils
+} // namespace MX
+
+#endif
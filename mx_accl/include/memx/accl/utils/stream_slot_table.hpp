@@ -0,0 +1,94 @@
+#ifndef STREAM_SLOT_TABLE_HPP
+#define STREAM_SLOT_TABLE_HPP
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <climits>
+
+namespace MX
+{
+    namespace Utils
+    {
+        /**
+         * @brief Fixed-capacity map of stream ids to slot indices 0 to capacity-1, given out in insertion order.
+         * find() is lock free and wait free: an open addressing table at most half full, so a lookup takes one
+         * probe most of the time. Entries are never removed. insert() calls have to be serialized by the caller,
+         * a stream becomes visible to find() on other threads together with everything written before its insert().
+         */
+        class stream_slot_table{
+            public:
+                explicit stream_slot_table(size_t capacity = 0) { reset(capacity); }
+
+                //Drop all entries and size the table for capacity streams, not thread safe
+                void reset(size_t capacity){
+                    size_t num_entries = 2;
+                    while(num_entries < 2*capacity){
+                        num_entries <<= 1;
+                    }
+                    m_entries.reset(new entry[num_entries]);
+                    m_mask = num_entries - 1;
+                    m_capacity = capacity;
+                    m_size.store(0);
+                }
+
+                //slot of the stream, -1 if the stream was not inserted
+                int find(int stream_id) const{
+                    for(size_t i = hash(stream_id);; i = (i + 1) & m_mask){
+                        int64_t key = m_entries[i].key.load(std::memory_order_acquire);
+                        if(key == EMPTY){
+                            return -1;
+                        }
+                        if(key == stream_id){
+                            return m_entries[i].slot.load(std::memory_order_relaxed);
+                        }
+                    }
+                }
+
+                //give the stream the next slot, or return its slot if it is already in the table.
+                //-1 if the table is full
+                int insert(int stream_id){
+                    size_t i = hash(stream_id);
+                    for(;; i = (i + 1) & m_mask){
+                        int64_t key = m_entries[i].key.load(std::memory_order_relaxed);
+                        if(key == stream_id){
+                            return m_entries[i].slot.load(std::memory_order_relaxed);
+                        }
+                        if(key == EMPTY){
+                            break;
+                        }
+                    }
+                    size_t slot = m_size.load(std::memory_order_relaxed);
+                    if(slot >= m_capacity){
+                        return -1;
+                    }
+                    m_entries[i].slot.store(static_cast<int>(slot), std::memory_order_relaxed);
+                    m_entries[i].key.store(stream_id, std::memory_order_release);
+                    m_size.store(slot + 1, std::memory_order_release);
+                    return static_cast<int>(slot);
+                }
+
+                size_t size() const { return m_size.load(std::memory_order_acquire); }
+                size_t capacity() const { return m_capacity; }
+
+            private:
+                static constexpr int64_t EMPTY = INT64_MIN;
+                struct entry{
+                    std::atomic<int64_t> key{EMPTY};
+                    std::atomic<int> slot{-1};
+                };
+
+                size_t hash(int stream_id) const{
+                    //Fibonacci hashing spreads consecutive ids over the table
+                    return static_cast<size_t>(static_cast<uint32_t>(stream_id) * 2654435769u) & m_mask;
+                }
+
+                std::unique_ptr<entry[]> m_entries;
+                size_t m_mask = 0;
+                size_t m_capacity = 0;
+                std::atomic<size_t> m_size{0};
+        };
+    } // namespace Utils
+} // namespace MX
+
+#endif
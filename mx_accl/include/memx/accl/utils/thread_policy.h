@@ -0,0 +1,42 @@
+#ifndef THREAD_POLICY_H
+#define THREAD_POLICY_H
+
+#include <string>
+#include <memx/accl/utils/mxTypes.h>
+
+namespace MX
+{
+    namespace Utils
+    {
+        /**
+         * Names the calling thread so it shows up in top/perf, names are cut to 15 characters
+         */
+        void set_thread_name(const std::string& name);
+
+        /**
+         * Applies affinity, scheduler and nice level of placement to the calling thread.
+         * Failures (e.g. SCHED_FIFO without CAP_SYS_NICE) are reported on stderr and the thread keeps running
+         * with its current settings
+         */
+        void apply_thread_placement(const MX::Types::ThreadPlacement& placement);
+
+        /**
+         * Throws invalid_argument if placement refers to CPUs that don't exist or to invalid priorities
+         */
+        void validate_thread_placement(const MX::Types::ThreadPlacement& placement);
+
+        /**
+         * Locks size bytes at ptr into RAM and touches every page so they are resident.
+         * Returns false if the pages could not be locked (e.g. RLIMIT_MEMLOCK)
+         */
+        bool lock_and_prefault(void* ptr, size_t size);
+
+        /**
+         * Undoes lock_and_prefault
+         */
+        void unlock_memory(void* ptr, size_t size);
+
+    } // namespace Utils
+} // namespace MX
+
+#endif
@@ -7,6 +7,8 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <functional>
+#include <string>
 
 #include <memx/accl/utils/sync_queue.hpp>
 
@@ -31,15 +33,21 @@ class CallbackTask: public Task {
 
 class thread_pool {
     public:
-        thread_pool(const std::string& label, size_t workers, size_t continious,size_t max_jobs=0);
+        // worker_init is run by each worker thread when it starts, with the index of the worker
+        thread_pool(const std::string& label, size_t workers, size_t continious,size_t max_jobs=0,
+                    std::function<void(size_t)> worker_init=nullptr);
         template <typename F, typename... Args>
         void submitTask(F&& function, Args&&... args);
         void wait();
         void stop();
         bool stopped();
+        // change the number of active workers while the pool is running, workers above the
+        // count are parked rather than joined. Not to be called concurrently with stop()
+        void resize(size_t workers);
+        size_t get_num_workers();
 
     private:
-        void workerTarget();
+        void workerTarget(size_t index);
         std::string m_label;
         size_t m_task_count{0};
         size_t m_done_count{0};
@@ -47,7 +55,11 @@ class thread_pool {
         std::atomic<bool> m_stop{false};
         std::mutex m_mutex;
         std::condition_variable m_done_condition;
+        std::atomic<size_t> m_active_workers{0};
+        std::mutex m_park_mutex;
+        std::condition_variable m_park_condition;
         bool m_continious;
+        std::function<void(size_t)> m_worker_init;
         sync_queue<Task*> m_task_queue;
         std::vector<std::thread> m_workers;
 };
@@ -55,18 +67,29 @@ class thread_pool {
 using namespace std::chrono_literals;
 
 inline thread_pool::thread_pool(const std::string& label,
-        size_t workers, size_t continious, size_t max_jobs):
+        size_t workers, size_t continious, size_t max_jobs,
+        std::function<void(size_t)> worker_init):
     m_label(label),
     m_continious(continious),
+    m_worker_init(std::move(worker_init)),
     m_task_queue(sync_queue<Task*>(max_jobs)){
+    m_active_workers.store(workers);
     for (size_t i = 0; i < workers; ++i) {
-        m_workers.push_back(std::thread(&thread_pool::workerTarget, this));
-        // TODO try setting thread scheduling priority
+        m_workers.push_back(std::thread(&thread_pool::workerTarget, this, i));
     }
 }
 
-inline void thread_pool::workerTarget() {
+inline void thread_pool::workerTarget(size_t index) {
+    // naming, affinity and scheduling priority of the worker
+    if (m_worker_init) {
+        m_worker_init(index);
+    }
     while (!m_stop.load()) {
+        if (index >= m_active_workers.load()) {
+            std::unique_lock lock(m_park_mutex);
+            m_park_condition.wait(lock, [this, index]() { return m_stop.load() || index < m_active_workers.load(); });
+            continue;
+        }
         std::optional<Task*> opt = m_task_queue.pop(m_timeout);
         if (!opt.has_value()) {
             continue;
@@ -101,7 +124,11 @@ inline void thread_pool::stop() {
     if(m_stop.load()){
         return;
     }
-    m_stop.store(true);
+    {
+        std::lock_guard lock(m_park_mutex);
+        m_stop.store(true);
+    }
+    m_park_condition.notify_all();
     for (auto& worker: m_workers) {
         worker.join();
     }
@@ -116,6 +143,30 @@ inline void thread_pool::stop() {
             m_done_count++;
         }
     }
+    else{
+        // tasks that never ran, e.g. outputs dropped at the drain deadline of a model
+        while(m_task_queue.get_size() > 0){
+            delete m_task_queue.pop().value();
+        }
+    }
+}
+
+inline void thread_pool::resize(size_t workers) {
+    if (workers == 0 || m_stop.load()) {
+        return;
+    }
+    {
+        std::lock_guard lock(m_park_mutex);
+        m_active_workers.store(workers);
+        while (m_workers.size() < workers) {
+            m_workers.push_back(std::thread(&thread_pool::workerTarget, this, m_workers.size()));
+        }
+    }
+    m_park_condition.notify_all();
+}
+
+inline size_t thread_pool::get_num_workers() {
+    return m_active_workers.load();
 }
 
 inline bool thread_pool::stopped() {
@@ -1,7 +1,9 @@
 #include <unordered_map>
+#include <set>
 #include <memx/accl/DeviceManager.h>
 #include <sstream>
 #include <fstream>
+#include <chrono>
 
 using namespace MX::Runtime;
 using namespace MX::Types;
@@ -13,6 +15,8 @@ DeviceManager::DeviceManager(){
     all_devices_count = 0;
     available_devices = 0;
     required_devices = 0;
+    device_cache_enabled = false;
+    download_faults = 0;
 
     // let' get all devices and manage them
     this->get_available_devices();
@@ -20,6 +24,7 @@ DeviceManager::DeviceManager(){
 
 bool DeviceManager::opendfp_bytes(const uint8_t *b, int dfp_tag){
 
+    auto parse_start = std::chrono::steady_clock::now();
     dfp_rt_info ddi;
     ddi.dfp = new Dfp::DfpObject(b);
     Dfp::DfpMeta temp_meta = ddi.dfp->get_dfp_meta();
@@ -32,7 +37,12 @@ bool DeviceManager::opendfp_bytes(const uint8_t *b, int dfp_tag){
     ddi.dfp_meta = temp_meta;
     ddi.use_multigroup_lb = temp_meta.use_multigroup_lb;
     ddi.context_ids_vector  = {};
+    ddi.device_ids = {};
+    ddi.context_owner = dfp_tag;
+    ddi.content_hash = 0;
+    ddi.health = NULL;
     ddi.valid = ddi.dfp->valid;
+    ddi.connect_stats.parse_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - parse_start).count();
 
     auto it = this->dfp_mxa_map.find(dfp_tag);
     if(it == this->dfp_mxa_map.end()){
@@ -47,6 +57,7 @@ bool DeviceManager::opendfp_bytes(const uint8_t *b, int dfp_tag){
 
 bool DeviceManager::opendfp(const std::filesystem::path dfp_filename, int dfp_tag){
 
+    auto parse_start = std::chrono::steady_clock::now();
     dfp_rt_info ddi;
     ddi.dfp = new Dfp::DfpObject(dfp_filename.string().c_str());
     Dfp::DfpMeta temp_meta = ddi.dfp->get_dfp_meta();
@@ -59,7 +70,12 @@ bool DeviceManager::opendfp(const std::filesystem::path dfp_filename, int dfp_ta
     ddi.dfp_meta = temp_meta;
     ddi.use_multigroup_lb = temp_meta.use_multigroup_lb;
     ddi.context_ids_vector  = {};
+    ddi.device_ids = {};
+    ddi.context_owner = dfp_tag;
+    ddi.content_hash = 0;
+    ddi.health = NULL;
     ddi.valid = ddi.dfp->valid;
+    ddi.connect_stats.parse_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - parse_start).count();
 
     auto it = this->dfp_mxa_map.find(dfp_tag);
     if(it == this->dfp_mxa_map.end()){
@@ -82,9 +98,12 @@ void DeviceManager::get_available_devices(){
     }
 
     // MX::Runtime::device_info di;
-    available_devices = 0;
+    // called again to find the devices that appeared or were freed since, the known devices are kept as they are
     for(int d = 0; d < all_devices_count ; d++){
         int device_id = d;
+        if(this->available_mxa_device_map.count(device_id) > 0){
+            continue;
+        }
         memx_status status = memx_trylock(device_id);
         if(memx_status_error(status)){
             std::cout<<"device locked - Trying next device \n";
@@ -101,6 +120,7 @@ void DeviceManager::get_available_devices(){
             di.is_device_open = false;
             di.number_of_contexts_attached = 0;
             di.contexts_ids_attached = {};
+            di.configs_skipped = 0;
             di.current_config = MEMX_MPU_GROUP_CONFIG_ONE_GROUP_FOUR_MPUS;
             
             auto device_it = this->available_mxa_device_map.find(device_id);
@@ -158,105 +178,306 @@ void DeviceManager::throw_device_not_available_exception(int pdevice_id){
 }
 
 
-void DeviceManager::set_power_mode(int device_id, int num_chips){
-
-  #ifdef __GNUC__
-    // ignore the fact this variable is unused, to satisfy -Werror
-    __attribute__((unused)) memx_status status;
-  #else
-    // else we're kind of stuck, lol
-    memx_status status;
-  #endif
+// Frequency and voltage per chip count from lines of KEY=value. Missing keys and malformed lines keep the defaults
+static void read_power_conf(uint16_t& c4_freq, uint16_t& c4_volt, uint16_t& c2_freq, uint16_t& c2_volt){
 
-    uint16_t c4_freq = 600;
-    uint16_t c4_volt = 700;
-    uint16_t c2_freq = 600;
-    uint16_t c2_volt = 700;
-   
   #ifdef __linux__
     // LINUX READ FILE
-
-    if(std::filesystem::exists("/etc/memryx/power.conf")){
-
-        // read each line
-        std::ifstream fd("/etc/memryx/power.conf");
-        for( std::string line; getline( fd, line ); ){
-            if(line[0] == '#')
-                continue;
-            std::string varname = line.substr(0,6);
-            if(varname == "FREQ4C"){
-                std::string val = line.substr(7,3);
-                c4_freq = (uint16_t) std::stoi(val);
-            } else if(varname == "VOLT4C"){
-                std::string val = line.substr(7,3);
-                c4_volt = (uint16_t) std::stoi(val);
-            } else if(varname == "FREQ2C"){
-                std::string val = line.substr(7,3);
-                c2_freq = (uint16_t) std::stoi(val);
-            } else if(varname == "VOLT2C"){
-                std::string val = line.substr(7,3);
-                c2_volt = (uint16_t) std::stoi(val);
+    std::ifstream fd("/etc/memryx/power.conf");
+    for( std::string line; getline( fd, line ); ){
+        size_t start = line.find_first_not_of(" \t");
+        if(start == std::string::npos || line[start] == '#')
+            continue;
+        size_t eq = line.find('=', start);
+        if(eq == std::string::npos)
+            continue;
+        std::string varname = line.substr(start, eq - start);
+        varname.erase(varname.find_last_not_of(" \t") + 1);
+        uint16_t* target = NULL;
+        if(varname == "FREQ4C"){
+            target = &c4_freq;
+        } else if(varname == "VOLT4C"){
+            target = &c4_volt;
+        } else if(varname == "FREQ2C"){
+            target = &c2_freq;
+        } else if(varname == "VOLT2C"){
+            target = &c2_volt;
+        }
+        if(target == NULL)
+            continue;
+        try{
+            int val = std::stoi(line.substr(eq + 1));
+            if(val <= 0 || val > UINT16_MAX){
+                throw std::out_of_range(varname);
             }
+            *target = (uint16_t) val;
+        }
+        catch(const std::exception&){
+            std::cerr<<"Warning!! Ignoring invalid line \""<<line<<"\" of /etc/memryx/power.conf"<<std::endl;
         }
-
     }
-
-    // else we use the defaults
-
   #else
     // Windows: just use defaults for now
+    (void) c4_freq; (void) c4_volt; (void) c2_freq; (void) c2_volt;
   #endif
+}
+
+void DeviceManager::set_chip_frequency(int device_id, int num_chips, int frequency){
+    for(int chip = 0; chip < num_chips; ++chip){
+        memx_status status = memx_set_feature(device_id, chip, OPCODE_SET_FREQUENCY, (uint16_t) frequency);
+        if(memx_status_error(status)){
+            std::ostringstream oss;
+            oss << "Setting the frequency of chip " << chip << " of device " << device_id << " to " << frequency << " MHz failed";
+            throw runtime_error(oss.str());
+        }
+    }
+}
+
+void DeviceManager::set_power_mode(int device_id, int num_chips){
+
+    uint16_t c4_freq = 600;
+    uint16_t c4_volt = 700;
+    uint16_t c2_freq = 600;
+    uint16_t c2_volt = 700;
+    read_power_conf(c4_freq, c4_volt, c2_freq, c2_volt);
+
+    uint16_t freq = (num_chips == 4) ? c4_freq : c2_freq;
+    uint16_t volt = (num_chips == 4) ? c4_volt : c2_volt;
+    MX::Utils::device_state& state = available_mxa_device_map.at(device_id).state;
+    if(state.power_chips == num_chips && state.frequency == freq && state.voltage == volt){
+        available_mxa_device_map.at(device_id).configs_skipped++;
+        return;
+    }
 
 #ifdef __linux__
     // SET THE STUFF
-    if(num_chips == 4){
-        status = memx_set_feature(device_id, 0, OPCODE_SET_FREQUENCY, c4_freq);
-        status = memx_set_feature(device_id, 1, OPCODE_SET_FREQUENCY, c4_freq);
-        status = memx_set_feature(device_id, 2, OPCODE_SET_FREQUENCY, c4_freq);
-        status = memx_set_feature(device_id, 3, OPCODE_SET_FREQUENCY, c4_freq);
-        status = memx_set_feature(device_id, 0, OPCODE_SET_VOLTAGE, c4_volt);
-    } else if(num_chips == 2){
-        status = memx_set_feature(device_id, 0, OPCODE_SET_FREQUENCY, c2_freq);
-        status = memx_set_feature(device_id, 1, OPCODE_SET_FREQUENCY, c2_freq);
-        status = memx_set_feature(device_id, 0, OPCODE_SET_VOLTAGE, c2_volt);
+    set_chip_frequency(device_id, num_chips, freq);
+    memx_status status = memx_set_feature(device_id, 0, OPCODE_SET_VOLTAGE, volt);
+    if(memx_status_error(status)){
+        throw runtime_error("Setting the voltage of device " + to_string(device_id) + " to " + to_string(volt) + " mV failed");
     }
 #else
     //Not supported for windows currently
 #endif
 
+    state.power_chips = num_chips;
+    state.frequency = freq;
+    state.voltage = volt;
+    MX::Utils::save_device_state(device_id, state);
+}
+
+void DeviceManager::set_device_frequency(int device_id, int frequency){
+
+    // Called by the power governor while the device streams, the voltage set at connect is kept
+    device_info& di = available_mxa_device_map.at(device_id);
+    std::lock_guard lock(device_state_mutex);
+    if(di.state.power_chips == 0){
+        throw logic_error("Device " + to_string(device_id) + " is not set up");
+    }
+#ifdef __linux__
+    set_chip_frequency(device_id, di.state.power_chips, frequency);
+#else
+    throw runtime_error("Changing the frequency of a device is not supported on this platform");
+#endif
+    di.state.frequency = (uint16_t) frequency;
+    MX::Utils::save_device_state(device_id, di.state);
+}
+
+void DeviceManager::set_power_policy(int dfp_tag, const MX::Types::PowerPolicy& policy, const std::vector<ModelBase*>& dfp_models){
+    if(policy.profile < MX::Types::POWER_STATIC || policy.profile > MX::Types::POWER_EFFICIENCY){
+        throw invalid_argument("invalid power profile");
+    }
+    if(policy.min_frequency <= 0 || policy.max_frequency < policy.min_frequency || policy.step_mhz <= 0 ||
+       policy.interval_ms <= 0 || policy.hold_intervals < 1){
+        throw invalid_argument("power policy needs 0 < min_frequency <= max_frequency and a step, interval and hold intervals > 0");
+    }
+    auto search = power_governors_.find(dfp_tag);
+    if(search == power_governors_.end()){
+        if(policy.profile == MX::Types::POWER_STATIC){
+            return;
+        }
+        power_control control;
+        control.governor = create_power_governor(dfp_tag, dfp_models);
+        control.models = dfp_models;
+        search = power_governors_.emplace(dfp_tag, control).first;
+    }
+    search->second.governor->set_policy(policy);
+    if(policy.profile == MX::Types::POWER_STATIC){
+        search->second.governor->stop();
+    }
+    else{
+        search->second.governor->start();
+    }
+}
+
+std::vector<MX::Types::DevicePowerStats> DeviceManager::get_power_stats(int dfp_tag){
+    auto search = power_governors_.find(dfp_tag);
+    if(search == power_governors_.end()){
+        return {};
+    }
+    return search->second.governor->stats();
+}
+
+void DeviceManager::stop_power_governors(int dfp_tag){
+    for(auto& entry : power_governors_){
+        if(dfp_tag < 0 || entry.first == dfp_tag){
+            entry.second.governor->stop();
+        }
+    }
+}
+
+void DeviceManager::start_power_governors(int dfp_tag){
+    for(auto& entry : power_governors_){
+        if((dfp_tag < 0 || entry.first == dfp_tag) && entry.second.governor->policy().profile != MX::Types::POWER_STATIC){
+            entry.second.governor->start();
+        }
+    }
+}
+
+void DeviceManager::refresh_power_governor(int dfp_tag){
+    auto search = power_governors_.find(dfp_tag);
+    if(search == power_governors_.end()){
+        return;
+    }
+    //the governor samples the contexts it was made with, it is left out of the overlap check while made again
+    power_control control = search->second;
+    power_governors_.erase(search);
+    control.governor->stop();
+    MX::Types::PowerPolicy policy = control.governor->policy();
+    delete control.governor;
+    set_power_policy(dfp_tag, policy, control.models);
+}
 
+void DeviceManager::delete_power_governors(){
+    for(auto& entry : power_governors_){
+        delete entry.second.governor;
+    }
+    power_governors_.clear();
+}
+
+MX::Utils::power_governor* DeviceManager::create_power_governor(int dfp_tag, const std::vector<ModelBase*>& dfp_models){
+    std::vector<int> device_ids = get_dfp_device_ids(dfp_tag);
+    for(auto& entry : power_governors_){
+        for(const MX::Types::DevicePowerStats& device : entry.second.governor->stats()){
+            if(std::find(device_ids.begin(), device_ids.end(), device.device_id) != device_ids.end()){
+                throw logic_error("device " + std::to_string(device.device_id) + " already follows the power policy of dfp " + std::to_string(entry.first));
+            }
+        }
+    }
+    std::vector<int> frequencies;
+    for(int device_id : device_ids){
+        frequencies.push_back(get_device_frequency(device_id));
+    }
+    std::vector<int> context_devices = get_dfp_context_devices(dfp_tag);
+    auto sample = [dfp_models, device_ids, context_devices](int device_idx){
+        MX::Utils::power_governor::load_sample load;
+        for(ModelBase* model : dfp_models){
+            MX::Types::DispatchStats stats = model->get_dispatch_stats();
+            for(size_t ctx = 0; ctx < stats.contexts.size() && ctx < context_devices.size(); ++ctx){
+                if(context_devices[ctx] == device_ids[device_idx]){
+                    load.in_flight += stats.contexts[ctx].in_flight;
+                }
+            }
+            //the send stage of a model feeds all devices of the dfp
+            load.queued += model->get_queued_frames();
+        }
+        return load;
+    };
+    auto apply = [this, device_ids](int device_idx, int frequency){
+        set_device_frequency(device_ids[device_idx], frequency);
+    };
+    return new MX::Utils::power_governor(device_ids, frequencies, sample, apply);
 }
 
+int DeviceManager::get_device_frequency(int device_id){
+    std::lock_guard lock(device_state_mutex);
+    return available_mxa_device_map.at(device_id).state.frequency;
+}
 
+std::vector<int> DeviceManager::get_dfp_device_ids(int dfp_tag){
+    return dfp_mxa_map.at(dfp_tag).device_ids;
+}
+
+std::vector<MX::Types::DeviceCapacity> DeviceManager::get_dfp_device_capacity(int dfp_tag){
+    dfp_rt_info& ddi = dfp_mxa_map.at(dfp_tag);
+    std::vector<MX::Types::DeviceCapacity> devices;
+    for(int device_id : ddi.device_ids){
+        const device_info& di = available_mxa_device_map.at(device_id);
+        MX::Types::DeviceCapacity capacity;
+        capacity.device_id = device_id;
+        capacity.chip_count = di.chip_count;
+        for(int ctx : ddi.context_ids_vector){
+            if(std::find(di.contexts_ids_attached.begin(), di.contexts_ids_attached.end(), ctx) != di.contexts_ids_attached.end()){
+                capacity.num_contexts++;
+            }
+        }
+        if(!ddi.context_ids_vector.empty()){
+            capacity.traffic_share = static_cast<double>(capacity.num_contexts) / ddi.context_ids_vector.size();
+        }
+        devices.push_back(capacity);
+    }
+    return devices;
+}
+
+std::vector<int> DeviceManager::get_dfp_context_devices(int dfp_tag){
+    dfp_rt_info& ddi = dfp_mxa_map.at(dfp_tag);
+    std::vector<int> devices;
+    for(int ctx : ddi.context_ids_vector){
+        for(int device_id : ddi.device_ids){
+            const std::vector<int>& contexts = available_mxa_device_map.at(device_id).contexts_ids_attached;
+            if(std::find(contexts.begin(), contexts.end(), ctx) != contexts.end()){
+                devices.push_back(device_id);
+                break;
+            }
+        }
+    }
+    return devices;
+}
+
+
+
+memx_status DeviceManager::config_mpu_group(int device_id, int config){
+
+    device_info& di = available_mxa_device_map.at(device_id);
+    di.current_config = config;
+    if(di.state.mpu_config == config){
+        di.configs_skipped++;
+        return MEMX_STATUS_OK;
+    }
+    // the dfps downloaded to the device don't survive a new configuration
+    di.state.mpu_config = -1;
+    di.state.context_dfp.clear();
+    MX::Utils::save_device_state(device_id, di.state);
+    memx_status status = memx_config_mpu_group(device_id, config);
+    if(!memx_status_error(status)){
+        di.state.mpu_config = config;
+        MX::Utils::save_device_state(device_id, di.state);
+    }
+    return status;
+}
 
 bool DeviceManager::configure_device(int device_id, int device_chip_count, int pdfp_num_chips, float pmxa_gen){
 
     memx_status status = MEMX_STATUS_OK;
 
     if(pmxa_gen == MEMX_DEVICE_CASCADE){
-        memx_unlock(device_id);
         throw_mxa_gen_exception(device_chip_count);
     }
     else{
         if(pdfp_num_chips>device_chip_count){
-            memx_unlock(device_id);
             throw_chip_exception(pdfp_num_chips, device_chip_count, device_id);
         }
         //Change the MPU config based on DFP if needed
         else if(pdfp_num_chips==8 && device_chip_count==8){
-            status = memx_config_mpu_group(device_id, MEMX_MPU_GROUP_CONFIG_ONE_GROUP_EIGHT_MPUS);
-            available_mxa_device_map.at(device_id).current_config = MEMX_MPU_GROUP_CONFIG_ONE_GROUP_EIGHT_MPUS;
+            status = config_mpu_group(device_id, MEMX_MPU_GROUP_CONFIG_ONE_GROUP_EIGHT_MPUS);
         }
         else if(pdfp_num_chips==4){
-            status = memx_config_mpu_group(device_id, MEMX_MPU_GROUP_CONFIG_ONE_GROUP_FOUR_MPUS);
-            available_mxa_device_map.at(device_id).current_config = MEMX_MPU_GROUP_CONFIG_ONE_GROUP_FOUR_MPUS;
+            status = config_mpu_group(device_id, MEMX_MPU_GROUP_CONFIG_ONE_GROUP_FOUR_MPUS);
         }
         else if(pdfp_num_chips==2){
-            status = memx_config_mpu_group(device_id, MEMX_MPU_GROUP_CONFIG_TWO_GROUP_TWO_MPUS);
-            available_mxa_device_map.at(device_id).current_config = MEMX_MPU_GROUP_CONFIG_TWO_GROUP_TWO_MPUS;
+            status = config_mpu_group(device_id, MEMX_MPU_GROUP_CONFIG_TWO_GROUP_TWO_MPUS);
         }
         else{
-            memx_unlock(device_id);
             throw_chip_exception(pdfp_num_chips, device_chip_count, device_id);
         }
     }
@@ -269,6 +490,8 @@ bool DeviceManager::configure_device(int device_id, int device_chip_count, int p
 
 bool DeviceManager::connect_device(int dfp_tag, int device_id){
 
+    // Runs on its own thread for every device, so only the entry of this device is changed
+
     memx_status lock_status;
     bool configure_status;
     // Lock MXA device
@@ -280,65 +503,347 @@ bool DeviceManager::connect_device(int dfp_tag, int device_id){
     }
     
     // check chip count and see if dfp chip requires that much
-    uint8_t device_chip_count = this->available_mxa_device_map.at(device_id).chip_count;
+    device_info& di = this->available_mxa_device_map.at(device_id);
+    uint8_t device_chip_count = di.chip_count;
     int l_dfp_num_chips = this->dfp_mxa_map.at(dfp_tag).dfp_num_chips;
     float l_mxa_gen = this->dfp_mxa_map.at(dfp_tag).mxa_gen;
     bool l_use_mg_lb = this->dfp_mxa_map.at(dfp_tag).use_multigroup_lb;
     
-    // if the dfp does not require a 8 chip MXA skip this device
-    if(device_chip_count > 4 && l_dfp_num_chips <=4 ){
+    // a dfp of up to 4 chips is not spread over the groups of a larger device
+    if(!device_fits_dfp(device_id, dfp_tag)){
         memx_unlock(device_id);
-        configure_status = false;
-        // continue;
+        if(device_chip_count < l_dfp_num_chips){
+            throw_chip_exception(l_dfp_num_chips, device_chip_count, device_id);
+        }
+        std::ostringstream oss;
+        oss << "Device " << device_id << " has " << int(device_chip_count) << " chips, a dfp made for " << l_dfp_num_chips << " chips does not run on it";
+        throw runtime_error(oss.str());
     }
-    else{
+
+    try{
+        // what the previous process left on the device, nothing is known without the cache
+        if(device_cache_enabled){
+            di.state = MX::Utils::load_device_state(device_id);
+        }
+        else{
+            di.state = MX::Utils::device_state();
+        }
+        di.configs_skipped = 0;
         //if device has the required number of chips configure the device and open necessary contexts    
         configure_status = configure_device(device_id, device_chip_count, l_dfp_num_chips, l_mxa_gen);
-        if(l_dfp_num_chips == 4){
-            set_power_mode(device_id, 4);
-        } else if(l_dfp_num_chips == 2){
-            if(l_use_mg_lb){
+        if(configure_status){
+            if(l_dfp_num_chips == 4){
                 set_power_mode(device_id, 4);
-            } else {
-                set_power_mode(device_id, 2);
+            } else if(l_dfp_num_chips == 2){
+                if(l_use_mg_lb){
+                    set_power_mode(device_id, 4);
+                } else {
+                    set_power_mode(device_id, 2);
+                }
             }
         }
-        open_devices.push_back(device_id);            
-        available_mxa_device_map.at(device_id).is_device_open = true;
     }
-    return configure_status;
+    catch(...){
+        memx_unlock(device_id);
+        throw;
+    }
+    if(!configure_status){
+        memx_unlock(device_id);
+        return false;
+    }
+    di.is_device_open = true;
+    return true;
+}
+
+std::vector<std::exception_ptr> DeviceManager::run_per_device(int num_devices, const std::function<void(int)>& fun){
+
+    // One thread per device, the bring-up takes as long as the slowest device instead of the sum of all
+    std::vector<std::exception_ptr> errors(num_devices);
+    auto run = [&fun, &errors](int i){
+        try{
+            fun(i);
+        }
+        catch(...){
+            errors[i] = std::current_exception();
+        }
+    };
+    if(num_devices == 1){
+        run(0);
+        return errors;
+    }
+    std::vector<std::thread> threads;
+    for(int i = 0; i < num_devices; i++){
+        threads.emplace_back(run, i);
+    }
+    for(std::thread& th : threads){
+        th.join();
+    }
+    return errors;
+}
+
+static std::string error_message(const std::exception_ptr& error){
+    try{
+        std::rethrow_exception(error);
+    }
+    catch(const std::exception& err){
+        return err.what();
+    }
+    catch(...){
+        return "unknown error";
+    }
+}
+
+void DeviceManager::throw_device_errors(const std::vector<int>& device_ids, const std::vector<std::exception_ptr>& errors){
+
+    std::vector<int> failed;
+    for(int i = 0; i < static_cast<int>(errors.size()); i++){
+        if(errors[i]){
+            failed.push_back(i);
+        }
+    }
+    if(failed.empty()){
+        return;
+    }
+    // a single failure keeps its own exception
+    if(failed.size() == 1){
+        std::rethrow_exception(errors[failed[0]]);
+    }
+    std::ostringstream oss;
+    oss << failed.size() << " of " << device_ids.size() << " devices failed:";
+    for(int i : failed){
+        oss << "\n  Device " << device_ids[i] << ": " << error_message(errors[i]);
+    }
+    throw runtime_error(oss.str());
+}
+
+std::vector<int> DeviceManager::keep_working_devices(const std::vector<int>& device_ids, const std::vector<std::exception_ptr>& errors, bool release){
+
+    std::vector<int> working;
+    for(int d = 0; d < static_cast<int>(device_ids.size()); d++){
+        if(!errors[d]){
+            working.push_back(device_ids[d]);
+            continue;
+        }
+        std::cerr << "Warning!! Device " << device_ids[d] << " is left out: " << error_message(errors[d]) << std::endl;
+        if(release){
+            release_device(device_ids[d]);
+        }
+    }
+    return working;
+}
+
+void DeviceManager::release_device(int device_id){
+
+    device_info& di = available_mxa_device_map.at(device_id);
+    for(int ctx : di.contexts_ids_attached){
+        memx_close(ctx);
+        context_allocator::process().release(ctx);
+    }
+    di.contexts_ids_attached.clear();
+    di.number_of_contexts_attached = 0;
+    memx_unlock(device_id);
+    di.is_device_open = false;
+}
+
+std::vector<int> DeviceManager::device_contexts_of(int device_id, int owner_tag){
+
+    std::vector<int> contexts;
+    for(int ctx : available_mxa_device_map.at(device_id).contexts_ids_attached){
+        if(context_allocator::process().owned_by(ctx, this, owner_tag)){
+            contexts.push_back(ctx);
+        }
+    }
+    return contexts;
+}
+
+void DeviceManager::close_device_contexts(int device_id, int owner_tag){
+
+    device_info& di = available_mxa_device_map.at(device_id);
+    for(int ctx : device_contexts_of(device_id, owner_tag)){
+        memx_close(ctx);
+        context_allocator::process().release(ctx);
+        di.contexts_ids_attached.erase(std::find(di.contexts_ids_attached.begin(), di.contexts_ids_attached.end(), ctx));
+        di.number_of_contexts_attached--;
+    }
+}
+
+bool DeviceManager::device_has_spare_group(int device_id, int dfp_tag){
+
+    // the configuration of the device stays as the dfps on it need it, so only a dfp running on one group of
+    // two chips fits in a group the others left free
+    const device_info& di = available_mxa_device_map.at(device_id);
+    const dfp_rt_info& ddi = dfp_mxa_map.at(dfp_tag);
+    if(di.current_config != MEMX_MPU_GROUP_CONFIG_TWO_GROUP_TWO_MPUS || ddi.dfp_num_chips != 2 || ddi.mxa_gen == MEMX_DEVICE_CASCADE){
+        return false;
+    }
+    int mpu_group_count = 0;
+    memx_status status = memx_operation_get_mpu_group_count(device_id, &mpu_group_count);
+    if (memx_status_error(status))
+    {
+        return false;
+    }
+    return static_cast<int>(di.contexts_ids_attached.size()) < mpu_group_count;
+}
+
+bool DeviceManager::device_fits_dfp(int device_id, int dfp_tag){
+
+    int device_chips = available_mxa_device_map.at(device_id).chip_count;
+    int dfp_chips = dfp_mxa_map.at(dfp_tag).dfp_num_chips;
+    return device_chips >= dfp_chips && !(device_chips > 4 && dfp_chips <= 4);
+}
+
+std::vector<int> DeviceManager::claim_free_devices(int dfp_tag){
+
+    {
+        // look for devices plugged in or freed by other processes since. The recoveries of other dfps read the map
+        std::lock_guard state_lock(device_state_mutex);
+        get_available_devices();
+    }
+    std::vector<int> candidates;
+    for(int device_id : available_devices_id){
+        if(!available_mxa_device_map.at(device_id).is_device_open && device_fits_dfp(device_id, dfp_tag)){
+            candidates.push_back(device_id);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    std::vector<std::exception_ptr> errors = run_per_device(candidates.size(), [this, dfp_tag, &candidates](int d){
+        if(!connect_device(dfp_tag, candidates[d])){
+            throw runtime_error("Error while configuring a device, Please check the device.  Device ID = "+to_string(candidates[d]));
+        }
+    });
+    // a device locked by another process meanwhile is not claimed, connect_device unlocks the devices that fail
+    return keep_working_devices(candidates, errors, false);
 }
 
 bool DeviceManager::setup_mxa(int dfp_tag, std::vector<int>& pgroup_ids){
 
-    
-    required_devices = pgroup_ids.size();
+    auto setup_start = std::chrono::steady_clock::now();
+    if(pgroup_ids.size() == 1 && pgroup_ids[0] == MX::Types::ALL_DEVICES){
+        std::vector<int> claimed = claim_free_devices(dfp_tag);
+        if(claimed.empty()){
+            print_available_devices();
+            throw runtime_error("No free MXA device can run this dfp");
+        }
+        pgroup_ids = claimed;
+        required_devices = pgroup_ids.size();
+    }
+    else{
+        connect_listed_devices(dfp_tag, pgroup_ids);
+    }
+
+    dfp_rt_info& ddi = dfp_mxa_map.at(dfp_tag);
+    for(int device_id : pgroup_ids){
+        ddi.device_ids.push_back(device_id);
+        if(std::find(open_devices.begin(), open_devices.end(), device_id) == open_devices.end()){
+            open_devices.push_back(device_id);
+        }
+        ddi.connect_stats.configs_skipped += available_mxa_device_map.at(device_id).configs_skipped;
+    }
+
+    ddi.connect_stats.setup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setup_start).count();
+    return true;
+}
 
-    open_devices.reserve(required_devices);
+void DeviceManager::connect_listed_devices(int dfp_tag, const std::vector<int>& pgroup_ids){
 
-    bool all_device_connected = true;
+    required_devices = pgroup_ids.size();
+    std::vector<int> new_devices;
+    std::vector<int> shared_devices;
 
+    // check all the devices before locking any of them
     for(int d = 0 ; d < required_devices ; d++){
-        bool connect_status;
         int device_id = pgroup_ids[d];
 
         auto device_it = this->available_mxa_device_map.find(device_id);
-        if (device_it != available_mxa_device_map.end() && !device_it->second.is_device_open) {
+        if (device_it == available_mxa_device_map.end()) {
+            throw_device_not_available_exception(device_id);
+        }
+        if (std::find(pgroup_ids.begin(), pgroup_ids.begin() + d, device_id) != pgroup_ids.begin() + d) {
+            throw runtime_error("Device " + to_string(device_id) + " is listed more than once");
+        }
+        if (device_it->second.is_device_open) {
+            //a device used by another dfp of this object is set up already, the dfp takes a group left free
+            if (!device_has_spare_group(device_id, dfp_tag)) {
+                throw runtime_error("Device " + to_string(device_id) + " is already used by another dfp of this object");
+            }
+            shared_devices.push_back(device_id);
+        }
+        else {
+            new_devices.push_back(device_id);
+        }
+    }
+
+    // a device set up for a single group of two chips gets the power of all its chips
+    for(int device_id : shared_devices){
+        std::lock_guard state_lock(device_state_mutex);
+        device_info& di = available_mxa_device_map.at(device_id);
+        di.configs_skipped = 0;
+        if(di.state.power_chips < 4){
+            set_power_mode(device_id, 4);
+        }
+    }
 
-            connect_status = connect_device(dfp_tag, device_id);
-            if(!connect_status){
-                all_device_connected = false;
-                throw runtime_error("Error while configuring a device, Please check the device.  Device ID = "+to_string(device_id));
+    std::vector<std::exception_ptr> errors = run_per_device(new_devices.size(), [this, dfp_tag, &new_devices](int d){
+        int device_id = new_devices[d];
+        if(!connect_device(dfp_tag, device_id)){
+            throw runtime_error("Error while configuring a device, Please check the device.  Device ID = "+to_string(device_id));
+        }
+    });
+
+    bool all_device_connected = std::none_of(errors.begin(), errors.end(), [](const std::exception_ptr& err){ return bool(err); });
+    if(!all_device_connected){
+        // roll back, the devices that came up are unlocked so the dfp can be connected again
+        for(int d = 0 ; d < static_cast<int>(new_devices.size()) ; d++){
+            if(!errors[d]){
+                release_device(new_devices[d]);
             }
         }
+        throw_device_errors(new_devices, errors);
+    }
+}
+
+void DeviceManager::open_device_contexts(int device_id, int dfp_tag, bool use_multigroup_lb){
+
+    int number_of_contexts = 0;
+    if(!available_mxa_device_map.at(device_id).contexts_ids_attached.empty()){
+        // the dfp shares the device with another dfp, it gets the group left free
+        number_of_contexts = 1;
+    }
+    else if(available_mxa_device_map.at(device_id).current_config == MEMX_MPU_GROUP_CONFIG_ONE_GROUP_FOUR_MPUS){
+        number_of_contexts = 1;            
+    }
+    else{
+        // the second group gets its own context if the device has the chips for it, a device with two
+        // contexts takes twice the frames of a device with one
+        if(use_multigroup_lb && available_mxa_device_map.at(device_id).chip_count >= 4)
+            number_of_contexts = 2;
+        else
+            number_of_contexts = 1;
+    }
+
+    for(int i = 0; i < number_of_contexts; i++){
+        // Context IDs are limited by the driver (0 to 31) across all the devices of the process, whatever
+        // the device id. The allocator gives out the free ones and records the dfp that owns them
+        int context_id = context_allocator::process().allocate(this, dfp_tag);
+
+        memx_status status = memx_open(context_id, device_id, MEMX_DEVICE_CASCADE_PLUS);
+        if (memx_status_error(status)){
+            context_allocator::process().release(context_id);
+            throw runtime_error("Couldn't open a context with a device, please verify the MXA connection");
+        }
         else{
-            all_device_connected = false;
-            throw_device_not_available_exception(device_id);
+            available_mxa_device_map.at(device_id).contexts_ids_attached.push_back(context_id);
+            available_mxa_device_map.at(device_id).number_of_contexts_attached++;
         }
-       
     }
 
-    return all_device_connected;
+    int mpu_group_count = 0;
+    memx_status status = memx_operation_get_mpu_group_count(device_id, &mpu_group_count);
+    if (memx_status_error(status))
+    {
+        throw runtime_error("Couldn't get the mpu group count");
+    }
 }
 
 void DeviceManager::attach_dfp_to_device(int dfp_tag){
@@ -348,82 +853,313 @@ void DeviceManager::attach_dfp_to_device(int dfp_tag){
     // this means that the dfps added later should have the same configuration as the initial dfp
     // if a new config dfp is added then setup and config has to be called again
 
-    for(int d = 0 ; d < required_devices ; d++){
-        int device_id = open_devices[d];
-        int number_of_contexts = 0;
-        if(available_mxa_device_map.at(device_id).current_config == MEMX_MPU_GROUP_CONFIG_ONE_GROUP_FOUR_MPUS){
-            number_of_contexts = 1;            
+    auto attach_start = std::chrono::steady_clock::now();
+    dfp_rt_info& ddi = dfp_mxa_map.at(dfp_tag);
+    bool use_multigroup_lb = ddi.use_multigroup_lb;
+    std::vector<std::exception_ptr> errors = run_per_device(ddi.device_ids.size(), [this, &ddi, dfp_tag, use_multigroup_lb](int d){
+        open_device_contexts(ddi.device_ids[d], dfp_tag, use_multigroup_lb);
+    });
+
+    if(std::any_of(errors.begin(), errors.end(), [](const std::exception_ptr& err){ return bool(err); })){
+        // roll back, close the contexts opened for the dfp on every device
+        for(int device_id : ddi.device_ids){
+            close_device_contexts(device_id, dfp_tag);
         }
-        else{
-            if(dfp_mxa_map.at(dfp_tag).use_multigroup_lb)
-                number_of_contexts = 2;
-            else
-                number_of_contexts = 1;
-        }
-
-        //reserving two contexts per device as maximum two contexts are possible. (ignoring model swaping)
-        int context_init = device_id*2;
-        for(int i = 0; i < number_of_contexts; i++){
-            // Context IDs are limited based on driver limitation (0 to 31) across all the devices
-            // hence the context_id_tracker that keeps running count on all IDs
-            // get the recent context_id to assign for a dfp
-            
-            if(context_init >= 32){
-                throw runtime_error("cannot open more than 32 contexts\n");
-            }
+        throw_device_errors(ddi.device_ids, errors);
+    }
 
-            memx_status status = memx_open(context_init, device_id, MEMX_DEVICE_CASCADE_PLUS);
-            if (memx_status_error(status)){
-                throw runtime_error("Couldn't open a context with a device, please verify the MXA connection");
-            }
-            else{
-                dfp_mxa_map.at(dfp_tag).context_ids_vector.push_back(context_init);
-                available_mxa_device_map.at(device_id).contexts_ids_attached.push_back(context_init);
-                available_mxa_device_map.at(device_id).number_of_contexts_attached++;
-                context_init++;
-            }
+    // contexts in device order, whichever device came up first
+    for(int device_id : ddi.device_ids){
+        for(int ctx : device_contexts_of(device_id, dfp_tag)){
+            ddi.context_ids_vector.push_back(ctx);
         }
+    }
+    create_context_health(ddi);
+    ddi.connect_stats.download_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - attach_start).count();
+}
 
-        int mpu_group_count = 0;
-        memx_status status = memx_operation_get_mpu_group_count(device_id, &mpu_group_count);
-        if (memx_status_error(status))
-        {
-            throw runtime_error("Couldn't get the mpu group count");
+void DeviceManager::create_context_health(dfp_rt_info& ddi){
+
+    // the entry of the dfp stays in place while other dfps are added, the recovery thread keeps a reference to it
+    dfp_rt_info* info = &ddi;
+    ddi.health = new MX::Utils::context_health(ddi.context_ids_vector.size(), [this, info](int context_idx){
+        reset_context(*info, context_idx);
+    });
+}
+
+std::vector<int> DeviceManager::add_free_devices(int dfp_tag){
+
+    dfp_rt_info& ddi = dfp_mxa_map.at(dfp_tag);
+    for(auto& it : dfp_mxa_map){
+        if(it.first != dfp_tag && ddi.health != NULL && it.second.health == ddi.health){
+            throw logic_error("Devices cannot be added to a dfp that takes turns with other dfps");
+        }
+    }
+
+    std::vector<int> claimed = claim_free_devices(dfp_tag);
+    bool use_multigroup_lb = ddi.use_multigroup_lb;
+    std::vector<std::exception_ptr> errors = run_per_device(claimed.size(), [this, &claimed, dfp_tag, use_multigroup_lb](int d){
+        open_device_contexts(claimed[d], dfp_tag, use_multigroup_lb);
+    });
+    std::vector<int> opened = keep_working_devices(claimed, errors, true);
+    errors = download_to_devices(dfp_tag, opened);
+    std::vector<int> added = keep_working_devices(opened, errors, true);
+    if(added.empty()){
+        return added;
+    }
+
+    // the health is sized for the contexts of the dfp, it is replaced once its recovery thread is done with the
+    // lists of the dfp. The contexts that had failed are tried again
+    std::vector<MX::Types::ContextHealth> old_stats;
+    MX::Types::FailoverPolicy policy;
+    if(ddi.health != NULL){
+        old_stats = ddi.health->stats();
+        policy = ddi.health->policy();
+        delete ddi.health;
+    }
+    for(int device_id : added){
+        ddi.device_ids.push_back(device_id);
+        open_devices.push_back(device_id);
+        for(int ctx : device_contexts_of(device_id, dfp_tag)){
+            ddi.context_ids_vector.push_back(ctx);
+        }
+    }
+    create_context_health(ddi);
+    ddi.health->set_policy(policy);
+    for(int ctx = 0; ctx < static_cast<int>(old_stats.size()); ctx++){
+        if(!old_stats[ctx].healthy){
+            ddi.health->report_failure(ctx, ddi.health->generation(ctx), old_stats[ctx].last_error);
+        }
+    }
+    return added;
+}
+
+void DeviceManager::release_dfp_devices(int dfp_tag){
+
+    dfp_rt_info& ddi = dfp_mxa_map.at(dfp_tag);
+    for(int device_id : ddi.device_ids){
+        close_device_contexts(device_id, dfp_tag);
+        if(available_mxa_device_map.at(device_id).contexts_ids_attached.empty()){
+            release_device(device_id);
+            open_devices.erase(std::remove(open_devices.begin(), open_devices.end(), device_id), open_devices.end());
         }
     }
+    ddi.device_ids.clear();
+}
+
+void DeviceManager::remove_dfp(int dfp_tag){
+
+    auto it = dfp_mxa_map.find(dfp_tag);
+    if(it == dfp_mxa_map.end()){
+        return;
+    }
+    if(it->second.health != NULL){
+        delete it->second.health;
+    }
+    if(it->second.dfp != NULL){
+        delete it->second.dfp;
+    }
+    dfp_mxa_map.erase(it);
+}
+
+void DeviceManager::inject_download_fault(int count){
+    download_faults += count;
 }
 
 void DeviceManager::download_dfp_to_device(int dfp_tag){
 
+    dfp_rt_info& ddi = dfp_mxa_map.at(dfp_tag);
+    std::vector<std::exception_ptr> errors = download_to_devices(dfp_tag, ddi.device_ids);
+    // what was downloaded stays recorded, the failed contexts are downloaded again by the next attempt
+    throw_device_errors(ddi.device_ids, errors);
+}
+
+std::vector<std::exception_ptr> DeviceManager::download_to_devices(int dfp_tag, const std::vector<int>& device_ids){
+
         // Since download of dfp has to happen a lot of times this function has been separated and can be called.
         // will download to all the contexts that has been assigned to that dfp and will enable the stream for that context
-        int dfp_num_contexts = dfp_mxa_map.at(dfp_tag).context_ids_vector.size();
-        for(int i = 0; i < dfp_num_contexts; i++){
-            int ctx = dfp_mxa_map.at(dfp_tag).context_ids_vector[i];
-
-            memx_status status;
-            if(dfp_mxa_map.at(dfp_tag).is_bytes){
-                status = memx_download_model(ctx,  (const char*) dfp_mxa_map.at(dfp_tag).dfp->src_dfp_bytes, 0 /*model_idx? */, MEMX_DOWNLOAD_TYPE_WTMEM_AND_MODEL_BUFFER);
-            } else {
-                status = memx_download_model(ctx,  dfp_mxa_map.at(dfp_tag).dfp->path().c_str(), 0 /*model_idx? */, MEMX_DOWNLOAD_TYPE_WTMEM_AND_MODEL);
-            }
-            if (memx_status_error(status))
-            {
-                std::ostringstream oss;
-                oss<< "Download of DFP "<<  dfp_mxa_map.at(dfp_tag).dfp->path() <<" failed";
-                throw runtime_error(oss.str());
-            }
+        // The devices are downloaded to in parallel
+        auto download_start = std::chrono::steady_clock::now();
+        dfp_rt_info& ddi = dfp_mxa_map.at(dfp_tag);
+        // without the cache the contexts are not recorded as holding the dfp
+        uint64_t hash = device_cache_enabled ? dfp_content_hash(dfp_tag) : 0;
+        int num_devices = device_ids.size();
+        std::vector<int> downloads(num_devices, 0);
+        std::vector<int> downloads_skipped(num_devices, 0);
+        std::vector<std::exception_ptr> errors = run_per_device(num_devices, [&](int d){
+            int device_id = device_ids[d];
+            device_info& di = available_mxa_device_map.at(device_id);
+            // the cache records the dfp of each group of the device by the order its context was opened in,
+            // the context ids change from one process to the next
+            for(int slot = 0; slot < static_cast<int>(di.contexts_ids_attached.size()); slot++){
+                int ctx = di.contexts_ids_attached[slot];
+                if(!context_allocator::process().owned_by(ctx, this, ddi.context_owner)){
+                    continue;
+                }
+                auto resident = di.state.context_dfp.find(slot);
+                if(hash != 0 && resident != di.state.context_dfp.end() && resident->second == hash){
+                    // the same dfp is still on the context
+                    downloads_skipped[d]++;
+                }
+                else{
+                    if(resident != di.state.context_dfp.end()){
+                        di.state.context_dfp.erase(resident);
+                        MX::Utils::save_device_state(device_id, di.state);
+                    }
+                    // an injected fault takes the place of a download the device refused
+                    int faults = download_faults.load();
+                    while(faults > 0 && !download_faults.compare_exchange_weak(faults, faults - 1)){}
+                    memx_status status = (faults > 0) ? MEMX_STATUS_OTHERS : download_context(ddi, ctx);
+                    if (memx_status_error(status))
+                    {
+                        std::ostringstream oss;
+                        oss<< "Download of DFP "<<  ddi.dfp->path() <<" failed";
+                        throw runtime_error(oss.str());
+                    }
+                    if(hash != 0){
+                        di.state.context_dfp[slot] = hash;
+                    }
+                    downloads[d]++;
+                }
 
-            // start stream
-            status = memx_set_stream_enable(ctx, 0 /*wait time?*/);
-            if (memx_status_error(status))
-            {
-                throw runtime_error("Enable stream failed");
+                // start stream
+                memx_status status = memx_set_stream_enable(ctx, 0 /*wait time?*/);
+                if (memx_status_error(status))
+                {
+                    throw runtime_error("Enable stream failed");
+                }
             }
+            MX::Utils::save_device_state(device_id, di.state);
+        });
+
+        for(int d = 0; d < num_devices; d++){
+            ddi.connect_stats.downloads += downloads[d];
+            ddi.connect_stats.downloads_skipped += downloads_skipped[d];
+        }
+        ddi.connect_stats.download_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - download_start).count();
+        return errors;
+}
+
+memx_status DeviceManager::download_context(dfp_rt_info& ddi, int ctx){
+    if(!ddi.preloaded_bytes.empty()){
+        return memx_download_model(ctx,  (const char*) ddi.preloaded_bytes.data(), 0 /*model_idx? */, MEMX_DOWNLOAD_TYPE_WTMEM_AND_MODEL_BUFFER);
+    } else if(ddi.is_bytes){
+        return memx_download_model(ctx,  (const char*) ddi.dfp->src_dfp_bytes, 0 /*model_idx? */, MEMX_DOWNLOAD_TYPE_WTMEM_AND_MODEL_BUFFER);
+    } else {
+        return memx_download_model(ctx,  ddi.dfp->path().c_str(), 0 /*model_idx? */, MEMX_DOWNLOAD_TYPE_WTMEM_AND_MODEL);
+    }
+}
+
+void DeviceManager::reset_context(dfp_rt_info& ddi, int context_idx){
+
+    // Runs on the recovery thread of the dfp while the other contexts keep streaming, so only this context and
+    // the cache entry of its device are touched
+    int ctx = ddi.context_ids_vector.at(context_idx);
+    // a context that failed may refuse to stop its streams, the download below decides if it is usable
+    memx_set_stream_disable(ctx, 0 /*wait time?*/);
+    std::unique_lock state_lock(device_state_mutex);
+    for(int device_id : ddi.device_ids){
+        device_info& di = available_mxa_device_map.at(device_id);
+        auto slot = std::find(di.contexts_ids_attached.begin(), di.contexts_ids_attached.end(), ctx);
+        if(slot != di.contexts_ids_attached.end() && di.state.context_dfp.erase(slot - di.contexts_ids_attached.begin()) > 0){
+            MX::Utils::save_device_state(device_id, di.state);
+        }
+    }
+    state_lock.unlock();
+    memx_status status = download_context(ddi, ctx);
+    if (memx_status_error(status))
+    {
+        std::ostringstream oss;
+        oss<< "Download of DFP "<<  ddi.dfp->path() <<" to context " << ctx << " failed";
+        throw runtime_error(oss.str());
+    }
+    status = memx_set_stream_enable(ctx, 0 /*wait time?*/);
+    if (memx_status_error(status))
+    {
+        throw runtime_error("Enable stream failed on context " + to_string(ctx));
     }
 }
 
+uint64_t DeviceManager::dfp_content_hash(int dfp_tag){
+
+    dfp_rt_info& ddi = dfp_mxa_map.at(dfp_tag);
+    if(ddi.content_hash == 0){
+        if(!ddi.preloaded_bytes.empty()){
+            ddi.content_hash = MX::Utils::hash_bytes(ddi.preloaded_bytes.data(), ddi.preloaded_bytes.size());
+        }
+        else if(!ddi.is_bytes){
+            ddi.content_hash = MX::Utils::hash_file(ddi.dfp_filename_path);
+        }
+        // the size of dfps passed as bytes is unknown, they are always downloaded
+    }
+    return ddi.content_hash;
+}
+
+void DeviceManager::share_mxa(int dfp_tag, int resident_dfp_tag){
+
+    // The dfp runs on the contexts of the resident dfp and is downloaded in its place when it is swapped in,
+    // so both have to need the same device configuration
+    dfp_rt_info& resident = dfp_mxa_map.at(resident_dfp_tag);
+    dfp_rt_info& shared = dfp_mxa_map.at(dfp_tag);
+    if(shared.dfp_num_chips != resident.dfp_num_chips || shared.use_multigroup_lb != resident.use_multigroup_lb){
+        std::ostringstream oss;
+        oss << "A dfp compiled for " << shared.dfp_num_chips << " chips cannot swap with a dfp compiled for " << resident.dfp_num_chips
+            << " chips, dfps sharing devices need the same chip count and group configuration";
+        throw runtime_error(oss.str());
+    }
+    shared.device_ids = resident.device_ids;
+    shared.context_ids_vector = resident.context_ids_vector;
+    shared.context_owner = resident.context_owner;
+    // the contexts fail and recover for all the dfps on them. Which dfp a recovered context has to hold is up to
+    // the swap scheduler, so failed contexts are left unused instead of being downloaded again
+    shared.health = resident.health;
+    shared.health->set_recovery(false);
+}
+
+void DeviceManager::preload_dfp(int dfp_tag){
+
+    dfp_rt_info& ddi = dfp_mxa_map.at(dfp_tag);
+    if(ddi.is_bytes || !ddi.preloaded_bytes.empty()){
+        return;
+    }
+    std::ifstream fd(ddi.dfp_filename_path, std::ios::binary | std::ios::ate);
+    if(!fd){
+        throw runtime_error("Cannot read dfp file " + ddi.dfp_filename_path.string());
+    }
+    std::streamsize size = fd.tellg();
+    fd.seekg(0, std::ios::beg);
+    std::vector<uint8_t> bytes(size);
+    if(!fd.read(reinterpret_cast<char*>(bytes.data()), size)){
+        throw runtime_error("Cannot read dfp file " + ddi.dfp_filename_path.string());
+    }
+    ddi.preloaded_bytes = std::move(bytes);
+}
+
+void DeviceManager::swap_dfp(int dfp_tag){
+
+    // The outputs of the previous dfp were all read, stop its streams before its weights are overwritten
+    for(int ctx : dfp_mxa_map.at(dfp_tag).context_ids_vector){
+        memx_status status = memx_set_stream_disable(ctx, 0 /*wait time?*/);
+        if (memx_status_error(status))
+        {
+            throw runtime_error("Disable stream failed");
+        }
+    }
+    download_dfp_to_device(dfp_tag);
+}
+
 void DeviceManager::cleanup__all_dfps(){
+    // recoveries use the dfps, they are stopped first. dfps swapping on the same contexts share their health
+    std::set<MX::Utils::context_health*> healths;
+    for(auto& it  : this->dfp_mxa_map ){
+        if(it.second.health != NULL){
+            healths.insert(it.second.health);
+            it.second.health = NULL;
+        }
+    }
+    for(MX::Utils::context_health* health : healths){
+        delete health;
+    }
     for(auto& it  : this->dfp_mxa_map ){
         it.second.context_ids_vector.clear();
 
@@ -449,11 +1185,13 @@ void DeviceManager::close_all_devices(){
             int num_contexts = available_mxa_device_map.at(device_id).number_of_contexts_attached;
             for(int ctx = 0; ctx < num_contexts ; ctx++){
                 memx_status status;
-                status = memx_close(available_mxa_device_map.at(device_id).contexts_ids_attached[ctx]);
+                int context_id = available_mxa_device_map.at(device_id).contexts_ids_attached[ctx];
+                status = memx_close(context_id);
                 if (memx_status_error(status))
                 {
                     throw runtime_error("MXA context close failed");
                 }
+                context_allocator::process().release(context_id);
             }
             available_mxa_device_map.at(device_id).number_of_contexts_attached = 0;
             available_mxa_device_map.at(device_id).contexts_ids_attached.clear();
@@ -472,10 +1210,12 @@ void DeviceManager::close_all_devices(){
         available_devices = 0;
         available_mxa_device_map.clear();
     }
+    context_allocator::process().release_owner(this);
 }
 
 void DeviceManager::init_mx_models(int dfp_tag, std::vector<ModelBase *>* mxmodel_vector ){
 
+    auto models_start = std::chrono::steady_clock::now();
     int num_models = dfp_mxa_map.at(dfp_tag).num_models;
     for (int i = 0; i < num_models; ++i)
     {
@@ -489,10 +1229,11 @@ void DeviceManager::init_mx_models(int dfp_tag, std::vector<ModelBase *>* mxmode
             throw(std::runtime_error("int inputs are currently not supported"));               
         }
         else{
-            MxModel<float> *fm = new MxModel<float>(i, dfp_mxa_map.at(dfp_tag).dfp, &dfp_mxa_map.at(dfp_tag).context_ids_vector);
+            MxModel<float> *fm = new MxModel<float>(i, dfp_mxa_map.at(dfp_tag).dfp, &dfp_mxa_map.at(dfp_tag).context_ids_vector, dfp_mxa_map.at(dfp_tag).health);
             mxmodel_vector->push_back(fm);
         }
     }
+    dfp_mxa_map.at(dfp_tag).connect_stats.models_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - models_start).count();
 }
 
 // bool DeviceManager::dfp_tag_duplicate_check(int dfp_tag){
@@ -521,6 +1262,30 @@ bool DeviceManager::get_dfp_validity(int dfp_tag){
     return dfp_mxa_map.at(dfp_tag).valid;
 }
 
+MX::Utils::context_health* DeviceManager::get_context_health(int dfp_tag){
+    return dfp_mxa_map.at(dfp_tag).health;
+}
+
+std::vector<MX::Types::ContextHealth> DeviceManager::get_context_health_stats(int dfp_tag){
+    dfp_rt_info& ddi = dfp_mxa_map.at(dfp_tag);
+    if(ddi.health == NULL){
+        return {};
+    }
+    std::vector<MX::Types::ContextHealth> stats = ddi.health->stats();
+    for(int i = 0; i < static_cast<int>(stats.size()); ++i){
+        stats[i].context_id = ddi.context_ids_vector[i];
+    }
+    return stats;
+}
+
+MX::Types::ConnectStats DeviceManager::get_connect_stats(int dfp_tag){
+    return dfp_mxa_map.at(dfp_tag).connect_stats;
+}
+
+void DeviceManager::set_device_cache(bool enable){
+    device_cache_enabled = enable;
+}
+
 // void DeviceManager::cleanup_all_setup_maps(){
     
 //     DeviceManager::dfp_mxa_map.clear();
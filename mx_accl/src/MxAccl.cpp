@@ -1,5 +1,8 @@
 #include <memx/accl/MxAccl.h>
 #include <sstream>
+#include <deque>
+#include <chrono>
+#include <algorithm>
 
 using namespace MX::Runtime;
 using namespace MX::Types;
@@ -8,6 +11,7 @@ using namespace MX::Utils;
 MxAccl::MxAccl(){
     dfp_valid = false;
     setup_status = false;
+    run.store(false);
     device_manager = new MX::Runtime::DeviceManager();
     // device_manager->print_available_devices();
 
@@ -24,30 +28,91 @@ int MxAccl::connect_dfp(const uint8_t *dfp_bytes,int group_id){
 }
 
 int MxAccl::connect_dfp(const std::filesystem::path pdfp_path,std::vector<int>& device_ids_to_use){
-    if(dfp_valid){
-        throw std::runtime_error("Only one dfp allowed per Accl object");
+    return connect_dfp_devices(pdfp_path, NULL, device_ids_to_use, false);
+}
+
+int MxAccl::connect_dfp(const uint8_t *dfp_bytes, std::vector<int>& device_ids_to_use){
+    return connect_dfp_devices(std::filesystem::path("<BYTES>"), dfp_bytes, device_ids_to_use, false);
+}
+
+int MxAccl::connect_dfp_async(const std::filesystem::path pdfp_path,std::vector<int>& device_ids_to_use){
+    return connect_dfp_devices(pdfp_path, NULL, device_ids_to_use, true);
+}
+
+int MxAccl::connect_dfp_async(const uint8_t *dfp_bytes, std::vector<int>& device_ids_to_use){
+    return connect_dfp_devices(std::filesystem::path("<BYTES>"), dfp_bytes, device_ids_to_use, true);
+}
+
+int MxAccl::connect_dfp_devices(const std::filesystem::path& pdfp_path, const uint8_t *dfp_bytes, std::vector<int>& device_ids_to_use, bool async){
+    if(run.load()){
+        throw logic_error("connect_dfp called while MxAccl is running");
     }
 
     if(device_ids_to_use.empty()){
         throw runtime_error("device_ids_to_use parameter cannot be empty");
     }
 
+    //the device manager is not shared with a download still running
+    join_connects(0, static_cast<int>(connects_.size()) - 1);
+
+    auto connect_start = std::chrono::steady_clock::now();
     dfp_path = pdfp_path;
-    dfp_tag = 0;
-    run.store(false);
+    dfp_paths.push_back(dfp_path);
+    //Every dfp runs on its own devices, the models of all dfps share the start, stop and wait of this object
+    int dfp_tag = static_cast<int>(dfp_model_offset_.size());
 
-    device_manager->opendfp(dfp_path, dfp_tag);
-    dfp_valid = device_manager->get_dfp_validity(dfp_tag);
-    if(!dfp_valid){
+    if(dfp_bytes != NULL){
+        device_manager->opendfp_bytes(dfp_bytes, dfp_tag);
+    }
+    else{
+        device_manager->opendfp(dfp_path, dfp_tag);
+    }
+    if(!device_manager->get_dfp_validity(dfp_tag)){
         throw runtime_error("Cannot parse dfp file - Please check given dfp");
     }
 
     setup_status = device_manager->setup_mxa(dfp_tag, device_ids_to_use);
     if(setup_status){
 
-        device_manager->attach_dfp_to_device(dfp_tag);
-        device_manager->download_dfp_to_device(dfp_tag);
-        device_manager->init_mx_models(dfp_tag, &models);
+        try{
+            device_manager->attach_dfp_to_device(dfp_tag);
+            if(!async){
+                device_manager->download_dfp_to_device(dfp_tag);
+            }
+        }
+        catch(...){
+            //the devices are given back, so the dfp can be connected to them again
+            device_manager->release_dfp_devices(dfp_tag);
+            device_manager->remove_dfp(dfp_tag);
+            dfp_paths.pop_back();
+            throw;
+        }
+        if(async){
+            //the models only need the dfp and the contexts, they are ready for the pre and post models and
+            //the streams while the dfp is downloaded
+            dfp_model_offset_.push_back(static_cast<int>(models.size()));
+            device_manager->init_mx_models(dfp_tag, &models);
+            dfp_valid = true;
+            connects_.emplace_back();
+            connects_[dfp_tag].download = new std::thread([this, dfp_tag, connect_start](){
+                try{
+                    device_manager->download_dfp_to_device(dfp_tag);
+                }
+                catch(...){
+                    //the models of the dfp are made already, only its devices are given back
+                    device_manager->release_dfp_devices(dfp_tag);
+                    connects_[dfp_tag].error = std::current_exception();
+                }
+                connects_[dfp_tag].total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - connect_start).count();
+            });
+        }
+        else{
+            dfp_model_offset_.push_back(static_cast<int>(models.size()));
+            device_manager->init_mx_models(dfp_tag, &models);
+            dfp_valid = true;
+            connects_.emplace_back();
+            connects_[dfp_tag].total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - connect_start).count();
+        }
 
     }
     else{
@@ -56,57 +121,72 @@ int MxAccl::connect_dfp(const std::filesystem::path pdfp_path,std::vector<int>&
     return dfp_tag;
 }
 
-int MxAccl::connect_dfp(const uint8_t *dfp_bytes, std::vector<int>& device_ids_to_use){
-    if(dfp_valid){
-        throw std::runtime_error("Only one dfp allowed per Accl object");
-    }
-
-    if(device_ids_to_use.empty()){
-        throw runtime_error("device_ids_to_use parameter cannot be empty");
+void MxAccl::wait_connect(int dfp_id){
+    if(dfp_id >= static_cast<int>(connects_.size())){
+        throw std::runtime_error("dfp is not connected.");
     }
-
-    dfp_path = std::filesystem::path("<BYTES>");
-    dfp_tag = 0;
-    run.store(false);
-
-    device_manager->opendfp_bytes(dfp_bytes, dfp_tag);
-    dfp_valid = device_manager->get_dfp_validity(dfp_tag);
-    if(!dfp_valid){
-        throw runtime_error("Cannot parse dfp file - Please check given dfp");
+    int first = dfp_id < 0 ? 0 : dfp_id;
+    int last = dfp_id < 0 ? static_cast<int>(connects_.size()) - 1 : dfp_id;
+    join_connects(first, last);
+    //a failed download is reported by every later wait, the dfp can't be run
+    for(int d = first; d <= last; ++d){
+        if(connects_[d].error){
+            std::rethrow_exception(connects_[d].error);
+        }
     }
+}
 
-    setup_status = device_manager->setup_mxa(dfp_tag, device_ids_to_use);
-    if(setup_status){
-
-        device_manager->attach_dfp_to_device(dfp_tag);
-        device_manager->download_dfp_to_device(dfp_tag);
-        device_manager->init_mx_models(dfp_tag, &models);
-
-    }
-    else{
-         throw runtime_error("MxAccl setup failed: Cannot configure the MXA devices given");
+void MxAccl::join_connects(int first, int last){
+    for(int d = first; d <= last; ++d){
+        connect_state& state = connects_[d];
+        if(state.download != NULL){
+            auto wait_start = std::chrono::steady_clock::now();
+            state.download->join();
+            delete state.download;
+            state.download = NULL;
+            state.wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wait_start).count();
+        }
     }
-    return dfp_tag;
 }
 
+int MxAccl::model_dfp(int model_idx) const{
+    int dfp_id = static_cast<int>(std::upper_bound(dfp_model_offset_.begin(), dfp_model_offset_.end(), model_idx) - dfp_model_offset_.begin()) - 1;
+    return std::max(dfp_id, 0);
+}
 
 void MxAccl::start(){
     if (dfp_valid)
     {
-        int num_models =  device_manager->get_dfp_num_models(dfp_tag);
+        int num_models = models.size();
 
         if(get_num_streams() == 0){
             throw logic_error("accl start called before connect_stream for auto threading");
         }
         else{
+            //featureMaps are allocated while the downloads of asynchronous connects finish
+            for (int i = 0; i < num_models; ++i)
+            {
+                if(models[i]->get_num_streams()>0){
+                    auto buffers_start = std::chrono::steady_clock::now();
+                    models[i]->model_prepare();
+                    connects_[model_dfp(i)].buffers_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buffers_start).count();
+                }
+            }
+            wait_connect();
+            //the models reset the dispatch stats the power governors sample
+            device_manager->stop_power_governors();
             // set run status to true
             run.store(true);
-            for (int i = 0; i < num_models; ++i)
+            //models fed by a pipeline are started before the models feeding them
+            std::vector<int> order = pipeline_order();
+            for (int k = num_models - 1; k >= 0; --k)
             {
+                int i = order[k];
                 //start models that have a stream connected to it
                 if(models[i]->get_num_streams()>0)
                     models[i]->model_start();
             }
+            device_manager->start_power_governors();
         }
     }
     else
@@ -117,11 +197,11 @@ void MxAccl::start(){
 
 void MxAccl::wait(){
     if(dfp_valid){
-        int num_models =  device_manager->get_dfp_num_models(dfp_tag);
+        int num_models = models.size();
         for (int i = 0; i < num_models; ++i)
         {
             //wait for the all the models to finish streaming
-            if(models[i]->get_num_streams()>0)
+            if(models[i]->model_running())
                 models[i]->model_wait();
         }
     }
@@ -132,11 +212,11 @@ void MxAccl::stop()
 
     if (dfp_valid && run.load())
     {
-        int num_models =  device_manager->get_dfp_num_models(dfp_tag);
-        for (int i = 0; i < num_models; ++i)
+        //models feeding a pipeline are stopped first, so their last outputs still reach the models they feed
+        for (int i : pipeline_order())
         {   
-            //Stop all models
-            if(models[i]->get_num_streams()>0)
+            //Stop all models, including the ones started by attach_stream
+            if(models[i]->model_running())
                 models[i]->model_stop();
         }
         run.store(false);
@@ -144,11 +224,146 @@ void MxAccl::stop()
 }
 
 void MxAccl::connect_stream(float_callback_t in_cb, float_callback_t out_cb, int stream_id, int model_id, int dfp_id){
-    //!!!!TODO: Need to use dfp_id for future
-    if(dfp_id!=0){
-        throw std::runtime_error("only one dfp per MxAccl allowed");
+    connect_stream(in_cb,out_cb,stream_id,MX::Types::StreamOptions(),model_id,dfp_id);
+}
+
+void MxAccl::connect_stream(float_callback_t in_cb, float_callback_t out_cb, int stream_id, const MX::Types::StreamOptions& options, int model_id, int dfp_id){
+    model_id = get_model_index(model_id, dfp_id);
+    //The stream runs through every model of the pipeline starting at model_id, each model
+    //hands its outputs to the next one and the last one calls the output callback of the user
+    std::vector<int> chain{model_id};
+    for(auto next = pipelines_.find(model_id); next != pipelines_.end(); next = pipelines_.find(next->second)){
+        chain.push_back(next->second);
     }
-    models[model_id]->connect_stream(in_cb,out_cb,stream_id);
+    for(size_t k = 0; k < chain.size(); ++k){
+        float_callback_t stage_out_cb = out_cb;
+        if(k + 1 < chain.size()){
+            ModelBase* downstream = models[chain[k+1]];
+            stage_out_cb = [downstream, stream_id](vector<const MX::Types::FeatureMap<float> *> fmaps, int){
+                downstream->pipeline_feed(stream_id, fmaps);
+                return true;
+            };
+        }
+        if(k == 0){
+            models[chain[k]]->connect_stream(in_cb,stage_out_cb,stream_id,options);
+        }
+        else{
+            models[chain[k]]->connect_pipeline_stream(stage_out_cb,stream_id);
+        }
+    }
+}
+
+void MxAccl::attach_stream(float_callback_t in_cb, float_callback_t out_cb, int stream_id, int model_id, int dfp_id){
+    attach_stream(in_cb,out_cb,stream_id,MX::Types::StreamOptions(),model_id,dfp_id);
+}
+
+void MxAccl::attach_stream(float_callback_t in_cb, float_callback_t out_cb, int stream_id, const MX::Types::StreamOptions& options, int model_id, int dfp_id){
+    if(!run.load()){
+        connect_stream(in_cb,out_cb,stream_id,options,model_id,dfp_id);
+        return;
+    }
+    model_id = get_model_index(model_id, dfp_id);
+    if(in_cb ==NULL || out_cb == NULL){
+        throw invalid_argument("input callback or output callback got a NULL ptr!");
+    }
+    std::vector<int> chain{model_id};
+    for(auto next = pipelines_.find(model_id); next != pipelines_.end(); next = pipelines_.find(next->second)){
+        chain.push_back(next->second);
+    }
+    //The models fed by a pipeline get the stream first, so it is ready before the upstream model feeds it
+    int k = static_cast<int>(chain.size()) - 1;
+    try{
+        for(; k >= 0; --k){
+            float_callback_t stage_out_cb = out_cb;
+            if(k + 1 < static_cast<int>(chain.size())){
+                ModelBase* downstream = models[chain[k+1]];
+                stage_out_cb = [downstream, stream_id](vector<const MX::Types::FeatureMap<float> *> fmaps, int){
+                    downstream->pipeline_feed(stream_id, fmaps);
+                    return true;
+                };
+            }
+            if(k == 0){
+                models[chain[k]]->attach_stream(in_cb,stage_out_cb,stream_id,options);
+            }
+            else{
+                models[chain[k]]->attach_stream(nullptr,stage_out_cb,stream_id,MX::Types::StreamOptions());
+            }
+        }
+    }
+    catch(...){
+        //undo the pipeline streams attached before the failure
+        for(size_t j = k + 1; j < chain.size(); ++j){
+            models[chain[j]]->detach_stream(stream_id);
+        }
+        throw;
+    }
+}
+
+void MxAccl::detach_stream(int stream_id){
+    if(!dfp_valid){
+        throw runtime_error("detach_stream called before connect_dfp");
+    }
+    //models feeding a pipeline drain first, so the frames they hand over reach the models they feed
+    bool found = false;
+    for(int i : pipeline_order()){
+        found = models[i]->detach_stream(stream_id) || found;
+    }
+    if(!found){
+        throw runtime_error("detach_stream called with a stream_id that is not connected");
+    }
+}
+
+void MxAccl::connect_pipeline(int model_a, int model_b, int dfp_id){
+    model_a = get_model_index(model_a, dfp_id);
+    model_b = get_model_index(model_b, dfp_id);
+    if(run.load()){
+        throw logic_error("connect_pipeline called after starting MxAccl");
+    }
+    if(model_a == model_b){
+        throw invalid_argument("connect_pipeline needs two different models");
+    }
+    if(pipelines_.find(model_a) != pipelines_.end()){
+        throw invalid_argument("model already feeds a pipeline, a model can only feed one model");
+    }
+    if(models[model_a]->get_num_streams() > 0){
+        throw logic_error("connect_pipeline has to be called before connecting streams to the upstream model");
+    }
+    for(auto next = pipelines_.find(model_b); next != pipelines_.end(); next = pipelines_.find(next->second)){
+        if(next->second == model_a){
+            throw invalid_argument("connect_pipeline would create a cycle of models");
+        }
+    }
+    MX::Types::MxModelInfo info_a = models[model_a]->return_model_info();
+    MX::Types::MxModelInfo info_b = models[model_b]->return_model_info();
+    if(info_a.out_featuremap_sizes != info_b.in_featuremap_sizes){
+        throw invalid_argument("outputs of model " + std::to_string(model_a) + " don't match the inputs of model " + std::to_string(model_b));
+    }
+    pipelines_[model_a] = model_b;
+}
+
+std::vector<int> MxAccl::pipeline_order(){
+    int num_models = models.size();
+    std::vector<int> num_feeding(num_models, 0);
+    for(auto& link : pipelines_){
+        num_feeding[link.second]++;
+    }
+    std::deque<int> ready;
+    for(int i = 0; i < num_models; ++i){
+        if(num_feeding[i] == 0){
+            ready.push_back(i);
+        }
+    }
+    std::vector<int> order;
+    while(!ready.empty()){
+        int i = ready.front();
+        ready.pop_front();
+        order.push_back(i);
+        auto next = pipelines_.find(i);
+        if(next != pipelines_.end() && --num_feeding[next->second] == 0){
+            ready.push_back(next->second);
+        }
+    }
+    return order;
 }
 
 // void MxAccl::connect_stream(int_callback_t in_cb, float_callback_t out_cb, int stream_id, int model_id){
@@ -156,11 +371,15 @@ void MxAccl::connect_stream(float_callback_t in_cb, float_callback_t out_cb, int
 // }
 
 void MxAccl::connect_post_model(std::filesystem::path post_model_path, int model_idx, const std::vector<size_t>& post_size_list){
+    auto plugin_start = std::chrono::steady_clock::now();
     models[model_idx]->model_set_post(post_model_path,post_size_list);
+    connects_[model_dfp(model_idx)].plugins_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - plugin_start).count();
 }
 
 void MxAccl::connect_pre_model(std::filesystem::path pre_model_path, int model_idx){
+    auto plugin_start = std::chrono::steady_clock::now();
     models[model_idx]->model_set_pre(pre_model_path);
+    connects_[model_dfp(model_idx)].plugins_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - plugin_start).count();
 }
 
 MxAccl::~MxAccl()
@@ -169,11 +388,14 @@ MxAccl::~MxAccl()
     if(run.load()){
         this->stop();
     }
+    //the downloads still running use the device manager
+    join_connects(0, static_cast<int>(connects_.size()) - 1);
+    //the power governors sample the models
+    device_manager->delete_power_governors();
     //Close the MXA
     // close_mxa();
-    if(dfp_valid && setup_status ){
-        int num_models =  device_manager->get_dfp_num_models(dfp_tag);
-        for (int i = 0; i < num_models; ++i)
+    if(dfp_valid){
+        for (int i = 0; i < static_cast<int>(models.size()); ++i)
         {
             //delete all the models created
             delete models[i];
@@ -198,10 +420,36 @@ MxAccl::~MxAccl()
 }
 
 int MxAccl::get_num_models(){
-    if(!dfp_valid){
+    return models.size();
+}
+
+int MxAccl::get_num_models(int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
         return 0;
     }
-    return  device_manager->get_dfp_num_models(dfp_tag);
+    return device_manager->get_dfp_num_models(dfp_id);
+}
+
+int MxAccl::get_num_dfps(){
+    return dfp_model_offset_.size();
+}
+
+int MxAccl::get_model_index(int model_id, int dfp_id) const{
+    int num_dfps = dfp_model_offset_.size();
+    if(dfp_id < 0 || dfp_id >= num_dfps){
+        std::ostringstream oss;
+        oss << "Invalid dfp ID passed : Number of dfps connected = "<<num_dfps<<"\n dfp_id range is 0 to "<<num_dfps-1;
+        throw runtime_error(oss.str());
+    }
+    int first = dfp_model_offset_[dfp_id];
+    int end = (dfp_id + 1 < num_dfps) ? dfp_model_offset_[dfp_id + 1] : static_cast<int>(models.size());
+    int num_models = end - first;
+    if(model_id < 0 || model_id >= num_models){
+        std::ostringstream oss;
+        oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
+        throw runtime_error(oss.str());
+    }
+    return first + model_id;
 }
 
 int MxAccl::get_num_streams(){
@@ -211,18 +459,77 @@ int MxAccl::get_num_streams(){
         return ans;
     }
     //return sum of num streams in each model
-    int num_models =  device_manager->get_dfp_num_models(dfp_tag);
+    int num_models = models.size();
     for(int i =0; i<num_models; ++i){
         ans+=models[i]->get_num_streams();
     }
     return ans;
 }
 
-int MxAccl::get_dfp_num_chips(){
-    if(!dfp_valid){
+void MxAccl::set_device_cache(bool enable){
+    join_connects(0, static_cast<int>(connects_.size()) - 1);
+    device_manager->set_device_cache(enable);
+}
+
+MX::Types::ConnectStats MxAccl::get_connect_stats(int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    join_connects(dfp_id, dfp_id);
+    MX::Types::ConnectStats stats = device_manager->get_connect_stats(dfp_id);
+    stats.plugins_ms = connects_[dfp_id].plugins_ms;
+    stats.buffers_ms = connects_[dfp_id].buffers_ms;
+    stats.wait_ms = connects_[dfp_id].wait_ms;
+    stats.total_ms = connects_[dfp_id].total_ms;
+    return stats;
+}
+
+std::vector<MX::Types::DeviceCapacity> MxAccl::get_device_capacity(int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
         throw std::runtime_error("dfp is not connected.");
     }
-    return  device_manager->get_dfp_num_chips(dfp_tag);
+    join_connects(dfp_id, dfp_id);
+    return device_manager->get_dfp_device_capacity(dfp_id);
+}
+
+std::vector<int> MxAccl::add_free_devices(int dfp_id){
+    if(run.load()){
+        throw logic_error("add_free_devices called while MxAccl is running");
+    }
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    //the download of the dfp to its first devices is done first, a failed one is thrown
+    wait_connect(dfp_id);
+    //the governor of the dfp samples the contexts it was made with, it is made again for the new devices
+    device_manager->stop_power_governors(dfp_id);
+    std::vector<int> added;
+    try{
+        added = device_manager->add_free_devices(dfp_id);
+    }
+    catch(...){
+        device_manager->start_power_governors(dfp_id);
+        throw;
+    }
+    if(added.empty()){
+        device_manager->start_power_governors(dfp_id);
+        return added;
+    }
+    MX::Utils::context_health* health = device_manager->get_context_health(dfp_id);
+    int end = (dfp_id + 1 < static_cast<int>(dfp_model_offset_.size())) ? dfp_model_offset_[dfp_id + 1] : static_cast<int>(models.size());
+    for(int i = dfp_model_offset_[dfp_id]; i < end; ++i){
+        models[i]->add_contexts(health);
+    }
+    device_manager->refresh_power_governor(dfp_id);
+    return added;
+}
+
+int MxAccl::get_dfp_num_chips(int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    join_connects(dfp_id, dfp_id);
+    return  device_manager->get_dfp_num_chips(dfp_id);
 }
 
 MX::Types::MxModelInfo MxAccl::get_model_info(int model_id) const{
@@ -272,6 +579,162 @@ void MxAccl::set_num_workers(int input_num_workers, int output_num_workers, int
     models[model_idx]->set_num_workers(input_num_workers,output_num_workers);
 }
 
+void MxAccl::set_pipeline_depth(int depth, int model_idx){
+    if(model_idx>= static_cast<int>(models.size())){
+        std::ostringstream oss;
+        int num_models = models.size();
+        oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
+        throw runtime_error(oss.str());
+    }
+    models[model_idx]->set_pipeline_depth(depth);
+}
+
+void MxAccl::set_max_streams(int max_streams, int model_idx){
+    if(model_idx>= static_cast<int>(models.size())){
+        std::ostringstream oss;
+        int num_models = models.size();
+        oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
+        throw runtime_error(oss.str());
+    }
+    models[model_idx]->set_max_streams(max_streams);
+}
+
+void MxAccl::set_stop_policy(const MX::Types::StopPolicy& policy, int model_idx){
+    if(model_idx>= static_cast<int>(models.size())){
+        std::ostringstream oss;
+        int num_models = models.size();
+        oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
+        throw runtime_error(oss.str());
+    }
+    models[model_idx]->set_stop_policy(policy);
+}
+
+void MxAccl::set_schedule_policy(MX::Types::StreamSchedulePolicy policy, int model_idx){
+    if(model_idx>= static_cast<int>(models.size())){
+        std::ostringstream oss;
+        int num_models = models.size();
+        oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
+        throw runtime_error(oss.str());
+    }
+    models[model_idx]->set_schedule_policy(policy);
+}
+
+void MxAccl::set_auto_tune(bool enable, const MX::Types::AutoTuneConfig& config, int model_idx){
+    if(model_idx>= static_cast<int>(models.size())){
+        std::ostringstream oss;
+        int num_models = models.size();
+        oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
+        throw runtime_error(oss.str());
+    }
+    models[model_idx]->set_auto_tune(enable, config);
+}
+
+void MxAccl::set_thread_policy(const MX::Types::ThreadPolicy& policy, int model_idx){
+    if(model_idx>= static_cast<int>(models.size())){
+        std::ostringstream oss;
+        int num_models = models.size();
+        oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
+        throw runtime_error(oss.str());
+    }
+    models[model_idx]->set_thread_policy(policy);
+}
+
+MX::Types::StreamStats MxAccl::get_stream_stats(int stream_id){
+    MX::Types::StreamStats stats;
+    for(size_t i = 0; i < models.size(); ++i){
+        if(models[i]->get_stream_stats(stream_id, stats)){
+            return stats;
+        }
+    }
+    throw runtime_error("get_stream_stats called with a stream_id that is not connected");
+}
+
+void MxAccl::set_dispatch_options(const MX::Types::DispatchOptions& options, int model_idx){
+    if(model_idx>= static_cast<int>(models.size())){
+        std::ostringstream oss;
+        int num_models = models.size();
+        oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
+        throw runtime_error(oss.str());
+    }
+    models[model_idx]->set_dispatch_options(options);
+}
+
+MX::Types::DispatchStats MxAccl::get_dispatch_stats(int model_idx){
+    if(model_idx>= static_cast<int>(models.size())){
+        std::ostringstream oss;
+        int num_models = models.size();
+        oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
+        throw runtime_error(oss.str());
+    }
+    return models[model_idx]->get_dispatch_stats();
+}
+
+void MxAccl::set_failover_policy(const MX::Types::FailoverPolicy& policy, int dfp_id){
+    int first = get_model_index(0, dfp_id);
+    join_connects(dfp_id, dfp_id);
+    int end = (dfp_id + 1 < static_cast<int>(dfp_model_offset_.size())) ? dfp_model_offset_[dfp_id + 1] : static_cast<int>(models.size());
+    for(int i = first; i < end; ++i){
+        models[i]->set_failover_policy(policy);
+    }
+    device_manager->get_context_health(dfp_id)->set_policy(policy);
+}
+
+std::vector<MX::Types::ContextHealth> MxAccl::get_context_health(int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    join_connects(dfp_id, dfp_id);
+    return device_manager->get_context_health_stats(dfp_id);
+}
+
+bool MxAccl::wait_context_recovery(int32_t timeout_ms, int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    join_connects(dfp_id, dfp_id);
+    return device_manager->get_context_health(dfp_id)->wait_recovery(timeout_ms);
+}
+
+void MxAccl::inject_context_fault(int context_idx, int count, int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    join_connects(dfp_id, dfp_id);
+    MX::Utils::context_health* health = device_manager->get_context_health(dfp_id);
+    if(context_idx < 0 || context_idx >= health->num_contexts()){
+        std::ostringstream oss;
+        oss << "Invalid context index passed : Number of contexts of the dfp = "<<health->num_contexts()<<"\n context_idx range is 0 to "<<health->num_contexts()-1;
+        throw runtime_error(oss.str());
+    }
+    health->inject_fault(context_idx, count);
+}
+
+void MxAccl::inject_download_fault(int count){
+    if(count < 1){
+        throw invalid_argument("number of download faults must be >= 1");
+    }
+    device_manager->inject_download_fault(count);
+}
+
+void MxAccl::set_power_policy(const MX::Types::PowerPolicy& policy, int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    join_connects(dfp_id, dfp_id);
+    //the governor thread keeps the models of the dfp, the models vector grows with later connects
+    int first = dfp_model_offset_[dfp_id];
+    int end = (dfp_id + 1 < static_cast<int>(dfp_model_offset_.size())) ? dfp_model_offset_[dfp_id + 1] : static_cast<int>(models.size());
+    std::vector<ModelBase*> dfp_models(models.begin() + first, models.begin() + end);
+    device_manager->set_power_policy(dfp_id, policy, dfp_models);
+}
+
+std::vector<MX::Types::DevicePowerStats> MxAccl::get_power_stats(int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    return device_manager->get_power_stats(dfp_id);
+}
+
 void MxAccl::set_parallel_fmap_convert(int num_threads, int model_idx){
     if(model_idx>= static_cast<int>(models.size())){
         std::ostringstream oss;
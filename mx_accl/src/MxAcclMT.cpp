@@ -1,5 +1,6 @@
 #include <memx/accl/MxAcclMT.h>
 #include <sstream>
+#include <algorithm>
 
 using namespace MX::Runtime;
 using namespace MX::Types;
@@ -8,6 +9,7 @@ using namespace MX::Utils;
 MxAcclMT::MxAcclMT(){
     dfp_valid = false;
     setup_status = false;
+    manual_run.store(false);
     device_manager = new MX::Runtime::DeviceManager();
     // device_manager->print_available_devices();
 
@@ -26,33 +28,39 @@ int MxAcclMT::connect_dfp(const uint8_t *dfp_bytes,int group_id){
 
 int MxAcclMT::connect_dfp(const std::filesystem::path pdfp_path,  std::vector<int>& device_ids_to_use)
 {
-    if(dfp_valid){
-        throw std::runtime_error("Only one dfp allowed per Accl object");
-    }
     if(device_ids_to_use.empty()){
         throw(std::runtime_error("device_ids_to_use parameter cannot be empty"));
     }
 
     dfp_path = pdfp_path;
-    manual_run.store(false);
-    dfp_tag = 0;
+    //Every dfp runs on its own devices
+    int dfp_tag = static_cast<int>(dfp_model_offset_.size());
     
     device_manager->opendfp(dfp_path, dfp_tag);
-    dfp_valid = device_manager->get_dfp_validity(dfp_tag);
-    if(!dfp_valid){
+    if(!device_manager->get_dfp_validity(dfp_tag)){
         throw runtime_error("Cannot parse dfp file - Please check given dfp");
     }
 
     setup_status = device_manager->setup_mxa(dfp_tag, device_ids_to_use);
     if(setup_status){
 
-        device_manager->attach_dfp_to_device(dfp_tag);
-        device_manager->download_dfp_to_device(dfp_tag);
+        try{
+            device_manager->attach_dfp_to_device(dfp_tag);
+            device_manager->download_dfp_to_device(dfp_tag);
+        }
+        catch(...){
+            //the devices are given back, so the dfp can be connected to them again
+            device_manager->release_dfp_devices(dfp_tag);
+            device_manager->remove_dfp(dfp_tag);
+            throw;
+        }
+        int first_model = static_cast<int>(models.size());
+        dfp_model_offset_.push_back(first_model);
         device_manager->init_mx_models(dfp_tag, &models);
+        dfp_valid = true;
 
-        int num_models =  device_manager->get_dfp_num_models(dfp_tag);
         manual_run.store(true);
-        for(int i=0; i<num_models; i++){
+        for(int i=first_model; i<static_cast<int>(models.size()); i++){
             models[i]->model_manual_start();
         }
     }
@@ -63,29 +71,34 @@ int MxAcclMT::connect_dfp(const std::filesystem::path pdfp_path,  std::vector<in
 }
 
 int MxAcclMT::connect_dfp(const uint8_t *dfp_bytes, std::vector<int>& device_ids_to_use){
-    if(dfp_valid){
-        throw std::runtime_error("Only one dfp allowed per Accl object");
-    }
-
     if(device_ids_to_use.empty()){
         throw runtime_error("device_ids_to_use parameter cannot be empty");
     }
 
     dfp_path = std::filesystem::path("<BYTES>");
-    dfp_tag = 0;
+    int dfp_tag = static_cast<int>(dfp_model_offset_.size());
 
     device_manager->opendfp_bytes(dfp_bytes, dfp_tag);
-    dfp_valid = device_manager->get_dfp_validity(dfp_tag);
-    if(!dfp_valid){
+    if(!device_manager->get_dfp_validity(dfp_tag)){
         throw runtime_error("Cannot parse dfp file - Please check given dfp");
     }
 
     setup_status = device_manager->setup_mxa(dfp_tag, device_ids_to_use);
     if(setup_status){
 
-        device_manager->attach_dfp_to_device(dfp_tag);
-        device_manager->download_dfp_to_device(dfp_tag);
+        try{
+            device_manager->attach_dfp_to_device(dfp_tag);
+            device_manager->download_dfp_to_device(dfp_tag);
+        }
+        catch(...){
+            //the devices are given back, so the dfp can be connected to them again
+            device_manager->release_dfp_devices(dfp_tag);
+            device_manager->remove_dfp(dfp_tag);
+            throw;
+        }
+        dfp_model_offset_.push_back(static_cast<int>(models.size()));
         device_manager->init_mx_models(dfp_tag, &models);
+        dfp_valid = true;
 
     }
     else{
@@ -94,6 +107,86 @@ int MxAcclMT::connect_dfp(const uint8_t *dfp_bytes, std::vector<int>& device_ids
     return dfp_tag;
 }
 
+int MxAcclMT::connect_swap_dfp(const std::filesystem::path pdfp_path, int shared_dfp_id){
+    int num_dfps = dfp_model_offset_.size();
+    if(shared_dfp_id < 0 || shared_dfp_id >= num_dfps){
+        std::ostringstream oss;
+        oss << "Invalid dfp ID passed : Number of dfps connected = "<<num_dfps<<"\n dfp_id range is 0 to "<<num_dfps-1;
+        throw runtime_error(oss.str());
+    }
+
+    dfp_path = pdfp_path;
+    int dfp_tag = num_dfps;
+
+    device_manager->opendfp(dfp_path, dfp_tag);
+    if(!device_manager->get_dfp_validity(dfp_tag)){
+        throw runtime_error("Cannot parse dfp file - Please check given dfp");
+    }
+    // no device setup, the dfp runs on the contexts of the shared dfp
+    device_manager->share_mxa(dfp_tag, shared_dfp_id);
+    device_manager->preload_dfp(dfp_tag);
+
+    swap_group* group = find_swap_group(shared_dfp_id);
+    if(group == NULL){
+        device_manager->preload_dfp(shared_dfp_id);
+        group = new swap_group();
+        //the shared dfp is on the devices already and stays there until another dfp has frames to send
+        group->scheduler = new MX::Utils::model_swap_scheduler([this, group](int, int to){
+            device_manager->swap_dfp(group->dfp_ids[to]);
+        }, 0);
+        group->dfp_ids.push_back(shared_dfp_id);
+        group->scheduler->add_member();
+        int end = (shared_dfp_id + 1 < num_dfps) ? dfp_model_offset_[shared_dfp_id + 1] : static_cast<int>(models.size());
+        for(int i = dfp_model_offset_[shared_dfp_id]; i < end; i++){
+            models[i]->model_manual_set_swap_gate(group->scheduler, 0);
+        }
+        swap_groups_.push_back(group);
+    }
+    int member = group->scheduler->add_member();
+    group->dfp_ids.push_back(dfp_tag);
+
+    int first_model = static_cast<int>(models.size());
+    dfp_model_offset_.push_back(first_model);
+    device_manager->init_mx_models(dfp_tag, &models);
+
+    manual_run.store(true);
+    for(int i=first_model; i<static_cast<int>(models.size()); i++){
+        models[i]->model_manual_set_swap_gate(group->scheduler, member);
+        models[i]->model_manual_start();
+    }
+    return dfp_tag;
+}
+
+MxAcclMT::swap_group* MxAcclMT::find_swap_group(int dfp_id){
+    for(swap_group* group : swap_groups_){
+        if(std::find(group->dfp_ids.begin(), group->dfp_ids.end(), dfp_id) != group->dfp_ids.end()){
+            return group;
+        }
+    }
+    return NULL;
+}
+
+void MxAcclMT::set_swap_batch_size(int frames, int dfp_id){
+    if(frames < 1){
+        throw invalid_argument("swap batch size has to be at least 1");
+    }
+    swap_group* group = find_swap_group(dfp_id);
+    if(group == NULL){
+        throw runtime_error("dfp " + to_string(dfp_id) + " does not share its devices with another dfp");
+    }
+    group->scheduler->set_batch_size(frames);
+}
+
+MX::Types::SwapStats MxAcclMT::get_swap_stats(int dfp_id){
+    swap_group* group = find_swap_group(dfp_id);
+    if(group == NULL){
+        throw runtime_error("dfp " + to_string(dfp_id) + " does not share its devices with another dfp");
+    }
+    MX::Types::SwapStats stats = group->scheduler->stats();
+    stats.dfp_ids = group->dfp_ids;
+    return stats;
+}
+
 void MxAcclMT::connect_post_model(std::filesystem::path post_model_path, int model_idx, const std::vector<size_t>& post_size_list){
     models[model_idx]->model_set_post(post_model_path,post_size_list);
 }
@@ -104,16 +197,25 @@ void MxAcclMT::connect_pre_model(std::filesystem::path pre_model_path, int model
 
 MxAcclMT::~MxAcclMT()
 {
-    if(dfp_valid && setup_status ){
-        int num_models =  device_manager->get_dfp_num_models(dfp_tag);
-
-        for (int i = 0; i < num_models; ++i)
+    //senders waiting for a swap give up, the receive threads of the models still complete frames on the schedulers
+    for(swap_group* group : swap_groups_){
+        group->scheduler->stop();
+    }
+    //the power governors sample the models
+    device_manager->delete_power_governors();
+    if(dfp_valid){
+        for (int i = 0; i < static_cast<int>(models.size()); ++i)
         {
             //delete all the models created
             delete models[i];
         }
         models.clear();
     }
+    for(swap_group* group : swap_groups_){
+        delete group->scheduler;
+        delete group;
+    }
+    swap_groups_.clear();
     device_manager->cleanup__all_dfps();
     device_manager->close_all_devices();
 
@@ -128,17 +230,64 @@ MxAcclMT::~MxAcclMT()
 }
 
 int MxAcclMT::get_num_models(){
-    if(!dfp_valid){
+    return models.size();
+}
+
+int MxAcclMT::get_num_models(int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
         return 0;
     }
-    return  device_manager->get_dfp_num_models(dfp_tag);
+    return device_manager->get_dfp_num_models(dfp_id);
+}
+
+int MxAcclMT::get_num_dfps(){
+    return dfp_model_offset_.size();
+}
+
+int MxAcclMT::get_model_index(int model_id, int dfp_id) const{
+    int num_dfps = dfp_model_offset_.size();
+    if(dfp_id < 0 || dfp_id >= num_dfps){
+        std::ostringstream oss;
+        oss << "Invalid dfp ID passed : Number of dfps connected = "<<num_dfps<<"\n dfp_id range is 0 to "<<num_dfps-1;
+        throw runtime_error(oss.str());
+    }
+    int first = dfp_model_offset_[dfp_id];
+    int end = (dfp_id + 1 < num_dfps) ? dfp_model_offset_[dfp_id + 1] : static_cast<int>(models.size());
+    int num_models = end - first;
+    if(model_id < 0 || model_id >= num_models){
+        std::ostringstream oss;
+        oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
+        throw runtime_error(oss.str());
+    }
+    return first + model_id;
 }
 
-int MxAcclMT::get_dfp_num_chips(){
-    if(!dfp_valid){
+void MxAcclMT::set_device_cache(bool enable){
+    device_manager->set_device_cache(enable);
+}
+
+MX::Types::ConnectStats MxAcclMT::get_connect_stats(int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
         throw std::runtime_error("dfp is not connected.");
     }
-    return  device_manager->get_dfp_num_chips(dfp_tag);
+    MX::Types::ConnectStats stats = device_manager->get_connect_stats(dfp_id);
+    //the phases of a connect of MxAcclMT run one after the other
+    stats.total_ms = stats.parse_ms + stats.setup_ms + stats.download_ms + stats.models_ms;
+    return stats;
+}
+
+std::vector<MX::Types::DeviceCapacity> MxAcclMT::get_device_capacity(int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    return device_manager->get_dfp_device_capacity(dfp_id);
+}
+
+int MxAcclMT::get_dfp_num_chips(int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    return  device_manager->get_dfp_num_chips(dfp_id);
 }
 
 MX::Types::MxModelInfo MxAcclMT::get_model_info(int model_id) const{
@@ -178,57 +327,154 @@ MX::Types::MxModelInfo MxAcclMT::get_post_model_info(int model_id) const{
 }
 
 bool MxAcclMT::send_input(std::vector<float*> in_data, int model_id, int pstream_id, int dfp_id, bool channel_first, int32_t timeout ){
-    //!!!!TODO: Need to use dfp_id for future
-    if(dfp_id!=0){
-        throw std::runtime_error("only one dfp per MxAccl allowed");
-    }
-    if(model_id>= static_cast<int>(models.size())){
+    return models[get_model_index(model_id, dfp_id)]->model_manual_send(in_data, pstream_id,channel_first,timeout);
+}
+
+// bool MxAcclMT::send_input(std::vector<uint8_t*> in_data, int model_id, int pstream_id, bool channel_first, int32_t timeout ){
+//     return models[model_id]->model_manual_send(in_data, pstream_id,channel_first,timeout);
+// }
+
+bool MxAcclMT::receive_output(std::vector<float*> &out_data, int pmodel_id, int pstream_id, int dfp_id, bool channel_first, int32_t timeout){
+    return models[get_model_index(pmodel_id, dfp_id)]->model_manual_receive(out_data, pstream_id, channel_first,timeout);
+}
+
+bool MxAcclMT::try_receive_output(std::vector<float*> &out_data, int pmodel_id, int pstream_id, int dfp_id, bool channel_first){
+    return models[get_model_index(pmodel_id, dfp_id)]->model_manual_try_receive(out_data, pstream_id, channel_first);
+}
+
+int MxAcclMT::get_event_fd(int model_id, int stream_id, int dfp_id){
+    return models[get_model_index(model_id, dfp_id)]->model_manual_event_fd(stream_id);
+}
+
+bool MxAcclMT::send_batch(const std::vector<std::vector<float*>>& batch, int model_id, int pstream_id, int dfp_id, bool channel_first, int32_t timeout){
+    return models[get_model_index(model_id, dfp_id)]->model_manual_send_batch(batch, pstream_id, channel_first, timeout);
+}
+
+bool MxAcclMT::receive_batch(std::vector<float*> &out_data, int num_frames, int pmodel_id, int pstream_id, int dfp_id, bool channel_first, int32_t timeout){
+    return models[get_model_index(pmodel_id, dfp_id)]->model_manual_receive_batch(out_data, num_frames, pstream_id, channel_first, timeout);
+}
+
+void MxAcclMT::set_parallel_fmap_convert(int num_threads, int model_idx){
+    if(model_idx>= static_cast<int>(models.size())){
         std::ostringstream oss;
         int num_models = models.size();
         oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
         throw runtime_error(oss.str());
     }
-    return models[model_id]->model_manual_send(in_data, pstream_id,channel_first,timeout);
+    models[model_idx]->set_parallel_fmap_convert(num_threads);
 }
 
-// bool MxAcclMT::send_input(std::vector<uint8_t*> in_data, int model_id, int pstream_id, bool channel_first, int32_t timeout ){
-//     return models[model_id]->model_manual_send(in_data, pstream_id,channel_first,timeout);
-// }
+bool MxAcclMT::run(std::vector<float *> in_data, std::vector<float*> &out_data, int pmodel_id, int pstream_id, int dfp_id, bool in_channel_first, bool out_channel_first, int32_t timeout){
+    return models[get_model_index(pmodel_id, dfp_id)]->manual_run(in_data,out_data,pstream_id,in_channel_first,out_channel_first,timeout);
+}
 
-bool MxAcclMT::receive_output(std::vector<float*> &out_data, int pmodel_id, int pstream_id, int dfp_id, bool channel_first, int32_t timeout){
-    //!!!!TODO: Need to use dfp_id for future
-    if(dfp_id!=0){
-        throw std::runtime_error("only one dfp per MxAccl allowed");
+std::future<bool> MxAcclMT::submit(std::vector<float *> in_data, std::vector<float*> out_data, int pmodel_id, int pstream_id, int dfp_id, bool in_channel_first, bool out_channel_first, int32_t timeout){
+    auto done = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = done->get_future();
+    bool sent = submit(in_data, out_data, pmodel_id, pstream_id, [done](bool ok, int){ done->set_value(ok); }, dfp_id, in_channel_first, out_channel_first, timeout);
+    if(!sent){
+        done->set_value(false);
     }
-    if(pmodel_id>= static_cast<int>(models.size())){
+    return result;
+}
+
+bool MxAcclMT::submit(std::vector<float *> in_data, std::vector<float*> out_data, int pmodel_id, int pstream_id, ModelBase::completion_callback_t on_done, int dfp_id, bool in_channel_first, bool out_channel_first, int32_t timeout){
+    return models[get_model_index(pmodel_id, dfp_id)]->model_manual_submit(in_data, out_data, pstream_id, in_channel_first, out_channel_first, timeout, on_done);
+}
+
+void MxAcclMT::set_freshest_only(int stream_id, bool enable, int model_id, int dfp_id){
+    models[get_model_index(model_id, dfp_id)]->model_manual_set_freshest(stream_id, enable);
+}
+
+uint64_t MxAcclMT::get_dropped_frames(int stream_id, int model_id, int dfp_id){
+    return models[get_model_index(model_id, dfp_id)]->model_manual_dropped_frames(stream_id);
+}
+
+void MxAcclMT::register_streams(const std::vector<int>& stream_ids, int model_id, int dfp_id){
+    models[get_model_index(model_id, dfp_id)]->model_manual_register_streams(stream_ids);
+}
+
+void MxAcclMT::set_max_streams(int max_streams, int model_id, int dfp_id){
+    models[get_model_index(model_id, dfp_id)]->set_max_streams(max_streams);
+}
+
+void MxAcclMT::set_dispatch_options(const MX::Types::DispatchOptions& options, int model_idx){
+    if(model_idx>= static_cast<int>(models.size())){
         std::ostringstream oss;
         int num_models = models.size();
         oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
         throw runtime_error(oss.str());
     }
-    return models[pmodel_id]->model_manual_receive(out_data, pstream_id, channel_first,timeout);
+    models[model_idx]->set_dispatch_options(options);
 }
 
-void MxAcclMT::set_parallel_fmap_convert(int num_threads, int model_idx){
+MX::Types::DispatchStats MxAcclMT::get_dispatch_stats(int model_idx){
     if(model_idx>= static_cast<int>(models.size())){
         std::ostringstream oss;
         int num_models = models.size();
         oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
         throw runtime_error(oss.str());
     }
-    models[model_idx]->set_parallel_fmap_convert(num_threads);
+    return models[model_idx]->get_dispatch_stats();
 }
 
-bool MxAcclMT::run(std::vector<float *> in_data, std::vector<float*> &out_data, int pmodel_id, int pstream_id, int dfp_id, bool in_channel_first, bool out_channel_first, int32_t timeout){
-    //!!!!TODO: Need to use dfp_id for future
-    if(dfp_id!=0){
-        throw std::runtime_error("only one dfp per MxAccl allowed");
+void MxAcclMT::set_failover_policy(const MX::Types::FailoverPolicy& policy, int dfp_id){
+    int first = get_model_index(0, dfp_id);
+    int end = (dfp_id + 1 < static_cast<int>(dfp_model_offset_.size())) ? dfp_model_offset_[dfp_id + 1] : static_cast<int>(models.size());
+    for(int i = first; i < end; ++i){
+        models[i]->set_failover_policy(policy);
     }
-    if(pmodel_id>= static_cast<int>(models.size())){
+    device_manager->get_context_health(dfp_id)->set_policy(policy);
+}
+
+std::vector<MX::Types::ContextHealth> MxAcclMT::get_context_health(int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    return device_manager->get_context_health_stats(dfp_id);
+}
+
+bool MxAcclMT::wait_context_recovery(int32_t timeout_ms, int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    return device_manager->get_context_health(dfp_id)->wait_recovery(timeout_ms);
+}
+
+void MxAcclMT::inject_context_fault(int context_idx, int count, int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    MX::Utils::context_health* health = device_manager->get_context_health(dfp_id);
+    if(context_idx < 0 || context_idx >= health->num_contexts()){
         std::ostringstream oss;
-        int num_models = models.size();
-        oss << "Invalid model ID passed : Number of models available = "<<num_models<<"\n model_id range is 0 to "<<num_models-1;
+        oss << "Invalid context index passed : Number of contexts of the dfp = "<<health->num_contexts()<<"\n context_idx range is 0 to "<<health->num_contexts()-1;
         throw runtime_error(oss.str());
     }
-    return models[pmodel_id]->manual_run(in_data,out_data,pstream_id,in_channel_first,out_channel_first,timeout);
+    health->inject_fault(context_idx, count);
+}
+
+void MxAcclMT::inject_download_fault(int count){
+    if(count < 1){
+        throw invalid_argument("number of download faults must be >= 1");
+    }
+    device_manager->inject_download_fault(count);
+}
+
+void MxAcclMT::set_power_policy(const MX::Types::PowerPolicy& policy, int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    //the governor thread keeps the models of the dfp, the models vector grows with later connects
+    int first = dfp_model_offset_[dfp_id];
+    int end = (dfp_id + 1 < static_cast<int>(dfp_model_offset_.size())) ? dfp_model_offset_[dfp_id + 1] : static_cast<int>(models.size());
+    std::vector<ModelBase*> dfp_models(models.begin() + first, models.begin() + end);
+    device_manager->set_power_policy(dfp_id, policy, dfp_models);
+}
+
+std::vector<MX::Types::DevicePowerStats> MxAcclMT::get_power_stats(int dfp_id){
+    if(dfp_id < 0 || dfp_id >= static_cast<int>(dfp_model_offset_.size())){
+        throw std::runtime_error("dfp is not connected.");
+    }
+    return device_manager->get_power_stats(dfp_id);
 }
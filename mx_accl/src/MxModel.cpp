@@ -1,7 +1,15 @@
 #include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
 #include <memx/accl/MxModel.h>
 #include <memx/accl/prepost.h>
 
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
 
 using namespace MX::Runtime;
 using namespace MX::Types;
@@ -10,13 +18,19 @@ using namespace MX::Utils;
 // template class MxModel<uint8_t>;
 template class MxModel<float>;
 
-#define VECTOR_INIT_BUFFER_LEN 500
+#define DEFAULT_MAX_MANUAL_STREAMS 500
+#define DEFAULT_MAX_STREAMS 64
 std::chrono::milliseconds INPUT_TASK_TIMEOUT = 500ms;
 
+static inline uint64_t elapsed_ns(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
 template <typename T>
-MxModel<T>::MxModel(int model_id, Dfp::DfpObject *dfp, const std::vector<int>* popen_contexts) : model_id_{model_id},
+MxModel<T>::MxModel(int model_id, Dfp::DfpObject *dfp, const std::vector<int>* popen_contexts, MX::Utils::context_health* health) : model_id_{model_id},
                                                                         dfp_{dfp},
-                                                                        open_contexts{popen_contexts}{
+                                                                        open_contexts{popen_contexts},
+                                                                        health_{health}{
 
     //Initate the model
     model_run.store(false);
@@ -24,6 +38,25 @@ MxModel<T>::MxModel(int model_id, Dfp::DfpObject *dfp, const std::vector<int>* p
     model_manual_run.store(false);
     model_manual_in_done = false;
     num_streams_=0;
+    pipeline_depth_ = 1;
+    requested_pipeline_depth_ = 1;
+    max_streams_ = 0;
+    stream_capacity_ = 0;
+    fresh_streams_.store(0);
+    fresh_pending_.store(0);
+    fresh_run_ = false;
+    send_done_ = false;
+    recv_timeout_ms_.store(0);
+    model_fresh_send_thread = NULL;
+    model_event_fd_ = -1;
+    event_fds_active_.store(false);
+    auto_tune_ = false;
+    tune_run_ = false;
+    model_tune_thread = NULL;
+    input_busy_ns_.store(0);
+    output_busy_ns_.store(0);
+    send_idle_ns_.store(0);
+    recv_blocked_ns_.store(0);
     parallel_fmap_convert_threads = 1;
     input_num_workers_ = 0;
     output_num_workers_ = 0;
@@ -42,8 +75,12 @@ MxModel<T>::MxModel(int model_id, Dfp::DfpObject *dfp, const std::vector<int>* p
     model_info.output_layer_names.reserve(num_op_ports);
     model_info.out_featuremap_shapes.reserve(num_op_ports);
     model_info.out_featuremap_sizes.reserve(num_op_ports);
-    context_send_current_index = 0;
     number_of_contexts = open_contexts->size();
+    dispatcher_.reset(number_of_contexts, 0);
+    manual_next_context_.store(0);
+    for(int ctx = 0; ctx < number_of_contexts; ++ctx){
+        manual_context_mutex.push_back(new std::mutex);
+    }
     
     
     for(int ip = 0; ip<num_in_ports ; ++ip){
@@ -79,14 +116,19 @@ MxModel<T>::MxModel(int model_id, Dfp::DfpObject *dfp, const std::vector<int>* p
 }
 
 template<typename T>
-void MxModel<T>::create_and_append_in_fm(){
+void MxModel<T>::create_and_append_in_fm(int slot){
     if(!pre_model_path.empty()){
         PrePost* temp_model = mx_create_prepost(pre_model_path);
         if(temp_model == nullptr){
             throw(std::runtime_error("The given post-processing model has dynamic output size. Please provide the largest \
                                             possible size of output in the second argument of connect_post_model()"));
         }
-        pre_model.push_back(temp_model);
+        if(slot < 0){
+            pre_model.push_back(temp_model);
+        }
+        else{
+            pre_model[slot] = temp_model;
+        }
     }
 
     if(!pre_model_path.empty()){
@@ -96,7 +138,12 @@ void MxModel<T>::create_and_append_in_fm(){
             t->fm_type = FM_PRE;
             temp_piv.push_back(t);
         }
-        pre_in_featuremaps_.push_back(temp_piv);
+        if(slot < 0){
+            pre_in_featuremaps_.push_back(temp_piv);
+        }
+        else{
+            pre_in_featuremaps_[slot] = temp_piv;
+        }
     }
 
     vector<FeatureMap<T> *> temp_v;
@@ -115,12 +162,18 @@ void MxModel<T>::create_and_append_in_fm(){
         FeatureMap<T>* t_in = new FeatureMap<T>(*t);
         temp_iv.push_back(t_in);
     }
-    in_featuremaps_.push_back(temp_v);
-    transposed_in_featuremaps_.push_back(temp_iv);
+    if(slot < 0){
+        in_featuremaps_.push_back(temp_v);
+        transposed_in_featuremaps_.push_back(temp_iv);
+    }
+    else{
+        in_featuremaps_[slot] = temp_v;
+        transposed_in_featuremaps_[slot] = temp_iv;
+    }
 }
 
 template<typename T>
-void MxModel<T>::create_and_append_out_fm(){
+void MxModel<T>::create_and_append_out_fm(int slot){
     vector<FeatureMap<float> *> temp_ov;
     vector<FeatureMap<float> *> temp_to;
     for (int k = 0; k < static_cast<int>(out_ports_.size()); ++k)
@@ -137,14 +190,25 @@ void MxModel<T>::create_and_append_out_fm(){
         FeatureMap<float> *t_out = new FeatureMap<float>(*t);
         temp_to.push_back(t_out);
     }
-    out_featuremaps_.push_back(temp_ov);
-    transposed_out_featuremaps_.push_back(temp_to);
+    if(slot < 0){
+        out_featuremaps_.push_back(temp_ov);
+        transposed_out_featuremaps_.push_back(temp_to);
+    }
+    else{
+        out_featuremaps_[slot] = temp_ov;
+        transposed_out_featuremaps_[slot] = temp_to;
+    }
     if(!post_model_path_.empty()){
         PrePost* temp_model = mx_create_prepost(post_model_path_);
         if(temp_model == nullptr){
             throw(std::runtime_error("Failed to create post procesing model"));
         }
-        post_model.push_back(temp_model);
+        if(slot < 0){
+            post_model.push_back(temp_model);
+        }
+        else{
+            post_model[slot] = temp_model;
+        }
     }
     if(!post_model_path_.empty()){
         vector<FeatureMap<float> *> temp_pov;
@@ -153,12 +217,103 @@ void MxModel<T>::create_and_append_out_fm(){
             t->fm_type = FM_POST;
             temp_pov.push_back(t);
         }
-        post_out_featuremaps_.push_back(temp_pov);
+        if(slot < 0){
+            post_out_featuremaps_.push_back(temp_pov);
+        }
+        else{
+            post_out_featuremaps_[slot] = temp_pov;
+        }
+    }
+}
+
+template<typename T>
+void MxModel<T>::release_slot(int slot){
+    if(in_featuremaps_[slot].empty()){
+        return;
+    }
+    if(!pre_model_path.empty()){
+        for(int k = 0; k < static_cast<int>(pre_model[slot]->get_input_sizes().size()); ++k)
+        delete pre_in_featuremaps_[slot][k];
+        pre_in_featuremaps_[slot].clear();
+        delete pre_model[slot];
+        pre_model[slot] = NULL;
+    }
+    for(int k = 0; k < static_cast<int>(in_ports_.size()); ++k){
+        delete in_featuremaps_[slot][k];
+        delete transposed_in_featuremaps_[slot][k];
+    }
+    in_featuremaps_[slot].clear();
+    transposed_in_featuremaps_[slot].clear();
+    for(int k = 0; k < static_cast<int>(out_ports_.size()); ++k){
+        delete out_featuremaps_[slot][k];
+        delete transposed_out_featuremaps_[slot][k];
+    }
+    out_featuremaps_[slot].clear();
+    transposed_out_featuremaps_[slot].clear();
+    if(!post_model_path_.empty()){
+        for(int k = 0; k < static_cast<int>(post_model[slot]->get_output_sizes().size()); ++k)
+        delete post_out_featuremaps_[slot][k];
+        post_out_featuremaps_[slot].clear();
+        delete post_model[slot];
+        post_model[slot] = NULL;
+    }
+}
+
+template<typename T>
+void MxModel<T>::reuse_kept_slots(int needed){
+    //All sets of a model are alike, so a kept set can serve any slot. The sets of detached
+    //streams are empty and the sets beyond the slots needed now are released
+    int kept = 0;
+    for(int i = 0; i < static_cast<int>(in_featuremaps_.size()); ++i){
+        if(in_featuremaps_[i].empty()){
+            continue;
+        }
+        if(kept >= needed){
+            release_slot(i);
+            continue;
+        }
+        if(i != kept){
+            std::swap(in_featuremaps_[i], in_featuremaps_[kept]);
+            std::swap(transposed_in_featuremaps_[i], transposed_in_featuremaps_[kept]);
+            std::swap(out_featuremaps_[i], out_featuremaps_[kept]);
+            std::swap(transposed_out_featuremaps_[i], transposed_out_featuremaps_[kept]);
+            if(!pre_model_path.empty()){
+                std::swap(pre_model[i], pre_model[kept]);
+                std::swap(pre_in_featuremaps_[i], pre_in_featuremaps_[kept]);
+            }
+            if(!post_model_path_.empty()){
+                std::swap(post_model[i], post_model[kept]);
+                std::swap(post_out_featuremaps_[i], post_out_featuremaps_[kept]);
+            }
+        }
+        //a stop past the drain deadline can leave a set waiting for its output callback
+        in_featuremaps_[kept][0]->set_in_ready(true);
+        out_featuremaps_[kept][0]->set_out_ready(true);
+        kept++;
+    }
+    in_featuremaps_.resize(kept);
+    transposed_in_featuremaps_.resize(kept);
+    out_featuremaps_.resize(kept);
+    transposed_out_featuremaps_.resize(kept);
+    if(!pre_model_path.empty()){
+        pre_model.resize(kept);
+        pre_in_featuremaps_.resize(kept);
+    }
+    if(!post_model_path_.empty()){
+        post_model.resize(kept);
+        post_out_featuremaps_.resize(kept);
+    }
+    if(kept > 0){
+        apply_convert_threads(parallel_fmap_convert_threads);
     }
 }
 
 template <typename T>
 void MxModel<T>::model_set_post(std::filesystem::path post_path, const std::vector<size_t>& post_out_sizelist){
+    //featureMaps kept by the last stop of auto threading were made for the previous post-processing model
+    if(!model_manual_run.load()){
+        reuse_kept_slots(0);
+    }
     post_model_path_ = post_path;
     post_out_size = post_out_sizelist;
     post_info_model = mx_create_prepost(post_model_path_,post_out_size);
@@ -206,6 +361,9 @@ void MxModel<T>::model_set_post(std::filesystem::path post_path, const std::vect
 
 template <typename T>
 void MxModel<T>::model_set_pre(std::filesystem::path pre_path){
+    if(!model_manual_run.load()){
+        reuse_kept_slots(0);
+    }
     pre_model_path = pre_path;
     pre_info_model = mx_create_prepost(pre_model_path);
     pre_info_model->match_names(model_info.input_layer_names,Process_Pre);
@@ -246,6 +404,267 @@ void MxModel<T>::set_num_workers(int input_workers, int output_workers){
     output_num_workers_ = output_workers;
 }        
 
+template <typename T>
+void MxModel<T>::set_pipeline_depth(int depth){
+    if(model_run.load()){
+        throw logic_error("pipeline depth cannot be changed while MxAccl is running");
+    }
+    if(depth < 1){
+        throw logic_error("pipeline depth must be a number >= 1");
+    }
+    requested_pipeline_depth_ = depth;
+    pipeline_depth_ = depth;
+}
+
+template <typename T>
+void MxModel<T>::set_max_streams(int max_streams){
+    if(model_run.load()){
+        throw logic_error("max streams cannot be changed while MxAccl is running");
+    }
+    if(max_streams < 1){
+        throw logic_error("max streams must be a number >= 1");
+    }
+    if(model_manual_run.load()){
+        //MxAcclMT starts the models on connect, the capacity can still change until the first stream is registered
+        std::lock_guard lock(fm_create_mutex);
+        if(stream_slots_.size() > 0){
+            throw logic_error("max streams cannot be changed once MxAcclMT streams are registered");
+        }
+        max_streams_ = max_streams;
+        stream_capacity_ = max_streams;
+        reserve_manual_streams();
+        return;
+    }
+    max_streams_ = max_streams;
+}
+
+template <typename T>
+void MxModel<T>::set_stop_policy(const MX::Types::StopPolicy& policy){
+    if(model_run.load()){
+        throw logic_error("stop policy cannot be changed while MxAccl is running");
+    }
+    if(policy.drain_timeout_ms < 0){
+        throw invalid_argument("drain timeout must be a number >= 0");
+    }
+    stop_policy_ = policy;
+}
+
+template <typename T>
+void MxModel<T>::set_schedule_policy(MX::Types::StreamSchedulePolicy policy){
+    if(model_run.load()){
+        throw logic_error("schedule policy cannot be changed while MxAccl is running");
+    }
+    if(policy < SCHEDULE_FIFO || policy > SCHEDULE_DEADLINE){
+        throw invalid_argument("invalid schedule policy");
+    }
+    stream_queue.set_policy(policy);
+}
+
+template <typename T>
+void MxModel<T>::set_dispatch_options(const MX::Types::DispatchOptions& options){
+    if(model_run.load()){
+        throw logic_error("dispatch options cannot be changed while MxAccl is running");
+    }
+    if(options.policy < DISPATCH_ROUND_ROBIN || options.policy > DISPATCH_LEAST_OUTSTANDING){
+        throw invalid_argument("invalid dispatch policy");
+    }
+    //manual threading reads the options per frame, they can change while MxAcclMT is running
+    dispatcher_.set_options(options);
+}
+
+template <typename T>
+void MxModel<T>::set_failover_policy(const MX::Types::FailoverPolicy& policy){
+    if(model_run.load()){
+        throw logic_error("failover policy cannot be changed while MxAccl is running");
+    }
+    if(policy.recv_timeout_ms < 0 || policy.max_recovery_attempts < 0 || policy.recovery_backoff_ms < 0){
+        throw invalid_argument("failover timeout, attempts and backoff must be numbers >= 0");
+    }
+    //manual threading runs from connect, its recv thread reads the timeout per frame
+    failover_policy_ = policy;
+    recv_timeout_ms_.store(policy.recv_timeout_ms);
+}
+
+template <typename T>
+int MxModel<T>::get_queued_frames(){
+    return static_cast<int>(stream_queue.size());
+}
+
+template <typename T>
+void MxModel<T>::add_contexts(MX::Utils::context_health* health){
+    if(model_run.load() || model_manual_run.load()){
+        throw logic_error("contexts cannot be added while the model is running");
+    }
+    number_of_contexts = open_contexts->size();
+    dispatcher_.reset(number_of_contexts, stream_capacity_);
+    while(static_cast<int>(manual_context_mutex.size()) < number_of_contexts){
+        manual_context_mutex.push_back(new std::mutex);
+    }
+    health_ = health;
+}
+
+template <typename T>
+MX::Types::DispatchStats MxModel<T>::get_dispatch_stats(){
+    return dispatcher_.stats();
+}
+
+template <typename T>
+bool MxModel<T>::get_stream_stats(int stream_id, MX::Types::StreamStats& stats){
+    std::lock_guard lock(streams_mutex);
+    for(int i = 0; i < static_cast<int>(stream_id_list.size()); ++i){
+        if(stream_live_[i] && stream_id_list[i] == stream_id){
+            //Streams have no statistics until the model is started
+            if(i < static_cast<int>(stream_queue.num_streams())){
+                stats = stream_queue.stats(i);
+            }
+            else{
+                stats = MX::Types::StreamStats();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+void MxModel<T>::set_thread_policy(const MX::Types::ThreadPolicy& policy){
+    if(model_run.load()){
+        throw logic_error("thread policy cannot be changed while MxAccl is running");
+    }
+    validate_thread_placement(policy.input_workers);
+    validate_thread_placement(policy.output_workers);
+    validate_thread_placement(policy.send);
+    validate_thread_placement(policy.recv);
+    thread_policy_ = policy;
+}
+
+template <typename T>
+void MxModel<T>::set_auto_tune(bool enable, const MX::Types::AutoTuneConfig& config){
+    if(model_run.load()){
+        throw logic_error("auto tune cannot be changed while MxAccl is running");
+    }
+    if(config.min_input_workers < 1 || config.min_output_workers < 1 || config.min_convert_threads < 1){
+        throw invalid_argument("auto tune lower bounds must be numbers >= 1");
+    }
+    if((config.max_input_workers != 0 && config.max_input_workers < config.min_input_workers) ||
+       (config.max_output_workers != 0 && config.max_output_workers < config.min_output_workers) ||
+       (config.max_convert_threads != 0 && config.max_convert_threads < config.min_convert_threads)){
+        throw invalid_argument("auto tune upper bounds must be 0 or >= the lower bounds");
+    }
+    if(config.interval_ms < 1){
+        throw invalid_argument("auto tune interval must be a number >= 1");
+    }
+    auto_tune_ = enable;
+    tune_config_ = config;
+}
+
+template <typename T>
+void MxModel<T>::apply_convert_threads(int num_threads){
+    std::lock_guard lock(streams_mutex);
+    parallel_fmap_convert_threads = num_threads;
+    for(auto& slot : in_featuremaps_){
+        for(FeatureMap<T>* fmap : slot){
+            fmap->set_num_fmap_threads(num_threads);
+        }
+    }
+    for(auto& slot : out_featuremaps_){
+        for(FeatureMap<float>* fmap : slot){
+            fmap->set_num_fmap_threads(num_threads);
+        }
+    }
+}
+
+template <typename T>
+void MxModel<T>::model_tune_fun(){
+    set_thread_name("mx_tune_m" + std::to_string(model_id_));
+    //Work out the bounds, the upper bounds follow the defaults of model_start
+    int num_cpu_cores = std::thread::hardware_concurrency();
+    int num_models = meta_.num_models;
+    int max_in = tune_config_.max_input_workers > 0 ? min(tune_config_.max_input_workers, num_streams_) : num_streams_;
+    int max_out = tune_config_.max_output_workers > 0 ? min(tune_config_.max_output_workers, num_streams_) : num_streams_;
+    int max_convert = tune_config_.max_convert_threads > 0 ? tune_config_.max_convert_threads : max(1, num_cpu_cores/(2*num_models));
+    int min_in = min(tune_config_.min_input_workers, max_in);
+    int min_out = min(tune_config_.min_output_workers, max_out);
+    int min_convert = min(tune_config_.min_convert_threads, max_convert);
+
+    int in_workers = std::clamp(input_num_workers_, min_in, max_in);
+    int out_workers = std::clamp(output_num_workers_, min_out, max_out);
+    int convert_threads = std::clamp(parallel_fmap_convert_threads, min_convert, max_convert);
+    input_pool->resize(in_workers);
+    output_pool->resize(out_workers);
+    apply_convert_threads(convert_threads);
+
+    uint64_t last_in_busy = input_busy_ns_.load();
+    uint64_t last_out_busy = output_busy_ns_.load();
+    uint64_t last_send_idle = send_idle_ns_.load();
+    uint64_t last_recv_blocked = recv_blocked_ns_.load();
+    auto last_time = std::chrono::steady_clock::now();
+
+    while(true){
+        {
+            std::unique_lock lock(tune_mutex);
+            tune_cv.wait_for(lock, std::chrono::milliseconds(tune_config_.interval_ms), [this]{ return !this->tune_run_; });
+            if(!tune_run_){
+                break;
+            }
+        }
+        double period = static_cast<double>(elapsed_ns(last_time));
+        last_time = std::chrono::steady_clock::now();
+        uint64_t in_busy_ns = input_busy_ns_.load();
+        uint64_t out_busy_ns = output_busy_ns_.load();
+        uint64_t send_idle_ns = send_idle_ns_.load();
+        uint64_t recv_blocked_ns = recv_blocked_ns_.load();
+
+        //Share of the period input/output workers spent in callbacks, the send thread spent
+        //waiting for inputs (MXA starved) and the recv threads spent waiting for output callbacks
+        double in_busy = (in_busy_ns - last_in_busy) / (period * in_workers);
+        double out_busy = (out_busy_ns - last_out_busy) / (period * out_workers);
+        double send_idle = (send_idle_ns - last_send_idle) / period;
+        double recv_blocked = (recv_blocked_ns - last_recv_blocked) / (period * number_of_contexts);
+        last_in_busy = in_busy_ns;
+        last_out_busy = out_busy_ns;
+        last_send_idle = send_idle_ns;
+        last_recv_blocked = recv_blocked_ns;
+
+        std::ostringstream reason;
+        reason << std::fixed << std::setprecision(0) << "(input busy " << in_busy*100 << "%, output busy " << out_busy*100
+               << "%, MXA waiting for input " << send_idle*100 << "%, MXA waiting for output " << recv_blocked*100 << "%)";
+
+        //Input side: grow workers first, then conversion threads once every stream has a worker
+        if(send_idle > 0.10 && in_busy > 0.75){
+            if(in_workers < max_in){
+                std::cout << "MxAccl auto tune model " << model_id_ << ": input workers " << in_workers << " -> " << in_workers+1 << " " << reason.str() << std::endl;
+                input_pool->resize(++in_workers);
+            }
+            else if(convert_threads < max_convert){
+                std::cout << "MxAccl auto tune model " << model_id_ << ": conversion threads " << convert_threads << " -> " << convert_threads+1 << " " << reason.str() << std::endl;
+                apply_convert_threads(++convert_threads);
+            }
+        }
+        else if(in_busy < 0.25 && in_workers > min_in){
+            std::cout << "MxAccl auto tune model " << model_id_ << ": input workers " << in_workers << " -> " << in_workers-1 << " " << reason.str() << std::endl;
+            input_pool->resize(--in_workers);
+        }
+        else if(send_idle < 0.02 && in_busy < 0.50 && convert_threads > min_convert){
+            std::cout << "MxAccl auto tune model " << model_id_ << ": conversion threads " << convert_threads << " -> " << convert_threads-1 << " " << reason.str() << std::endl;
+            apply_convert_threads(--convert_threads);
+        }
+
+        //Output side
+        if(recv_blocked > 0.10 && out_busy > 0.75 && out_workers < max_out){
+            std::cout << "MxAccl auto tune model " << model_id_ << ": output workers " << out_workers << " -> " << out_workers+1 << " " << reason.str() << std::endl;
+            output_pool->resize(++out_workers);
+        }
+        else if(out_busy < 0.25 && out_workers > min_out){
+            std::cout << "MxAccl auto tune model " << model_id_ << ": output workers " << out_workers << " -> " << out_workers-1 << " " << reason.str() << std::endl;
+            output_pool->resize(--out_workers);
+        }
+    }
+    //The next start resumes from the tuned worker counts
+    input_num_workers_ = in_workers;
+    output_num_workers_ = out_workers;
+}
+
 template <typename T>
 void MxModel<T>::set_parallel_fmap_convert(int num_threads){
     if(num_threads < 2){
@@ -256,38 +675,96 @@ void MxModel<T>::set_parallel_fmap_convert(int num_threads){
 }        
 
 template <typename T>
-void MxModel<T>::model_start(){
-    //Create input vector of featureMaps for all streams
-    if(!pre_model_path.empty()){
-        for (int n = 0; n < num_streams_; ++n){
-            pre_model.push_back(mx_create_prepost(pre_model_path));
-            if(pre_model[n] == nullptr){
-                throw(std::runtime_error("The given post-processing model has dynamic output size. Please provide the largest \
-                                                possible size of output in the second argument of connect_post_model()"));
-            }
+void MxModel<T>::model_prepare(){
+    //A freshest_only stream needs a second slot to hold the new frame while the previous one is queued.
+    //The depth is worked out again on every start, so it drops back once no stream is freshest_only
+    pipeline_depth_ = requested_pipeline_depth_;
+    for(const MX::Types::StreamOptions& options : stream_options_){
+        if(options.freshest_only && pipeline_depth_ < 2){
+            pipeline_depth_ = 2;
         }
     }
+    //featureMap sets kept by the last stop serve the first slots
+    reuse_kept_slots(num_streams_*pipeline_depth_);
 
-    for(int i=0; i<num_streams_; ++i){
+    //Create pipeline_depth_ sets of input and output featureMaps for all streams
+    //The sets of stream s are the slots s*pipeline_depth_ to (s+1)*pipeline_depth_-1
+    for(int i=static_cast<int>(in_featuremaps_.size()); i<num_streams_*pipeline_depth_; ++i){
             create_and_append_in_fm();
             create_and_append_out_fm();
         }
+}
 
+template <typename T>
+void MxModel<T>::model_start(){
+    //no-op for the sets already made by an earlier model_prepare()
+    model_prepare();
+    //The per-stream vectors are read by the model threads without a lock, reserving them for the
+    //streams that can be attached while running keeps them from being reallocated under the threads
+    stream_capacity_ = max(max_streams_ > 0 ? max_streams_ : DEFAULT_MAX_STREAMS, num_streams_);
+    int capacity = stream_capacity_;
+    int num_slots = capacity*pipeline_depth_;
+    dispatcher_.reset(number_of_contexts, capacity);
+    in_featuremaps_.reserve(num_slots);
+    transposed_in_featuremaps_.reserve(num_slots);
+    out_featuremaps_.reserve(num_slots);
+    transposed_out_featuremaps_.reserve(num_slots);
+    pre_model.reserve(num_slots);
+    pre_in_featuremaps_.reserve(num_slots);
+    post_model.reserve(num_slots);
+    post_out_featuremaps_.reserve(num_slots);
+    comb_in_call.reserve(capacity);
+    comb_out_call.reserve(capacity);
+    stream_id_list.reserve(capacity);
+    pipeline_passthrough_.reserve(capacity);
+    pipeline_scratch_.reserve(capacity);
+    out_task_mutex.reserve(capacity);
+    out_task_cv.reserve(capacity);
+    stream_rings_.reserve(capacity);
+    free_streams_.clear();
+
+
+    input_thread_counter.store(num_streams_*pipeline_depth_);
+
+    if(thread_policy_.lock_memory){
+        bool locked = true;
+        for(int i = 0; i < num_streams_*pipeline_depth_; ++i){
+            for(FeatureMap<T>* fmap : in_featuremaps_[i]){
+                locked = fmap->lock_buffers() && locked;
+            }
+            for(FeatureMap<float>* fmap : out_featuremaps_[i]){
+                locked = fmap->lock_buffers() && locked;
+            }
+        }
+        if(!locked){
+            std::cerr<<"Warning!! Could not mlock all featureMap buffers, check RLIMIT_MEMLOCK (ulimit -l)"<<std::endl;
+        }
+    }
 
-    input_thread_counter.store(num_streams_);
-
+    stream_queue.clear();
     for(int i = 0; i< num_streams_;++i){
+        stream_queue.add_stream(stream_options_[i]);
         out_task_mutex.push_back(new std::mutex);
         out_task_cv.push_back(new std::condition_variable);
+        stream_ring* ring = new stream_ring;
+        ring->out_read.assign(pipeline_depth_, false);
+        stream_rings_.push_back(ring);
     }
 
     //starting the model by setting the corresponding flags to true
+    send_done_ = false;
     model_run.store(true);
     model_recv_run.store(true);
 
-    //Create and start model threads
+    //Create and start model threads, one recv thread per context so a slow
+    //context doesn't hold back outputs that are already ready on the others
     model_send_thread = new std::thread(&MxModel<T>::model_send_fun, this);
-    model_recv_thread = new std::thread(&MxModel<T>::model_recv_fun, this);
+    for(int ctx = 0; ctx < number_of_contexts; ++ctx){
+        context_recvs_.push_back(new context_recv);
+    }
+    for(int ctx = 0; ctx < number_of_contexts; ++ctx){
+        context_recvs_[ctx]->thread = new std::thread(&MxModel<T>::model_recv_fun, this, ctx);
+    }
 
     int num_cpu_cores = std::thread::hardware_concurrency();
     int num_models = meta_.num_models;
@@ -307,109 +784,130 @@ void MxModel<T>::model_start(){
         std::cout<<"Warning!! Output number of workers are set to be more than number of streams. \
                                 \n Default mode is activated and num workers is set to num streams"<<std::endl;
     }
-    input_pool = new thread_pool("input_pool", input_num_workers_,true,num_streams_);
-    output_pool = new thread_pool("output_pool",output_num_workers_,false,num_streams_);
+    //A model started by attach_stream has a single stream, it still needs a worker per pool
+    input_num_workers_ = max(input_num_workers_, 1);
+    output_num_workers_ = max(output_num_workers_, 1);
+    input_pool = new thread_pool("input_pool", input_num_workers_,true,capacity,[this](size_t index){
+        set_thread_name("mx_in_m" + std::to_string(model_id_) + "_" + std::to_string(index));
+        apply_thread_placement(thread_policy_.input_workers);
+    });
+    output_pool = new thread_pool("output_pool",output_num_workers_,false,capacity,[this](size_t index){
+        set_thread_name("mx_out_m" + std::to_string(model_id_) + "_" + std::to_string(index));
+        apply_thread_placement(thread_policy_.output_workers);
+    });
 
     for(int i = 0; i<num_streams_; ++i){
-        vector<const FeatureMap<T>*> temp(in_featuremaps_[i].begin(),in_featuremaps_[i].end());
-        input_pool->submitTask(&MxModel<T>::inputTask,this,comb_in_call[i],std::move(temp),std::move(i),stream_id_list[i]);
+        //pipeline streams are filled by the output workers of their upstream model
+        if(!comb_in_call[i]){
+            continue;
+        }
+        input_pool->submitTask(&MxModel<T>::inputTask,this,comb_in_call[i],std::move(i),stream_id_list[i]);
+    }
+
+    if(auto_tune_){
+        tune_run_ = true;
+        model_tune_thread = new std::thread(&MxModel<T>::model_tune_fun, this);
     }
 }
 
 template <typename T>
-void MxModel<T>::_pre_copy(int stream){
-    if(pre_model[stream]->type==Plugin_Onnx){
+void MxModel<T>::_pre_copy(int slot){
+    if(pre_model[slot]->type==Plugin_Onnx){
         for(int i =0; i<(int)pre_info_model->real_featuremaps.size();++i){
-            pre_in_featuremaps_[stream].push_back(transposed_in_featuremaps_[stream][pre_info_model->real_featuremaps[i]]);
+            pre_in_featuremaps_[slot].push_back(transposed_in_featuremaps_[slot][pre_info_model->real_featuremaps[i]]);
         }
     }
     else{
         for(int i =0; i<(int)pre_info_model->real_featuremaps.size();++i){
-            pre_in_featuremaps_[stream].push_back(in_featuremaps_[stream][pre_info_model->real_featuremaps[i]]);
+            pre_in_featuremaps_[slot].push_back(in_featuremaps_[slot][pre_info_model->real_featuremaps[i]]);
         }                
     }
 }
 
 template <typename T>
-void MxModel<T>::_pre_inference(int stream){
+void MxModel<T>::_pre_inference(int slot){
     vector<FeatureMap<T>*> premuted_output;
-    if(pre_model[stream]->type==Plugin_Onnx){
+    if(pre_model[slot]->type==Plugin_Onnx){
         for(int i =0;i<(int)pre_info_model->dfp_pattern.size();++i){
-            premuted_output.push_back(transposed_in_featuremaps_[stream][pre_info_model->dfp_pattern[i]]);
+            premuted_output.push_back(transposed_in_featuremaps_[slot][pre_info_model->dfp_pattern[i]]);
         }
-        pre_model[stream]->runinference(pre_in_featuremaps_[stream],premuted_output);
+        pre_model[slot]->runinference(pre_in_featuremaps_[slot],premuted_output);
         for(int i=0; i<model_info.num_in_featuremaps;++i)
-        in_featuremaps_[stream][i]->set_data(transposed_in_featuremaps_[stream][i]->get_data_ptr(),true);
+        in_featuremaps_[slot][i]->set_data(transposed_in_featuremaps_[slot][i]->get_data_ptr(),true);
     }
     else{
         for(int i =0;i<(int)pre_info_model->dfp_pattern.size();++i){
-            premuted_output.push_back(in_featuremaps_[stream][pre_info_model->dfp_pattern[i]]);
+            premuted_output.push_back(in_featuremaps_[slot][pre_info_model->dfp_pattern[i]]);
         }
-        pre_model[stream]->runinference(pre_in_featuremaps_[stream],premuted_output);
+        pre_model[slot]->runinference(pre_in_featuremaps_[slot],premuted_output);
     }
 }
 
 
 template <typename T>
-void MxModel<T>::_post_inference(int stream){
+void MxModel<T>::_post_inference(int slot){
     std::vector<FeatureMap<float>* > premuted_output;
-    if(post_model[stream]->type == Plugin_Onnx){
+    if(post_model[slot]->type == Plugin_Onnx){
         for(int i=0; i< model_info.num_out_featuremaps; ++i){
-            out_featuremaps_[stream][i]->get_data(transposed_out_featuremaps_[stream][i]->get_data_ptr(),true);
+            out_featuremaps_[slot][i]->get_data(transposed_out_featuremaps_[slot][i]->get_data_ptr(),true);
         }
-        if(post_model[stream]->dynamic_output){
+        if(post_model[slot]->dynamic_output){
             for(int m =0 ;m < static_cast<int>(post_out_size.size());++m)
-            memset(post_out_featuremaps_[stream][m]->get_data_ptr(),0,post_out_size[m]*sizeof(float));
+            memset(post_out_featuremaps_[slot][m]->get_data_ptr(),0,post_out_size[m]*sizeof(float));
         }
         for(int i =0; i< (int)post_info_model->dfp_pattern.size();++i){
-            premuted_output.push_back(transposed_out_featuremaps_[stream][post_info_model->dfp_pattern[i]]);
+            premuted_output.push_back(transposed_out_featuremaps_[slot][post_info_model->dfp_pattern[i]]);
         }
-        post_model[stream]->runinference(premuted_output,post_out_featuremaps_[stream]);
+        post_model[slot]->runinference(premuted_output,post_out_featuremaps_[slot]);
         for(int i =0; i< (int)post_info_model->real_featuremaps.size();++i){
-            transposed_out_featuremaps_[stream][post_info_model->real_featuremaps[i]]->fm_type = FM_POST;
-            post_out_featuremaps_[stream].push_back(transposed_out_featuremaps_[stream][post_info_model->real_featuremaps[i]]);
+            transposed_out_featuremaps_[slot][post_info_model->real_featuremaps[i]]->fm_type = FM_POST;
+            post_out_featuremaps_[slot].push_back(transposed_out_featuremaps_[slot][post_info_model->real_featuremaps[i]]);
         }
     }
     else{
-        if(post_model[stream]->dynamic_output){
+        if(post_model[slot]->dynamic_output){
             for(int m =0 ;m < static_cast<int>(post_out_size.size());++m)
-            memset(post_out_featuremaps_[stream][m]->get_data_ptr(),0,post_out_size[m]*sizeof(float));
+            memset(post_out_featuremaps_[slot][m]->get_data_ptr(),0,post_out_size[m]*sizeof(float));
         }
         for(int i =0; i< (int)post_info_model->dfp_pattern.size();++i){
-            premuted_output.push_back(out_featuremaps_[stream][post_info_model->dfp_pattern[i]]);
+            premuted_output.push_back(out_featuremaps_[slot][post_info_model->dfp_pattern[i]]);
         }
-        post_model[stream]->runinference(premuted_output,post_out_featuremaps_[stream]);
+        post_model[slot]->runinference(premuted_output,post_out_featuremaps_[slot]);
         for(int i =0; i< (int)post_info_model->real_featuremaps.size();++i){
-            post_out_featuremaps_[stream].push_back(out_featuremaps_[stream][post_info_model->real_featuremaps[i]]);
+            post_out_featuremaps_[slot].push_back(out_featuremaps_[slot][post_info_model->real_featuremaps[i]]);
         }
     }
 }
 
 template <typename T>
-bool MxModel<T>::inputTask(combined_input_callback_t in_cb, vector<const FeatureMap<T>* >inputs,int stream, int stream_idx){
-    if(in_featuremaps_[stream][0]->get_in_ready()){
+bool MxModel<T>::inputTask(combined_input_callback_t in_cb, int stream, int stream_idx){
+    stream_ring* ring = stream_rings_[stream];
+    if(ring->detaching.load()){
+        finish_input(stream);
+        return false;
+    }
+    int slot = stream*pipeline_depth_ + ring->in_pos;
+    if(in_featuremaps_[slot][0]->get_in_ready()){
         bool send_flag = false;
+        auto busy_start = std::chrono::steady_clock::now();
         if(!pre_model_path.empty()){
-            _pre_copy(stream);
-            vector<const FeatureMap<T>*> temp(pre_in_featuremaps_[stream].begin(),pre_in_featuremaps_[stream].end());
+            _pre_copy(slot);
+            vector<const FeatureMap<T>*> temp(pre_in_featuremaps_[slot].begin(),pre_in_featuremaps_[slot].end());
             send_flag = in_cb(temp,stream_idx);
-            _pre_inference(stream);
+            _pre_inference(slot);
         }
         else{
-            send_flag = in_cb(inputs,stream_idx);
+            vector<const FeatureMap<T>*> temp(in_featuremaps_[slot].begin(),in_featuremaps_[slot].end());
+            send_flag = in_cb(temp,stream_idx);
         }
 
-        in_featuremaps_[stream][0]->set_in_ready(false);
+        in_featuremaps_[slot][0]->set_in_ready(false);
+        input_busy_ns_ += elapsed_ns(busy_start);
         if(!send_flag){
+            finish_input(stream);
             return false;
         }
-        stream_queue.push(stream);
-        input_thread_counter--;
-        {
-            std::unique_lock lock(input_task_mutex);
-            input_task_flag = true;
-            input_task_cv.notify_one();
-        }
+        enqueue_input(stream, slot);
     }
     else{
         std::unique_lock lock(input_thread_mutex);
@@ -420,32 +918,189 @@ bool MxModel<T>::inputTask(combined_input_callback_t in_cb, vector<const Feature
 }
 
 template <typename T>
-bool MxModel<T>::outputTask(combined_output_callback_t out_cb, vector<const FeatureMap<float>* >outputs,int stream, int stream_idx){
+void MxModel<T>::enqueue_input(int stream, int slot){
+    stream_ring* ring = stream_rings_[stream];
+    ring->in_pos = (ring->in_pos + 1) % pipeline_depth_;
+    frame_ticket ticket{};
+    ticket.stream = stream;
+    ticket.in_slot = slot;
+    ring->enqueued++;
+    std::optional<frame_ticket> dropped = stream_queue.push(stream, ticket);
+    input_thread_counter--;
+    if(dropped){
+        ring->enqueued--;
+        //A freshest_only stream replaced a frame that wasn't sent yet, its slot is free again
+        in_featuremaps_[dropped->in_slot][0]->set_in_ready(true);
+        std::unique_lock lock(input_thread_mutex);
+        input_thread_counter++;
+        input_thread_cv.notify_all();
+    }
+    {
+        std::unique_lock lock(input_task_mutex);
+        input_task_flag = true;
+        input_task_cv.notify_one();
+    }
+}
+
+template <typename T>
+void MxModel<T>::finish_input(int stream){
+    {
+        std::unique_lock<std::mutex> lock(*out_task_mutex[stream]);
+        stream_rings_[stream]->input_done = true;
+    }
+    out_task_cv[stream]->notify_all();
+}
+
+template <typename T>
+bool MxModel<T>::pipeline_feed(int stream_id, const vector<const FeatureMap<float> *>& src){
+    int stream;
+    {
+        //pipeline streams may be attached and detached while the model runs
+        std::lock_guard lock(streams_mutex);
+        auto search = pipeline_streams_.find(stream_id);
+        if(search == pipeline_streams_.end()){
+            throw invalid_argument("pipeline_feed called with a stream that is not a pipeline stream of this model");
+        }
+        stream = search->second;
+        //A detaching stream takes no more frames. Counted feeds hold detach_stream off the slots till they are enqueued
+        if(stream_rings_[stream]->detaching.load()){
+            return false;
+        }
+        stream_rings_[stream]->feeding++;
+    }
+    try{
+        bool fed = feed_slot(stream, src);
+        finish_feed(stream);
+        return fed;
+    }
+    catch(...){
+        finish_feed(stream);
+        throw;
+    }
+}
+
+template <typename T>
+void MxModel<T>::finish_feed(int stream){
+    {
+        std::unique_lock<std::mutex> lock(*out_task_mutex[stream]);
+        stream_rings_[stream]->feeding--;
+    }
+    out_task_cv[stream]->notify_all();
+}
+
+template <typename T>
+bool MxModel<T>::feed_slot(int stream, const vector<const FeatureMap<float> *>& src){
+    stream_ring* ring = stream_rings_[stream];
+    int slot = stream*pipeline_depth_ + ring->in_pos;
+    //Backpressure: the upstream output worker waits till the send stage frees the slot
+    {
+        std::unique_lock lock(input_thread_mutex);
+        input_thread_cv.wait(lock, [this, slot]{ return this->in_featuremaps_[slot][0]->get_in_ready() || !this->model_run.load(); });
+    }
+    if(!model_run.load()){
+        return false;
+    }
+
+    //Pipeline streams feed the DFP inputs directly, a pre-processing model of this model is not applied to them
+    auto busy_start = std::chrono::steady_clock::now();
+    vector<FeatureMap<T>*>& dst = in_featuremaps_[slot];
+    if(src.size() != dst.size()){
+        throw runtime_error("pipeline stream got " + std::to_string(src.size()) + " featureMaps from the upstream model but needs " + std::to_string(dst.size()));
+    }
+    vector<int>& passthrough = pipeline_passthrough_[stream];
+    passthrough.resize(dst.size(), -1);
+    for(size_t i = 0; i < dst.size(); ++i){
+        if(passthrough[i] < 0){
+            //The MXA produces the input as is when both ports agree on format and shape
+            passthrough[i] = (src[i]->fm_type == FM_DFP &&
+                              src[i]->get_format() == dst[i]->get_format() &&
+                              src[i]->get_formatted_size() == dst[i]->get_formatted_size() &&
+                              src[i]->shape() == dst[i]->shape()) ? 1 : 0;
+        }
+        if(passthrough[i] == 1){
+            std::memcpy(dst[i]->get_formatted_data(), src[i]->get_formatted_data(), dst[i]->get_formatted_size());
+        }
+        else{
+            if(src[i]->get_data_size() != dst[i]->get_data_size()){
+                throw runtime_error("pipeline stream input " + std::to_string(i) + " has a different size than the upstream output");
+            }
+            vector<float>& scratch = pipeline_scratch_[stream];
+            scratch.resize(std::max(scratch.size(), dst[i]->get_data_size()));
+            src[i]->get_data(scratch.data());
+            dst[i]->set_data(scratch.data());
+        }
+    }
+    in_featuremaps_[slot][0]->set_in_ready(false);
+    input_busy_ns_ += elapsed_ns(busy_start);
+    enqueue_input(stream, slot);
+    return true;
+}
+
+template <typename T>
+bool MxModel<T>::outputTask(combined_output_callback_t out_cb, int out_slot, int stream, int stream_idx){
+    auto busy_start = std::chrono::steady_clock::now();
     if(!post_model_path_.empty()){
-        _post_inference(stream);
-        vector<const FeatureMap<float>*> temp(post_out_featuremaps_[stream].begin(),post_out_featuremaps_[stream].end());
+        _post_inference(out_slot);
+        vector<const FeatureMap<float>*> temp(post_out_featuremaps_[out_slot].begin(),post_out_featuremaps_[out_slot].end());
         out_cb(temp,stream_idx);
         for(int i =0; i< (int)post_info_model->real_featuremaps.size();++i){
-            transposed_out_featuremaps_[stream][post_info_model->real_featuremaps[i]]->fm_type = FM_DFP;
+            transposed_out_featuremaps_[out_slot][post_info_model->real_featuremaps[i]]->fm_type = FM_DFP;
         }
     }
     else{
-        out_cb(outputs,stream_idx);
-    }    
+        vector<const FeatureMap<float>*> temp(out_featuremaps_[out_slot].begin(),out_featuremaps_[out_slot].end());
+        out_cb(temp,stream_idx);
+    }
+    output_busy_ns_ += elapsed_ns(busy_start);
     {
         std::unique_lock<std::mutex> lock(*out_task_mutex[stream]);
-        out_featuremaps_[stream][0]->set_out_ready(true);
+        out_featuremaps_[out_slot][0]->set_out_ready(true);
+        stream_rings_[stream]->released++;
+        stream_rings_[stream]->out_busy = false;
     }
-    out_task_cv[stream]->notify_one();
+    out_task_cv[stream]->notify_all();
+    dispatch_output(stream);
     return true;
 }
 
+template <typename T>
+void MxModel<T>::dispatch_output(int stream){
+    //Output callbacks of a stream run one at a time and in send order, the next
+    //one is handed to the output pool once the previous one has returned
+    int out_slot;
+    {
+        std::unique_lock<std::mutex> lock(*out_task_mutex[stream]);
+        stream_ring* ring = stream_rings_[stream];
+        //frames lost on a failed context have no output, the next frame takes their turn
+        bool skipped = false;
+        while(!ring->out_busy && ring->failed.erase(ring->dispatched) > 0){
+            ring->dispatched++;
+            ring->released++;
+            skipped = true;
+        }
+        if(skipped){
+            out_task_cv[stream]->notify_all();
+        }
+        int pos = ring->dispatched % pipeline_depth_;
+        if(ring->out_busy || !ring->out_read[pos]){
+            return;
+        }
+        ring->out_read[pos] = false;
+        ring->out_busy = true;
+        ring->dispatched++;
+        out_slot = stream*pipeline_depth_ + pos;
+    }
+    output_pool->submitTask(&MxModel<T>::outputTask,this,comb_out_call[stream],std::move(out_slot),std::move(stream),stream_id_list[stream]);
+}
+
 template <typename T>
 void MxModel<T>::create_append_manual_mem(){
     manual_recv_mutex.push_back(new std::mutex);
     manual_recv_cv.push_back(new std::condition_variable);
     manual_recv_task_mutex.push_back(new std::mutex);
     manual_recv_task_cv.push_back(new std::condition_variable);
+    manual_recv_failed_.push_back(new std::atomic_bool(false));
+    manual_batch_rings_.push_back(new batch_ring);
 }
 
 // Manual threading model start to init model features and featureMap
@@ -456,18 +1111,30 @@ void MxModel<T>::model_manual_start(){
     model_run.store(false);
     model_recv_run.store(false);
     model_manual_run.store(true);
-    out_featuremaps_.reserve(VECTOR_INIT_BUFFER_LEN);
-    in_featuremaps_.reserve(VECTOR_INIT_BUFFER_LEN);
-    post_model.reserve(VECTOR_INIT_BUFFER_LEN);
-    pre_model.reserve(VECTOR_INIT_BUFFER_LEN);
-    post_out_featuremaps_.reserve(VECTOR_INIT_BUFFER_LEN);
-    pre_in_featuremaps_.reserve(VECTOR_INIT_BUFFER_LEN);
-    transposed_in_featuremaps_.reserve(VECTOR_INIT_BUFFER_LEN);
-    transposed_out_featuremaps_.reserve(VECTOR_INIT_BUFFER_LEN);
-    manual_recv_cv.reserve(VECTOR_INIT_BUFFER_LEN);
-    manual_recv_mutex.reserve(VECTOR_INIT_BUFFER_LEN);
-    manual_recv_task_cv.reserve(VECTOR_INIT_BUFFER_LEN);
-    manual_recv_task_mutex.reserve(VECTOR_INIT_BUFFER_LEN);
+    stream_capacity_ = max_streams_ > 0 ? max_streams_ : DEFAULT_MAX_MANUAL_STREAMS;
+    reserve_manual_streams();
+}
+
+// The per-stream vectors and the slot table are read by the send, receive and recv threads without a lock,
+// they are sized once for the capacity so that registering a stream never reallocates them
+template <typename T>
+void MxModel<T>::reserve_manual_streams(){
+    out_featuremaps_.reserve(stream_capacity_);
+    in_featuremaps_.reserve(stream_capacity_);
+    post_model.reserve(stream_capacity_);
+    pre_model.reserve(stream_capacity_);
+    post_out_featuremaps_.reserve(stream_capacity_);
+    pre_in_featuremaps_.reserve(stream_capacity_);
+    transposed_in_featuremaps_.reserve(stream_capacity_);
+    transposed_out_featuremaps_.reserve(stream_capacity_);
+    manual_recv_cv.reserve(stream_capacity_);
+    manual_recv_mutex.reserve(stream_capacity_);
+    manual_recv_task_cv.reserve(stream_capacity_);
+    manual_recv_task_mutex.reserve(stream_capacity_);
+    manual_recv_failed_.reserve(stream_capacity_);
+    manual_batch_rings_.reserve(stream_capacity_);
+    stream_slots_.reset(stream_capacity_);
+    dispatcher_.reset(number_of_contexts, stream_capacity_);
 }
 
 template <typename T>
@@ -475,6 +1142,11 @@ int MxModel<T>::get_num_streams(){
     return num_streams_;
 }
 
+template <typename T>
+bool MxModel<T>::model_running(){
+    return model_run.load();
+}
+
 template< typename T>
 void MxModel<T>::model_wait(){
     if(!model_run.load()){
@@ -490,35 +1162,88 @@ void MxModel<T>::model_stop()
     if(!model_run.load()){
         throw logic_error("Model stop called when model is not running");
     }
+    //The controller is stopped first so the pools are not resized while stopping
+    if(model_tune_thread != NULL){
+        {
+            std::lock_guard lock(tune_mutex);
+            tune_run_ = false;
+        }
+        tune_cv.notify_one();
+        model_tune_thread->join();
+        delete model_tune_thread;
+        model_tune_thread = NULL;
+    }
     //Stop signal for model
     input_pool->stop();
     model_run.store(false);
     input_task_cv.notify_one();
+    {
+        //wake upstream models waiting to feed a pipeline stream
+        std::unique_lock lock(input_thread_mutex);
+        input_thread_cv.notify_all();
+    }
 
     //waiting for model threads to be done
     model_send_thread->join();
-    //stopping the model recv thread
+    //stopping the model recv threads
     model_recv_run.store(false);
-    model_recv_cv.notify_one();
-    model_recv_thread->join();
-    //Giving the recv stream threads to finish iteration before last iteration
-    for(int i =0;i<num_streams_;++i){
-        while(!out_featuremaps_[i][0]->get_out_ready())
+    for(context_recv* recv : context_recvs_){
         {
-            this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::unique_lock lock(recv->mutex);
+            recv->flag = true;
         }
+        recv->cv.notify_one();
+        recv->thread->join();
+    }
+    //Outputs already read by the recv threads go through their output callbacks, outputTask
+    //notifies the stream when it sets out_ready. Outputs still pending at the deadline are dropped
+    int num_slots = static_cast<int>(out_featuremaps_.size());
+    int live_slot = -1;
+    bool drained = true;
+    auto drain_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(stop_policy_.drain_timeout_ms);
+    for(int stream = 0; stream < static_cast<int>(stream_rings_.size()); ++stream){
+        int first = stream*pipeline_depth_;
+        //Slots of detached streams are empty
+        if(out_featuremaps_[first].empty()){
+            continue;
+        }
+        live_slot = (live_slot < 0) ? first : live_slot;
+        std::unique_lock<std::mutex> lock(*out_task_mutex[stream]);
+        drained = out_task_cv[stream]->wait_until(lock, drain_deadline, [this, first]{
+            for(int pos = 0; pos < this->pipeline_depth_; ++pos){
+                if(!this->out_featuremaps_[first+pos][0]->get_out_ready()){
+                    return false;
+                }
+            }
+            return true;
+        }) && drained;
+    }
+    if(!drained){
+        std::cerr<<"Warning!! Model "<<model_id_<<" stopped with outputs that didn't reach the output callback within "
+                 <<stop_policy_.drain_timeout_ms<<" ms, they are dropped"<<std::endl;
     }
     output_pool->stop();
 
-    for(int i =0;i<num_streams_;++i){
+    for(int i =0;i<static_cast<int>(stream_rings_.size());++i){
         delete out_task_cv[i];
         delete out_task_mutex[i];
+        delete stream_rings_[i];
     }
     out_task_cv.clear();
     out_task_mutex.clear();
+    stream_rings_.clear();
 
     //Flushing the MPU (Sake of sanity and shouldn't be required if everything goes as intended)
-    if(num_streams_>0){
+    //The recv threads have read the ofmaps of every sent frame, so a drained model only needs a short timeout
+    if(live_slot>=0){
+        size_t blob_size = 0;
+        for (int i = 0; i < static_cast<int>(out_ports_.size()); ++i){
+            blob_size = max(blob_size, out_featuremaps_[live_slot][i]->get_formatted_size());
+        }
+        if(flush_scratch_.size() < blob_size){
+            flush_scratch_.resize(blob_size);
+        }
+        int flush_timeout = drained ? 1 : 100;
         for(int ctx = 0; ctx < number_of_contexts; ctx++){
 
             int context_id = open_contexts->at(ctx);
@@ -527,14 +1252,11 @@ void MxModel<T>::model_stop()
             while(status==MEMX_STATUS_OK){
                 for (int i = 0; i < static_cast<int>(out_ports_.size()); ++i)
                 {
-                    uint8_t* temp_blob = new uint8_t[out_featuremaps_[0][i]->get_formatted_size()];
-                    status = (memx_status) ((int)status | memx_stream_ofmap( context_id, out_ports_[i], temp_blob, 100));
+                    status = (memx_status) ((int)status | memx_stream_ofmap( context_id, out_ports_[i], flush_scratch_.data(), flush_timeout));
                     
                     if(memx_status_no_error(status)){
                         std::cerr<<"Entered flushing"<<std::endl;
                     }
-                    delete [] temp_blob;
-                    temp_blob = NULL;
                 }
             }
         }
@@ -547,54 +1269,40 @@ void MxModel<T>::model_stop()
     
     delete model_send_thread;
     model_send_thread = NULL;
-    delete model_recv_thread;
-    model_recv_thread = NULL;
+    for(context_recv* recv : context_recvs_){
+        delete recv->thread;
+        delete recv;
+    }
+    context_recvs_.clear();
 
-    //Deleting the created featureMaps
-    if(!pre_model_path.empty()){
-        for(int j = 0; j<num_streams_;++j){
-            for(int k = 0; k< static_cast<int>(pre_model[j]->get_input_sizes().size());++k)
-            delete pre_in_featuremaps_[j][k];
-            delete pre_model[j];
+    //Deleting the created featureMaps, unless they are kept for the next start
+    if(!stop_policy_.keep_buffers){
+        for(int j = 0; j<num_slots;++j){
+            release_slot(j);
         }
-        delete pre_info_model;
-        pre_in_featuremaps_.clear();
-    }
-    for (int j = 0; j < num_streams_; ++j)
-    {
-        for (int k = 0; k < static_cast<int>(in_ports_.size()); ++k)
-        {
-            delete in_featuremaps_[j][k];
-            in_featuremaps_[j][k] = NULL;
-            delete transposed_in_featuremaps_[j][k];
-            transposed_in_featuremaps_[j][k] = NULL;
+        if(!pre_model_path.empty()){
+            delete pre_info_model;
+            pre_in_featuremaps_.clear();
+            pre_model.clear();
         }
-        in_featuremaps_[j].clear();
-    }
-    in_featuremaps_.clear();
-    transposed_in_featuremaps_.clear();
-    for (int j = 0; j < num_streams_; ++j)
-    {
-        for (int k = 0; k < static_cast<int>(out_ports_.size()); ++k)
-        {
-            delete out_featuremaps_[j][k];
-            out_featuremaps_[j][k] = NULL;
-            delete transposed_out_featuremaps_[j][k];
-            transposed_out_featuremaps_[j][k] = NULL;
+        in_featuremaps_.clear();
+        transposed_in_featuremaps_.clear();
+        out_featuremaps_.clear();
+        transposed_out_featuremaps_.clear();
+        if(!post_model_path_.empty()){
+            delete post_info_model;
+            post_out_featuremaps_.clear();
+            post_model.clear();
         }
-        out_featuremaps_[j].clear();
     }
-    out_featuremaps_.clear();
-    transposed_out_featuremaps_.clear();
-    if(!post_model_path_.empty()){
-        for(int j = 0; j<num_streams_;++j){
-            for(int k = 0; k<static_cast<int>(post_model[j]->get_output_sizes().size());++k)
-            delete post_out_featuremaps_[j][k];
-            delete post_model[j];
+
+    //Streams detached while running are dropped, the next start only sees the connected ones
+    for(int i = static_cast<int>(stream_live_.size())-1; i>=0; --i){
+        if(!stream_live_[i]){
+            remove_stream_config(i);
         }
-        delete post_info_model;
-        post_out_featuremaps_.clear();
     }
+    free_streams_.clear();
 }
 
 template<typename T>
@@ -602,6 +1310,24 @@ void MxModel<T>::model_manual_stop(){
     if(!model_manual_run.load()){
          throw logic_error("Model stop called when model is not running");
     }
+    //Frames still waiting in the mailboxes of freshest streams are dropped
+    if(model_fresh_send_thread != NULL){
+        {
+            std::lock_guard lock(fresh_mutex);
+            fresh_run_ = false;
+        }
+        fresh_cv.notify_one();
+        model_fresh_send_thread->join();
+        delete model_fresh_send_thread;
+        model_fresh_send_thread = NULL;
+    }
+    for(auto& entry : fresh_mailboxes_){
+        delete entry.second;
+    }
+    fresh_mailboxes_.clear();
+    fresh_streams_.store(0);
+    fresh_pending_.store(0);
+
     model_manual_run.store(false);
     model_manual_cv.notify_one();
     for(int i =0; i<static_cast<int>(in_featuremaps_.size());++i){
@@ -611,21 +1337,49 @@ void MxModel<T>::model_manual_stop(){
     delete model_manual_recv_thread;
     model_manual_recv_thread = NULL;
 
+    //Submitted frames the recv thread did not get to are reported as failed
+    while(pair_stream_context_queue.size() > 0){
+        frame_ticket ticket = pair_stream_context_queue.pop();
+        if(ticket.completion != NULL){
+            fail_manual_completion(ticket.completion);
+        }
+    }
+
+#ifdef __linux__
+    {
+        std::lock_guard lock(event_fd_mutex);
+        for(auto& entry : event_fds_){
+            close(entry.second);
+        }
+        event_fds_.clear();
+        if(model_event_fd_ >= 0){
+            close(model_event_fd_);
+            model_event_fd_ = -1;
+        }
+        event_fds_active_.store(false);
+    }
+#endif
+
     // std::cout<<"MODEL STOPPPPP CALLED \n\n";
     //Flushing the MPU (Sake of sanity and shouldn't be required if everything goes as intended)
     if(out_featuremaps_.size()>0){
+        size_t blob_size = 0;
+        for (int i = 0; i < static_cast<int>(out_ports_.size()); ++i){
+            blob_size = max(blob_size, out_featuremaps_[0][i]->get_formatted_size());
+        }
+        if(flush_scratch_.size() < blob_size){
+            flush_scratch_.resize(blob_size);
+        }
         for(int ctx = 0; ctx < number_of_contexts; ctx++){
             int context_id = open_contexts->at(ctx);
             memx_status status = MEMX_STATUS_OK;
             while(status==MEMX_STATUS_OK){
                 for (int i = 0; i < static_cast<int>(out_ports_.size()); ++i)
                 {
-                    uint8_t* temp_blob = new uint8_t[out_featuremaps_[0][i]->get_formatted_size()];
-                    status = (memx_status) ((int)status | memx_stream_ofmap(context_id, out_ports_[i], temp_blob, 100));
+                    status = (memx_status) ((int)status | memx_stream_ofmap(context_id, out_ports_[i], flush_scratch_.data(), 100));
                     if(memx_status_no_error(status)){
                         std::cerr<<"Entered flushing\r";
                     }
-                    delete [] temp_blob;
                 }
             }
         }
@@ -656,6 +1410,13 @@ void MxModel<T>::model_manual_stop(){
     transposed_in_featuremaps_.clear();
     in_featuremaps_.clear();
 
+    for(auto& frame_fmaps : batch_in_featuremaps_){
+        for(FeatureMap<T>* fmap : frame_fmaps){
+            delete fmap;
+        }
+    }
+    batch_in_featuremaps_.clear();
+
     for(int i =0; i<static_cast<int>(out_featuremaps_.size());++i){
         for (int k = 0; k < static_cast<int>(out_ports_.size()); ++k)
         {
@@ -668,7 +1429,20 @@ void MxModel<T>::model_manual_stop(){
             delete manual_recv_mutex[i];
             delete manual_recv_task_cv[i];
             delete manual_recv_task_mutex[i];
+            delete manual_recv_failed_[i];
     }
+    for(batch_ring* ring : manual_batch_rings_){
+        for(batch_output& output : ring->ready){
+            ring->free.push_back(output.fmaps);
+        }
+        for(auto& fmaps : ring->free){
+            for(FeatureMap<float>* fmap : fmaps){
+                delete fmap;
+            }
+        }
+        delete ring;
+    }
+    manual_batch_rings_.clear();
 
     if(!post_model_path_.empty()){
         for(int i =0; i<static_cast<int>(post_model.size());++i){
@@ -734,96 +1508,218 @@ MX::Types::MxModelInfo MxModel<T>::return_post_model_info(){
 template <typename T>
 void MxModel<T>::model_send_fun()
 {
+    set_thread_name("mx_send_m" + std::to_string(model_id_));
+    apply_thread_placement(thread_policy_.send);
 
     //Run till model is running or there are streams left to send to ifmap
-    while (model_run.load() || stream_queue.size()>0)
+    while (true)
     {
-        if (stream_queue.size() > 0)
+        if(!model_run.load() && stream_queue.size() == 0){
+            //the recv threads queue lost frames for replay under this lock, none come in once send_done_ is set
+            std::unique_lock lock(input_task_mutex);
+            if(replay_queue_.size() == 0){
+                send_done_ = true;
+                break;
+            }
+        }
+        frame_ticket ticket;
+        if(replay_queue_.size() > 0){
+            ticket = replay_queue_.pop();
+            send_ticket(ticket, true);
+        }
+        else if (stream_queue.pop(ticket))
         {
-            memx_status send_status =  MEMX_STATUS_OTHERS;
-            int stream = stream_queue.pop();
-
-            while(memx_status_error(send_status)){
-                int context_to_send = open_contexts->at(context_send_current_index);
-
-                for (int i = 0; i < static_cast<int>(in_ports_.size()); ++i)
-                {                         
-                    // int timeout = (i == 0)? 1 : 0;
-                    send_status = memx_stream_ifmap(context_to_send , in_ports_[i], in_featuremaps_[stream][i]->get_formatted_data(), 0);
-                }
-                
-                //update context_id every iteration
-                context_send_current_index = (context_send_current_index + 1) % number_of_contexts;
-                
-                if(memx_status_no_error(send_status)){
-
-                    in_featuremaps_[stream][0]->set_in_ready(true);
-                    {
-                        std::unique_lock lock(input_thread_mutex);
-                        input_thread_counter++;
-                        input_thread_cv.notify_all();
-                    }
-
-                    //Push the stream id and context to recv to out_queue right after sending it to ifmap
-                    pair_stream_context_queue.push(std::make_pair(stream, context_to_send));
-                    std::unique_lock lock(model_recv_mutex);
-                    model_recv_flag = true;
-                    model_recv_cv.notify_one();
-                    break;
-                }
-            }    
+            send_ticket(ticket, false);
         }
         else{
+            auto idle_start = std::chrono::steady_clock::now();
             std::unique_lock lock(input_task_mutex);
             input_task_cv.wait(lock,[this]() { return ((this->input_task_flag||!this->model_run.load())); });
             input_task_flag = false;
+            send_idle_ns_ += elapsed_ns(idle_start);
         }
     }
 
-    model_recv_cv.notify_one();
+    for(context_recv* recv : context_recvs_){
+        recv->cv.notify_one();
+    }
+}
+
+template <typename T>
+void MxModel<T>::send_ticket(frame_ticket& ticket, bool replay){
+    int stream = ticket.stream;
+    if(!replay){
+        //The output of the frame lands in the ring position matching its send order
+        ticket.seq = stream_rings_[stream]->sent++;
+        ticket.out_slot = stream*pipeline_depth_ + static_cast<int>(ticket.seq % pipeline_depth_);
+    }
+    int context_idx = healthy_context(dispatcher_.acquire(stream));
+    while(context_idx >= 0){
+        int context_to_send = open_contexts->at(context_idx);
+        uint32_t generation = (health_ != NULL) ? health_->generation(context_idx) : 0;
+        memx_status send_status = MEMX_STATUS_OK;
+        for (int i = 0; i < static_cast<int>(in_ports_.size()) && memx_status_no_error(send_status); ++i)
+        {
+            send_status = memx_stream_ifmap(context_to_send , in_ports_[i], in_featuremaps_[ticket.in_slot][i]->get_formatted_data(), 0);
+        }
+
+        if(memx_status_no_error(send_status)){
+            //a frame that may be replayed keeps its input till its outputs are read
+            if(!failover_policy_.replay_in_flight){
+                release_input(ticket.in_slot);
+            }
+            ticket.context = context_to_send;
+            ticket.context_idx = context_idx;
+            ticket.generation = generation;
+            ticket.in_flight = dispatcher_.in_flight(context_idx);
+            ticket.sent_at = std::chrono::steady_clock::now();
+
+            //Push the frame to the recv queue of its context right after sending it to ifmap
+            context_recv* recv = context_recvs_[context_idx];
+            recv->queue.push(ticket);
+            std::unique_lock lock(recv->mutex);
+            recv->flag = true;
+            recv->cv.notify_one();
+            return;
+        }
+        if(health_ == NULL){
+            //the context did not take the frame, try the next one
+            dispatcher_.cancel(context_idx);
+            context_idx = (context_idx + 1) % number_of_contexts;
+            dispatcher_.take(context_idx);
+            continue;
+        }
+        health_->report_failure(context_idx, generation, "stream_ifmap failed with status " + std::to_string(static_cast<int>(send_status)));
+        context_idx = healthy_context(context_idx);
+    }
+    //every context of the model failed
+    release_input(ticket.in_slot);
+    fail_frame(ticket, "no healthy context left to send the frame to");
 }
 
 template <typename T>
-void MxModel<T>::model_recv_fun()
+int MxModel<T>::healthy_context(int ctx){
+    if(health_ == NULL || health_->healthy(ctx)){
+        return ctx;
+    }
+    dispatcher_.cancel(ctx);
+    for(int i = 1; i < number_of_contexts; ++i){
+        int next = (ctx + i) % number_of_contexts;
+        if(health_->healthy(next)){
+            dispatcher_.take(next);
+            return next;
+        }
+    }
+    return -1;
+}
+
+template <typename T>
+void MxModel<T>::reroute_frame(frame_ticket& ticket, const std::string& error){
+    dispatcher_.fail(ticket.context_idx);
+    if(failover_policy_.replay_in_flight){
+        if(health_->any_healthy()){
+            std::unique_lock lock(input_task_mutex);
+            if(!send_done_){
+                stream_queue.record_failure(ticket.stream, true, error);
+                replay_queue_.push(ticket);
+                input_task_flag = true;
+                input_task_cv.notify_one();
+                return;
+            }
+        }
+        release_input(ticket.in_slot);
+    }
+    fail_frame(ticket, error);
+}
+
+template <typename T>
+void MxModel<T>::fail_frame(const frame_ticket& ticket, const std::string& error){
+    stream_queue.record_failure(ticket.stream, false, error);
+    {
+        std::unique_lock<std::mutex> lock(*out_task_mutex[ticket.stream]);
+        stream_rings_[ticket.stream]->failed.insert(ticket.seq);
+    }
+    dispatch_output(ticket.stream);
+}
+
+template <typename T>
+void MxModel<T>::release_input(int in_slot){
+    in_featuremaps_[in_slot][0]->set_in_ready(true);
+    std::unique_lock lock(input_thread_mutex);
+    input_thread_counter++;
+    input_thread_cv.notify_all();
+}
+
+template <typename T>
+void MxModel<T>::model_recv_fun(int context_idx)
 {
+    set_thread_name("mx_recv_m" + std::to_string(model_id_) + "_" + std::to_string(context_idx));
+    apply_thread_placement(thread_policy_.recv);
+    context_recv* recv = context_recvs_[context_idx];
     //Run till model is running or there are streams left to send to ofmap
-    while (model_recv_run.load() || pair_stream_context_queue.size()>0)
+    //Frames of a stream may finish on different contexts in any order, the
+    //stream ring puts them back in send order before the output callback
+    while (model_recv_run.load() || recv->queue.size()>0)
     {
-        if (pair_stream_context_queue.size() > 0)
+        if (recv->queue.size() > 0)
         {
-            std::pair<int, int> pop_data = pair_stream_context_queue.pop(); 
-            int stream = pop_data.first;
-            int context_to_recv = pop_data.second;
-            //wait till particular stream thread is done with previous
-            // ofmap results
+            frame_ticket ticket = recv->queue.pop(); 
+            int stream = ticket.stream;
+            int context_to_recv = ticket.context;
+            stream_ring* ring = stream_rings_[stream];
+            //frames sent before the context failed are lost with it
+            if(health_ != NULL && health_->generation(context_idx) != ticket.generation){
+                reroute_frame(ticket, "context " + std::to_string(context_to_recv) + " failed with the frame on it");
+                continue;
+            }
+            //wait till the output callback of the frame that last used
+            // this ring position is done with its ofmap results
             {
+                auto blocked_start = std::chrono::steady_clock::now();
                 std::unique_lock<std::mutex> lock(*out_task_mutex[stream]);
-                while(!out_featuremaps_[stream][0]->get_out_ready())
-                {
-                    out_task_cv[stream]->wait(lock);
-                    // continue;
-                }
+                out_task_cv[stream]->wait(lock, [this, ring, &ticket]{ return ticket.seq < ring->released + pipeline_depth_; });
+                recv_blocked_ns_ += elapsed_ns(blocked_start);
             }
-            for (int i = 0; i < static_cast<int>(out_ports_.size()); ++i)
+            memx_status status = MEMX_STATUS_OK;
+            for (int i = 0; i < static_cast<int>(out_ports_.size()) && memx_status_no_error(status); ++i)
             {
-                memx_status status;
-                {
-                    status = memx_stream_ofmap(context_to_recv , out_ports_[i], out_featuremaps_[stream][i]->get_formatted_data(), 0);
-                }
+                status = memx_stream_ofmap(context_to_recv , out_ports_[i], out_featuremaps_[ticket.out_slot][i]->get_formatted_data(), recv_timeout_ms_.load());
+            }
+            if(health_ != NULL){
+                std::string error;
                 if(memx_status_error(status)){
-                    throw runtime_error("stream_ofmap failed, try resetting the MXA");              
+                    error = "stream_ofmap failed with status " + std::to_string(static_cast<int>(status));
+                }
+                else if(health_->take_fault(context_idx)){
+                    //the outputs of an injected fault are read and dropped, like those of a frame cut off by a driver error
+                    error = "injected fault";
+                }
+                if(!error.empty()){
+                    health_->report_failure(context_idx, ticket.generation, error);
+                    reroute_frame(ticket, error);
+                    continue;
                 }
             }
+            else if(memx_status_error(status)){
+                throw runtime_error("stream_ofmap failed, try resetting the MXA");
+            }
+            if(failover_policy_.replay_in_flight){
+                release_input(ticket.in_slot);
+            }
+            dispatcher_.complete(context_idx, elapsed_ns(ticket.sent_at), ticket.in_flight);
             //Specifing a specific recv stream thread that the ofmap is done
-            out_featuremaps_[stream][0]->set_out_ready(false);
-            vector<const FeatureMap<float>*> temp(out_featuremaps_[stream].begin(),out_featuremaps_[stream].end());
-            output_pool->submitTask(&MxModel<T>::outputTask,this,comb_out_call[stream],std::move(temp),std::move(stream),stream_id_list[stream]);       
+            out_featuremaps_[ticket.out_slot][0]->set_out_ready(false);
+            {
+                std::unique_lock<std::mutex> lock(*out_task_mutex[stream]);
+                ring->out_read[ticket.seq % pipeline_depth_] = true;
+            }
+            dispatch_output(stream);
         }
         else{
             {
-                std::unique_lock lock(model_recv_mutex);
-                model_recv_cv.wait(lock,[this]() { return ((this->model_recv_flag||!this->model_run.load())); });
-                model_recv_flag = false;
+                std::unique_lock lock(recv->mutex);
+                recv->cv.wait(lock,[this, recv]() { return ((recv->flag||!this->model_run.load())); });
+                recv->flag = false;
             }
         }
     }
@@ -839,10 +1735,16 @@ MxModel<T>::~MxModel()
     else if(model_manual_run.load()){
         this->model_manual_stop();
     }
+    //featureMaps kept by the last stop
+    reuse_kept_slots(0);
+    for(std::mutex* context_mutex : manual_context_mutex){
+        delete context_mutex;
+    }
+    manual_context_mutex.clear();
 }
 
 template <typename T>
-void MxModel<T>::connect_stream(MxModel<T>::combined_input_callback_t in_cb, MxModel<T>::combined_output_callback_t out_cb, int stream_id)
+void MxModel<T>::connect_stream(MxModel<T>::combined_input_callback_t in_cb, MxModel<T>::combined_output_callback_t out_cb, int stream_id, const MX::Types::StreamOptions& options)
 {
     //Don't connect streams after starting the Model
     if(model_run.load()){
@@ -857,32 +1759,379 @@ void MxModel<T>::connect_stream(MxModel<T>::combined_input_callback_t in_cb, MxM
     if(search != stream_set_.end()){
         throw invalid_argument("duplicate stream id passed in connect_stream");
     }
+    if(options.weight < 1 || options.deadline_us < 0){
+        throw invalid_argument("stream weight must be >= 1 and deadline must be >= 0 in connect_stream");
+    }
     stream_set_.insert(stream_id);
     stream_id_list.push_back(stream_id);
+    stream_options_.push_back(options);
     comb_in_call.push_back(in_cb);
     comb_out_call.push_back(out_cb);
+    pipeline_passthrough_.emplace_back();
+    pipeline_scratch_.emplace_back();
+    stream_live_.push_back(true);
 
     num_streams_ += 1;
 }
 
+template <typename T>
+void MxModel<T>::connect_pipeline_stream(MxModel<T>::combined_output_callback_t out_cb, int stream_id)
+{
+    if(model_run.load()){
+        throw logic_error("connect_pipeline called after starting MxAccl");
+    }
+    if(out_cb == NULL){
+        throw invalid_argument("output callback got a NULL ptr!");
+    }
+    auto search = stream_set_.find(stream_id);
+    if(search != stream_set_.end()){
+        throw invalid_argument("duplicate stream id passed in connect_stream");
+    }
+    stream_set_.insert(stream_id);
+    pipeline_streams_[stream_id] = num_streams_;
+    stream_id_list.push_back(stream_id);
+    stream_options_.push_back(MX::Types::StreamOptions());
+    comb_in_call.push_back(nullptr);
+    comb_out_call.push_back(out_cb);
+    pipeline_passthrough_.emplace_back();
+    pipeline_scratch_.emplace_back();
+    stream_live_.push_back(true);
+
+    num_streams_ += 1;
+}
+
+template <typename T>
+void MxModel<T>::remove_stream_config(int stream)
+{
+    stream_id_list.erase(stream_id_list.begin() + stream);
+    stream_options_.erase(stream_options_.begin() + stream);
+    comb_in_call.erase(comb_in_call.begin() + stream);
+    comb_out_call.erase(comb_out_call.begin() + stream);
+    pipeline_passthrough_.erase(pipeline_passthrough_.begin() + stream);
+    pipeline_scratch_.erase(pipeline_scratch_.begin() + stream);
+    stream_live_.erase(stream_live_.begin() + stream);
+    //the streams after it move down one index
+    for(auto& entry : pipeline_streams_){
+        if(entry.second > stream){
+            entry.second--;
+        }
+    }
+}
+
+template <typename T>
+void MxModel<T>::attach_stream(MxModel<T>::combined_input_callback_t in_cb, MxModel<T>::combined_output_callback_t out_cb, int stream_id, const MX::Types::StreamOptions& options)
+{
+    //A model with no streams at start isn't started, its first attached stream starts it
+    if(!model_run.load()){
+        if(in_cb){
+            connect_stream(in_cb,out_cb,stream_id,options);
+        }
+        else{
+            connect_pipeline_stream(out_cb,stream_id);
+        }
+        model_start();
+        return;
+    }
+    if(out_cb == NULL){
+        throw invalid_argument("output callback got a NULL ptr!");
+    }
+    if(options.weight < 1 || options.deadline_us < 0){
+        throw invalid_argument("stream weight must be >= 1 and deadline must be >= 0 in attach_stream");
+    }
+    if(options.freshest_only && pipeline_depth_ < 2){
+        throw invalid_argument("a freshest_only stream can only be attached while running if the pipeline depth is >= 2");
+    }
+
+    std::unique_lock lock(streams_mutex);
+    if(stream_set_.find(stream_id) != stream_set_.end()){
+        throw invalid_argument("duplicate stream id passed in attach_stream");
+    }
+    //Take the index of a detached stream, or a new one within the vectors reserved at start
+    int stream;
+    bool reuse = !free_streams_.empty();
+    if(reuse){
+        stream = free_streams_.back();
+    }
+    else if(static_cast<int>(stream_rings_.size()) < stream_capacity_){
+        stream = static_cast<int>(stream_rings_.size());
+    }
+    else{
+        throw runtime_error("attach_stream: model " + std::to_string(model_id_) + " already holds " + std::to_string(stream_capacity_) +
+                            " streams, raise the limit with set_max_streams before start");
+    }
+
+    bool locked = true;
+    for(int pos = 0; pos < pipeline_depth_; ++pos){
+        int slot = stream*pipeline_depth_ + pos;
+        create_and_append_in_fm(reuse ? slot : -1);
+        create_and_append_out_fm(reuse ? slot : -1);
+        if(thread_policy_.lock_memory){
+            for(FeatureMap<T>* fmap : in_featuremaps_[slot]){
+                locked = fmap->lock_buffers() && locked;
+            }
+            for(FeatureMap<float>* fmap : out_featuremaps_[slot]){
+                locked = fmap->lock_buffers() && locked;
+            }
+        }
+    }
+    if(!locked){
+        std::cerr<<"Warning!! Could not mlock all featureMap buffers, check RLIMIT_MEMLOCK (ulimit -l)"<<std::endl;
+    }
+
+    if(reuse){
+        free_streams_.pop_back();
+        stream_id_list[stream] = stream_id;
+        stream_options_[stream] = options;
+        comb_in_call[stream] = in_cb;
+        comb_out_call[stream] = out_cb;
+        pipeline_passthrough_[stream].clear();
+        stream_live_[stream] = true;
+        stream_queue.reset_stream(stream, options);
+        //An output worker of the previous stream may still be leaving dispatch_output, so the ring is reset rather than replaced
+        std::unique_lock<std::mutex> ring_lock(*out_task_mutex[stream]);
+        stream_ring* ring = stream_rings_[stream];
+        ring->in_pos = 0;
+        ring->sent = 0;
+        ring->dispatched = 0;
+        ring->released = 0;
+        ring->out_busy = false;
+        ring->out_read.assign(pipeline_depth_, false);
+        ring->enqueued.store(0);
+        ring->input_done = !in_cb;
+        ring->detaching.store(false);
+        ring->failed.clear();
+    }
+    else{
+        stream_id_list.push_back(stream_id);
+        stream_options_.push_back(options);
+        comb_in_call.push_back(in_cb);
+        comb_out_call.push_back(out_cb);
+        pipeline_passthrough_.emplace_back();
+        pipeline_scratch_.emplace_back();
+        stream_live_.push_back(true);
+        stream_queue.add_stream(options);
+        out_task_mutex.push_back(new std::mutex);
+        out_task_cv.push_back(new std::condition_variable);
+        stream_ring* ring = new stream_ring;
+        ring->out_read.assign(pipeline_depth_, false);
+        ring->input_done = !in_cb;
+        stream_rings_.push_back(ring);
+    }
+    stream_set_.insert(stream_id);
+    if(!in_cb){
+        pipeline_streams_[stream_id] = stream;
+    }
+    num_streams_ += 1;
+    lock.unlock();
+
+    {
+        std::unique_lock counter_lock(input_thread_mutex);
+        input_thread_counter += pipeline_depth_;
+    }
+    if(in_cb){
+        input_pool->submitTask(&MxModel<T>::inputTask,this,std::move(in_cb),std::move(stream),std::move(stream_id));
+    }
+}
+
+template <typename T>
+bool MxModel<T>::detach_stream(int stream_id)
+{
+    std::unique_lock lock(streams_mutex);
+    int stream = -1;
+    for(int i = 0; i < static_cast<int>(stream_id_list.size()); ++i){
+        if(stream_live_[i] && stream_id_list[i] == stream_id){
+            stream = i;
+            break;
+        }
+    }
+    if(stream < 0){
+        return false;
+    }
+    //Before start the stream is only a connection to drop
+    if(!model_run.load()){
+        stream_set_.erase(stream_id);
+        pipeline_streams_.erase(stream_id);
+        remove_stream_config(stream);
+        num_streams_ -= 1;
+        return true;
+    }
+    stream_ring* ring = stream_rings_[stream];
+    if(ring->detaching.exchange(true)){
+        throw logic_error("detach_stream already called for this stream");
+    }
+    lock.unlock();
+
+    //The input task ends at its next run, then the frames it queued go through the MXA and the output
+    //callback. Only this stream waits, the other streams keep their slots and frames in flight
+    {
+        std::unique_lock<std::mutex> ring_lock(*out_task_mutex[stream]);
+        out_task_cv[stream]->wait(ring_lock, [this, ring]{
+            return (ring->input_done && ring->feeding.load() == 0 && ring->released == ring->enqueued.load()) || !this->model_run.load();
+        });
+    }
+
+    lock.lock();
+    stream_live_[stream] = false;
+    stream_set_.erase(stream_id);
+    pipeline_streams_.erase(stream_id);
+    num_streams_ -= 1;
+    if(!model_run.load()){
+        //model_stop releases the featureMaps
+        return true;
+    }
+    for(int pos = 0; pos < pipeline_depth_; ++pos){
+        release_slot(stream*pipeline_depth_ + pos);
+    }
+    comb_in_call[stream] = nullptr;
+    comb_out_call[stream] = nullptr;
+    pipeline_scratch_[stream] = vector<float>();
+    dispatcher_.release_stream(stream);
+    free_streams_.push_back(stream);
+    lock.unlock();
+    {
+        std::unique_lock counter_lock(input_thread_mutex);
+        input_thread_counter -= pipeline_depth_;
+    }
+    return true;
+}
+
 
 template<typename T>
 bool MxModel<T>::model_manual_send(std::vector<T *> in_data, int pstream_id, bool channel_first, int32_t timeout){
 
-    if(stream_id_map_.find(pstream_id) == stream_id_map_.end()){
-        unique_lock lock(fm_create_mutex);
-        if(stream_id_map_.find(pstream_id) == stream_id_map_.end()){
-            int map_size = stream_id_map_.size();
-            create_and_append_in_fm();
-            create_and_append_out_fm();
-            create_append_manual_mem();
-            stream_id_map_[pstream_id] = map_size;
-            manual_init_cv.notify_all();
+    if(fresh_streams_.load() > 0){
+        fresh_mailbox* box = NULL;
+        {
+            std::lock_guard lock(fresh_mutex);
+            auto search = fresh_mailboxes_.find(pstream_id);
+            if(search != fresh_mailboxes_.end()){
+                box = search->second;
+            }
+        }
+        if(box != NULL){
+            std::unique_lock box_lock(box->mutex);
+            if(box->enabled){
+                const MX::Types::MxModelInfo& info = pre_model_path.empty() ? model_info : pre_model_info;
+                box->pending.resize(info.num_in_featuremaps);
+                for(int i = 0; i < info.num_in_featuremaps; ++i){
+                    box->pending[i].assign(in_data[i], in_data[i] + info.in_featuremap_sizes[i]);
+                }
+                box->channel_first = channel_first;
+                if(box->full){
+                    box->dropped++;
+                    return true;
+                }
+                box->full = true;
+                box_lock.unlock();
+                {
+                    std::lock_guard lock(fresh_mutex);
+                    fresh_pending_++;
+                }
+                fresh_cv.notify_one();
+                return true;
+            }
         }
     }
+    return model_manual_send_frame(in_data, pstream_id, channel_first, timeout);
+}
+
+template<typename T>
+int MxModel<T>::lock_send_context(std::unique_lock<std::mutex>& lock, int stream_idx){
+    if(!dispatcher_.round_robin()){
+        int ctx = healthy_context(dispatcher_.acquire(stream_idx));
+        if(ctx < 0){
+            throw runtime_error("all contexts of model " + std::to_string(model_id_) + " failed, try resetting the MXA");
+        }
+        lock = std::unique_lock<std::mutex>(*manual_context_mutex[ctx]);
+        return ctx;
+    }
+    //failed contexts are passed over till they are recovered
+    int start = static_cast<int>(manual_next_context_.fetch_add(1) % number_of_contexts);
+    for(int i = 0; i < number_of_contexts; ++i){
+        int ctx = (start + i) % number_of_contexts;
+        if(health_ != NULL && !health_->healthy(ctx)){
+            continue;
+        }
+        std::unique_lock<std::mutex> ctx_lock(*manual_context_mutex[ctx], std::try_to_lock);
+        if(ctx_lock.owns_lock()){
+            lock = std::move(ctx_lock);
+            dispatcher_.take(ctx);
+            return ctx;
+        }
+    }
+    for(int i = 0; i < number_of_contexts; ++i){
+        int ctx = (start + i) % number_of_contexts;
+        if(health_ == NULL || health_->healthy(ctx)){
+            lock = std::unique_lock<std::mutex>(*manual_context_mutex[ctx]);
+            dispatcher_.take(ctx);
+            return ctx;
+        }
+    }
+    throw runtime_error("all contexts of model " + std::to_string(model_id_) + " failed, try resetting the MXA");
+}
+
+template<typename T>
+int MxModel<T>::manual_stream_index(int pstream_id){
+    int stream_idx = stream_slots_.find(pstream_id);
+    if(stream_idx >= 0){
+        return stream_idx;
+    }
+    //first frame of a stream that was not registered
+    std::lock_guard lock(fm_create_mutex);
+    return register_manual_stream(pstream_id);
+}
+
+template<typename T>
+int MxModel<T>::register_manual_stream(int pstream_id){
+    int stream_idx = stream_slots_.find(pstream_id);
+    if(stream_idx >= 0){
+        return stream_idx;
+    }
+    if(stream_slots_.size() >= stream_slots_.capacity()){
+        throw runtime_error("model " + std::to_string(model_id_) + " already holds " + std::to_string(stream_slots_.capacity()) +
+                            " streams, raise the limit with set_max_streams before the first stream is registered");
+    }
+    create_and_append_in_fm();
+    create_and_append_out_fm();
+    create_append_manual_mem();
+    //the featureMaps are published with the slot, a thread that finds the stream can use them right away
+    stream_idx = stream_slots_.insert(pstream_id);
+    {
+        //taking the lock orders the insert with receivers checking the table before they wait
+        std::lock_guard init_lock(manual_init_mutex);
+    }
+    manual_init_cv.notify_all();
+    return stream_idx;
+}
+
+template<typename T>
+void MxModel<T>::model_manual_register_streams(const std::vector<int>& stream_ids){
+    if(!model_manual_run.load()){
+        throw logic_error("streams can only be registered while MxAcclMT is running");
+    }
+    std::lock_guard lock(fm_create_mutex);
+    std::unordered_set<int> new_ids;
+    for(int stream_id : stream_ids){
+        if(stream_slots_.find(stream_id) < 0){
+            new_ids.insert(stream_id);
+        }
+    }
+    //nothing is created if the streams do not all fit
+    if(stream_slots_.size() + new_ids.size() > stream_slots_.capacity()){
+        throw runtime_error("registering " + std::to_string(new_ids.size()) + " streams exceeds the " +
+                            std::to_string(stream_slots_.capacity()) + " streams of model " + std::to_string(model_id_) +
+                            ", raise the limit with set_max_streams");
+    }
+    for(int stream_id : stream_ids){
+        register_manual_stream(stream_id);
+    }
+}
+
+template<typename T>
+bool MxModel<T>::model_manual_send_frame(std::vector<T *> in_data, int pstream_id, bool channel_first, int32_t timeout, manual_completion* completion){
 
     // this->out_queue.push(pstream_id);
-    int stream_idx = stream_id_map_[pstream_id];
+    int stream_idx = manual_stream_index(pstream_id);
 
     if(!pre_model_path.empty()){
         for(int i=0; i<this->pre_model_info.num_in_featuremaps;i++){
@@ -898,21 +2147,60 @@ bool MxModel<T>::model_manual_send(std::vector<T *> in_data, int pstream_id, boo
         }
     }
 
+    //On devices shared with other dfps the frame waits for this dfp to be downloaded
+    MX::Utils::model_swap_scheduler* gate = swap_gate_.load();
+    if(gate != NULL && !gate->enter(swap_member_, 1, timeout)){
+        return false;
+    }
+
     {
-        unique_lock lock(manual_mutex_in);
-        
-        int context_to_send = open_contexts->at(context_send_current_index);
+        //The frame is already formatted, only the transfer holds the lock of the context.
+        //The ticket is queued under the same lock so the recv thread reads each context in send order
+        std::unique_lock<std::mutex> lock;
+        int context_idx;
+        try{
+            context_idx = lock_send_context(lock, stream_idx);
+        }
+        catch(...){
+            if(gate != NULL){
+                gate->leave(swap_member_, 0);
+            }
+            throw;
+        }
+        int context_to_send = open_contexts->at(context_idx);
+        uint32_t generation = (health_ != NULL) ? health_->generation(context_idx) : 0;
         for(int i=0; i<this->model_info.num_in_featuremaps;i++){    
             memx_status status;
             status = memx_stream_ifmap(context_to_send, in_ports_[i], this->in_featuremaps_[stream_idx][i]->get_formatted_data(), timeout);
 
             // if ifmap is success set in ready to true until next set_data is called to copy data from user
             if(memx_status_error(status)){
+                //the next frames go to the other contexts
+                if(health_ != NULL){
+                    health_->report_failure(context_idx, generation, "stream_ifmap failed with status " + std::to_string(static_cast<int>(status)));
+                }
+                dispatcher_.cancel(context_idx);
+                if(gate != NULL){
+                    gate->leave(swap_member_, 0);
+                }
                 throw runtime_error("stream_ifmap failed, try resetting the MXA");
             }
         }
-        context_send_current_index = (context_send_current_index + 1) % number_of_contexts;
-        pair_stream_context_queue.push(std::make_pair(pstream_id, context_to_send));
+        frame_ticket ticket{};
+        ticket.stream = stream_idx;
+        ticket.in_slot = stream_idx;
+        ticket.out_slot = stream_idx;
+        ticket.context = context_to_send;
+        ticket.context_idx = context_idx;
+        ticket.in_flight = dispatcher_.in_flight(context_idx);
+        ticket.sent_at = std::chrono::steady_clock::now();
+        ticket.completion = completion;
+        ticket.swap_gate = gate;
+        ticket.generation = generation;
+        pair_stream_context_queue.push(ticket);
+    }
+    if(gate != NULL){
+        gate->leave(swap_member_, 1);
     }
     
     {
@@ -924,40 +2212,532 @@ bool MxModel<T>::model_manual_send(std::vector<T *> in_data, int pstream_id, boo
 
 }
 
+template<typename T>
+bool MxModel<T>::model_manual_send_batch(const std::vector<std::vector<T *>>& batch, int pstream_id, bool channel_first, int32_t timeout){
+    if(batch.empty()){
+        return true;
+    }
+    //Pre and post-processing models keep one set of buffers per stream, so their batches are sent frame by frame
+    //and their outputs have to be received by another thread while the batch is sent
+    if(!pre_model_path.empty() || !post_model_path_.empty()){
+        for(const std::vector<T*>& in_data : batch){
+            if(!model_manual_send(in_data, pstream_id, channel_first, timeout)){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int stream_idx = manual_stream_index(pstream_id);
+    int num_frames = static_cast<int>(batch.size());
+    std::lock_guard batch_lock(batch_mutex);
+    while(static_cast<int>(batch_in_featuremaps_.size()) < num_frames){
+        vector<FeatureMap<T> *> temp_v;
+        for (int k = 0; k < static_cast<int>(in_ports_.size()); ++k)
+        {
+            int port_idx = in_ports_[k];
+            temp_v.push_back(new FeatureMap<T>(dfp_->input_port(port_idx)->total_size,
+                            (MX_data_format) dfp_->input_port(port_idx)->format,
+                            dfp_->input_port(port_idx)->dim_h,
+                            dfp_->input_port(port_idx)->dim_w,
+                            dfp_->input_port(port_idx)->dim_z,
+                            dfp_->input_port(port_idx)->dim_c,
+                            1));
+        }
+        batch_in_featuremaps_.push_back(temp_v);
+    }
+
+    //Encode the frames in parallel, one frame per thread
+    #pragma omp parallel for schedule(dynamic)
+    for(int f = 0; f < num_frames; ++f){
+        for(int i = 0; i < this->model_info.num_in_featuremaps; i++){
+            batch_in_featuremaps_[f][i]->set_data(batch[f][i], channel_first);
+        }
+    }
+
+    //Each frame gets an output set of its own, so the recv thread never waits for the batch to be received
+    reserve_batch_outputs(stream_idx, num_frames);
+
+    //The whole batch is sent in one turn of this dfp on shared devices
+    MX::Utils::model_swap_scheduler* gate = swap_gate_.load();
+    if(gate != NULL && !gate->enter(swap_member_, num_frames, timeout)){
+        unreserve_batch_outputs(stream_idx, num_frames);
+        return false;
+    }
+
+    //Submit the frames back to back, each under the lock of its context
+    for(int f = 0; f < num_frames; ++f){
+        std::unique_lock<std::mutex> lock;
+        int context_idx;
+        try{
+            context_idx = lock_send_context(lock, stream_idx);
+        }
+        catch(...){
+            unreserve_batch_outputs(stream_idx, num_frames - f);
+            if(gate != NULL){
+                gate->leave(swap_member_, f);
+            }
+            throw;
+        }
+        int context_to_send = open_contexts->at(context_idx);
+        uint32_t generation = (health_ != NULL) ? health_->generation(context_idx) : 0;
+        for(int i=0; i<this->model_info.num_in_featuremaps;i++){
+            memx_status status = memx_stream_ifmap(context_to_send, in_ports_[i], batch_in_featuremaps_[f][i]->get_formatted_data(), timeout);
+            if(memx_status_error(status)){
+                //the next frames go to the other contexts
+                if(health_ != NULL){
+                    health_->report_failure(context_idx, generation, "stream_ifmap failed with status " + std::to_string(static_cast<int>(status)));
+                }
+                dispatcher_.cancel(context_idx);
+                unreserve_batch_outputs(stream_idx, num_frames - f);
+                if(gate != NULL){
+                    gate->leave(swap_member_, f);
+                }
+                throw runtime_error("stream_ifmap failed, try resetting the MXA");
+            }
+        }
+        frame_ticket ticket{};
+        ticket.stream = stream_idx;
+        ticket.in_slot = stream_idx;
+        ticket.out_slot = stream_idx;
+        ticket.context = context_to_send;
+        ticket.context_idx = context_idx;
+        ticket.in_flight = dispatcher_.in_flight(context_idx);
+        ticket.sent_at = std::chrono::steady_clock::now();
+        ticket.swap_gate = gate;
+        ticket.generation = generation;
+        ticket.batch = true;
+        pair_stream_context_queue.push(ticket);
+    }
+    if(gate != NULL){
+        gate->leave(swap_member_, num_frames);
+    }
+
+    {
+        std::lock_guard model_manual_send_lock(manual_mutex);
+        model_manual_in_done = true;
+    }
+    model_manual_cv.notify_one();
+    return true;
+}
+
+template<typename T>
+void MxModel<T>::reserve_batch_outputs(int stream_idx, int num_frames){
+    batch_ring* ring = manual_batch_rings_[stream_idx];
+    std::lock_guard lock(*manual_recv_task_mutex[stream_idx]);
+    //the ring grows to the most batched frames of the stream in flight and not received at once
+    while(static_cast<int>(ring->free.size()) < ring->pending + num_frames){
+        vector<FeatureMap<float> *> fmaps;
+        for(int k = 0; k < static_cast<int>(out_ports_.size()); ++k){
+            int port_idx = out_ports_[k];
+            fmaps.push_back(new FeatureMap<float>(dfp_->output_port(port_idx)->total_size,
+                            (MX_data_format) dfp_->output_port(port_idx)->format,
+                            dfp_->output_port(port_idx)->dim_h,
+                            dfp_->output_port(port_idx)->dim_w,
+                            dfp_->output_port(port_idx)->dim_z,
+                            dfp_->output_port(port_idx)->dim_c,
+                            parallel_fmap_convert_threads));
+        }
+        ring->free.push_back(fmaps);
+    }
+    ring->pending += num_frames;
+}
+
+template<typename T>
+bool MxModel<T>::batch_output_first(int stream_idx){
+    batch_ring* ring = manual_batch_rings_[stream_idx];
+    if(ring->ready.empty()){
+        return false;
+    }
+    return out_featuremaps_[stream_idx][0]->get_out_ready() || ring->ready.front().seq < ring->slot_seq;
+}
+
+template<typename T>
+void MxModel<T>::unreserve_batch_outputs(int stream_idx, int num_frames){
+    std::lock_guard lock(*manual_recv_task_mutex[stream_idx]);
+    manual_batch_rings_[stream_idx]->pending -= num_frames;
+}
+
+template<typename T>
+void MxModel<T>::take_batch_output(int stream_idx, int pstream_id, std::vector<float*> &out_data, bool channel_first){
+    batch_ring* ring = manual_batch_rings_[stream_idx];
+    batch_output output;
+    {
+        std::lock_guard lock(*manual_recv_task_mutex[stream_idx]);
+        output = ring->ready.front();
+        ring->ready.pop_front();
+    }
+    if(!output.lost){
+        for(int i = 0; i < static_cast<int>(out_ports_.size()); ++i){
+            output.fmaps[i]->get_data(out_data[i], channel_first);
+        }
+    }
+    {
+        std::lock_guard lock(*manual_recv_task_mutex[stream_idx]);
+        ring->free.push_back(output.fmaps);
+    }
+    if(output.lost){
+        throw runtime_error("frame of stream " + std::to_string(pstream_id) + " was lost on a failed context");
+    }
+}
+
+template<typename T>
+bool MxModel<T>::model_manual_receive_batch(std::vector<float*> &out_data, int num_frames, int pstream_id, bool channel_first, int32_t timeout){
+    //Output i of frame f lands at out_data[i] + f * size of output i
+    const std::vector<size_t>& sizes = post_model_path_.empty() ? model_info.out_featuremap_sizes : post_model_info.out_featuremap_sizes;
+    if(out_data.size() < sizes.size()){
+        throw invalid_argument("receive batch got fewer output buffers than the model has outputs");
+    }
+    std::vector<float*> frame_out(out_data.size());
+    for(int f = 0; f < num_frames; ++f){
+        for(int i = 0; i < static_cast<int>(sizes.size()); ++i){
+            frame_out[i] = out_data[i] + f * sizes[i];
+        }
+        if(!model_manual_receive(frame_out, pstream_id, channel_first, timeout)){
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T>
+bool MxModel<T>::model_manual_submit(std::vector<T *> in_data, std::vector<float*> out_data, int pstream_id, bool in_channel_first, bool out_channel_first, int32_t timeout, completion_callback_t on_done){
+    if(!on_done){
+        throw invalid_argument("submit needs a completion callback");
+    }
+    const std::vector<size_t>& sizes = post_model_path_.empty() ? model_info.out_featuremap_sizes : post_model_info.out_featuremap_sizes;
+    if(out_data.size() < sizes.size()){
+        throw invalid_argument("submit got fewer output buffers than the model has outputs");
+    }
+    //Frames of freshest streams may be replaced in the mailbox, so they cannot promise a completion
+    if(fresh_streams_.load() > 0){
+        std::lock_guard lock(fresh_mutex);
+        auto search = fresh_mailboxes_.find(pstream_id);
+        if(search != fresh_mailboxes_.end()){
+            std::lock_guard box_lock(search->second->mutex);
+            if(search->second->enabled){
+                throw logic_error("submit is not supported on streams in freshest only mode");
+            }
+        }
+    }
+    manual_completion* completion = new manual_completion{std::move(out_data), out_channel_first, pstream_id, std::move(on_done)};
+    bool sent = false;
+    try{
+        sent = model_manual_send_frame(in_data, pstream_id, in_channel_first, timeout, completion);
+    }
+    catch(...){
+        delete completion;
+        throw;
+    }
+    //A frame that was not sent is not queued, so the recv thread never sees its completion
+    if(!sent){
+        delete completion;
+    }
+    return sent;
+}
+
+template<typename T>
+void MxModel<T>::model_manual_set_swap_gate(MX::Utils::model_swap_scheduler* gate, int member){
+    swap_member_ = member;
+    swap_gate_.store(gate);
+}
+
+template<typename T>
+void MxModel<T>::fail_manual_completion(manual_completion* completion){
+    completion->callback(false, completion->stream_id);
+    delete completion;
+}
+
+template<typename T>
+bool MxModel<T>::model_manual_try_receive(std::vector<float*> &out_data, int pstream_id, bool channel_first){
+    int stream_idx = stream_slots_.find(pstream_id);
+    if(stream_idx < 0){
+        return false;
+    }
+    bool batched;
+    {
+        std::lock_guard lock(*(manual_recv_task_mutex[stream_idx]));
+        batched = batch_output_first(stream_idx);
+    }
+    if(batched){
+        take_batch_output(stream_idx, pstream_id, out_data, channel_first);
+        return true;
+    }
+    //out ready is cleared by the recv thread once the ofmaps of the stream are read
+    if(out_featuremaps_[stream_idx][0]->get_out_ready()){
+        return false;
+    }
+    if(manual_recv_failed_[stream_idx]->exchange(false)){
+        out_featuremaps_[stream_idx][0]->set_out_ready(true);
+        manual_recv_cv[stream_idx]->notify_one();
+        throw runtime_error("frame of stream " + std::to_string(pstream_id) + " was lost on a failed context");
+    }
+    copy_manual_output(stream_idx, out_data, channel_first);
+    out_featuremaps_[stream_idx][0]->set_out_ready(true);
+    manual_recv_cv[stream_idx]->notify_one();
+    return true;
+}
+
+template<typename T>
+int MxModel<T>::model_manual_event_fd(int pstream_id){
+#ifdef __linux__
+    if(!model_manual_run.load()){
+        throw logic_error("event fds can only be requested while MxAcclMT is running");
+    }
+    int stream_idx = -1;
+    if(pstream_id >= 0){
+        stream_idx = manual_stream_index(pstream_id);
+    }
+    std::lock_guard lock(event_fd_mutex);
+    int fd = model_event_fd_;
+    if(stream_idx >= 0){
+        auto search = event_fds_.find(stream_idx);
+        fd = (search == event_fds_.end()) ? -1 : search->second;
+    }
+    if(fd >= 0){
+        return fd;
+    }
+    //Start readable if an output is already waiting to be received
+    unsigned int pending = 0;
+    if(stream_idx >= 0 && !out_featuremaps_[stream_idx][0]->get_out_ready()){
+        pending = 1;
+    }
+    fd = eventfd(pending, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(fd < 0){
+        throw runtime_error("failed to create eventfd : " + std::string(strerror(errno)));
+    }
+    if(stream_idx < 0){
+        model_event_fd_ = fd;
+    }
+    else{
+        event_fds_[stream_idx] = fd;
+    }
+    event_fds_active_.store(true);
+    return fd;
+#else
+    (void) pstream_id;
+    throw runtime_error("event fds are only supported on Linux");
+#endif
+}
+
+template<typename T>
+void MxModel<T>::signal_event_fds(int stream_idx){
+#ifdef __linux__
+    std::lock_guard lock(event_fd_mutex);
+    auto search = event_fds_.find(stream_idx);
+    if(search != event_fds_.end() && search->second >= 0){
+        eventfd_write(search->second, 1);
+    }
+    if(model_event_fd_ >= 0){
+        eventfd_write(model_event_fd_, 1);
+    }
+#else
+    (void) stream_idx;
+#endif
+}
+
+template <typename T>
+void MxModel<T>::model_fresh_send_fun(){
+    set_thread_name("mx_fresh_m" + std::to_string(model_id_));
+    struct fresh_frame{
+        int stream_id;
+        fresh_mailbox* box;
+        bool channel_first;
+    };
+    std::vector<fresh_frame> frames;
+    std::vector<T*> in_data;
+    while(true){
+        frames.clear();
+        {
+            std::unique_lock lock(fresh_mutex);
+            fresh_cv.wait(lock,[this]() { return this->fresh_pending_.load() > 0 || !this->fresh_run_; });
+            if(!fresh_run_){
+                break;
+            }
+            //Take the newest frame of every stream, later frames keep replacing the mailbox while these are sent
+            for(auto& entry : fresh_mailboxes_){
+                fresh_mailbox* box = entry.second;
+                std::lock_guard box_lock(box->mutex);
+                if(box->full){
+                    box->pending.swap(box->sending);
+                    box->full = false;
+                    fresh_pending_--;
+                    frames.push_back({entry.first, box, box->channel_first});
+                }
+            }
+        }
+        for(const fresh_frame& frame : frames){
+            in_data.clear();
+            for(vector<T>& data : frame.box->sending){
+                in_data.push_back(data.data());
+            }
+            //A frame that cannot be sent, such as one whose context failed, is dropped like a replaced one.
+            //The thread keeps running so the next frames of the streams go to the contexts left
+            bool sent = false;
+            try{
+                sent = model_manual_send_frame(in_data, frame.stream_id, frame.channel_first, 0);
+            }
+            catch(const std::exception& e){
+                std::cerr<<"Warning!! Model "<<model_id_<<" dropped a frame of stream "<<frame.stream_id<<": "<<e.what()<<std::endl;
+            }
+            if(!sent){
+                std::lock_guard box_lock(frame.box->mutex);
+                frame.box->dropped++;
+            }
+        }
+    }
+}
+
+template <typename T>
+void MxModel<T>::model_manual_set_freshest(int pstream_id, bool enable){
+    std::lock_guard lock(fresh_mutex);
+    if(!model_manual_run.load()){
+        throw logic_error("freshest mode can only be set while MxAcclMT is running");
+    }
+    fresh_mailbox* box = NULL;
+    auto search = fresh_mailboxes_.find(pstream_id);
+    if(search == fresh_mailboxes_.end()){
+        if(!enable){
+            return;
+        }
+        box = new fresh_mailbox;
+        fresh_mailboxes_[pstream_id] = box;
+    }
+    else{
+        box = search->second;
+    }
+    std::lock_guard box_lock(box->mutex);
+    if(box->enabled == enable){
+        return;
+    }
+    //A frame still waiting in the mailbox is sent by the fresh send thread after disabling
+    box->enabled = enable;
+    if(enable){
+        fresh_streams_++;
+    }
+    else{
+        fresh_streams_--;
+    }
+    if(model_fresh_send_thread == NULL){
+        fresh_run_ = true;
+        model_fresh_send_thread = new std::thread(&MxModel<T>::model_fresh_send_fun, this);
+    }
+}
+
+template <typename T>
+uint64_t MxModel<T>::model_manual_dropped_frames(int pstream_id){
+    std::lock_guard lock(fresh_mutex);
+    auto search = fresh_mailboxes_.find(pstream_id);
+    if(search == fresh_mailboxes_.end()){
+        return 0;
+    }
+    std::lock_guard box_lock(search->second->mutex);
+    return search->second->dropped;
+}
+
 template <typename T>
 void MxModel<T>::model_manual_recv_fun(){
+    set_thread_name("mx_mrecv_m" + std::to_string(model_id_));
     //Run till model is running or there are streams left to send to ofmap
     while (model_manual_run.load() || pair_stream_context_queue.size()>0)
     {
         if (pair_stream_context_queue.size() > 0)
         {
-            std::pair<int, int> pop_data = pair_stream_context_queue.pop(); 
-            int pstream_id = pop_data.first;
-            int context_to_recv = pop_data.second;
-            int stream_idx = stream_id_map_[pstream_id];
-            if(!out_featuremaps_[stream_idx][0]->get_out_ready())
+            frame_ticket ticket = pair_stream_context_queue.pop(); 
+            int stream_idx = ticket.stream;
+            int context_to_recv = ticket.context;
+            if(!ticket.batch && !out_featuremaps_[stream_idx][0]->get_out_ready())
             {
                 std::unique_lock lock(*manual_recv_mutex[stream_idx]);
                 manual_recv_cv[stream_idx]->wait(lock);
             }
             if(!model_manual_run.load()){
+                if(ticket.completion != NULL){
+                    fail_manual_completion(ticket.completion);
+                }
                 return;
             }
-            for (int i = 0; i < static_cast<int>(out_ports_.size()); ++i){
-
-                memx_status status;
-                status = memx_stream_ofmap(context_to_recv, out_ports_[i], this->out_featuremaps_[stream_idx][i]->get_formatted_data(), 0);
-
+            //A batched frame is read into a set of the batch ring of the stream, it doesn't wait for the user
+            vector<FeatureMap<float> *> out_fmaps;
+            if(ticket.batch){
+                batch_ring* ring = manual_batch_rings_[stream_idx];
+                std::lock_guard lock(*manual_recv_task_mutex[stream_idx]);
+                out_fmaps = ring->free.back();
+                ring->free.pop_back();
+                ring->pending--;
+            }
+            else{
+                out_fmaps = out_featuremaps_[stream_idx];
+            }
+            //frames sent before their context failed are lost with it
+            bool lost = health_ != NULL && health_->generation(ticket.context_idx) != ticket.generation;
+            memx_status status = MEMX_STATUS_OK;
+            for (int i = 0; i < static_cast<int>(out_ports_.size()) && !lost && memx_status_no_error(status); ++i){
+                status = memx_stream_ofmap(context_to_recv, out_ports_[i], out_fmaps[i]->get_formatted_data(), recv_timeout_ms_.load());
+            }
+            if(!lost && health_ != NULL){
+                std::string error;
                 if(memx_status_error(status)){
-                    throw runtime_error("stream_ofmap failed, try resetting the MXA");              
+                    error = "stream_ofmap failed with status " + std::to_string(static_cast<int>(status));
                 }
+                else if(health_->take_fault(ticket.context_idx)){
+                    error = "injected fault";
+                }
+                if(!error.empty()){
+                    health_->report_failure(ticket.context_idx, ticket.generation, error);
+                    lost = true;
+                }
+            }
+            else if(memx_status_error(status)){
+                throw runtime_error("stream_ofmap failed, try resetting the MXA");
+            }
+            if(ticket.swap_gate != NULL){
+                ticket.swap_gate->complete(swap_member_);
+            }
+            if(lost){
+                dispatcher_.fail(ticket.context_idx);
+                if(ticket.completion != NULL){
+                    fail_manual_completion(ticket.completion);
+                    continue;
+                }
+                //the receive of the stream throws instead of handing out the outputs
+                if(!ticket.batch){
+                    manual_recv_failed_[stream_idx]->store(true);
+                }
+            }
+            else{
+                dispatcher_.complete(ticket.context_idx, elapsed_ns(ticket.sent_at), ticket.in_flight);
+            }
+            if(ticket.batch){
+                {
+                    std::lock_guard lock(*manual_recv_task_mutex[stream_idx]);
+                    batch_ring* ring = manual_batch_rings_[stream_idx];
+                    ring->ready.push_back({out_fmaps, lost, ring->next_seq++});
+                    manual_recv_task_cv[stream_idx]->notify_one();
+                }
+                if(event_fds_active_.load()){
+                    signal_event_fds(stream_idx);
+                }
+                continue;
+            }
+            //Submitted frames are copied out here, the featureMaps of the stream stay free for the next frame
+            if(ticket.completion != NULL){
+                copy_manual_output(stream_idx, ticket.completion->out_data, ticket.completion->channel_first);
+                ticket.completion->callback(true, ticket.completion->stream_id);
+                delete ticket.completion;
+                continue;
             }
             //Specifing a specific recv stream thread that the ofmap is done
-            out_featuremaps_[stream_idx][0]->set_out_ready(false);     
             {
                 std::unique_lock lock(*manual_recv_task_mutex[stream_idx]);
+                batch_ring* ring = manual_batch_rings_[stream_idx];
+                ring->slot_seq = ring->next_seq++;
+                out_featuremaps_[stream_idx][0]->set_out_ready(false);
                 manual_recv_task_cv[stream_idx]->notify_one();
             }
+            if(event_fds_active_.load()){
+                signal_event_fds(stream_idx);
+            }
         }
         else{
             {
@@ -971,32 +2751,57 @@ void MxModel<T>::model_manual_recv_fun(){
 
 template<typename T>
 bool MxModel<T>::model_manual_receive(std::vector<float*> &out_data, int pstream_id, bool channel_first, int32_t timeout){
-    int stream_idx = 0;
-    while(stream_id_map_.find(pstream_id) == stream_id_map_.end()){
+    int stream_idx = stream_slots_.find(pstream_id);
+    if(stream_idx < 0){
+        //the stream gets its slot with its first frame or from register_streams
         std::unique_lock lock(manual_init_mutex);
+        auto registered = [this, pstream_id, &stream_idx]{
+            stream_idx = stream_slots_.find(pstream_id);
+            return stream_idx >= 0;
+        };
         if(timeout>0){
             auto cv_timeout = std::chrono::system_clock::now() + std::chrono::seconds(timeout);
-            if(!manual_init_cv.wait_until(lock,cv_timeout,[this, pstream_id]{return stream_id_map_.find(pstream_id) != stream_id_map_.end();})){
+            if(!manual_init_cv.wait_until(lock,cv_timeout,registered)){
                 return false;
             }
         }
         else{
-            manual_init_cv.wait(lock,[this, pstream_id]{return stream_id_map_.find(pstream_id) != stream_id_map_.end();});
+            manual_init_cv.wait(lock,registered);
         }
-        std::this_thread::sleep_for(10us);
     }
-    stream_idx = stream_id_map_[pstream_id];
     std::chrono::milliseconds timeout_ms(timeout);
-    if(out_featuremaps_[stream_idx][0]->get_out_ready()){
+    //the oldest output of the stream is received, from the batch ring or the featureMaps of the stream
+    batch_ring* ring = manual_batch_rings_[stream_idx];
+    bool batched;
+    {
         std::unique_lock lock(*(manual_recv_task_mutex[stream_idx]));
+        auto ready = [this, stream_idx, ring] { return !ring->ready.empty() || !this->out_featuremaps_[stream_idx][0]->get_out_ready(); };
         if(timeout>0){
-            if(!manual_recv_task_cv[stream_idx]->wait_for(lock,timeout_ms,[this,stream_idx] { return !this->out_featuremaps_[stream_idx][0]->get_out_ready(); }))
+            if(!manual_recv_task_cv[stream_idx]->wait_for(lock,timeout_ms,ready))
             return false;
         }
         else{
-            manual_recv_task_cv[stream_idx]->wait(lock);
+            manual_recv_task_cv[stream_idx]->wait(lock,ready);
         }
+        batched = batch_output_first(stream_idx);
+    }
+    if(batched){
+        take_batch_output(stream_idx, pstream_id, out_data, channel_first);
+        return true;
+    }
+    if(manual_recv_failed_[stream_idx]->exchange(false)){
+        out_featuremaps_[stream_idx][0]->set_out_ready(true);
+        manual_recv_cv[stream_idx]->notify_one();
+        throw runtime_error("frame of stream " + std::to_string(pstream_id) + " was lost on a failed context");
     }
+    copy_manual_output(stream_idx, out_data, channel_first);
+    out_featuremaps_[stream_idx][0]->set_out_ready(true);
+    manual_recv_cv[stream_idx]->notify_one();
+    return true; 
+}
+
+template<typename T>
+void MxModel<T>::copy_manual_output(int stream_idx, std::vector<float*> &out_data, bool channel_first){
     if(!post_model_path_.empty()){
         _post_inference(stream_idx);
         for (int i = 0; i < post_model_info.num_out_featuremaps; ++i){
@@ -1010,9 +2815,6 @@ bool MxModel<T>::model_manual_receive(std::vector<float*> &out_data, int pstream
             this->out_featuremaps_[stream_idx][i]->get_data(out_data[i], channel_first);
         }
     }
-    out_featuremaps_[stream_idx][0]->set_out_ready(true);
-    manual_recv_cv[stream_idx]->notify_one();
-    return true; 
 }
 
 template<typename T>
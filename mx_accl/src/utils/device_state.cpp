@@ -0,0 +1,139 @@
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <memx/accl/utils/device_state.h>
+
+namespace fs = std::filesystem;
+
+static std::string boot_id()
+{
+#ifdef __linux__
+    std::ifstream fd("/proc/sys/kernel/random/boot_id");
+    std::string id;
+    std::getline(fd, id);
+    return id;
+#else
+    return "";
+#endif
+}
+
+fs::path MX::Utils::device_state_dir()
+{
+#ifdef __linux__
+    // tmpfs, a reboot clears it together with the devices
+    if (fs::is_directory("/dev/shm"))
+    {
+        return fs::path("/dev/shm") / "memx_accl";
+    }
+#endif
+    std::error_code ec;
+    fs::path tmp = fs::temp_directory_path(ec);
+    return tmp / "memx_accl";
+}
+
+static fs::path device_state_file(int device_id)
+{
+    return MX::Utils::device_state_dir() / ("device_" + std::to_string(device_id) + ".state");
+}
+
+MX::Utils::device_state MX::Utils::load_device_state(int device_id)
+{
+    device_state state;
+    std::ifstream fd(device_state_file(device_id));
+    if (!fd)
+    {
+        return state;
+    }
+    std::string line;
+    // a state from an earlier boot says nothing about the device
+    if (!std::getline(fd, line) || line != "boot " + boot_id())
+    {
+        return state;
+    }
+    while (std::getline(fd, line))
+    {
+        std::istringstream iss(line);
+        std::string key;
+        iss >> key;
+        if (key == "mpu_config")
+        {
+            iss >> state.mpu_config;
+        }
+        else if (key == "power")
+        {
+            iss >> state.power_chips >> state.frequency >> state.voltage;
+        }
+        else if (key == "context")
+        {
+            int context_id;
+            uint64_t hash;
+            if (iss >> context_id >> std::hex >> hash)
+            {
+                state.context_dfp[context_id] = hash;
+            }
+        }
+        if (iss.fail())
+        {
+            return device_state();
+        }
+    }
+    return state;
+}
+
+void MX::Utils::save_device_state(int device_id, const device_state& state)
+{
+    std::error_code ec;
+    fs::create_directories(device_state_dir(), ec);
+    fs::path file = device_state_file(device_id);
+    fs::path tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream fd(tmp, std::ios::trunc);
+        if (!fd)
+        {
+            return;
+        }
+        fd << "boot " << boot_id() << "\n";
+        fd << "mpu_config " << state.mpu_config << "\n";
+        fd << "power " << state.power_chips << " " << state.frequency << " " << state.voltage << "\n";
+        for (const auto& [context_id, hash] : state.context_dfp)
+        {
+            fd << "context " << context_id << " " << std::hex << hash << std::dec << "\n";
+        }
+        if (!fd)
+        {
+            return;
+        }
+    }
+    // a process that stops halfway leaves the previous state, never half of one
+    fs::rename(tmp, file, ec);
+}
+
+uint64_t MX::Utils::hash_bytes(const uint8_t* data, size_t size, uint64_t hash)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t MX::Utils::hash_file(const fs::path& path)
+{
+    std::ifstream fd(path, std::ios::binary);
+    if (!fd)
+    {
+        return 0;
+    }
+    uint64_t hash = 14695981039346656037ull;
+    std::vector<char> buffer(1 << 20);
+    while (fd)
+    {
+        fd.read(buffer.data(), buffer.size());
+        hash = hash_bytes(reinterpret_cast<const uint8_t*>(buffer.data()), static_cast<size_t>(fd.gcount()), hash);
+    }
+    return hash;
+}
@@ -1,5 +1,6 @@
 #include <memx/accl/utils/featureMap.h>
 #include <memx/accl/utils/gbf.h>
+#include <memx/accl/utils/thread_policy.h>
 
 #include <cstring>
 #include <iostream>
@@ -84,7 +85,7 @@ FeatureMap<T>::FeatureMap(const FeatureMap& rhs){
     this->dim_w = rhs.dim_w;
     this->dim_z = rhs.dim_z;
     num_ch = rhs.num_ch;
-    fmap_convert_threads_ = rhs.fmap_convert_threads_;
+    fmap_convert_threads_.store(rhs.fmap_convert_threads_.load());
     formatted_featuremap_size = rhs.formatted_featuremap_size;
     fmap_data = new T[featureMap_size];
     std::memcpy(fmap_data, rhs.fmap_data, featureMap_size);
@@ -110,7 +111,8 @@ FeatureMap<T>& FeatureMap<T>::operator=(const FeatureMap& rhs){
     this->dim_w = rhs.dim_w;
     this->dim_z = rhs.dim_z;
     num_ch = rhs.num_ch;
-    fmap_convert_threads_ = rhs.fmap_convert_threads_;
+    fmap_convert_threads_.store(rhs.fmap_convert_threads_.load());
+    unlock_buffers();
     formatted_featuremap_size = rhs.formatted_featuremap_size;
     if(fmap_data != NULL){
         delete[] fmap_data;
@@ -315,7 +317,8 @@ MX_status FeatureMap<T>::get_data(T *out_data, bool channel_first) const
         return MX_STATUS_OK;
     }
 
-    #pragma omp parallel if(fmap_convert_threads_ > 1) num_threads(fmap_convert_threads_)
+    int num_convert_threads = fmap_convert_threads_.load();
+    #pragma omp parallel if(num_convert_threads > 1) num_threads(num_convert_threads)
     {
         unconvert_data();
 
@@ -337,7 +340,8 @@ MX_status FeatureMap<T>::set_data(T *in_data, bool channel_first) const
         return MX_STATUS_OK;
     }
 
-    #pragma omp parallel if(fmap_convert_threads_ > 1) num_threads(fmap_convert_threads_)
+    int num_convert_threads = fmap_convert_threads_.load();
+    #pragma omp parallel if(num_convert_threads > 1) num_threads(num_convert_threads)
     {
         if(channel_first){
             this->transpose_chw_hwc(in_data,fmap_data);
@@ -376,6 +380,7 @@ void FeatureMap<T>::get_data_len(T *out_data, size_t data_len) const
 template <typename T>
 FeatureMap<T>::~FeatureMap()
 {
+    unlock_buffers();
     if (fmap_data != NULL)
     {
         delete[] fmap_data;
@@ -399,11 +404,29 @@ uint8_t *FeatureMap<T>::get_formatted_data()
 }
 
 template <typename T>
-size_t FeatureMap<T>::get_formatted_size()
+const uint8_t *FeatureMap<T>::get_formatted_data() const
+{
+    return formatted_data;
+}
+
+template <typename T>
+size_t FeatureMap<T>::get_formatted_size() const
 {
     return formatted_featuremap_size;
 }
 
+template <typename T>
+size_t FeatureMap<T>::get_data_size() const
+{
+    return featureMap_size;
+}
+
+template <typename T>
+MX_data_format FeatureMap<T>::get_format() const
+{
+    return fmt;
+}
+
 template <typename T>
 std::vector<int64_t> FeatureMap<T>::shape(bool channel_first) const{
     MX::Types::ShapeVector shape_vec(dim_h, dim_w, dim_z, num_ch);
@@ -438,7 +461,38 @@ bool FeatureMap<T>::get_in_ready(){
 
 template <typename T>
 int FeatureMap<T>::get_num_fmap_threads() const{
-    return fmap_convert_threads_;
+    return fmap_convert_threads_.load();
+}
+
+template <typename T>
+void FeatureMap<T>::set_num_fmap_threads(int num_threads){
+    fmap_convert_threads_.store(num_threads < 2 ? 1 : num_threads);
+}
+
+template <typename T>
+bool FeatureMap<T>::lock_buffers(){
+    if(buffers_locked_){
+        return true;
+    }
+    bool locked = MX::Utils::lock_and_prefault(fmap_data, featureMap_size*sizeof(T));
+    if((uint8_t*) fmap_data != formatted_data){
+        locked = MX::Utils::lock_and_prefault(formatted_data, formatted_featuremap_size) && locked;
+    }
+    // munlock of pages that were not locked is harmless, so always undo in unlock_buffers
+    buffers_locked_ = true;
+    return locked;
+}
+
+template <typename T>
+void FeatureMap<T>::unlock_buffers(){
+    if(!buffers_locked_){
+        return;
+    }
+    MX::Utils::unlock_memory(fmap_data, featureMap_size*sizeof(T));
+    if((uint8_t*) fmap_data != formatted_data){
+        MX::Utils::unlock_memory(formatted_data, formatted_featuremap_size);
+    }
+    buffers_locked_ = false;
 }
 
 // template class FeatureMap<uint8_t>;
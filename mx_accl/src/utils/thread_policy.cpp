@@ -0,0 +1,107 @@
+#include <iostream>
+#include <thread>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <memx/accl/utils/thread_policy.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+void MX::Utils::set_thread_name(const std::string& name)
+{
+#ifdef __linux__
+    // pthread names are limited to 16 bytes including the terminator
+    pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+#else
+    (void) name;
+#endif
+}
+
+void MX::Utils::validate_thread_placement(const MX::Types::ThreadPlacement& placement)
+{
+    int num_cpus = static_cast<int>(std::thread::hardware_concurrency());
+    for(int cpu : placement.cpus){
+        if(cpu < 0 || (num_cpus > 0 && cpu >= num_cpus)){
+            throw std::invalid_argument("thread placement refers to cpu " + std::to_string(cpu) + " but only " + std::to_string(num_cpus) + " cpus are available");
+        }
+    }
+    if(placement.rt_priority < 0 || placement.rt_priority > 99){
+        throw std::invalid_argument("thread placement rt_priority must be in the range 0 to 99");
+    }
+    if(placement.nice < -20 || placement.nice > 19){
+        throw std::invalid_argument("thread placement nice must be in the range -20 to 19");
+    }
+}
+
+void MX::Utils::apply_thread_placement(const MX::Types::ThreadPlacement& placement)
+{
+#ifdef __linux__
+    if(!placement.cpus.empty()){
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for(int cpu : placement.cpus){
+            CPU_SET(cpu, &cpu_set);
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+        if(err != 0){
+            std::cerr << "Warning!! Could not set thread affinity: " << std::strerror(err) << std::endl;
+        }
+    }
+    if(placement.rt_priority > 0){
+        sched_param param{};
+        param.sched_priority = placement.rt_priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if(err != 0){
+            std::cerr << "Warning!! Could not set SCHED_FIFO priority " << placement.rt_priority << ": " << std::strerror(err) << std::endl;
+        }
+    }
+    else if(placement.nice != 0){
+        // nice values are per thread on Linux when applied to the thread id
+        pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+        if(setpriority(PRIO_PROCESS, tid, placement.nice) != 0){
+            std::cerr << "Warning!! Could not set nice level " << placement.nice << ": " << std::strerror(errno) << std::endl;
+        }
+    }
+#else
+    (void) placement;
+#endif
+}
+
+bool MX::Utils::lock_and_prefault(void* ptr, size_t size)
+{
+    if(ptr == NULL || size == 0){
+        return true;
+    }
+#ifdef __linux__
+    bool locked = (mlock(ptr, size) == 0);
+    // touch every page so it is backed before the first frame
+    volatile uint8_t* bytes = static_cast<volatile uint8_t*>(ptr);
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    for(size_t offset = 0; offset < size; offset += page_size){
+        bytes[offset] = bytes[offset];
+    }
+    return locked;
+#else
+    return false;
+#endif
+}
+
+void MX::Utils::unlock_memory(void* ptr, size_t size)
+{
+#ifdef __linux__
+    if(ptr != NULL && size > 0){
+        munlock(ptr, size);
+    }
+#else
+    (void) ptr;
+    (void) size;
+#endif
+}
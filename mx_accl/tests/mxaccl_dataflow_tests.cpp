@@ -371,6 +371,171 @@ TEST(accl_dataflow_tests, identity_multiconfig){
     accl.stop();
 }
 
+atomic_int depth_sent_frames = 0;
+atomic_int depth_recv_frames = 0;
+
+bool input_callback_depth(vector<const MX::Types::FeatureMap<float>*> dst, int stream_id){
+    if(depth_sent_frames.load()>=50)
+        return false;
+    float input[3] = {static_cast<float>(depth_sent_frames.load()), 0, 0};
+    dst[0]->set_data(input);
+    depth_sent_frames++;
+    return true;
+}
+
+bool output_callback_depth(vector<const MX::Types::FeatureMap<float>*> src, int stream_id){
+    float output;
+    src[0]->get_data(&output);
+    // outputs have to come back in the order the inputs were produced
+    EXPECT_EQ(static_cast<float>(depth_recv_frames.load()),output);
+    depth_recv_frames++;
+    return true;
+}
+
+TEST(accl_dataflow_tests, identity_pipeline_depth){
+    depth_sent_frames = 0;
+    depth_recv_frames = 0;
+    fs::path model_path = dfp_path/"identity.dfp";
+    MX::Runtime::MxAccl accl;
+    accl.connect_dfp(model_path.c_str());
+    accl.connect_stream(&input_callback_depth,&output_callback_depth,0);
+    accl.set_pipeline_depth(4);
+    accl.start();
+    accl.wait();
+    accl.stop();
+    EXPECT_EQ(depth_sent_frames.load(),depth_recv_frames.load());
+}
+
+TEST(accl_dataflow_tests, identity_hot_attach){
+    init_num_frames();
+    fs::path model_path = dfp_path/"identity.dfp";
+    MX::Runtime::MxAccl accl;
+    accl.connect_dfp(model_path.c_str());
+    accl.connect_stream(&input_callback_1,&output_callback_1,0);
+    accl.start();
+    //stream 1 joins the running model and stream 0 leaves it, without a restart
+    accl.attach_stream(&input_callback_2,&output_callback_2,1);
+    EXPECT_EQ(accl.get_num_streams(),2);
+    accl.detach_stream(0);
+    EXPECT_EQ(accl.get_num_streams(),1);
+    EXPECT_EQ(sent_num_frames_1.load(),recv_num_frames_1.load());
+    accl.wait();
+    accl.stop();
+    test_num_frames();
+    EXPECT_EQ(sent_num_frames_2.load(),20);
+    EXPECT_THROW(accl.detach_stream(0), std::runtime_error);
+}
+
+TEST(accl_dataflow_tests, identity_keep_buffers){
+    fs::path model_path = dfp_path/"identity.dfp";
+    MX::Runtime::MxAccl accl;
+    accl.connect_dfp(model_path.c_str());
+    MX::Types::StopPolicy policy;
+    policy.keep_buffers = true;
+    policy.drain_timeout_ms = 1000;
+    accl.set_stop_policy(policy);
+    accl.connect_stream(&input_callback_1,&output_callback_1,0);
+    //the second run reuses the featureMaps of the first one, the third one gets a new stream too
+    for(int run = 0; run < 3; ++run){
+        init_num_frames();
+        if(run == 2){
+            accl.connect_stream(&input_callback_2,&output_callback_2,1);
+        }
+        accl.start();
+        accl.wait();
+        accl.stop();
+        test_num_frames();
+        EXPECT_EQ(sent_num_frames_1.load(),20);
+    }
+    EXPECT_EQ(sent_num_frames_2.load(),20);
+    policy.drain_timeout_ms = -1;
+    EXPECT_THROW(accl.set_stop_policy(policy), std::invalid_argument);
+}
+
+TEST(accl_dataflow_tests, identity_least_outstanding){
+    init_num_frames();
+    fs::path model_path = dfp_path/"identity.dfp";
+    MX::Runtime::MxAccl accl;
+    accl.connect_dfp(model_path.c_str());
+    MX::Types::DispatchOptions options;
+    options.policy = MX::Types::DISPATCH_LEAST_OUTSTANDING;
+    options.stream_affinity = true;
+    accl.set_dispatch_options(options);
+    accl.connect_stream(&input_callback_1,&output_callback_1,0);
+    accl.connect_stream(&input_callback_2,&output_callback_2,1);
+    accl.start();
+    accl.wait();
+    accl.stop();
+    test_num_frames();
+    MX::Types::DispatchStats stats = accl.get_dispatch_stats();
+    uint64_t frames_sent = 0;
+    for(const MX::Types::ContextStats& context : stats.contexts){
+        EXPECT_EQ(context.in_flight, 0);
+        frames_sent += context.frames_sent;
+    }
+    EXPECT_EQ(frames_sent, static_cast<uint64_t>(sent_num_frames_1.load() + sent_num_frames_2.load()));
+}
+
+TEST(accl_dataflow_tests, identity_failover){
+    init_num_frames();
+    fs::path model_path = dfp_path/"identity.dfp";
+    MX::Runtime::MxAccl accl;
+    accl.connect_dfp(model_path.c_str());
+    MX::Types::FailoverPolicy policy;
+    policy.recovery_backoff_ms = 10;
+    accl.set_failover_policy(policy);
+    //the frame read with the fault is dropped, the others go to the healthy contexts or wait for the recovery
+    accl.inject_context_fault(0);
+    accl.connect_stream(&input_callback_1,&output_callback_1,0);
+    accl.start();
+    accl.wait();
+    accl.stop();
+    MX::Types::StreamStats stats = accl.get_stream_stats(0);
+    EXPECT_GE(stats.frames_failed, 1u);
+    EXPECT_EQ(recv_num_frames_1.load() + static_cast<int>(stats.frames_failed), sent_num_frames_1.load());
+    EXPECT_TRUE(accl.wait_context_recovery(5000));
+    std::vector<MX::Types::ContextHealth> health = accl.get_context_health();
+    EXPECT_EQ(health[0].failures, 1u);
+    EXPECT_EQ(health[0].recoveries, 1u);
+    EXPECT_TRUE(health[0].healthy);
+    EXPECT_THROW(accl.inject_context_fault(static_cast<int>(health.size())), std::runtime_error);
+    policy.recv_timeout_ms = -1;
+    EXPECT_THROW(accl.set_failover_policy(policy), std::invalid_argument);
+}
+
+TEST(accl_dataflow_tests, identity_power_policy){
+    init_num_frames();
+    fs::path model_path = dfp_path/"identity.dfp";
+    MX::Runtime::MxAccl accl;
+    accl.connect_dfp(model_path.c_str());
+    EXPECT_TRUE(accl.get_power_stats().empty());
+    MX::Types::PowerPolicy policy;
+    policy.profile = MX::Types::POWER_BALANCED;
+    policy.interval_ms = 10;
+    accl.set_power_policy(policy);
+    accl.connect_stream(&input_callback_1,&output_callback_1,0);
+    accl.start();
+    accl.wait();
+    accl.stop();
+    test_num_frames();
+    std::vector<MX::Types::DevicePowerStats> stats = accl.get_power_stats();
+    ASSERT_EQ(stats.size(), 1u);
+    EXPECT_EQ(stats[0].errors, 0u);
+    EXPECT_GE(stats[0].frequency, policy.min_frequency);
+    EXPECT_LE(stats[0].frequency, policy.max_frequency);
+    policy.profile = MX::Types::POWER_STATIC;
+    accl.set_power_policy(policy);
+    policy.min_frequency = 700;
+    EXPECT_THROW(accl.set_power_policy(policy), std::invalid_argument);
+}
+
+TEST(accl_dataflow_tests, pipeline_depth_invalid){
+    fs::path model_path = dfp_path/"identity.dfp";
+    MX::Runtime::MxAccl accl;
+    accl.connect_dfp(model_path.c_str());
+    EXPECT_THROW(accl.set_pipeline_depth(0), std::logic_error);
+}
+
 bool input_callback_gbf(vector<const MX::Types::FeatureMap<float>*> dst, int stream_id){
     if(sent_num_frames_1.load()>=20)
         return false;
@@ -54,6 +54,148 @@ TEST(accl_manual_dfp_tests, num_models_2){
     GTEST_ASSERT_EQ(accl.get_num_models(),2);
 }
 
+TEST(accl_dfp_tests, num_models_two_dfps){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    fs::path multimodel_path = dfp_path/"mobilenet_multimodel.dfp";
+    MX::Runtime::MxAccl accl;
+    std::vector<int> first_devices{0};
+    std::vector<int> second_devices{1};
+    GTEST_ASSERT_EQ(accl.connect_dfp(model_path, first_devices),0);
+    GTEST_ASSERT_EQ(accl.connect_dfp(multimodel_path, second_devices),1);
+    GTEST_ASSERT_EQ(accl.get_num_dfps(),2);
+    GTEST_ASSERT_EQ(accl.get_num_models(),3);
+    GTEST_ASSERT_EQ(accl.get_num_models(1),2);
+    //models are numbered across dfps in connect order
+    GTEST_ASSERT_EQ(accl.get_model_index(1,1),2);
+    EXPECT_THROW(accl.get_model_index(1,0), std::runtime_error);
+    accl.connect_stream(&input_callback,&output_callback,0);
+    accl.connect_stream(&input_callback,&output_callback,1,1,1);
+    accl.start();
+    accl.wait();
+    GTEST_ASSERT_EQ(accl.get_num_streams(),2);
+    accl.stop();
+}
+
+TEST(accl_dfp_tests, device_cache){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    {
+        MX::Runtime::MxAccl accl;
+        accl.set_device_cache(true);
+        accl.connect_dfp(model_path);
+    }
+    //the next object finds the dfp on the device and only enables its streams
+    MX::Runtime::MxAccl accl;
+    accl.set_device_cache(true);
+    accl.connect_dfp(model_path);
+    MX::Types::ConnectStats stats = accl.get_connect_stats();
+    GTEST_ASSERT_EQ(stats.downloads, 0);
+    EXPECT_GT(stats.downloads_skipped, 0);
+    EXPECT_GT(stats.configs_skipped, 0);
+    accl.connect_stream(&input_callback,&output_callback,0);
+    accl.start();
+    accl.wait();
+    accl.stop();
+}
+
+TEST(accl_dfp_tests, connect_async){
+    fs::path model_path = dfp_path/"prepost_onnx.dfp";
+    fs::path pre_model_path = prepost_path/"onnx"/"prepost_pre.onnx";
+    fs::path post_model_path = prepost_path/"onnx"/"prepost_post.onnx";
+    MX::Runtime::MxAccl accl;
+    std::vector<int> device_ids = {0};
+    int dfp_id = accl.connect_dfp_async(model_path, device_ids);
+    //the models are usable while the dfp is downloaded
+    GTEST_ASSERT_EQ(accl.get_num_models(dfp_id), 1);
+    accl.connect_pre_model(pre_model_path);
+    accl.connect_post_model(post_model_path);
+    accl.connect_stream(&input_callback,&output_callback,0);
+    accl.start();
+    accl.wait();
+    accl.stop();
+    MX::Types::ConnectStats stats = accl.get_connect_stats(dfp_id);
+    EXPECT_GT(stats.download_ms, 0);
+    EXPECT_GT(stats.plugins_ms, 0);
+    EXPECT_GT(stats.buffers_ms, 0);
+    EXPECT_GE(stats.total_ms, stats.parse_ms + stats.setup_ms + stats.download_ms);
+}
+
+TEST(accl_dfp_tests, connect_retry_after_failed_download){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    MX::Runtime::MxAccl accl;
+    std::vector<int> device_ids = {0};
+    accl.inject_download_fault();
+    EXPECT_THROW(accl.connect_dfp(model_path, device_ids), std::runtime_error);
+    EXPECT_EQ(accl.get_num_dfps(), 0);
+    //the failed connect gave device 0 back
+    int dfp_id = accl.connect_dfp(model_path, device_ids);
+    EXPECT_EQ(dfp_id, 0);
+    GTEST_ASSERT_EQ(accl.get_num_models(dfp_id), 1);
+    accl.connect_stream(&input_callback,&output_callback,0);
+    accl.start();
+    accl.wait();
+    accl.stop();
+}
+
+TEST(accl_manual_dfp_tests, connect_retry_after_failed_download){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    MX::Runtime::MxAcclMT accl;
+    std::vector<int> device_ids = {0};
+    accl.inject_download_fault();
+    EXPECT_THROW(accl.connect_dfp(model_path, device_ids), std::runtime_error);
+    EXPECT_EQ(accl.connect_dfp(model_path, device_ids), 0);
+    EXPECT_EQ(accl.get_num_models(), 1);
+}
+
+TEST(accl_manual_dfp_tests, model_ids_per_dfp){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    fs::path multimodel_path = dfp_path/"mobilenet_multimodel.dfp";
+    MX::Runtime::MxAcclMT accl;
+    std::vector<int> first_devices{0};
+    std::vector<int> second_devices{1};
+    GTEST_ASSERT_EQ(accl.connect_dfp(model_path, first_devices),0);
+    GTEST_ASSERT_EQ(accl.connect_dfp(multimodel_path, second_devices),1);
+    //model ids count from 0 within each dfp, like send_input
+    accl.set_max_streams(4, 1, 1);
+    EXPECT_THROW(accl.set_max_streams(4, 1, 0), std::runtime_error);
+    EXPECT_THROW(accl.set_max_streams(4, 2, 1), std::runtime_error);
+    EXPECT_THROW(accl.set_freshest_only(0, true, -1), std::runtime_error);
+    EXPECT_THROW(accl.get_dropped_frames(0, -1), std::runtime_error);
+    EXPECT_EQ(accl.get_dropped_frames(0, 1, 1), 0u);
+    EXPECT_THROW(accl.get_event_fd(-1), std::runtime_error);
+    EXPECT_THROW(accl.get_event_fd(0, -1, 2), std::runtime_error);
+}
+
+TEST(accl_dfp_tests, all_devices){
+    fs::path model_path = dfp_path/"prepost_onnx.dfp";
+    fs::path pre_model_path = prepost_path/"onnx"/"prepost_pre.onnx";
+    fs::path post_model_path = prepost_path/"onnx"/"prepost_post.onnx";
+    MX::Runtime::MxAccl accl;
+    std::vector<int> device_ids = {MX::Types::ALL_DEVICES};
+    int dfp_id = accl.connect_dfp(model_path, device_ids);
+    ASSERT_FALSE(device_ids.empty());
+    EXPECT_EQ(std::count(device_ids.begin(), device_ids.end(), MX::Types::ALL_DEVICES), 0);
+    std::vector<MX::Types::DeviceCapacity> devices = accl.get_device_capacity(dfp_id);
+    ASSERT_EQ(devices.size(), device_ids.size());
+    double share = 0;
+    for(size_t d = 0; d < devices.size(); ++d){
+        EXPECT_EQ(devices[d].device_id, device_ids[d]);
+        EXPECT_GE(devices[d].num_contexts, 1);
+        share += devices[d].traffic_share;
+    }
+    EXPECT_NEAR(share, 1.0, 1e-9);
+    //every free device is claimed already
+    EXPECT_TRUE(accl.add_free_devices(dfp_id).empty());
+    std::vector<int> more_ids = {MX::Types::ALL_DEVICES};
+    EXPECT_THROW(accl.connect_dfp(model_path, more_ids), std::runtime_error);
+    accl.connect_pre_model(pre_model_path);
+    accl.connect_post_model(post_model_path);
+    accl.connect_stream(&input_callback,&output_callback,0);
+    accl.start();
+    EXPECT_THROW(accl.add_free_devices(dfp_id), std::logic_error);
+    accl.wait();
+    accl.stop();
+}
+
 TEST(accl_dfp_tests, num_streams_1){
     fs::path model_path = dfp_path/"mobilenet.dfp";
     MX::Runtime::MxAccl accl;
@@ -270,6 +412,31 @@ TEST(accl_dfp_tests, prepost_tf_model_info_tests){
     accl.stop();
 }
 
+TEST(accl_manual_dfp_tests, swap_dfps){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    MX::Runtime::MxAcclMT accl;
+    int first = accl.connect_dfp(model_path);
+    int second = accl.connect_swap_dfp(model_path, first);
+    GTEST_ASSERT_EQ(accl.get_num_dfps(),2);
+    accl.set_swap_batch_size(4, second);
+    MX::Types::MxModelInfo model_info = accl.get_model_info(0);
+    std::vector<float> input(model_info.in_featuremap_sizes[0]);
+    std::vector<float> output(model_info.out_featuremap_sizes[0]);
+    std::vector<float*> in_data{input.data()};
+    std::vector<float*> out_data{output.data()};
+    for(int i = 0; i < 4; ++i){
+        ASSERT_TRUE(accl.run(in_data, out_data, 0, 0, first));
+        ASSERT_TRUE(accl.run(in_data, out_data, 0, 0, second));
+    }
+    MX::Types::SwapStats stats = accl.get_swap_stats(first);
+    GTEST_ASSERT_EQ(stats.dfp_ids, std::vector<int>({first, second}));
+    //the first dfp is on the devices already, every other run swaps
+    GTEST_ASSERT_EQ(stats.swaps, 7u);
+    GTEST_ASSERT_EQ(stats.frames_sent, std::vector<uint64_t>({4, 4}));
+    EXPECT_GT(stats.avg_swap_ms, 0);
+    EXPECT_THROW(accl.set_swap_batch_size(0, first), std::invalid_argument);
+}
+
 TEST(accl_manual_dfp_tests, model_info_tests){
     fs::path model_path = dfp_path/"mobilenet_multimodel.dfp";
     MX::Runtime::MxAcclMT accl;
@@ -7,6 +7,10 @@
 #include "string.h"
 #include "memx/accl/utils/path.h"
 #include "memx/accl/MxAcclMT.h"
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#endif
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -217,6 +221,26 @@ TEST(accl_manual_threading_accuracy_test, multistream_mobilenet_timeout){
     }
 }
 
+TEST(accl_manual_threading_accuracy_test, multistream_mobilenet_registered){
+    init_num_frames();
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    MX::Runtime::MxAcclMT accl;
+    accl.connect_dfp(model_path);
+    accl.set_max_streams(2);
+    accl.register_streams({0, 1});
+    EXPECT_THROW(accl.register_streams({1, 2}), std::runtime_error);
+    EXPECT_THROW(accl.set_max_streams(4), std::logic_error);
+    std::thread send_thread = std::thread(send, &accl, 20,0);
+    std::thread recv_thread = std::thread(receive, &accl, 20,0,1000);
+    std::thread send_thread_1 = std::thread(send, &accl, 20,1);
+    std::thread recv_thread_1 = std::thread(receive, &accl, 20,1,1000);
+    send_thread.join();
+    send_thread_1.join();
+    recv_thread.join();
+    recv_thread_1.join();
+    test_num_frames();
+}
+
 void send_run(MX::Runtime::MxAcclMT* accl, int num_frames, int stream_idx){
     int i = 0;
     while(++i <= num_frames){
@@ -263,3 +287,235 @@ TEST(accl_manual_threading_accuracy_test, multistream_mobilenet_run){
         accl  = NULL;
     }
 }
+
+TEST(accl_manual_threading_accuracy_test, multistream_mobilenet_submit){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    MX::Runtime::MxAcclMT accl;
+    accl.connect_dfp(model_path);
+
+    std::vector<cv::Mat> input_images;
+    for(int stream_idx = 0; stream_idx < 2; ++stream_idx){
+        fs::path img_path = mx_accl_path/"tests"/images[stream_idx];
+        input_images.push_back(mobilenet_load_image(img_path.c_str()));
+    }
+
+    //One thread keeps all frames of both streams in flight
+    int num_frames = 20;
+    std::vector<std::vector<float>> outputs(2*num_frames, std::vector<float>(1000));
+    std::vector<std::future<bool>> results;
+    for(int i = 0; i < num_frames; ++i){
+        for(int stream_idx = 0; stream_idx < 2; ++stream_idx){
+            std::vector<float*> input_data{(float*)input_images[stream_idx].data};
+            std::vector<float*> ofmap{outputs[2*i+stream_idx].data()};
+            results.push_back(accl.submit(input_data, ofmap, 0, stream_idx));
+        }
+    }
+    for(int i = 0; i < 2*num_frames; ++i){
+        EXPECT_TRUE(results[i].get());
+        vector<size_t> top5 = getTopNMaxIndices(outputs[i], 5);
+        EXPECT_EQ(i%2 == 0 ? 235 : 949, top5[0]);
+    }
+
+    //Completion callbacks come in submit order within a stream
+    std::atomic_int completed = 0;
+    std::atomic_int out_of_order = 0;
+    std::vector<float> callback_output(1000*num_frames);
+    for(int i = 0; i < num_frames; ++i){
+        std::vector<float*> input_data{(float*)input_images[0].data};
+        std::vector<float*> ofmap{callback_output.data() + 1000*i};
+        accl.submit(input_data, ofmap, 0, 0, [&completed, &out_of_order, i](bool ok, int stream_id){
+            if(!ok || stream_id != 0 || completed.load() != i){
+                out_of_order++;
+            }
+            completed++;
+        });
+    }
+    while(completed.load() < num_frames){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(0, out_of_order.load());
+}
+
+#ifdef __linux__
+TEST(accl_manual_threading_accuracy_test, multistream_mobilenet_event_fd){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    MX::Runtime::MxAcclMT accl;
+    accl.connect_dfp(model_path);
+
+    std::vector<cv::Mat> input_images;
+    std::vector<pollfd> fds;
+    for(int stream_idx = 0; stream_idx < 2; ++stream_idx){
+        fs::path img_path = mx_accl_path/"tests"/images[stream_idx];
+        input_images.push_back(mobilenet_load_image(img_path.c_str()));
+        fds.push_back({accl.get_event_fd(0, stream_idx), POLLIN, 0});
+    }
+    EXPECT_EQ(accl.get_event_fd(0, 0), fds[0].fd);
+
+    //Nothing sent yet, so nothing to receive
+    std::vector<float> output(1000);
+    std::vector<float*> ofmap{output.data()};
+    EXPECT_FALSE(accl.try_receive_output(ofmap, 0, 0));
+
+    int num_frames = 20;
+    std::thread send_thread_0 = std::thread(send, &accl, num_frames, 0);
+    std::thread send_thread_1 = std::thread(send, &accl, num_frames, 1);
+
+    //One thread waits on both streams with poll
+    std::vector<int> received(2, 0);
+    while(received[0] < num_frames || received[1] < num_frames){
+        ASSERT_GT(poll(fds.data(), fds.size(), 5000), 0);
+        for(int stream_idx = 0; stream_idx < 2; ++stream_idx){
+            if(!(fds[stream_idx].revents & POLLIN)){
+                continue;
+            }
+            eventfd_t count;
+            eventfd_read(fds[stream_idx].fd, &count);
+            while(accl.try_receive_output(ofmap, 0, stream_idx)){
+                vector<size_t> top5 = getTopNMaxIndices(output, 5);
+                EXPECT_EQ(stream_idx == 0 ? 235 : 949, top5[0]);
+                received[stream_idx]++;
+            }
+        }
+    }
+    send_thread_0.join();
+    send_thread_1.join();
+    EXPECT_EQ(num_frames, received[0]);
+    EXPECT_EQ(num_frames, received[1]);
+}
+#endif
+
+//Send num_frames frames alternating the two images with send_batch and receive them with receive_batch
+void run_batch(MX::Runtime::MxAcclMT& accl, const std::vector<cv::Mat>& input_images, int num_frames, int stream_idx, std::vector<float>& batch_output){
+    std::vector<std::vector<float*>> batch;
+    for(int f = 0; f < num_frames; ++f){
+        batch.push_back({(float*)input_images[f%2].data});
+    }
+    batch_output.assign(1000*num_frames, 0.0f);
+    std::vector<float*> ofmap{batch_output.data()};
+    ASSERT_TRUE(accl.send_batch(batch, 0, stream_idx));
+    ASSERT_TRUE(accl.receive_batch(ofmap, num_frames, 0, stream_idx));
+}
+
+TEST(accl_manual_threading_accuracy_test, mobilenet_batch){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    MX::Runtime::MxAcclMT accl;
+    accl.connect_dfp(model_path);
+
+    std::vector<cv::Mat> input_images;
+    for(int stream_idx = 0; stream_idx < 2; ++stream_idx){
+        fs::path img_path = mx_accl_path/"tests"/images[stream_idx];
+        input_images.push_back(mobilenet_load_image(img_path.c_str()));
+    }
+
+    //The same frames one at a time give the reference outputs
+    int num_frames = 10;
+    std::vector<float> reference(1000*num_frames);
+    for(int f = 0; f < num_frames; ++f){
+        std::vector<float*> input_data{(float*)input_images[f%2].data};
+        std::vector<float*> ofmap{reference.data() + 1000*f};
+        EXPECT_TRUE(accl.send_input(input_data, 0, 0));
+        EXPECT_TRUE(accl.receive_output(ofmap, 0, 0));
+    }
+
+    std::vector<float> batch_output;
+    run_batch(accl, input_images, num_frames, 0, batch_output);
+    EXPECT_EQ(reference, batch_output);
+    for(int f = 0; f < num_frames; ++f){
+        vector<float> floatVector(batch_output.begin() + 1000*f, batch_output.begin() + 1000*(f+1));
+        vector<size_t> top5 = getTopNMaxIndices(floatVector, 5);
+        EXPECT_EQ(f%2 == 0 ? 235 : 949, top5[0]);
+    }
+
+    //A batch on another stream after the first one
+    std::vector<float> batch_output_1;
+    run_batch(accl, input_images, num_frames, 1, batch_output_1);
+    EXPECT_EQ(reference, batch_output_1);
+}
+
+TEST(accl_manual_threading_accuracy_test, mobilenet_batch_failover){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    MX::Runtime::MxAcclMT accl;
+    accl.connect_dfp(model_path);
+    MX::Types::FailoverPolicy policy;
+    policy.recovery_backoff_ms = 10;
+    accl.set_failover_policy(policy);
+
+    std::vector<cv::Mat> input_images;
+    for(int stream_idx = 0; stream_idx < 2; ++stream_idx){
+        fs::path img_path = mx_accl_path/"tests"/images[stream_idx];
+        input_images.push_back(mobilenet_load_image(img_path.c_str()));
+    }
+
+    //The frame read from context 0 with the fault is lost and its receive throws
+    accl.inject_context_fault(0);
+    std::vector<float> output(1000);
+    std::vector<float*> ofmap{output.data()};
+    std::vector<float*> input_data{(float*)input_images[0].data};
+    int num_contexts = static_cast<int>(accl.get_context_health().size());
+    bool lost = false;
+    for(int i = 0; i < num_contexts && !lost; ++i){
+        EXPECT_TRUE(accl.send_input(input_data, 0, 0));
+        try{
+            EXPECT_TRUE(accl.receive_output(ofmap, 0, 0));
+        }
+        catch(const std::runtime_error&){
+            lost = true;
+        }
+    }
+    EXPECT_TRUE(lost);
+    EXPECT_TRUE(accl.wait_context_recovery(5000));
+    std::vector<MX::Types::ContextHealth> health = accl.get_context_health();
+    EXPECT_EQ(health[0].recoveries, 1u);
+
+    //Batched frames sent after the recovery all come back, from every context
+    int num_frames = 4*num_contexts;
+    std::vector<float> batch_output;
+    run_batch(accl, input_images, num_frames, 0, batch_output);
+    for(int f = 0; f < num_frames; ++f){
+        vector<float> floatVector(batch_output.begin() + 1000*f, batch_output.begin() + 1000*(f+1));
+        vector<size_t> top5 = getTopNMaxIndices(floatVector, 5);
+        EXPECT_EQ(f%2 == 0 ? 235 : 949, top5[0]);
+    }
+
+    //Single frames still follow the batch on the same stream
+    EXPECT_TRUE(accl.send_input(input_data, 0, 0));
+    EXPECT_TRUE(accl.receive_output(ofmap, 0, 0));
+    vector<size_t> top5 = getTopNMaxIndices(output, 5);
+    EXPECT_EQ(235, top5[0]);
+}
+
+TEST(accl_manual_threading_accuracy_test, mobilenet_large_batch){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    MX::Runtime::MxAcclMT accl;
+    accl.connect_dfp(model_path);
+
+    std::vector<cv::Mat> input_images;
+    for(int stream_idx = 0; stream_idx < 2; ++stream_idx){
+        fs::path img_path = mx_accl_path/"tests"/images[stream_idx];
+        input_images.push_back(mobilenet_load_image(img_path.c_str()));
+    }
+
+    //Far more frames than the device can buffer, sent whole before any output is received on the same thread
+    int num_frames = 256;
+    std::vector<float> batch_output;
+    run_batch(accl, input_images, num_frames, 0, batch_output);
+    for(int f = 0; f < num_frames; ++f){
+        vector<float> floatVector(batch_output.begin() + 1000*f, batch_output.begin() + 1000*(f+1));
+        vector<size_t> top5 = getTopNMaxIndices(floatVector, 5);
+        EXPECT_EQ(f%2 == 0 ? 235 : 949, top5[0]);
+    }
+
+    //Single frames before and after a batch come out in send order
+    std::vector<float> output(1000);
+    std::vector<float*> ofmap{output.data()};
+    std::vector<float*> input_data{(float*)input_images[1].data};
+    EXPECT_TRUE(accl.send_input(input_data, 0, 1));
+    std::vector<std::vector<float*>> batch(num_frames, std::vector<float*>{(float*)input_images[0].data});
+    EXPECT_TRUE(accl.send_batch(batch, 0, 1));
+    EXPECT_TRUE(accl.receive_output(ofmap, 0, 1));
+    EXPECT_EQ(949, getTopNMaxIndices(output, 5)[0]);
+    for(int f = 0; f < num_frames; ++f){
+        EXPECT_TRUE(accl.receive_output(ofmap, 0, 1));
+        EXPECT_EQ(235, getTopNMaxIndices(output, 5)[0]);
+    }
+}
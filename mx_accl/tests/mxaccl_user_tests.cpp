@@ -523,7 +523,8 @@ TEST(accl_user_tests,invalid_dfp_connect){
     fs::path model_path = dfp_path/"mobilenet.dfp";
     MX::Runtime::MxAccl accl;
     accl.connect_dfp(model_path);
-    const char* expected_exception = "Only one dfp allowed per Accl object";
+    //a second dfp needs devices of its own
+    const char* expected_exception = "Device 0 is already used by another dfp of this object";
     try
     {
         accl.connect_dfp(model_path);
@@ -537,11 +538,33 @@ TEST(accl_user_tests,invalid_dfp_connect){
     }   
 }
 
+TEST(accl_user_tests,duplicate_device_connect){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    MX::Runtime::MxAccl accl;
+    std::vector<int> device_ids = {0, 0};
+    const char* expected_exception = "Device 0 is listed more than once";
+    try
+    {
+        accl.connect_dfp(model_path, device_ids);
+    }
+    catch(std::exception const & err)
+    {
+        EXPECT_EQ(std::string(err.what()),expected_exception);
+    }
+    catch(...){
+        FAIL()<< expected_exception;
+    }   
+    //nothing was locked, the device can still be connected
+    std::vector<int> device_id = {0};
+    accl.connect_dfp(model_path, device_id);
+    GTEST_ASSERT_EQ(1,accl.get_num_dfps());
+}
+
 TEST(accl_user_tests,invalid_connect_stream){
     fs::path model_path = dfp_path/"mobilenet.dfp";
     MX::Runtime::MxAccl accl;
     accl.connect_dfp(model_path);
-    const char* expected_exception = "only one dfp per MxAccl allowed";
+    const char* expected_exception = "Invalid dfp ID passed : Number of dfps connected = 1\n dfp_id range is 0 to 0";
     try
     {
         accl.connect_stream(input_callback,output_callback,0,0,1);
@@ -555,11 +578,54 @@ TEST(accl_user_tests,invalid_connect_stream){
     }   
 }
 
+TEST(accl_user_tests,invalid_connect_pipeline){
+    fs::path model_path = dfp_path/"identity_multimodel.dfp";
+    MX::Runtime::MxAccl accl;
+    accl.connect_dfp(model_path);
+    EXPECT_THROW(accl.connect_pipeline(0,0), std::invalid_argument);
+    EXPECT_THROW(accl.connect_pipeline(0,2), std::runtime_error);
+    //the identity models take 3 values and return 1, so one can't feed the other
+    EXPECT_THROW(accl.connect_pipeline(0,1), std::invalid_argument);
+    accl.connect_stream(input_callback,output_callback,0);
+    const char* expected_exception = "connect_pipeline has to be called before connecting streams to the upstream model";
+    try
+    {
+        accl.connect_pipeline(0,1);
+    }
+    catch(std::logic_error const & err)
+    {
+        EXPECT_EQ(std::string(err.what()),expected_exception);
+    }
+    catch(...){
+        FAIL()<< expected_exception;
+    }
+}
+
+TEST(accl_user_tests,invalid_attach_stream){
+    fs::path model_path = dfp_path/"mobilenet.dfp";
+    MX::Runtime::MxAccl accl;
+    accl.connect_dfp(model_path);
+    EXPECT_THROW(accl.set_max_streams(0), std::logic_error);
+    accl.set_max_streams(1);
+    accl.connect_stream(&input_callback,&output_callback,0);
+    EXPECT_THROW(accl.detach_stream(1), std::runtime_error);
+    accl.start();
+    EXPECT_THROW(accl.attach_stream(&input_callback,&output_callback,0), std::invalid_argument);
+    //the model holds a single stream
+    EXPECT_THROW(accl.attach_stream(&input_callback,&output_callback,1), std::runtime_error);
+    accl.detach_stream(0);
+    accl.attach_stream(&input_callback,&output_callback,1);
+    accl.wait();
+    accl.stop();
+    GTEST_ASSERT_EQ(1,accl.get_num_streams());
+}
+
 TEST(accl_manual_user_tests,invalid_dfp_connect){
     fs::path model_path = dfp_path/"mobilenet.dfp";
     MX::Runtime::MxAcclMT accl;
     accl.connect_dfp(model_path);
-    const char* expected_exception = "Only one dfp allowed per Accl object";
+    //a second dfp needs devices of its own
+    const char* expected_exception = "Device 0 is already used by another dfp of this object";
     try
     {
         accl.connect_dfp(model_path);
@@ -577,7 +643,7 @@ TEST(accl_manual_user_tests,invalid_send_input){
     fs::path model_path = dfp_path/"mobilenet.dfp";
     MX::Runtime::MxAcclMT accl;
     accl.connect_dfp(model_path);
-    const char* expected_exception = "only one dfp per MxAccl allowed";
+    const char* expected_exception = "Invalid dfp ID passed : Number of dfps connected = 1\n dfp_id range is 0 to 0";
     std::vector<float*> dummy;
     try
     {
@@ -608,7 +674,7 @@ TEST(accl_manual_user_tests,invalid_recv_output){
     fs::path model_path = dfp_path/"mobilenet.dfp";
     MX::Runtime::MxAcclMT accl;
     accl.connect_dfp(model_path);
-    const char* expected_exception = "only one dfp per MxAccl allowed";
+    const char* expected_exception = "Invalid dfp ID passed : Number of dfps connected = 1\n dfp_id range is 0 to 0";
     std::vector<float*> dummy;
     try
     {
@@ -639,7 +705,7 @@ TEST(accl_manual_user_tests,invalid_run){
     fs::path model_path = dfp_path/"mobilenet.dfp";
     MX::Runtime::MxAcclMT accl;
     accl.connect_dfp(model_path);
-    const char* expected_exception = "only one dfp per MxAccl allowed";
+    const char* expected_exception = "Invalid dfp ID passed : Number of dfps connected = 1\n dfp_id range is 0 to 0";
     std::vector<float*> dummy;
     try
     {
@@ -1,6 +1,17 @@
 #include <gtest/gtest.h>
 #include "memx/accl/prepost.h"
 #include "memx/accl/utils/featureMap.h"
+#include "memx/accl/utils/stream_scheduler.hpp"
+#include "memx/accl/utils/stream_slot_table.hpp"
+#include "memx/accl/utils/context_dispatcher.hpp"
+#include "memx/accl/utils/model_swap_scheduler.hpp"
+#include "memx/accl/utils/context_allocator.hpp"
+#include "memx/accl/utils/context_health.hpp"
+#include "memx/accl/utils/power_governor.hpp"
+#include "memx/accl/utils/device_state.h"
+#include "memx/accl/utils/thread_pool.hpp"
+#include "memx/accl/utils/thread_policy.h"
+#include "memx/accl/utils/awaitable.hpp"
 namespace fs = std::filesystem;
 
 TEST(accl_utility_tests, split_func){
@@ -338,3 +349,714 @@ TEST(accl_utility_tests, pre_name_mismatch){
     }
     delete obj;
 }
+
+TEST(accl_utility_tests, scheduler_round_robin){
+    MX::Utils::stream_scheduler<int> sched;
+    sched.set_policy(MX::Types::SCHEDULE_ROUND_ROBIN);
+    sched.add_stream(MX::Types::StreamOptions());
+    sched.add_stream(MX::Types::StreamOptions());
+    for(int i = 0; i < 3; ++i){
+        sched.push(0, i);
+    }
+    sched.push(1, 10);
+    sched.push(1, 11);
+    std::vector<int> order;
+    int item;
+    while(sched.pop(item)){
+        order.push_back(item);
+    }
+    EXPECT_EQ(order, std::vector<int>({0, 10, 1, 11, 2}));
+    EXPECT_EQ(sched.stats(0).frames_sent, 3u);
+    EXPECT_EQ(sched.stats(1).frames_sent, 2u);
+}
+
+TEST(accl_utility_tests, scheduler_weighted_fair){
+    MX::Utils::stream_scheduler<int> sched;
+    sched.set_policy(MX::Types::SCHEDULE_WEIGHTED_FAIR);
+    MX::Types::StreamOptions heavy;
+    heavy.weight = 3;
+    sched.add_stream(MX::Types::StreamOptions());
+    sched.add_stream(heavy);
+    for(int i = 0; i < 8; ++i){
+        sched.push(0, 0);
+        sched.push(1, 1);
+    }
+    //While both streams are backlogged stream 1 gets three frames for every frame of stream 0
+    int served[2] = {0, 0};
+    int item;
+    for(int i = 0; i < 8; ++i){
+        ASSERT_TRUE(sched.pop(item));
+        served[item]++;
+    }
+    EXPECT_EQ(served[0], 2);
+    EXPECT_EQ(served[1], 6);
+}
+
+TEST(accl_utility_tests, scheduler_priority){
+    MX::Utils::stream_scheduler<int> sched;
+    sched.set_policy(MX::Types::SCHEDULE_PRIORITY);
+    MX::Types::StreamOptions high;
+    high.priority = 5;
+    sched.add_stream(MX::Types::StreamOptions());
+    sched.add_stream(high);
+    sched.push(0, 0);
+    sched.push(0, 1);
+    sched.push(1, 10);
+    int item;
+    ASSERT_TRUE(sched.pop(item));
+    EXPECT_EQ(item, 10);
+    ASSERT_TRUE(sched.pop(item));
+    EXPECT_EQ(item, 0);
+}
+
+TEST(accl_utility_tests, scheduler_deadline){
+    MX::Utils::stream_scheduler<int> sched;
+    sched.set_policy(MX::Types::SCHEDULE_DEADLINE);
+    MX::Types::StreamOptions relaxed, urgent;
+    relaxed.deadline_us = 1000000;
+    urgent.deadline_us = 1000;
+    sched.add_stream(relaxed);
+    sched.add_stream(urgent);
+    sched.add_stream(MX::Types::StreamOptions());
+    sched.push(2, 20);
+    sched.push(0, 0);
+    sched.push(1, 10);
+    int item;
+    ASSERT_TRUE(sched.pop(item));
+    EXPECT_EQ(item, 10);
+    ASSERT_TRUE(sched.pop(item));
+    EXPECT_EQ(item, 0);
+    ASSERT_TRUE(sched.pop(item));
+    EXPECT_EQ(item, 20);
+    EXPECT_FALSE(sched.pop(item));
+}
+
+TEST(accl_utility_tests, scheduler_invalid_weight){
+    MX::Utils::stream_scheduler<int> sched;
+    MX::Types::StreamOptions options;
+    options.weight = 0;
+    EXPECT_THROW(sched.add_stream(options), std::invalid_argument);
+}
+
+TEST(accl_utility_tests, scheduler_freshest_only){
+    MX::Utils::stream_scheduler<int> sched;
+    MX::Types::StreamOptions live;
+    live.freshest_only = true;
+    sched.add_stream(live);
+    sched.add_stream(MX::Types::StreamOptions());
+    EXPECT_FALSE(sched.push(0, 0).has_value());
+    sched.push(1, 10);
+    //The newer frame takes the place of the queued one and hands it back
+    std::optional<int> dropped = sched.push(0, 1);
+    ASSERT_TRUE(dropped.has_value());
+    EXPECT_EQ(*dropped, 0);
+    EXPECT_FALSE(sched.push(1, 11).has_value());
+    EXPECT_EQ(sched.size(), 3u);
+    int item;
+    ASSERT_TRUE(sched.pop(item));
+    EXPECT_EQ(item, 1);
+    EXPECT_EQ(sched.stats(0).frames_dropped, 1u);
+    EXPECT_EQ(sched.stats(1).frames_dropped, 0u);
+}
+
+TEST(accl_utility_tests, scheduler_reset_stream){
+    MX::Utils::stream_scheduler<int> sched;
+    sched.set_policy(MX::Types::SCHEDULE_PRIORITY);
+    sched.add_stream(MX::Types::StreamOptions());
+    sched.add_stream(MX::Types::StreamOptions());
+    sched.push(0, 0);
+    sched.push(1, 10);
+    EXPECT_THROW(sched.reset_stream(0, MX::Types::StreamOptions()), std::logic_error);
+    int item;
+    ASSERT_TRUE(sched.pop(item));
+    EXPECT_EQ(item, 0);
+    //A stream attached later takes the index of stream 0 with its own options and fresh statistics
+    MX::Types::StreamOptions high;
+    high.priority = 5;
+    sched.reset_stream(0, high);
+    EXPECT_EQ(sched.stats(0).frames_sent, 0u);
+    sched.push(0, 1);
+    ASSERT_TRUE(sched.pop(item));
+    EXPECT_EQ(item, 1);
+    ASSERT_TRUE(sched.pop(item));
+    EXPECT_EQ(item, 10);
+}
+
+TEST(accl_utility_tests, stream_slot_table){
+    MX::Utils::stream_slot_table table(3);
+    EXPECT_EQ(table.find(7), -1);
+    //slots are given in registration order, whatever the ids
+    EXPECT_EQ(table.insert(1000), 0);
+    EXPECT_EQ(table.insert(-5), 1);
+    EXPECT_EQ(table.insert(1000), 0);
+    EXPECT_EQ(table.insert(7), 2);
+    EXPECT_EQ(table.insert(8), -1);
+    EXPECT_EQ(table.size(), 3u);
+    EXPECT_EQ(table.find(-5), 1);
+    EXPECT_EQ(table.find(7), 2);
+    EXPECT_EQ(table.find(8), -1);
+    table.reset(2);
+    EXPECT_EQ(table.size(), 0u);
+    EXPECT_EQ(table.capacity(), 2u);
+    EXPECT_EQ(table.find(1000), -1);
+}
+
+TEST(accl_utility_tests, stream_slot_table_concurrent_find){
+    const int num_streams = 256;
+    MX::Utils::stream_slot_table table(num_streams);
+    std::atomic_bool bad_slot{false};
+    std::thread reader([&](){
+        //a stream is either missing or found at its final slot while the writer inserts
+        for(int seen = 0; seen < num_streams;){
+            seen = 0;
+            for(int id = 0; id < num_streams; ++id){
+                int slot = table.find(id*3);
+                if(slot >= 0){
+                    bad_slot.store(bad_slot.load() || slot != id);
+                    seen++;
+                }
+            }
+        }
+    });
+    for(int id = 0; id < num_streams; ++id){
+        table.insert(id*3);
+    }
+    reader.join();
+    EXPECT_FALSE(bad_slot.load());
+}
+
+TEST(accl_utility_tests, dispatcher_least_outstanding){
+    MX::Utils::context_dispatcher dispatcher;
+    dispatcher.reset(2, 4);
+    MX::Types::DispatchOptions options;
+    options.policy = MX::Types::DISPATCH_LEAST_OUTSTANDING;
+    dispatcher.set_options(options);
+    //context 1 takes four times as long per frame as context 0
+    dispatcher.take(0);
+    dispatcher.complete(0, 1000, 1);
+    dispatcher.take(1);
+    dispatcher.complete(1, 4000, 1);
+    int counts[2] = {0, 0};
+    for(int i = 0; i < 10; ++i){
+        counts[dispatcher.acquire(i % 4)]++;
+    }
+    EXPECT_EQ(counts[0], 8);
+    EXPECT_EQ(counts[1], 2);
+    EXPECT_EQ(dispatcher.in_flight(0), 8);
+    MX::Types::DispatchStats stats = dispatcher.stats();
+    ASSERT_EQ(stats.contexts.size(), 2u);
+    EXPECT_EQ(stats.contexts[0].frames_sent, 9u);
+    EXPECT_EQ(stats.contexts[0].max_in_flight, 8);
+    EXPECT_DOUBLE_EQ(stats.contexts[1].avg_latency_us, 4.0);
+    EXPECT_NEAR(stats.imbalance, 0.5, 1e-9);
+}
+
+TEST(accl_utility_tests, dispatcher_stream_affinity){
+    MX::Utils::context_dispatcher dispatcher;
+    dispatcher.reset(3, 2);
+    //plain round robin hands out the contexts in turn
+    EXPECT_EQ(dispatcher.acquire(0), 0);
+    EXPECT_EQ(dispatcher.acquire(0), 1);
+    EXPECT_EQ(dispatcher.acquire(0), 2);
+    MX::Types::DispatchOptions options;
+    options.stream_affinity = true;
+    dispatcher.set_options(options);
+    int ctx = dispatcher.acquire(1);
+    EXPECT_EQ(dispatcher.acquire(1), ctx);
+    EXPECT_EQ(dispatcher.acquire(1), ctx);
+    dispatcher.release_stream(1);
+    EXPECT_NE(dispatcher.acquire(1), ctx);
+    dispatcher.cancel(ctx);
+    EXPECT_EQ(dispatcher.stats().contexts[ctx].frames_sent, 3u);
+}
+
+TEST(accl_utility_tests, dispatcher_failed_frames_stay_sent){
+    MX::Utils::context_dispatcher dispatcher;
+    dispatcher.reset(2, 1);
+    int ctx = dispatcher.acquire(0);
+    dispatcher.take(ctx);
+    //the first frame never made it to the context, the second was lost on it
+    dispatcher.cancel(ctx);
+    dispatcher.fail(ctx);
+    EXPECT_EQ(dispatcher.in_flight(ctx), 0);
+    MX::Types::DispatchStats stats = dispatcher.stats();
+    EXPECT_EQ(stats.contexts[ctx].frames_sent, 1u);
+    EXPECT_EQ(stats.contexts[ctx].in_flight, 0);
+    EXPECT_DOUBLE_EQ(stats.contexts[ctx].avg_latency_us, 0.0);
+}
+
+TEST(accl_utility_tests, swap_scheduler_drains_before_swap){
+    std::vector<std::pair<int,int>> swaps;
+    MX::Utils::model_swap_scheduler scheduler([&swaps](int from, int to){ swaps.push_back({from, to}); }, 0);
+    scheduler.add_member();
+    scheduler.add_member();
+    //member 0 is resident and sends right away
+    ASSERT_TRUE(scheduler.enter(0, 1, 0));
+    scheduler.leave(0, 1);
+    //member 1 can't be swapped in before the frame of member 0 is read back
+    EXPECT_FALSE(scheduler.enter(1, 1, 20));
+    EXPECT_TRUE(swaps.empty());
+    std::thread waiting([&scheduler](){
+        ASSERT_TRUE(scheduler.enter(1, 1, 0));
+        scheduler.leave(1, 1);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    scheduler.complete(0);
+    waiting.join();
+    scheduler.complete(1);
+    ASSERT_EQ(swaps.size(), 1u);
+    EXPECT_EQ(swaps[0], std::make_pair(0, 1));
+    MX::Types::SwapStats stats = scheduler.stats();
+    EXPECT_EQ(stats.resident, 1);
+    EXPECT_EQ(stats.swaps, 1u);
+    EXPECT_EQ(stats.frames_sent, std::vector<uint64_t>({1, 1}));
+    scheduler.stop();
+    EXPECT_FALSE(scheduler.enter(0, 1, 0));
+}
+
+TEST(accl_utility_tests, swap_scheduler_batches){
+    std::atomic<int> on_device[2] = {0, 0};
+    std::atomic<bool> overlap{false};
+    MX::Utils::model_swap_scheduler scheduler([&](int from, int){
+        if(from >= 0 && on_device[from].load() != 0){
+            overlap = true;
+        }
+    });
+    scheduler.add_member();
+    scheduler.add_member();
+    scheduler.set_batch_size(10);
+    auto sender = [&](int member){
+        for(int i = 0; i < 200; ++i){
+            ASSERT_TRUE(scheduler.enter(member, 1, 0));
+            on_device[member]++;
+            if(on_device[1 - member].load() != 0){
+                overlap = true;
+            }
+            scheduler.leave(member, 1);
+            on_device[member]--;
+            scheduler.complete(member);
+        }
+    };
+    std::thread first(sender, 0);
+    std::thread second(sender, 1);
+    first.join();
+    second.join();
+    EXPECT_FALSE(overlap.load());
+    MX::Types::SwapStats stats = scheduler.stats();
+    EXPECT_EQ(stats.frames_sent, std::vector<uint64_t>({200, 200}));
+    EXPECT_GE(stats.swaps, 1u);
+}
+
+TEST(accl_utility_tests, swap_scheduler_keeps_busy_member){
+    int num_swaps = 0;
+    MX::Utils::model_swap_scheduler scheduler([&num_swaps](int, int){ num_swaps++; }, 0);
+    scheduler.add_member();
+    scheduler.add_member();
+    scheduler.set_batch_size(2);
+    ASSERT_TRUE(scheduler.enter(0, 1, 0));
+    scheduler.leave(0, 1);
+    //member 0 has a frame on the device and half of its batch left, so it keeps the devices
+    std::thread waiting([&scheduler](){
+        ASSERT_TRUE(scheduler.enter(1, 1, 0));
+        scheduler.leave(1, 1);
+        scheduler.complete(1);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_TRUE(scheduler.enter(0, 1, 0));
+    scheduler.leave(0, 1);
+    EXPECT_EQ(num_swaps, 0);
+    //its batch is used up, member 1 gets the devices once both frames are read
+    EXPECT_FALSE(scheduler.enter(0, 1, 20));
+    scheduler.complete(0);
+    scheduler.complete(0);
+    waiting.join();
+    EXPECT_EQ(num_swaps, 1);
+    EXPECT_EQ(scheduler.resident(), 1);
+}
+
+TEST(accl_utility_tests, context_health_recovers){
+    std::atomic_int resets = 0;
+    //the first reset fails, the second one brings the context back
+    MX::Utils::context_health health(2, [&resets](int context_idx){
+        EXPECT_EQ(context_idx, 1);
+        if(resets++ == 0){
+            throw std::runtime_error("download failed");
+        }
+    });
+    MX::Types::FailoverPolicy policy;
+    policy.recovery_backoff_ms = 1;
+    health.set_policy(policy);
+    uint32_t generation = health.generation(1);
+    EXPECT_TRUE(health.report_failure(1, generation, "ofmap failed"));
+    //frames sent before the failure report it again, it is counted once
+    EXPECT_FALSE(health.report_failure(1, generation, "ofmap failed"));
+    EXPECT_TRUE(health.healthy(0));
+    EXPECT_TRUE(health.any_healthy());
+    EXPECT_TRUE(health.wait_recovery(5000));
+    EXPECT_EQ(resets.load(), 2);
+    EXPECT_TRUE(health.healthy(1));
+    EXPECT_NE(health.generation(1), generation);
+    std::vector<MX::Types::ContextHealth> stats = health.stats();
+    EXPECT_EQ(stats[1].failures, 1u);
+    EXPECT_EQ(stats[1].recoveries, 1u);
+    EXPECT_EQ(stats[1].last_error, "ofmap failed");
+    EXPECT_EQ(stats[0].failures, 0u);
+}
+
+TEST(accl_utility_tests, context_health_gives_up){
+    MX::Utils::context_health health(1, [](int){ throw std::runtime_error("download failed"); });
+    MX::Types::FailoverPolicy policy;
+    policy.max_recovery_attempts = 2;
+    policy.recovery_backoff_ms = 1;
+    health.set_policy(policy);
+    EXPECT_TRUE(health.report_failure(0, health.generation(0), "ofmap failed"));
+    EXPECT_TRUE(health.wait_recovery(5000));
+    EXPECT_FALSE(health.healthy(0));
+    EXPECT_FALSE(health.any_healthy());
+    MX::Types::ContextHealth stats = health.stats()[0];
+    EXPECT_FALSE(stats.recovering);
+    EXPECT_EQ(stats.recoveries, 0u);
+    EXPECT_EQ(stats.last_error, "download failed");
+}
+
+TEST(accl_utility_tests, context_health_injected_faults){
+    int resets = 0;
+    MX::Utils::context_health health(1, [&resets](int){ resets++; });
+    health.set_recovery(false);
+    health.inject_fault(0, 2);
+    EXPECT_TRUE(health.take_fault(0));
+    EXPECT_TRUE(health.take_fault(0));
+    EXPECT_FALSE(health.take_fault(0));
+    //without recovery the context stays failed
+    EXPECT_TRUE(health.report_failure(0, health.generation(0), "injected fault"));
+    EXPECT_TRUE(health.wait_recovery(0));
+    EXPECT_FALSE(health.healthy(0));
+    EXPECT_EQ(resets, 0);
+}
+
+TEST(accl_utility_tests, power_governor_balanced){
+    MX::Utils::power_governor::load_sample load;
+    std::vector<int> applied;
+    MX::Utils::power_governor governor({3}, {400}, [&load](int){ return load; }, [&applied](int device_idx, int frequency){
+        EXPECT_EQ(device_idx, 0);
+        applied.push_back(frequency);
+    });
+    MX::Types::PowerPolicy policy;
+    policy.profile = MX::Types::POWER_BALANCED;
+    policy.hold_intervals = 2;
+    governor.set_policy(policy);
+    //a busy device is raised right away, up to the maximum
+    load.in_flight = 1;
+    for(int i = 0; i < 3; ++i){
+        governor.sample_load();
+        governor.evaluate();
+    }
+    EXPECT_EQ(applied, (std::vector<int>{500, 600}));
+    //an idle device is lowered after hold_intervals idle intervals, a busy interval starts the count again
+    load.in_flight = 0;
+    governor.sample_load();
+    governor.evaluate();
+    load.in_flight = 1;
+    governor.sample_load();
+    governor.evaluate();
+    load.in_flight = 0;
+    governor.sample_load();
+    governor.evaluate();
+    EXPECT_EQ(applied.size(), 2u);
+    governor.sample_load();
+    governor.evaluate();
+    EXPECT_EQ(applied.back(), 500);
+    MX::Types::DevicePowerStats stats = governor.stats()[0];
+    EXPECT_EQ(stats.device_id, 3);
+    EXPECT_EQ(stats.frequency, 500);
+    EXPECT_EQ(stats.changes, 3u);
+    EXPECT_EQ(stats.utilization, 0);
+}
+
+TEST(accl_utility_tests, power_governor_profiles){
+    MX::Utils::power_governor::load_sample load;
+    bool refuse = false;
+    MX::Utils::power_governor governor({0}, {600}, [&load](int){ return load; }, [&refuse](int, int){
+        if(refuse){
+            throw std::runtime_error("set_feature failed");
+        }
+    });
+    MX::Types::PowerPolicy policy;
+    policy.profile = MX::Types::POWER_EFFICIENCY;
+    policy.hold_intervals = 1;
+    governor.set_policy(policy);
+    //a busy device without a queue is lowered, frames queuing up raise it again
+    load.in_flight = 1;
+    governor.sample_load();
+    governor.evaluate();
+    EXPECT_EQ(governor.stats()[0].frequency, 500);
+    load.queued = 2;
+    governor.sample_load();
+    governor.evaluate();
+    EXPECT_EQ(governor.stats()[0].frequency, 600);
+    //a refused change keeps the frequency
+    policy.profile = MX::Types::POWER_STATIC;
+    governor.set_policy(policy);
+    load.queued = 0;
+    governor.evaluate();
+    EXPECT_EQ(governor.stats()[0].frequency, 600);
+    refuse = true;
+    policy.profile = MX::Types::POWER_EFFICIENCY;
+    policy.min_frequency = 200;
+    policy.max_frequency = 400;
+    governor.set_policy(policy);
+    governor.evaluate();
+    EXPECT_EQ(governor.stats()[0].frequency, 600);
+    EXPECT_EQ(governor.stats()[0].errors, 1u);
+    refuse = false;
+    governor.evaluate();
+    EXPECT_EQ(governor.stats()[0].frequency, 400);
+}
+
+TEST(accl_utility_tests, power_governor_thread){
+    std::atomic_int frequency = 300;
+    MX::Utils::power_governor governor({0}, {300}, [](int){ return MX::Utils::power_governor::load_sample(); },
+                                       [&frequency](int, int value){ frequency = value; });
+    MX::Types::PowerPolicy policy;
+    policy.profile = MX::Types::POWER_PERFORMANCE;
+    policy.interval_ms = 10;
+    governor.set_policy(policy);
+    governor.start();
+    for(int i = 0; i < 500 && frequency.load() != 600; ++i){
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    governor.stop();
+    EXPECT_EQ(frequency.load(), 600);
+}
+
+TEST(accl_utility_tests, context_allocator_ownership){
+    MX::Utils::context_allocator allocator(4);
+    int owner_a = 0;
+    int owner_b = 0;
+    //the lowest free id first, whatever the dfp or owner
+    EXPECT_EQ(allocator.allocate(&owner_a, 0), 0);
+    EXPECT_EQ(allocator.allocate(&owner_a, 1), 1);
+    EXPECT_EQ(allocator.allocate(&owner_b, 0), 2);
+    EXPECT_TRUE(allocator.owned_by(1, &owner_a, 1));
+    EXPECT_FALSE(allocator.owned_by(1, &owner_a, 0));
+    EXPECT_FALSE(allocator.owned_by(2, &owner_a, 0));
+    EXPECT_EQ(allocator.owned(&owner_a, 0), (std::vector<int>{0}));
+    allocator.release(0);
+    EXPECT_EQ(allocator.allocate(&owner_b, 1), 0);
+    EXPECT_EQ(allocator.allocate(&owner_b, 1), 3);
+    EXPECT_EQ(allocator.num_free(), 0);
+    EXPECT_THROW(allocator.allocate(&owner_a, 0), std::runtime_error);
+    allocator.release_owner(&owner_b);
+    EXPECT_EQ(allocator.num_free(), 3);
+    EXPECT_EQ(allocator.owned(&owner_a, 1), (std::vector<int>{1}));
+    EXPECT_TRUE(allocator.owned(&owner_b, 1).empty());
+}
+
+TEST(accl_utility_tests, context_allocator_threads){
+    MX::Utils::context_allocator allocator;
+    std::vector<std::vector<int>> contexts(4);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t){
+        threads.emplace_back([&allocator, &contexts, t]{
+            for(int i = 0; i < MX::Utils::context_allocator::max_contexts / 4; ++i){
+                contexts[t].push_back(allocator.allocate(&allocator, t));
+            }
+        });
+    }
+    for(std::thread& th : threads){
+        th.join();
+    }
+    //every id is given out once
+    std::vector<int> all;
+    for(int t = 0; t < 4; ++t){
+        EXPECT_EQ(allocator.owned(&allocator, t), contexts[t]);
+        all.insert(all.end(), contexts[t].begin(), contexts[t].end());
+    }
+    std::sort(all.begin(), all.end());
+    for(int ctx = 0; ctx < MX::Utils::context_allocator::max_contexts; ++ctx){
+        EXPECT_EQ(all[ctx], ctx);
+    }
+}
+
+TEST(accl_utility_tests, device_state_round_trip){
+    const uint8_t dfp[] = {'a'};
+    EXPECT_EQ(MX::Utils::hash_bytes(dfp, 1), 0xaf63dc4c8601ec8cull);
+    MX::Utils::device_state state;
+    state.mpu_config = 1;
+    state.power_chips = 2;
+    state.frequency = 600;
+    state.voltage = 700;
+    state.context_dfp[4] = MX::Utils::hash_bytes(dfp, 1);
+    state.context_dfp[5] = 1;
+    //an id no device has, so the test doesn't touch the state of a real device
+    const int device_id = 250;
+    MX::Utils::save_device_state(device_id, state);
+    MX::Utils::device_state loaded = MX::Utils::load_device_state(device_id);
+    EXPECT_EQ(loaded.mpu_config, 1);
+    EXPECT_EQ(loaded.power_chips, 2);
+    EXPECT_EQ(loaded.frequency, 600);
+    EXPECT_EQ(loaded.voltage, 700);
+    EXPECT_EQ(loaded.context_dfp, state.context_dfp);
+    fs::remove(MX::Utils::device_state_dir()/"device_250.state");
+    loaded = MX::Utils::load_device_state(device_id);
+    EXPECT_EQ(loaded.mpu_config, -1);
+    EXPECT_TRUE(loaded.context_dfp.empty());
+}
+
+TEST(accl_utility_tests, thread_pool_resize){
+    thread_pool pool("resize_pool", 1, false);
+    EXPECT_EQ(pool.get_num_workers(), 1u);
+    pool.resize(3);
+    EXPECT_EQ(pool.get_num_workers(), 3u);
+    //Three tasks that only finish once all of them run at the same time
+    std::atomic_int started{0};
+    std::atomic_int finished{0};
+    auto task = [&started, &finished]() {
+        started++;
+        auto deadline = std::chrono::steady_clock::now() + 2s;
+        while(started.load() < 3 && std::chrono::steady_clock::now() < deadline){
+            std::this_thread::sleep_for(1ms);
+        }
+        if(started.load() == 3){
+            finished++;
+        }
+        return true;
+    };
+    for(int i = 0; i < 3; ++i){
+        pool.submitTask(task);
+    }
+    auto deadline = std::chrono::steady_clock::now() + 3s;
+    while(finished.load() < 3 && std::chrono::steady_clock::now() < deadline){
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_EQ(finished.load(), 3);
+    pool.resize(1);
+    EXPECT_EQ(pool.get_num_workers(), 1u);
+    pool.stop();
+    EXPECT_TRUE(pool.stopped());
+}
+
+TEST(accl_utility_tests, featuremap_num_fmap_threads){
+    MX::Types::FeatureMap<float> fmap(16);
+    EXPECT_EQ(fmap.get_num_fmap_threads(), 1);
+    fmap.set_num_fmap_threads(4);
+    EXPECT_EQ(fmap.get_num_fmap_threads(), 4);
+    fmap.set_num_fmap_threads(0);
+    EXPECT_EQ(fmap.get_num_fmap_threads(), 1);
+}
+
+TEST(accl_utility_tests, thread_placement_invalid){
+    MX::Types::ThreadPlacement placement;
+    placement.cpus = {-1};
+    EXPECT_THROW(MX::Utils::validate_thread_placement(placement), std::invalid_argument);
+    placement.cpus = {0};
+    placement.rt_priority = 100;
+    EXPECT_THROW(MX::Utils::validate_thread_placement(placement), std::invalid_argument);
+    placement.rt_priority = 0;
+    EXPECT_NO_THROW(MX::Utils::validate_thread_placement(placement));
+}
+
+#ifdef __linux__
+TEST(accl_utility_tests, thread_pool_worker_placement){
+    MX::Types::ThreadPlacement placement;
+    placement.cpus = {0};
+    std::atomic_int pinned{0};
+    std::atomic_int named{0};
+    {
+        thread_pool pool("placement_pool", 2, false, 0, [&placement](size_t index){
+            MX::Utils::set_thread_name("test_pool_" + std::to_string(index));
+            MX::Utils::apply_thread_placement(placement);
+        });
+        for(int i = 0; i < 2; ++i){
+            pool.submitTask([&pinned, &named](){
+                cpu_set_t cpu_set;
+                CPU_ZERO(&cpu_set);
+                pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+                if(CPU_COUNT(&cpu_set) == 1 && CPU_ISSET(0, &cpu_set)){
+                    pinned++;
+                }
+                char name[16] = {0};
+                pthread_getname_np(pthread_self(), name, sizeof(name));
+                if(std::string(name).rfind("test_pool_", 0) == 0){
+                    named++;
+                }
+                return true;
+            });
+        }
+        auto deadline = std::chrono::steady_clock::now() + 2s;
+        while(pinned.load() + named.load() < 4 && std::chrono::steady_clock::now() < deadline){
+            std::this_thread::sleep_for(1ms);
+        }
+        pool.stop();
+    }
+    EXPECT_EQ(pinned.load(), 2);
+    EXPECT_EQ(named.load(), 2);
+}
+
+TEST(accl_utility_tests, featuremap_lock_buffers){
+    MX::Types::FeatureMap<float> fmap(4096);
+    //Locking may be refused by RLIMIT_MEMLOCK, but must not fail twice or leave the buffers unusable
+    fmap.lock_buffers();
+    std::vector<float> in(4096, 1.0f), out(4096, 0.0f);
+    fmap.set_data(in.data());
+    fmap.get_data(out.data());
+    EXPECT_EQ(in, out);
+    fmap.unlock_buffers();
+}
+#endif
+
+#ifdef MX_ACCL_HAS_COROUTINES
+//Minimal eagerly started coroutine to drive the awaitable
+struct test_task{
+    struct promise_type{
+        test_task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+test_task await_completion(MX::Utils::completion_awaitable awaitable, int& state){
+    state = 1;
+    bool ok = co_await awaitable;
+    state = ok ? 2 : 3;
+}
+
+TEST(accl_utility_tests, awaitable_resumes_on_completion){
+    MX::Utils::completion_awaitable::completion_t pending;
+    int state = 0;
+    await_completion(MX::Utils::completion_awaitable([&pending](MX::Utils::completion_awaitable::completion_t on_done){
+        pending = on_done;
+        return true;
+    }), state);
+    //Suspended until the completion is called
+    EXPECT_EQ(1, state);
+    pending(true, 0);
+    EXPECT_EQ(2, state);
+}
+
+TEST(accl_utility_tests, awaitable_not_started){
+    int state = 0;
+    await_completion(MX::Utils::completion_awaitable([](MX::Utils::completion_awaitable::completion_t){
+        return false;
+    }), state);
+    EXPECT_EQ(3, state);
+}
+
+TEST(accl_utility_tests, awaitable_resume_executor){
+    MX::Utils::completion_awaitable::completion_t pending;
+    std::vector<std::coroutine_handle<>> posted;
+    int state = 0;
+    await_completion(MX::Utils::completion_awaitable([&pending](MX::Utils::completion_awaitable::completion_t on_done){
+        pending = on_done;
+        return true;
+    }, [&posted](std::coroutine_handle<> handle){ posted.push_back(handle); }), state);
+    pending(false, 0);
+    //The executor gets the coroutine instead of it being resumed inline
+    EXPECT_EQ(1, state);
+    ASSERT_EQ(1u, posted.size());
+    posted[0].resume();
+    EXPECT_EQ(3, state);
+}
+#endif
@@ -12,6 +12,9 @@
 #include <thread>
 #include <iomanip>
 #include <numeric>
+#include <deque>
+#include <mutex>
+#include <algorithm>
 
 #include "memx/accl/MxAccl.h"
 #include "memx/accl/MxAcclMT.h"
@@ -23,6 +26,19 @@
 #define MT_MODE 1004
 #define MD_IDS 1005
 #define DS_AL 1006
+#define PD_OPT 1007
+#define SCHED_OPT 1008
+#define WEIGHTS_OPT 1009
+#define DEADLINE_OPT 1010
+#define FRESH_OPT 1011
+#define AUTOTUNE_OPT 1012
+#define LATENCY_OPT 1013
+#define PIN_WORKERS_OPT 1014
+#define PIN_IO_OPT 1015
+#define RT_PRIO_OPT 1016
+#define MLOCK_OPT 1017
+#define BATCH_OPT 1018
+#define DEVICE_CACHE_OPT 1019
 
 const char  *default_dfp_path = "model/single_ssd_mobilenet_300_MX3.dfp";
 int frame_count = 1000;
@@ -54,11 +70,34 @@ MX::Runtime::MxAcclMT* accl_mt = NULL;
 
 int num_input_workers = 0;
 int num_output_workers = 0;
+int pipeline_depth = 1;
+MX::Types::StreamSchedulePolicy schedule_policy = MX::Types::SCHEDULE_FIFO;
+std::string schedule_name = "fifo";
+std::vector<int> stream_weights;
+int64_t stream_deadline_us = 0;
+bool freshest_only = false;
+bool auto_tune = false;
+
+// thread placement and latency measurement
+MX::Types::ThreadPolicy thread_policy;
+bool measure_latency = false;
+std::mutex latency_mutex;
+std::vector<std::deque<std::chrono::steady_clock::time_point>> frame_start_times;
+std::vector<double> frame_latencies_us;
+
+// batched sends in manual threading mode
+int batch_size = 1;
+std::atomic<uint64_t> total_send_ns{0};
 int num_devices = 1;
 
+// reuse the setup left on the devices by the previous run
+bool device_cache = false;
+
 //mutit device support
 std::vector<int> device_ids;
 bool multi_device_bench = false;
+// run on every free device that can run the dfp
+bool all_devices = false;
 // multistream variables
 std::vector<int> sent_frame_count_vector;
 std::vector<int> recv_frame_count_vector;
@@ -101,12 +140,71 @@ static void print_usage(int argc, char **argv){
                       "--max_fps              maximum allowed FPS per stream\n"<<
                       "--iw                   number of input pre-processing workers per model\n"<<
                       "--ow                   number of output post-processing workers per model\n"<<
+                      "--pd                   number of in-flight frames per stream (pipeline depth), default= " << pipeline_depth << "\n"<<
+                      "--sched                send stage scheduling policy: fifo, rr, wfq, prio or edf, default= " << schedule_name << "\n"<<
+                      "--weights              comma separated weight (wfq) / priority class (prio) of the streams of each model, default= 1 for all\n"<<
+                      "--deadline_us          per-frame latency budget in microseconds used by edf, default= no deadline\n"<<
+                      "--freshest             drop frames that are replaced by a newer frame before being sent (live video mode)\n"<<
+                      "--autotune             let the runtime resize input/output workers and conversion threads (--iw/--ow/-c become starting points)\n"<<
+                      "--latency              report p50/p99/max latency from input callback to output callback\n"<<
+                      "--pin_workers          CPUs for the input/output workers, e.g. 0-3,8\n"<<
+                      "--pin_io               CPUs for the send/recv threads, e.g. 4,5\n"<<
+                      "--rt_prio              SCHED_FIFO priority (1-99) for the send/recv threads\n"<<
+                      "--mlock                lock and prefault the featureMap buffers\n"<<
+                      "--batch                frames per send_batch/receive_batch call with --mt, default= " << batch_size << " (single-frame API)\n"<<
+                      "--device_cache         skip the device configuration and dfp download already done by the previous run\n"<<
                       "--device_ids           MXA device IDs to be used to run benchmark, used in cases of multi device use cases. Takes in a comma separated list of device IDss\n"<<
-                      "--ls                   Allows lenient setup in multi device use cases, uses available devices in case if some of the passed IDs are not available.\n"<<
+                      "--ls                   Run on every free device that can run the dfp in place of --device_ids\n"<<
                       "--mt                   Runs benchmark tool with Manual Threading model of c++ API\n"
                       " ";
 }
 
+void parse_stream_weights(const std::string& input) {
+    std::stringstream ss(input);
+    std::string token;
+    while (std::getline(ss, token, ',')) {
+        try {
+            stream_weights.push_back(std::stoi(token));
+        } catch (const std::invalid_argument& e) {
+            std::cerr << "Invalid stream weight: " << token << ". Skipping..." << std::endl;
+        }
+    }
+}
+
+std::vector<int> parse_cpu_list(const std::string& input) {
+    std::vector<int> cpus;
+    std::stringstream ss(input);
+    std::string token;
+    while (std::getline(ss, token, ',')) {
+        try {
+            size_t dash = token.find('-');
+            if (dash == std::string::npos) {
+                cpus.push_back(std::stoi(token));
+            } else {
+                int first = std::stoi(token.substr(0, dash));
+                int last = std::stoi(token.substr(dash + 1));
+                for (int cpu = first; cpu <= last; ++cpu) {
+                    cpus.push_back(cpu);
+                }
+            }
+        } catch (const std::invalid_argument& e) {
+            std::cerr << "Invalid cpu: " << token << ". Skipping..." << std::endl;
+        }
+    }
+    return cpus;
+}
+
+bool parse_schedule_policy(const std::string& input) {
+    if(input == "fifo") schedule_policy = MX::Types::SCHEDULE_FIFO;
+    else if(input == "rr") schedule_policy = MX::Types::SCHEDULE_ROUND_ROBIN;
+    else if(input == "wfq") schedule_policy = MX::Types::SCHEDULE_WEIGHTED_FAIR;
+    else if(input == "prio") schedule_policy = MX::Types::SCHEDULE_PRIORITY;
+    else if(input == "edf") schedule_policy = MX::Types::SCHEDULE_DEADLINE;
+    else return false;
+    schedule_name = input;
+    return true;
+}
+
 void parse_device_ids(const std::string& input) {
     std::stringstream ss(input);
     std::string token;
@@ -136,6 +234,19 @@ static const struct option
         {"max_fps", required_argument, 0,MAX_FPS_OPT},
         {"iw", required_argument, 0,IW_OPT},
         {"ow", required_argument, 0,OW_OPT},
+        {"pd", required_argument, 0,PD_OPT},
+        {"sched", required_argument, 0,SCHED_OPT},
+        {"weights", required_argument, 0,WEIGHTS_OPT},
+        {"deadline_us", required_argument, 0,DEADLINE_OPT},
+        {"freshest", no_argument, 0,FRESH_OPT},
+        {"autotune", no_argument, 0,AUTOTUNE_OPT},
+        {"latency", no_argument, 0,LATENCY_OPT},
+        {"pin_workers", required_argument, 0,PIN_WORKERS_OPT},
+        {"pin_io", required_argument, 0,PIN_IO_OPT},
+        {"rt_prio", required_argument, 0,RT_PRIO_OPT},
+        {"mlock", no_argument, 0,MLOCK_OPT},
+        {"batch", required_argument, 0,BATCH_OPT},
+        {"device_cache", no_argument, 0,DEVICE_CACHE_OPT},
         {"mt", no_argument, NULL, MT_MODE},
         {"device_ids", required_argument, 0, MD_IDS},
         {"ls", no_argument, NULL, DS_AL},
@@ -144,6 +255,21 @@ static const struct option
         {0, 0, 0, 0 }};
 
 
+void print_connect_stats(const MX::Types::ConnectStats& stats){
+        std::cout << "Startup: " << stats.total_ms << " ms total, dfp parse " << stats.parse_ms << " ms, device setup "
+                  << stats.setup_ms << " ms, dfp download " << stats.download_ms << " ms ("
+                  << stats.downloads << " downloads, " << stats.downloads_skipped << " skipped, "
+                  << stats.configs_skipped << " configurations skipped" << (device_cache ? ")\n" : ", device cache off)\n");
+}
+
+void print_devices(const std::vector<MX::Types::DeviceCapacity>& devices){
+        num_devices = devices.size();
+        for(const MX::Types::DeviceCapacity& device : devices){
+                std::cout << "Device " << device.device_id << ": " << device.chip_count << " chips, " << device.num_contexts
+                          << " contexts, " << device.traffic_share * 100 << "% of the frames\n";
+        }
+}
+
 void print_model_info(MX::Types::MxModelInfo pmodel_info){
     std::cout << "\033[3;33m*************************************************\n";
     std::cout << "*               Model Information               *\n";
@@ -245,6 +371,10 @@ bool incallback_ms(vector<const MX::Types::FeatureMap<float>*> dst, int streamLa
                 for(int i = 0; i<model_info_vector[streamLabel].num_in_featuremaps; i++){
                         dst[i]->set_data(ifmap_vector[streamLabel][i], false);
                 }
+                if(measure_latency){
+                        std::lock_guard lock(latency_mutex);
+                        frame_start_times[streamLabel].push_back(std::chrono::steady_clock::now());
+                }
                 sent_frame_count_vector[streamLabel]++;
                 return true;
         }
@@ -262,6 +392,14 @@ bool outcallback_ms(vector<const MX::Types::FeatureMap<float>*> src, int streamL
         for(int i = 0; i<model_info_vector[streamLabel].num_out_featuremaps; ++i){
                 src[i]->get_data(ofmap_vector[streamLabel][i], false);
         }
+        if(measure_latency){
+                std::lock_guard lock(latency_mutex);
+                if(!frame_start_times[streamLabel].empty()){
+                        frame_latencies_us.push_back(std::chrono::duration<double, std::micro>(
+                                std::chrono::steady_clock::now() - frame_start_times[streamLabel].front()).count());
+                        frame_start_times[streamLabel].pop_front();
+                }
+        }
 
 
         if( recv_frame_count_vector[streamLabel]!=0 && recv_frame_count_vector[streamLabel] % 50 == 0){
@@ -295,6 +433,9 @@ void print_bench_setting_info(){
         std::cout << "Number of frame per stream            = " << frame_count << "\n";
         std::cout << "Number of input workers set to        = " << ((num_input_workers == 0 || num_input_workers > num_streams) ? num_streams : num_input_workers) <<"\n";
         std::cout << "Number of output workers set to       = " << ((num_output_workers == 0 || num_output_workers > num_streams) ? num_streams : num_output_workers) <<"\n";
+        std::cout << "Pipeline depth per stream             = " << pipeline_depth << "\n";
+        std::cout << "Send stage scheduling policy          = " << schedule_name << "\n";
+        std::cout << "Auto tuning of workers                = " << (auto_tune ? "on" : "off") << "\n";
         std::cout << "number of devices used                = " << num_devices << "\n";
         std::cout << "Number of FMap conversion threads     = " << num_fmap_convert_threads << "\n";
 
@@ -359,10 +500,18 @@ void model_bench(int num_models){
                         sent_frame_count_vector.push_back(0);
                         recv_frame_count_vector.push_back(0);
                         temp_start_ms_vector.push_back(temp_start_ms);
+                        frame_start_times.emplace_back();
                         fps_values.push_back(0.0);
                         fps_avg_counters.push_back(0);
                         // running_fps_values.push_back(0.0);
-                        accl->connect_stream(&incallback_ms, &outcallback_ms, model_unique_stream_start+stream_id, model_index );
+                        MX::Types::StreamOptions stream_options;
+                        if(stream_id < static_cast<int>(stream_weights.size())){
+                                stream_options.weight = stream_weights[stream_id];
+                                stream_options.priority = stream_weights[stream_id];
+                        }
+                        stream_options.deadline_us = stream_deadline_us;
+                        stream_options.freshest_only = freshest_only;
+                        accl->connect_stream(&incallback_ms, &outcallback_ms, model_unique_stream_start+stream_id, stream_options, model_index );
                         if(verbose){
                                 std::cout<<"Connected stream "<< model_unique_stream_start+stream_id <<" for model "<< model_index << "\n\n"; 
                                 std::cout << "\033[3;33m*************************************************\033[m\n";   
@@ -402,6 +551,26 @@ void model_bench(int num_models){
         float fps_per_stream = fps_total / connected_streams;
         std::cout << "\rAverage FPS per stream : "<< fps_per_stream << "\033[m\n";
         std::cout << "\rAverage FPS for DFP    : "<< fps_total << "\033[m\n";
+        if(measure_latency && freshest_only){
+                std::cout << "\nLatency is not reported with --freshest as dropped frames have no output\n";
+        }
+        else if(measure_latency && !frame_latencies_us.empty()){
+                std::sort(frame_latencies_us.begin(), frame_latencies_us.end());
+                size_t n = frame_latencies_us.size();
+                std::cout << "\rLatency p50 (us)       : " << frame_latencies_us[n/2] << "\033[m\n";
+                std::cout << "\rLatency p99 (us)       : " << frame_latencies_us[std::min(n-1, (n*99)/100)] << "\033[m\n";
+                std::cout << "\rLatency max (us)       : " << frame_latencies_us[n-1] << "\033[m\n";
+        }
+        if(verbose || schedule_policy != MX::Types::SCHEDULE_FIFO || freshest_only){
+                std::cout << "\nSend stage wait per stream (" << schedule_name << ")\n";
+                std::cout << "Stream | Frames | Avg wait (us) | Max wait (us) | Deadline misses | Dropped\n";
+                for(int stream = 0; stream < connected_streams; ++stream){
+                        MX::Types::StreamStats stats = accl->get_stream_stats(stream);
+                        std::cout << std::setw(6) << stream << " | " << std::setw(6) << stats.frames_sent << " | "
+                                  << std::setw(13) << stats.avg_wait_us << " | " << std::setw(13) << stats.max_wait_us << " | "
+                                  << std::setw(15) << stats.deadline_misses << " | " << std::setw(7) << stats.frames_dropped << "\n";
+                }
+        }
         if(verbose){
                 std::cout << "\n\n*************************************************\033[m\n";
                 std::cout<<"\n\n";
@@ -413,8 +582,19 @@ void send_data(int stream_label){
         int sent_frame = 0; 
 
         while(sent_frame_count_vector[stream_label]  < frame_count && runflag.load()){
-                accl_mt->send_input(ifmap_vector[stream_label], model_info_vector[stream_label].model_index, stream_label, false);
-                sent_frame_count_vector[stream_label]++;
+                int num_frames = std::min(batch_size, frame_count - sent_frame_count_vector[stream_label]);
+                auto send_start = std::chrono::steady_clock::now();
+                if(batch_size > 1){
+                        //the frames are counted before the batch is sent, so the receive thread takes them as they come out
+                        std::vector<std::vector<float*>> batch(num_frames, ifmap_vector[stream_label]);
+                        sent_frame_count_vector[stream_label] += num_frames;
+                        accl_mt->send_batch(batch, model_info_vector[stream_label].model_index, stream_label);
+                }
+                else{
+                        accl_mt->send_input(ifmap_vector[stream_label], model_info_vector[stream_label].model_index, stream_label, false);
+                        sent_frame_count_vector[stream_label]++;
+                }
+                total_send_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - send_start).count();
         }
 }
 
@@ -423,7 +603,7 @@ void receive_data(int model_index,int stream_id_recv){
         std::vector<float*> out_data;
         out_data.reserve(minfo.num_out_featuremaps);
         for(int i=0; i<minfo.num_out_featuremaps ; i++){
-                float* ofmap = new float[minfo.out_featuremap_sizes[i]];
+                float* ofmap = new float[minfo.out_featuremap_sizes[i] * batch_size];
                 out_data.push_back(ofmap);
         }
         float fps = 0.0;
@@ -431,9 +611,20 @@ void receive_data(int model_index,int stream_id_recv){
                 if(sent_frame_count_vector[stream_id_recv]<=recv_frame_count_vector[stream_id_recv]){
                         continue;
                 }
-                accl_mt->receive_output(out_data, model_index, stream_id_recv, false);
+                int num_frames = 1;
+                if(batch_size > 1){
+                        //receive what has been sent, at most one batch
+                        num_frames = std::min(batch_size, sent_frame_count_vector[stream_id_recv] - recv_frame_count_vector[stream_id_recv]);
+                        accl_mt->receive_batch(out_data, num_frames, model_index, stream_id_recv);
+                        recv_frame_count_vector[stream_id_recv] += num_frames - 1;
+                }
+                else{
+                        accl_mt->receive_output(out_data, model_index, stream_id_recv, false);
+                }
 
-                if( recv_frame_count_vector[stream_id_recv]!=0 && recv_frame_count_vector[stream_id_recv] % 50 == 0){
+                //a batch may step over the multiple of 50
+                int recv_count = recv_frame_count_vector[stream_id_recv];
+                if( recv_count!=0 && (recv_count % 50 == 0 || recv_count / 50 != (recv_count - num_frames + 1) / 50)){
                         std::chrono::milliseconds duration =
                                 std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()) - temp_start_ms_vector[stream_id_recv];
 
@@ -535,6 +726,11 @@ void manual_model_bench(int num_models){
         float fps_per_stream = fps_total / (num_models*num_streams);
         std::cout << "\rAverage FPS per stream : "<< fps_per_stream << "\033[m\n";
         std::cout << "\rAverage FPS for DFP    : "<< fps_total << "\033[m\n";
+        int total_sent = std::accumulate(sent_frame_count_vector.begin(), sent_frame_count_vector.end(), 0);
+        if(total_sent > 0){
+                std::cout << "\rSend time per frame    : " << (double) total_send_ns.load() / 1000.0 / total_sent << " us"
+                          << (batch_size > 1 ? " (send_batch of " + std::to_string(batch_size) + ")" : std::string(" (send_input)")) << "\033[m\n";
+        }
         if(verbose){
                 std::cout << "\n\n*************************************************\033[m\n";
                 std::cout<<"\n\n";
@@ -640,6 +836,64 @@ int main(int argc, char **argv)
                                 if (errno)
                                         _error_exit(optarg);
                                 break;
+                        case PD_OPT:
+                                errno =0;
+                                pipeline_depth = strtol(optarg, NULL, 0);
+                                if (errno)
+                                        _error_exit(optarg);
+                                break;
+                        case SCHED_OPT:
+                                if (!parse_schedule_policy(optarg))
+                                        _error_exit(optarg);
+                                break;
+                        case WEIGHTS_OPT:
+                                parse_stream_weights(optarg);
+                                break;
+                        case DEADLINE_OPT:
+                                errno =0;
+                                stream_deadline_us = strtol(optarg, NULL, 0);
+                                if (errno)
+                                        _error_exit(optarg);
+                                break;
+                        case LATENCY_OPT:
+                                measure_latency = true;
+                                break;
+                        case PIN_WORKERS_OPT:
+                                thread_policy.input_workers.cpus = parse_cpu_list(optarg);
+                                thread_policy.output_workers.cpus = thread_policy.input_workers.cpus;
+                                break;
+                        case PIN_IO_OPT:
+                                thread_policy.send.cpus = parse_cpu_list(optarg);
+                                thread_policy.recv.cpus = thread_policy.send.cpus;
+                                break;
+                        case RT_PRIO_OPT:
+                                errno =0;
+                                thread_policy.send.rt_priority = strtol(optarg, NULL, 0);
+                                thread_policy.recv.rt_priority = thread_policy.send.rt_priority;
+                                if (errno)
+                                        _error_exit(optarg);
+                                break;
+                        case BATCH_OPT:
+                                errno =0;
+                                batch_size = strtol(optarg, NULL, 0);
+                                if (errno || batch_size < 1)
+                                        _error_exit(optarg);
+                                break;
+                        case DEVICE_CACHE_OPT:
+                                device_cache = true;
+                                break;
+                        case DS_AL:
+                                all_devices = true;
+                                break;
+                        case MLOCK_OPT:
+                                thread_policy.lock_memory = true;
+                                break;
+                        case AUTOTUNE_OPT:
+                                auto_tune = true;
+                                break;
+                        case FRESH_OPT:
+                                freshest_only = true;
+                                break;
                         case MD_IDS:
                                 errno = 0;
                                 if(optarg){
@@ -687,15 +941,21 @@ int main(int argc, char **argv)
                         print_usage(argc, argv);
                         exit(EXIT_FAILURE);
                 }
+                if(all_devices){
+                        device_ids = {MX::Types::ALL_DEVICES};
+                        multi_device_bench = true;
+                }
                 if(manual_threading){
+                        accl_mt = new MX::Runtime::MxAcclMT;
+                        accl_mt->set_device_cache(device_cache);
                         if(multi_device_bench){
-                                accl_mt = new MX::Runtime::MxAcclMT;
                                 accl_mt->connect_dfp(dfp_path, device_ids);
                         }
                         else {
-                                accl_mt = new MX::Runtime::MxAcclMT;
                                 accl_mt->connect_dfp(dfp_path, grp_id);
                         }
+                        print_connect_stats(accl_mt->get_connect_stats());
+                        print_devices(accl_mt->get_device_capacity());
                         num_models = accl_mt->get_num_models();
                         for(int i=0; i < num_models; i++){
                                 accl_mt->set_parallel_fmap_convert(num_fmap_convert_threads, i);
@@ -708,20 +968,26 @@ int main(int argc, char **argv)
 
                 }
                 else{
+                        accl = new MX::Runtime::MxAccl;
+                        accl->set_device_cache(device_cache);
                         if(multi_device_bench){
-                                accl = new MX::Runtime::MxAccl;
                                 accl->connect_dfp(dfp_path, device_ids);
 
                         }
                         else{
-                                accl = new MX::Runtime::MxAccl;
                                 accl->connect_dfp(dfp_path, grp_id);
                         }
+                        print_connect_stats(accl->get_connect_stats());
+                        print_devices(accl->get_device_capacity());
 
                         accl->set_num_workers(num_input_workers,num_output_workers);
                         num_models = accl->get_num_models();
                         for(int i=0; i < num_models; i++){
                                 accl->set_parallel_fmap_convert(num_fmap_convert_threads, i);
+                                accl->set_pipeline_depth(pipeline_depth, i);
+                                accl->set_schedule_policy(schedule_policy, i);
+                                accl->set_auto_tune(auto_tune, MX::Types::AutoTuneConfig(), i);
+                                accl->set_thread_policy(thread_policy, i);
                         }
                         dfp_num_chips = accl->get_dfp_num_chips();
                         if(verbose)